@@ -0,0 +1,301 @@
+#include "Benchmark.hpp"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Profile
+#include "Profile.hpp"
+
+namespace
+{
+
+// Writes a string as a JSON string.
+void writeString(std::ostream &out, const std::string &s)
+{
+    out << '"';
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << s[i];
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+        {
+            out << s[i];
+        }
+    }
+    out << '"';
+}
+
+// Formats a rate with a metric prefix and a space, as "12.3 M".
+std::string formatRate(double rate)
+{
+    const char *prefixes[] = { " ", " k", " M", " G", " T" };
+    size_t p = 0;
+    while (rate >= 1000.0 && p + 1 < sizeof(prefixes) / sizeof(prefixes[0]))
+    {
+        rate /= 1000.0;
+        ++p;
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3g%s", rate, prefixes[p]);
+    return text;
+}
+
+}
+
+BenchmarkState::BenchmarkState(size_t size, int threads, double minSeconds, size_t maxIterations)
+    : size_(size), threads_(threads), minSeconds_(minSeconds), maxIterations_(maxIterations),
+      started_(false), running_(false), current_(0.0), total_(0.0), items_(0), bytes_(0)
+{
+}
+
+bool BenchmarkState::keepRunning()
+{
+    if (!started_)
+    {
+        // The first iteration, the input is ready.
+        started_ = true;
+        Profile::instance().reset();
+    }
+    else
+    {
+        pauseTiming();
+        times_.push_back(current_);
+        total_ += current_;
+        current_ = 0.0;
+        if (!error_.empty() || times_.size() >= maxIterations_ || total_ >= minSeconds_)
+        {
+            return false;
+        }
+    }
+    resumeTiming();
+    return true;
+}
+
+void BenchmarkState::pauseTiming()
+{
+    if (running_)
+    {
+        current_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        running_ = false;
+    }
+}
+
+void BenchmarkState::resumeTiming()
+{
+    if (!running_)
+    {
+        running_ = true;
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+BenchmarkSuite::BenchmarkSuite()
+    : scale_(1.0), minSeconds_(1.0), maxIterations_(100)
+{
+    threads_.push_back(1);
+    int hardware = static_cast<int>(std::thread::hardware_concurrency());
+    if (hardware > 1)
+    {
+        threads_.push_back(hardware);
+    }
+}
+
+void BenchmarkSuite::add(const std::string &name, const Function &function, const std::vector<size_t> &sizes, bool threaded)
+{
+    Benchmark benchmark = { name, function, sizes, threaded };
+    benchmarks_.push_back(benchmark);
+}
+
+void BenchmarkSuite::list() const
+{
+    for (size_t b = 0; b < benchmarks_.size(); ++b)
+    {
+        std::cout << benchmarks_[b].name << (benchmarks_[b].threaded ? " (threaded)" : "") << ", sizes";
+        for (size_t s = 0; s < benchmarks_[b].sizes.size(); ++s)
+        {
+            std::cout << ' ' << benchmarks_[b].sizes[s];
+        }
+        std::cout << '\n';
+    }
+}
+
+bool BenchmarkSuite::run()
+{
+    bool ok = true;
+    results_.clear();
+    for (size_t b = 0; b < benchmarks_.size(); ++b)
+    {
+        const Benchmark &benchmark = benchmarks_[b];
+        if (benchmark.name.find(filter_) == std::string::npos)
+        {
+            continue;
+        }
+
+        std::vector<int> threads = benchmark.threaded ? threads_ : std::vector<int>(1, 0);
+        for (size_t s = 0; s < benchmark.sizes.size(); ++s)
+        {
+            size_t size = std::max(static_cast<size_t>(1), static_cast<size_t>(std::llround(benchmark.sizes[s] * scale_)));
+            for (size_t t = 0; t < threads.size(); ++t)
+            {
+                results_.push_back(runCase(benchmark, size, threads[t]));
+                print(results_.back());
+                ok = ok && results_.back().error.empty();
+            }
+        }
+    }
+    return ok;
+}
+
+BenchmarkResult BenchmarkSuite::runCase(const Benchmark &benchmark, size_t size, int threads) const
+{
+    BenchmarkState state(size, threads, minSeconds_, maxIterations_);
+    try
+    {
+        benchmark.function(state);
+        if (state.error_.empty() && state.times_.empty())
+        {
+            state.error_ = "the case did not run its loop";
+        }
+    }
+    catch (const std::exception &e)
+    {
+        state.error_ = e.what();
+    }
+
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.size = size;
+    result.threads = threads;
+    result.iterations = state.times_.size();
+    result.medianSeconds = 0.0;
+    result.minSeconds = 0.0;
+    result.itemsPerSecond = 0.0;
+    result.bytesPerSecond = 0.0;
+    result.peakBytes = Profile::peakResidentBytes();
+    result.label = state.label_;
+    result.error = state.error_;
+
+    if (!state.times_.empty())
+    {
+        std::vector<double> times = state.times_;
+        std::sort(times.begin(), times.end());
+        size_t n = times.size();
+        result.medianSeconds = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+        result.minSeconds = times.front();
+        if (result.medianSeconds > 0.0)
+        {
+            result.itemsPerSecond = static_cast<double>(state.items_) / result.medianSeconds;
+            result.bytesPerSecond = static_cast<double>(state.bytes_) / result.medianSeconds;
+        }
+        for (size_t p = 0; p < state.phaseNames_.size(); ++p)
+        {
+            double seconds = Profile::instance().getPhaseSeconds(state.phaseNames_[p]) / static_cast<double>(n);
+            result.phases.push_back(std::make_pair(state.phaseNames_[p], seconds));
+        }
+    }
+    return result;
+}
+
+void BenchmarkSuite::print(const BenchmarkResult &result) const
+{
+    std::ostringstream line;
+    line << result.name << '/' << result.size;
+    if (result.threads > 0)
+    {
+        line << "/threads:" << result.threads;
+    }
+    if (!result.error.empty())
+    {
+        line << "  FAILED: " << result.error;
+        std::cout << line.str() << std::endl;
+        return;
+    }
+
+    char text[64];
+    std::snprintf(text, sizeof(text), "  %.3f ms median, %.3f ms min, %lu iterations",
+                  1000.0 * result.medianSeconds, 1000.0 * result.minSeconds, static_cast<unsigned long>(result.iterations));
+    line << text;
+    if (result.itemsPerSecond > 0.0)
+    {
+        line << ", " << formatRate(result.itemsPerSecond) << "items/s";
+    }
+    if (result.bytesPerSecond > 0.0)
+    {
+        line << ", " << formatRate(result.bytesPerSecond) << "B/s";
+    }
+    for (size_t p = 0; p < result.phases.size(); ++p)
+    {
+        std::snprintf(text, sizeof(text), "%.3f", 1000.0 * result.phases[p].second);
+        line << (p == 0 ? "\n    " : ", ") << result.phases[p].first << ' ' << text << " ms";
+    }
+    if (!result.label.empty())
+    {
+        line << "\n    " << result.label;
+    }
+    std::cout << line.str() << std::endl;
+}
+
+bool BenchmarkSuite::writeJson(const std::string &filename) const
+{
+    std::ofstream out(filename.c_str());
+    if (!out.is_open())
+    {
+        return false;
+    }
+
+    out.precision(9);
+    out << "{\n  \"hardware_threads\": " << std::thread::hardware_concurrency();
+    out << ",\n  \"results\": [";
+    for (size_t r = 0; r < results_.size(); ++r)
+    {
+        const BenchmarkResult &result = results_[r];
+        out << (r == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        writeString(out, result.name);
+        out << ", \"size\": " << result.size << ", \"threads\": " << result.threads;
+        if (!result.error.empty())
+        {
+            out << ", \"error\": ";
+            writeString(out, result.error);
+            out << "}";
+            continue;
+        }
+        out << ", \"iterations\": " << result.iterations
+            << ", \"median_seconds\": " << result.medianSeconds
+            << ", \"min_seconds\": " << result.minSeconds
+            << ", \"items_per_second\": " << result.itemsPerSecond
+            << ", \"bytes_per_second\": " << result.bytesPerSecond
+            << ", \"peak_rss_bytes\": " << result.peakBytes
+            << ", \"phases\": {";
+        for (size_t p = 0; p < result.phases.size(); ++p)
+        {
+            out << (p == 0 ? "" : ", ");
+            writeString(out, result.phases[p].first);
+            out << ": " << result.phases[p].second;
+        }
+        out << "}";
+        if (!result.label.empty())
+        {
+            out << ", \"label\": ";
+            writeString(out, result.label);
+        }
+        out << "}";
+    }
+    out << (results_.empty() ? "]" : "\n  ]") << "\n}\n";
+    return out.good();
+}
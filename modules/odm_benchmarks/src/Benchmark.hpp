@@ -0,0 +1,196 @@
+#pragma once
+
+// C++
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief   The BenchmarkState class is handed to a benchmark case, and times its iterations.
+ * \details A case prepares its input, then runs the code to measure in a loop of
+ *          "while (state.keepRunning())". The loop runs at least once, and until the
+ *          iterations took the minimum time of the run, or the iteration limit is hit.
+ *          The profile of the process is reset when the loop starts, so the phases of the
+ *          instrumented modules are reported per iteration.
+ */
+class BenchmarkState
+{
+public:
+    BenchmarkState(size_t size, int threads, double minSeconds, size_t maxIterations);
+
+    /*!
+     * \brief size      The size of the input of the case, in the unit of the case.
+     */
+    size_t size() const { return size_; }
+
+    /*!
+     * \brief threads   The number of threads to use, 0 if the case is not threaded.
+     */
+    int threads() const { return threads_; }
+
+    /*!
+     * \brief keepRunning   Ends the timing of the previous iteration, if any.
+     * \return              True if another iteration is to run, its timing starts at once.
+     */
+    bool keepRunning();
+
+    /*!
+     * \brief pauseTiming   Stops the clock of the current iteration, as for resetting its input.
+     */
+    void pauseTiming();
+
+    /*!
+     * \brief resumeTiming  Restarts the clock of the current iteration.
+     */
+    void resumeTiming();
+
+    /*!
+     * \brief setItems  Sets the number of items, as faces or points, processed by one iteration.
+     */
+    void setItems(uint64_t items) { items_ = items; }
+
+    /*!
+     * \brief setBytes  Sets the number of bytes read or written by one iteration.
+     */
+    void setBytes(uint64_t bytes) { bytes_ = bytes; }
+
+    /*!
+     * \brief addPhase  Reports the time of a phase of the profile per iteration, next to the total.
+     */
+    void addPhase(const std::string &name) { phaseNames_.push_back(name); }
+
+    /*!
+     * \brief setLabel  Sets a note on the case shown with its result, as the generated input.
+     */
+    void setLabel(const std::string &label) { label_ = label; }
+
+    /*!
+     * \brief skip      Marks the case as not run, with the reason.
+     */
+    void skip(const std::string &reason) { error_ = reason; }
+
+private:
+    friend class BenchmarkSuite;
+
+    size_t size_;                       /**< The size of the input. */
+    int threads_;                       /**< The number of threads, 0 if not threaded. */
+    double minSeconds_;                 /**< The least total time of the iterations. */
+    size_t maxIterations_;              /**< The most iterations. */
+
+    bool started_;                      /**< True once the loop started. */
+    bool running_;                      /**< True while an iteration is timed. */
+    std::chrono::steady_clock::time_point start_;   /**< The start of the timed part of the current iteration. */
+    double current_;                    /**< The time of the current iteration so far, in seconds. */
+    double total_;                      /**< The total time of the iterations, in seconds. */
+    std::vector<double> times_;         /**< The time of each iteration, in seconds. */
+
+    uint64_t items_;                    /**< Items processed per iteration. */
+    uint64_t bytes_;                    /**< Bytes processed per iteration. */
+    std::vector<std::string> phaseNames_;   /**< The phases to report. */
+    std::string label_;                 /**< The note on the case. */
+    std::string error_;                 /**< Why the case did not run, empty if it did. */
+};
+
+/*!
+ * \brief   The result of one benchmark case, for one size and thread count.
+ */
+struct BenchmarkResult
+{
+    std::string name;                   /**< The name of the benchmark. */
+    size_t size;                        /**< The size of the input. */
+    int threads;                        /**< The number of threads, 0 if not threaded. */
+    size_t iterations;                  /**< The number of timed iterations. */
+    double medianSeconds;               /**< The median time of an iteration. */
+    double minSeconds;                  /**< The fastest iteration. */
+    double itemsPerSecond;              /**< Items per second at the median time, 0 if not given. */
+    double bytesPerSecond;              /**< Bytes per second at the median time, 0 if not given. */
+    uint64_t peakBytes;                 /**< The peak resident set size of the process after the case. */
+    std::vector<std::pair<std::string, double> > phases;   /**< The reported phases, in seconds per iteration. */
+    std::string label;                  /**< The note on the case. */
+    std::string error;                  /**< Why the case did not run, empty if it did. */
+};
+
+/*!
+ * \brief   The BenchmarkSuite class holds the benchmarks, runs them over their sizes and thread counts,
+ *          and reports the results as a table and as JSON.
+ */
+class BenchmarkSuite
+{
+public:
+    typedef std::function<void (BenchmarkState &)> Function;
+
+    BenchmarkSuite();
+
+    /*!
+     * \brief add       Adds a benchmark.
+     * \param name      The name of the benchmark, as "group/case".
+     * \param function  The case, called once per size and thread count.
+     * \param sizes     The sizes the case is run for, scaled by setScale.
+     * \param threaded  True if the case is run for every thread count, else once with 0 threads.
+     */
+    void add(const std::string &name, const Function &function, const std::vector<size_t> &sizes, bool threaded);
+
+    /*!
+     * \brief setThreads    Sets the thread counts of the threaded benchmarks, by default 1 and all hardware threads.
+     */
+    void setThreads(const std::vector<int> &threads) { threads_ = threads; }
+
+    /*!
+     * \brief setScale      Scales the sizes of all benchmarks.
+     */
+    void setScale(double scale) { scale_ = scale; }
+
+    /*!
+     * \brief setMinSeconds Sets the least total time of the iterations of a case.
+     */
+    void setMinSeconds(double seconds) { minSeconds_ = seconds; }
+
+    /*!
+     * \brief setMaxIterations  Sets the most iterations of a case.
+     */
+    void setMaxIterations(size_t iterations) { maxIterations_ = iterations; }
+
+    /*!
+     * \brief setFilter     Only runs the benchmarks whose name contains filter.
+     */
+    void setFilter(const std::string &filter) { filter_ = filter; }
+
+    /*!
+     * \brief list          Prints the names of the benchmarks.
+     */
+    void list() const;
+
+    /*!
+     * \brief run           Runs the benchmarks and prints each result as it is done.
+     * \return              False if a case failed.
+     */
+    bool run();
+
+    /*!
+     * \brief writeJson     Writes the results of run.
+     * \return              False if the file could not be written.
+     */
+    bool writeJson(const std::string &filename) const;
+
+private:
+    struct Benchmark
+    {
+        std::string name;               /**< The name of the benchmark. */
+        Function function;              /**< The case. */
+        std::vector<size_t> sizes;      /**< The sizes, before scaling. */
+        bool threaded;                  /**< True if run for every thread count. */
+    };
+
+    BenchmarkResult runCase(const Benchmark &benchmark, size_t size, int threads) const;
+    void print(const BenchmarkResult &result) const;
+
+    std::vector<Benchmark> benchmarks_; /**< The benchmarks, in the order they were added. */
+    std::vector<int> threads_;          /**< The thread counts of the threaded benchmarks. */
+    double scale_;                      /**< The scale of the sizes. */
+    double minSeconds_;                 /**< The least total time of the iterations of a case. */
+    size_t maxIterations_;              /**< The most iterations of a case. */
+    std::string filter_;                /**< The part of the names of the benchmarks to run. */
+    std::vector<BenchmarkResult> results_;  /**< The results of run. */
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+// C++
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+
+/*!
+ * \brief   The ArgumentList class builds the arguments of a run of a module, as its main receives them.
+ */
+class ArgumentList
+{
+public:
+    explicit ArgumentList(const std::string &program) { add(program); }
+
+    void add(const std::string &argument) { arguments_.push_back(argument); }
+    void add(const std::string &option, const std::string &value) { add(option); add(value); }
+
+    int argc() const { return static_cast<int>(arguments_.size()); }
+
+    /*!
+     * \brief argv  The arguments, valid until the list changes.
+     */
+    char** argv()
+    {
+        pointers_.clear();
+        for (size_t a = 0; a < arguments_.size(); ++a)
+        {
+            pointers_.push_back(&arguments_[a][0]);
+        }
+        pointers_.push_back(NULL);
+        return &pointers_[0];
+    }
+
+private:
+    std::vector<std::string> arguments_;    /**< The arguments, starting with the program. */
+    std::vector<char *> pointers_;          /**< The arguments as given to main. */
+};
+
+/*!
+ * \brief addMeshIOBenchmarks   Adds the benchmarks of the OBJ and binary mesh readers shared by odm_georef and
+ *                              odm_orthophoto, and of the OBJ writer of odm_georef.
+ */
+void addMeshIOBenchmarks(BenchmarkSuite &suite, const std::string &workDir);
+
+/*!
+ * \brief addGeorefBenchmarks   Adds the benchmarks of odm_georef, with cameras and with GCPs.
+ */
+void addGeorefBenchmarks(BenchmarkSuite &suite, const std::string &workDir);
+
+/*!
+ * \brief addOrthoPhotoBenchmarks   Adds the benchmarks of odm_orthophoto, over the faces and over the pixels.
+ */
+void addOrthoPhotoBenchmarks(BenchmarkSuite &suite, const std::string &workDir);
+
+/*!
+ * \brief addPointCloudBenchmarks   Adds the benchmarks of the PLY reader and of the pipelines of odm_filterpoints.
+ */
+void addPointCloudBenchmarks(BenchmarkSuite &suite, const std::string &workDir);
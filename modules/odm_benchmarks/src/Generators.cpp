@@ -0,0 +1,384 @@
+#include "Generators.hpp"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+// POSIX
+#include <sys/stat.h>
+
+// PCL
+#include <pcl/conversions.h>
+#include <pcl/point_types.h>
+
+// OpenCV
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+// Eigen
+#include <Eigen/Geometry>
+
+// Mesh IO
+#include "BinaryMesh.hpp"
+
+// Modified PCL functions
+#include "modifiedPclFunctions.hpp"
+
+namespace Generators
+{
+
+namespace
+{
+
+const double cameraAltitude = 60.0;         // The height of the cameras above the model origin.
+const double focalLength = 500.0;           // The focal length of the cameras, in pixels.
+const int imageWidth = 800;                 // The size of the images of the cameras.
+const int imageHeight = 600;
+const double utmEastOffset = 500000.0;      // The offset of the georeferenced system.
+const double utmNorthOffset = 4000000.0;
+
+// The files written by this process.
+std::set<std::string> writtenFiles;
+
+// True the first time a file is asked for, when it has to be written.
+bool claim(const std::string &filename)
+{
+    return writtenFiles.insert(filename).second;
+}
+
+// The height of the terrain.
+double terrainHeight(double x, double y)
+{
+    return 4.0 * std::sin(x / 11.0) * std::cos(y / 17.0) + 2.0 * std::sin((x + y) / 7.0);
+}
+
+// The transform from model coordinates to the georeferenced system, without the offset.
+Eigen::Affine3d georeferenceTransform()
+{
+    Eigen::Affine3d transform = Eigen::Affine3d::Identity();
+    transform.translate(Eigen::Vector3d(1234.5, 5678.25, 100.0));
+    transform.rotate(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitZ()));
+    transform.scale(1.5);
+    return transform;
+}
+
+std::string textureName(size_t material, int size)
+{
+    return "texture_" + std::to_string(size) + "_" + std::to_string(material) + ".jpg";
+}
+
+void writeTexture(const std::string &filename, int size, size_t material)
+{
+    cv::Mat texture(size, size, CV_8UC3);
+    cv::theRNG().state = static_cast<uint64_t>(material) + 1;
+    cv::randu(texture, cv::Scalar::all(0), cv::Scalar::all(256));
+    // A checker board over the noise, so that the texture compresses like a photo and not like noise.
+    for (int row = 0; row < size; ++row)
+    {
+        for (int col = 0; col < size; ++col)
+        {
+            if (((row / 32) + (col / 32)) % 2)
+            {
+                texture.at<cv::Vec3b>(row, col) /= 4;
+            }
+        }
+    }
+    if (!cv::imwrite(filename, texture))
+    {
+        throw std::runtime_error("Could not write " + filename);
+    }
+}
+
+}
+
+pcl::TextureMesh makeTerrainMesh(size_t faces, size_t materials, int textureSize, const std::string &directory)
+{
+    size_t cells = std::max(static_cast<size_t>(1), static_cast<size_t>(std::sqrt(faces / 2.0) + 0.5));
+    size_t side = cells + 1;
+    materials = std::max(static_cast<size_t>(1), std::min(materials, cells));
+    double step = terrainExtent / static_cast<double>(cells);
+
+    pcl::PointCloud<pcl::PointXYZ> cloud;
+    cloud.points.reserve(side * side);
+    for (size_t j = 0; j < side; ++j)
+    {
+        for (size_t i = 0; i < side; ++i)
+        {
+            double x = static_cast<double>(i) * step;
+            double y = static_cast<double>(j) * step;
+            cloud.points.push_back(pcl::PointXYZ(static_cast<float>(x), static_cast<float>(y), static_cast<float>(terrainHeight(x, y))));
+        }
+    }
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    cloud.height = 1;
+
+    pcl::TextureMesh mesh;
+    pcl::toPCLPointCloud2(cloud, mesh.cloud);
+    mesh.tex_polygons.resize(materials);
+    mesh.tex_coordinates.resize(materials);
+    mesh.tex_materials.resize(materials);
+
+    for (size_t m = 0; m < materials; ++m)
+    {
+        pcl::TexMaterial &material = mesh.tex_materials[m];
+        material.tex_name = "material" + std::to_string(m);
+        material.tex_file = textureName(m, textureSize);
+        material.tex_Ka.r = material.tex_Ka.g = material.tex_Ka.b = 1.0f;
+        material.tex_Kd.r = material.tex_Kd.g = material.tex_Kd.b = 1.0f;
+        material.tex_Ks.r = material.tex_Ks.g = material.tex_Ks.b = 0.0f;
+        material.tex_d = 1.0f;
+        material.tex_Ns = 0.0f;
+        material.tex_illum = 1;
+
+        std::string textureFile = directory + "/" + material.tex_file;
+        if (claim(textureFile))
+        {
+            writeTexture(textureFile, textureSize, m);
+        }
+    }
+
+    // Every material textures a band of columns, its texture spans the band.
+    for (size_t j = 0; j < cells; ++j)
+    {
+        for (size_t i = 0; i < cells; ++i)
+        {
+            size_t m = i * materials / cells;
+            size_t firstColumn = (m * cells + materials - 1) / materials;
+            size_t lastColumn = ((m + 1) * cells + materials - 1) / materials;
+            float bandWidth = static_cast<float>(lastColumn - firstColumn);
+
+            uint32_t v00 = static_cast<uint32_t>(j * side + i);
+            uint32_t v10 = v00 + 1;
+            uint32_t v01 = v00 + static_cast<uint32_t>(side);
+            uint32_t v11 = v01 + 1;
+            uint32_t triangles[2][3] = { { v00, v10, v11 }, { v00, v11, v01 } };
+            for (size_t t = 0; t < 2; ++t)
+            {
+                pcl::Vertices face;
+                face.vertices.assign(triangles[t], triangles[t] + 3);
+                mesh.tex_polygons[m].push_back(face);
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    size_t column = triangles[t][c] % side;
+                    size_t row = triangles[t][c] / side;
+                    mesh.tex_coordinates[m].push_back(Eigen::Vector2f(static_cast<float>(column - firstColumn) / bandWidth,
+                                                                      static_cast<float>(row) / static_cast<float>(cells)));
+                }
+            }
+        }
+    }
+    return mesh;
+}
+
+std::string writeObjMesh(const std::string &directory, size_t faces, size_t materials, int textureSize)
+{
+    std::ostringstream name;
+    name << directory << "/terrain_" << faces << "_" << materials << "_" << textureSize << ".obj";
+    if (claim(name.str()))
+    {
+        pcl::TextureMesh mesh = makeTerrainMesh(faces, materials, textureSize, directory);
+        if (saveOBJFile(name.str(), mesh, 8) != 0)
+        {
+            throw std::runtime_error("Could not write " + name.str());
+        }
+    }
+    return name.str();
+}
+
+std::string writeBinaryMesh(const std::string &directory, size_t faces, size_t materials, int textureSize)
+{
+    std::ostringstream name;
+    name << directory << "/terrain_" << faces << "_" << materials << "_" << textureSize << ".bin";
+    if (claim(name.str()))
+    {
+        pcl::TextureMesh mesh = makeTerrainMesh(faces, materials, textureSize, directory);
+        BinaryMesh::write(name.str(), mesh);
+    }
+    return name.str();
+}
+
+std::string writePlyPointCloud(const std::string &directory, size_t points)
+{
+    std::string filename = directory + "/point_cloud_" + std::to_string(points) + ".ply";
+    if (!claim(filename))
+    {
+        return filename;
+    }
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out << "ply\n"
+        << "format binary_little_endian 1.0\n"
+        << "element vertex " << points << "\n"
+        << "property float x\nproperty float y\nproperty float z\n"
+        << "property float nx\nproperty float ny\nproperty float nz\n"
+        << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+        << "end_header\n";
+
+    // The records are packed, 6 floats and 3 bytes. The hosts building ODM are little endian.
+    const size_t recordSize = 6 * sizeof(float) + 3;
+    std::vector<char> buffer;
+    buffer.reserve(65536 * recordSize);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(0.0f, static_cast<float>(terrainExtent));
+    std::uniform_real_distribution<float> noise(-0.02f, 0.02f);
+    std::uniform_int_distribution<int> outlier(0, 99);
+    std::uniform_int_distribution<int> color(0, 255);
+
+    for (size_t p = 0; p < points; ++p)
+    {
+        float values[6];
+        values[0] = position(rng);
+        values[1] = position(rng);
+        values[2] = static_cast<float>(terrainHeight(values[0], values[1])) + noise(rng);
+        if (outlier(rng) < 2)
+        {
+            values[2] += (outlier(rng) < 50 ? -1.0f : 1.0f) * (5.0f + position(rng) * 0.2f);
+        }
+        values[3] = 0.0f;
+        values[4] = 0.0f;
+        values[5] = 1.0f;
+
+        size_t offset = buffer.size();
+        buffer.resize(offset + recordSize);
+        std::memcpy(&buffer[offset], values, sizeof(values));
+        for (size_t c = 0; c < 3; ++c)
+        {
+            buffer[offset + sizeof(values) + c] = static_cast<char>(color(rng));
+        }
+
+        if (buffer.size() + recordSize > buffer.capacity() || p + 1 == points)
+        {
+            out.write(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+    if (!out.good())
+    {
+        throw std::runtime_error("Could not write " + filename);
+    }
+    return filename;
+}
+
+CameraSet writeCameraSet(const std::string &directory, size_t cameras, size_t gcps)
+{
+    std::ostringstream prefix;
+    prefix << directory << "/survey_" << cameras << "_" << gcps;
+
+    CameraSet set;
+    set.bundleFile = prefix.str() + "_bundle.out";
+    set.coordFile = prefix.str() + "_coords.txt";
+    set.gcpFile = gcps > 0 ? prefix.str() + "_gcp_list.txt" : "";
+    set.imagesPath = directory + "/images";
+    set.imagesListPath = prefix.str() + "_img_list.txt";
+    if (!claim(set.bundleFile))
+    {
+        return set;
+    }
+
+    size_t side = std::max(static_cast<size_t>(2), static_cast<size_t>(std::sqrt(static_cast<double>(cameras)) + 0.5));
+    double spacing = terrainExtent / static_cast<double>(side);
+    std::vector<Eigen::Vector3d> centers;
+    for (size_t j = 0; j < side; ++j)
+    {
+        for (size_t i = 0; i < side; ++i)
+        {
+            centers.push_back(Eigen::Vector3d((static_cast<double>(i) + 0.5) * spacing, (static_cast<double>(j) + 0.5) * spacing, cameraAltitude));
+        }
+    }
+
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 0.01);
+    Eigen::Affine3d transform = georeferenceTransform();
+
+    // The cameras look straight down: a Bundler rotation of identity, and a translation of minus the center.
+    std::ofstream bundle(set.bundleFile.c_str());
+    bundle.precision(10);
+    bundle << "# Bundle file v0.3\n" << centers.size() << " 0\n";
+    for (size_t c = 0; c < centers.size(); ++c)
+    {
+        bundle << focalLength << " 0 0\n1 0 0\n0 1 0\n0 0 1\n"
+               << -centers[c].x() << " " << -centers[c].y() << " " << -centers[c].z() << "\n";
+    }
+
+    std::ofstream coords(set.coordFile.c_str());
+    coords.precision(10);
+    coords << "WGS84 UTM 32N\n" << static_cast<long>(utmEastOffset) << " " << static_cast<long>(utmNorthOffset) << "\n";
+    for (size_t c = 0; c < centers.size(); ++c)
+    {
+        Eigen::Vector3d position = transform * centers[c];
+        coords << position.x() + noise(rng) << " " << position.y() + noise(rng) << " " << position.z() + noise(rng) << "\n";
+    }
+
+    std::ofstream imageList(set.imagesListPath.c_str());
+    for (size_t c = 0; c < centers.size(); ++c)
+    {
+        char imageName[32];
+        std::snprintf(imageName, sizeof(imageName), "image_%06lu.jpg", static_cast<unsigned long>(c));
+        imageList << imageName << "\n";
+    }
+
+    if (!bundle.good() || !coords.good() || !imageList.good())
+    {
+        throw std::runtime_error("Could not write the survey " + prefix.str());
+    }
+    if (gcps == 0)
+    {
+        return set;
+    }
+
+    mkdir(set.imagesPath.c_str(), 0755);
+    cv::Mat blank(imageHeight, imageWidth, CV_8UC3, cv::Scalar::all(0));
+
+    std::ofstream gcpList(set.gcpFile.c_str());
+    gcpList.precision(10);
+    gcpList << "WGS84 UTM 32N\n";
+    std::uniform_real_distribution<double> position(0.1 * terrainExtent, 0.9 * terrainExtent);
+    for (size_t g = 0; g < gcps; ++g)
+    {
+        Eigen::Vector3d local(position(rng), position(rng), 0.0);
+        local.z() = terrainHeight(local.x(), local.y());
+
+        size_t i = std::min(side - 1, static_cast<size_t>(local.x() / spacing));
+        size_t j = std::min(side - 1, static_cast<size_t>(local.y() / spacing));
+        size_t c = j * side + i;
+
+        // The inverse of the ray odm_georef casts through the pixel, with the camera axes flipped from Bundler.
+        Eigen::Vector3d d = local - centers[c];
+        double pixelX = imageWidth / 2.0 + focalLength * d.x() / -d.z();
+        double pixelY = imageHeight / 2.0 + focalLength * d.y() / d.z();
+
+        char imageName[32];
+        std::snprintf(imageName, sizeof(imageName), "image_%06lu.jpg", static_cast<unsigned long>(c));
+        std::string imageFile = set.imagesPath + "/" + imageName;
+        if (claim(imageFile) && !cv::imwrite(imageFile, blank))
+        {
+            throw std::runtime_error("Could not write " + imageFile);
+        }
+
+        Eigen::Vector3d world = transform * local;
+        gcpList << world.x() + utmEastOffset << " " << world.y() + utmNorthOffset << " " << world.z() << " "
+                << pixelX << " " << pixelY << " " << imageName << " gcp" << g << "\n";
+    }
+    if (!gcpList.good())
+    {
+        throw std::runtime_error("Could not write " + set.gcpFile);
+    }
+    return set;
+}
+
+size_t fileSize(const std::string &filename)
+{
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+}
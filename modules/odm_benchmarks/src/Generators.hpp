@@ -0,0 +1,85 @@
+#pragma once
+
+// C++
+#include <string>
+
+// PCL
+#include <pcl/TextureMesh.h>
+
+/*!
+ * \brief   The synthetic inputs of the benchmarks.
+ * \details All inputs cover the same terrain, a square of terrainExtent meters with rolling
+ *          hills, in model coordinates. The files are written to a work directory and named
+ *          after their parameters, and are only written once per process. The random parts are
+ *          seeded, so every run measures the same data.
+ */
+namespace Generators
+{
+
+/*!
+ * \brief The width and height of the terrain, in meters.
+ */
+const double terrainExtent = 100.0;
+
+/*!
+ * \brief makeTerrainMesh   Makes a textured triangle mesh of the terrain.
+ * \details                 The faces are split into submeshes by columns, one per material, each with its
+ *                          texture file. The texture coordinates are stored per face corner, as odm_georef and
+ *                          odm_texturing hand them over. The textures are written to directory.
+ * \param faces             The number of faces, rounded to a square grid.
+ * \param materials         The number of materials.
+ * \param textureSize       The width and height of the textures, in pixels.
+ */
+pcl::TextureMesh makeTerrainMesh(size_t faces, size_t materials, int textureSize, const std::string &directory);
+
+/*!
+ * \brief writeObjMesh      Writes the terrain mesh as an OBJ file, with its material library.
+ * \return                  The path of the OBJ file.
+ */
+std::string writeObjMesh(const std::string &directory, size_t faces, size_t materials, int textureSize);
+
+/*!
+ * \brief writeBinaryMesh   Writes the terrain mesh as a binary mesh file of the mesh IO library.
+ * \return                  The path of the binary mesh file.
+ */
+std::string writeBinaryMesh(const std::string &directory, size_t faces, size_t materials, int textureSize);
+
+/*!
+ * \brief writePlyPointCloud    Writes a binary little endian PLY point cloud of the terrain, as dense
+ *                              reconstruction gives it to odm_filterpoints.
+ * \details                     The points have x, y, z, nx, ny, nz as floats and red, green, blue as bytes.
+ *                              Two in every hundred points are outliers above or below the terrain.
+ * \return                      The path of the PLY file.
+ */
+std::string writePlyPointCloud(const std::string &directory, size_t points);
+
+/*!
+ * \brief   The files of a synthetic survey, as odm_georef reads them.
+ */
+struct CameraSet
+{
+    std::string bundleFile;         /**< The cameras, as a Bundler file. */
+    std::string coordFile;          /**< The georeferenced positions of the cameras. */
+    std::string gcpFile;            /**< The ground control points, empty if there are none. */
+    std::string imagesPath;         /**< The directory of the images. */
+    std::string imagesListPath;     /**< The list of the images, one per camera. */
+};
+
+/*!
+ * \brief writeCameraSet    Writes a survey of cameras looking down on the terrain from a grid, and optionally
+ *                          ground control points seen by them.
+ * \details                 The georeferenced positions are the model positions in a scaled, rotated and shifted
+ *                          UTM system, with centimeter noise. Every GCP is a point of the terrain mesh, marked in
+ *                          the image of the camera closest to it. Blank images are written for the GCP images, since
+ *                          odm_georef reads their size.
+ * \param cameras           The number of cameras, rounded to a square grid.
+ * \param gcps              The number of ground control points.
+ */
+CameraSet writeCameraSet(const std::string &directory, size_t cameras, size_t gcps);
+
+/*!
+ * \brief fileSize          The size of a file in bytes, 0 if it does not exist.
+ */
+size_t fileSize(const std::string &filename);
+
+}
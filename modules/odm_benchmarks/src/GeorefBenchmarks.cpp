@@ -0,0 +1,99 @@
+#include "Benchmarks.hpp"
+#include "Generators.hpp"
+
+// C++
+#include <stdexcept>
+
+// Georef
+#include "Georef.hpp"
+
+namespace
+{
+
+const size_t exifMeshFaces = 20000;     // The mesh georeferenced from the cameras, small so that the search dominates.
+const size_t gcpMeshFaces = 500000;     // The mesh the GCPs are looked up in.
+const size_t gcpCameras = 64;           // The cameras of the GCP survey.
+
+void runGeoref(ArgumentList &arguments, const std::string &logFile)
+{
+    Georef georef;
+    if (georef.run(arguments.argc(), arguments.argv()) != EXIT_SUCCESS)
+    {
+        throw std::runtime_error("odm_georef failed, see " + logFile);
+    }
+}
+
+void addPhases(BenchmarkState &state)
+{
+    state.addPhase("read_mesh");
+    state.addPhase("solve_transform");
+    state.addPhase("transform_mesh");
+    state.addPhase("write_mesh");
+}
+
+// Georeferencing from the camera positions, where finding the best camera triplet dominates.
+void georefCameras(BenchmarkState &state, const std::string &workDir, const std::string &solver)
+{
+    Generators::CameraSet cameras = Generators::writeCameraSet(workDir, state.size(), 0);
+    std::string mesh = Generators::writeObjMesh(workDir, exifMeshFaces, 1, 256);
+    std::string logFile = workDir + "/georef_cameras_log.txt";
+
+    ArgumentList arguments("odm_georef");
+    arguments.add("-bundleFile", cameras.bundleFile);
+    arguments.add("-inputCoordFile", cameras.coordFile);
+    arguments.add("-inputFile", mesh);
+    arguments.add("-outputFile", workDir + "/georef_cameras.obj");
+    arguments.add("-logFile", logFile);
+    arguments.add("-solver", solver);
+
+    addPhases(state);
+    while (state.keepRunning())
+    {
+        runGeoref(arguments, logFile);
+    }
+    state.setItems(state.size());
+}
+
+// Georeferencing from GCPs, where the lookup of the GCPs in the mesh dominates.
+void georefGCPs(BenchmarkState &state, const std::string &workDir)
+{
+    Generators::CameraSet cameras = Generators::writeCameraSet(workDir, gcpCameras, state.size());
+    std::string mesh = Generators::writeObjMesh(workDir, gcpMeshFaces, 1, 256);
+    std::string logFile = workDir + "/georef_gcps_log.txt";
+
+    ArgumentList arguments("odm_georef");
+    arguments.add("-bundleFile", cameras.bundleFile);
+    arguments.add("-gcpFile", cameras.gcpFile);
+    arguments.add("-imagesPath", cameras.imagesPath);
+    arguments.add("-imagesListPath", cameras.imagesListPath);
+    arguments.add("-inputFile", mesh);
+    arguments.add("-outputFile", workDir + "/georef_gcps.obj");
+    arguments.add("-logFile", logFile);
+
+    addPhases(state);
+    while (state.keepRunning())
+    {
+        runGeoref(arguments, logFile);
+    }
+    state.setItems(state.size());
+    state.setLabel(std::to_string(gcpMeshFaces) + " faces, " + std::to_string(gcpCameras) + " cameras");
+}
+
+}
+
+void addGeorefBenchmarks(BenchmarkSuite &suite, const std::string &workDir)
+{
+    std::vector<size_t> cameras;
+    cameras.push_back(25);
+    cameras.push_back(100);
+    cameras.push_back(400);
+
+    std::vector<size_t> gcps;
+    gcps.push_back(10);
+    gcps.push_back(40);
+    gcps.push_back(160);
+
+    suite.add("georef/camera_triplet", [workDir](BenchmarkState &state) { georefCameras(state, workDir, "bruteforce"); }, cameras, false);
+    suite.add("georef/camera_ransac", [workDir](BenchmarkState &state) { georefCameras(state, workDir, "ransac"); }, cameras, false);
+    suite.add("georef/gcp", [workDir](BenchmarkState &state) { georefGCPs(state, workDir); }, gcps, false);
+}
@@ -0,0 +1,104 @@
+#include "Benchmarks.hpp"
+#include "Generators.hpp"
+
+// C++
+#include <cstdio>
+#include <stdexcept>
+
+// Mesh IO
+#include "BinaryMesh.hpp"
+#include "ObjReader.hpp"
+
+// Georef
+#include "ThreadPool.hpp"
+#include "modifiedPclFunctions.hpp"
+
+namespace
+{
+
+const size_t materials = 8;     // The materials of the meshes, as a multi-material texturing result.
+const int textureSize = 512;    // The size of the textures, which are not read here.
+
+size_t faceCount(const pcl::TextureMesh &mesh)
+{
+    size_t faces = 0;
+    for (size_t m = 0; m < mesh.tex_polygons.size(); ++m)
+    {
+        faces += mesh.tex_polygons[m].size();
+    }
+    return faces;
+}
+
+std::string meshLabel(const pcl::TextureMesh &mesh, const std::string &file)
+{
+    return std::to_string(faceCount(mesh)) + " faces, " + std::to_string(mesh.tex_polygons.size()) + " materials, " +
+           std::to_string(Generators::fileSize(file) >> 20) + " MB";
+}
+
+void readObj(BenchmarkState &state, const std::string &workDir)
+{
+    std::string file = Generators::writeObjMesh(workDir, state.size(), materials, textureSize);
+
+    ObjReader reader;
+    reader.setThreads(state.threads());
+    pcl::TextureMesh mesh;
+    while (state.keepRunning())
+    {
+        mesh = pcl::TextureMesh();
+        std::vector<pcl::MTLReader> companions;
+        reader.read(file, mesh, companions);
+    }
+    state.setItems(faceCount(mesh));
+    state.setBytes(Generators::fileSize(file));
+    state.setLabel(meshLabel(mesh, file));
+}
+
+void readBinary(BenchmarkState &state, const std::string &workDir)
+{
+    std::string file = Generators::writeBinaryMesh(workDir, state.size(), materials, textureSize);
+
+    pcl::TextureMesh mesh;
+    while (state.keepRunning())
+    {
+        mesh = pcl::TextureMesh();
+        BinaryMesh binaryMesh(file);
+        binaryMesh.toTextureMesh(mesh);
+    }
+    state.setItems(faceCount(mesh));
+    state.setBytes(Generators::fileSize(file));
+    state.setLabel(meshLabel(mesh, file));
+}
+
+void saveObj(BenchmarkState &state, const std::string &workDir)
+{
+    pcl::TextureMesh mesh = Generators::makeTerrainMesh(state.size(), materials, textureSize, workDir);
+    std::string file = workDir + "/save_obj_" + std::to_string(state.size()) + ".obj";
+
+    ThreadPool pool(static_cast<size_t>(state.threads()));
+    while (state.keepRunning())
+    {
+        if (saveOBJFile(file, mesh, 8, &pool) != 0)
+        {
+            throw std::runtime_error("Could not write " + file);
+        }
+    }
+    state.setItems(faceCount(mesh));
+    state.setBytes(Generators::fileSize(file));
+    state.setLabel(meshLabel(mesh, file));
+    std::remove(file.c_str());
+    std::remove((workDir + "/save_obj_" + std::to_string(state.size()) + ".mtl").c_str());
+}
+
+}
+
+void addMeshIOBenchmarks(BenchmarkSuite &suite, const std::string &workDir)
+{
+    std::vector<size_t> sizes;
+    sizes.push_back(100000);
+    sizes.push_back(1000000);
+    sizes.push_back(4000000);
+
+    suite.add("meshio/read_obj", [workDir](BenchmarkState &state) { readObj(state, workDir); }, sizes, true);
+    suite.add("meshio/read_binary", [workDir](BenchmarkState &state) { readBinary(state, workDir); }, sizes, false);
+    suite.add("georef/save_obj", [workDir](BenchmarkState &state) { saveObj(state, workDir); }, sizes, true);
+}
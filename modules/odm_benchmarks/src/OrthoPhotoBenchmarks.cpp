@@ -0,0 +1,99 @@
+#include "Benchmarks.hpp"
+#include "Generators.hpp"
+
+// C++
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+// Ortho photo
+#include "OdmOrthoPhoto.hpp"
+
+// Profile
+#include "Profile.hpp"
+
+namespace
+{
+
+const size_t materials = 8;             // The materials of the meshes, as a multi-material texturing result.
+const int textureSize = 2048;           // The size of the textures.
+const double facesResolution = 20.0;    // The resolution over the faces, in pixels per meter, 2000 x 2000 pixels.
+const size_t pixelsFaces = 200000;      // The faces of the mesh rendered over the resolutions.
+
+// Renders the mesh into a photo with a depth buffer of depthBits and reports the phases of odm_orthophoto.
+void render(BenchmarkState &state, const std::string &workDir, size_t faces, double resolution, int depthBits = 32)
+{
+    std::string mesh = Generators::writeObjMesh(workDir, faces, materials, textureSize);
+    std::string photo = workDir + "/orthophoto.tif";
+    std::string logFile = workDir + "/orthophoto_log.txt";
+
+    std::ostringstream resolutionText;
+    resolutionText << resolution;
+
+    ArgumentList arguments("odm_orthophoto");
+    arguments.add("-inputFiles", mesh);
+    arguments.add("-outputFile", photo);
+    arguments.add("-logFile", logFile);
+    arguments.add("-resolution", resolutionText.str());
+    arguments.add("-threads", std::to_string(state.threads()));
+    arguments.add("-depthBits", std::to_string(depthBits));
+
+    state.addPhase("read_mesh");
+    state.addPhase("texture_decode");
+    state.addPhase("rasterize");
+    state.addPhase("shade");
+    state.addPhase("write_tiff");
+    size_t iterations = 0;
+    while (state.keepRunning())
+    {
+        ++iterations;
+        OdmOrthoPhoto orthoPhoto;
+        if (orthoPhoto.run(arguments.argc(), arguments.argv()) != 0)
+        {
+            throw std::runtime_error("odm_orthophoto failed, see " + logFile);
+        }
+    }
+
+    double side = Generators::terrainExtent * resolution;
+    std::ostringstream label;
+    label << faces << " faces, " << materials << " materials of " << textureSize << " px, "
+          << static_cast<size_t>(side) << " x " << static_cast<size_t>(side) << " px, "
+          << Profile::instance().getCount("pixels_shaded") / iterations << " pixels shaded";
+    state.setLabel(label.str());
+    std::remove(photo.c_str());
+}
+
+}
+
+void addOrthoPhotoBenchmarks(BenchmarkSuite &suite, const std::string &workDir)
+{
+    std::vector<size_t> faces;
+    faces.push_back(100000);
+    faces.push_back(1000000);
+    faces.push_back(4000000);
+
+    // In megapixels.
+    std::vector<size_t> pixels;
+    pixels.push_back(4);
+    pixels.push_back(16);
+    pixels.push_back(64);
+
+    suite.add("orthophoto/faces", [workDir](BenchmarkState &state)
+    {
+        render(state, workDir, state.size(), facesResolution);
+        state.setItems(state.size());
+    }, faces, true);
+
+    suite.add("orthophoto/megapixels", [workDir](BenchmarkState &state)
+    {
+        render(state, workDir, pixelsFaces, std::sqrt(state.size() * 1.0e6) / Generators::terrainExtent);
+        state.setItems(state.size() * 1000000);
+    }, pixels, true);
+
+    suite.add("orthophoto/megapixels_depth16", [workDir](BenchmarkState &state)
+    {
+        render(state, workDir, pixelsFaces, std::sqrt(state.size() * 1.0e6) / Generators::terrainExtent, 16);
+        state.setItems(state.size() * 1000000);
+    }, pixels, true);
+}
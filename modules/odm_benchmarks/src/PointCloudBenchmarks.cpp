@@ -0,0 +1,171 @@
+#include "Benchmarks.hpp"
+#include "Generators.hpp"
+
+// C++
+#include <cstdio>
+
+// PDAL
+#include <pdal/Options.hpp>
+#include <pdal/PointTable.hpp>
+#include <pdal/filters/RangeFilter.hpp>
+#include <pdal/io/BufferReader.hpp>
+
+// Filter points
+#include "FloatPlyReader.hpp"
+#include "ModifiedPlyWriter.hpp"
+#include "PoissonSampleFilter.hpp"
+#include "StatisticalOutlierFilter.hpp"
+#include "TiledFilter.hpp"
+
+namespace
+{
+
+const double tileSize = 25.0;   // The tiles of the tiled filter, 4 x 4 over the terrain.
+const double sampleRadius = 0.2; // The radius of "-sample", twice the point spacing of the smallest cloud.
+
+// Reads the whole cloud into memory, as the first stage of odm_filterpoints does.
+void readPly(BenchmarkState &state, const std::string &workDir)
+{
+    std::string file = Generators::writePlyPointCloud(workDir, state.size());
+
+    pdal::Options options;
+    options.add("filename", file);
+
+    size_t points = 0;
+    while (state.keepRunning())
+    {
+        pdal::PointTable table;
+        pdal::FloatPlyReader reader;
+        reader.setOptions(options);
+        reader.prepare(table);
+        pdal::PointViewSet views = reader.execute(table);
+        points = views.empty() ? 0 : (*views.begin())->size();
+    }
+    state.setItems(points);
+    state.setBytes(Generators::fileSize(file));
+}
+
+// The pipeline of odm_filterpoints without tiles.
+void filterPipeline(BenchmarkState &state, const std::string &workDir)
+{
+    std::string input = Generators::writePlyPointCloud(workDir, state.size());
+    std::string output = workDir + "/filtered.ply";
+
+    pdal::Options inPlyOpts;
+    inPlyOpts.add("filename", input);
+
+    pdal::Options outlierOpts;
+    outlierOpts.add("mean_k", 16);
+    outlierOpts.add("multiplier", 2.5);
+    outlierOpts.add("threads", state.threads());
+
+    pdal::Options rangeOpts;
+    rangeOpts.add("limits", "Classification![7:7]");
+
+    pdal::Options outPlyOpts;
+    outPlyOpts.add("storage_mode", "little endian");
+    outPlyOpts.add("filename", output);
+
+    state.addPhase("read_ply");
+    state.addPhase("outlier_filter");
+    state.addPhase("write_ply");
+    while (state.keepRunning())
+    {
+        pdal::PointTable table;
+        pdal::FloatPlyReader plyReader;
+        plyReader.setOptions(inPlyOpts);
+
+        pdal::StatisticalOutlierFilter outlierFilter;
+        outlierFilter.setInput(plyReader);
+        outlierFilter.setOptions(outlierOpts);
+
+        pdal::RangeFilter rangeFilter;
+        rangeFilter.setInput(outlierFilter);
+        rangeFilter.setOptions(rangeOpts);
+
+        pdal::ModifiedPlyWriter plyWriter;
+        plyWriter.setOptions(outPlyOpts);
+        plyWriter.setInput(rangeFilter);
+        plyWriter.prepare(table);
+        plyWriter.execute(table);
+    }
+    state.setItems(state.size());
+    state.setBytes(Generators::fileSize(input));
+    std::remove(output.c_str());
+}
+
+// The radius sampling of "-sample", on the cloud read into memory.
+void samplePoints(BenchmarkState &state, const std::string &workDir)
+{
+    std::string file = Generators::writePlyPointCloud(workDir, state.size());
+
+    pdal::Options inPlyOpts;
+    inPlyOpts.add("filename", file);
+
+    pdal::Options sampleOpts;
+    sampleOpts.add("radius", sampleRadius);
+    sampleOpts.add("threads", state.threads());
+
+    size_t points = 0;
+    while (state.keepRunning())
+    {
+        state.pauseTiming();
+        pdal::PointTable table;
+        pdal::FloatPlyReader reader;
+        reader.setOptions(inPlyOpts);
+        reader.prepare(table);
+        pdal::PointViewSet views = reader.execute(table);
+        pdal::BufferReader buffer;
+        buffer.addView(*views.begin());
+        state.resumeTiming();
+
+        pdal::PoissonSampleFilter sampleFilter;
+        sampleFilter.setOptions(sampleOpts);
+        sampleFilter.setInput(buffer);
+        sampleFilter.prepare(table);
+        pdal::PointViewSet sampled = sampleFilter.execute(table);
+        points = sampled.empty() ? 0 : (*sampled.begin())->size();
+    }
+    state.setItems(state.size());
+    state.setLabel(std::to_string(points) + " points kept");
+}
+
+// The tiled pipeline of odm_filterpoints, with "-tileSize".
+void filterTiled(BenchmarkState &state, const std::string &workDir)
+{
+    std::string input = Generators::writePlyPointCloud(workDir, state.size());
+    std::string output = workDir + "/filtered_tiled.ply";
+
+    state.addPhase("read_bounds");
+    state.addPhase("write_tiles");
+    state.addPhase("filter_tiles");
+    state.addPhase("repair_tiles");
+    state.addPhase("write_output");
+    while (state.keepRunning())
+    {
+        pdal::TiledFilter tiledFilter(input, output, [](const std::string &){});
+        tiledFilter.setMeanK(16);
+        tiledFilter.setMultiplier(2.5);
+        tiledFilter.setTileSize(tileSize);
+        tiledFilter.setThreads(state.threads());
+        tiledFilter.run();
+    }
+    state.setItems(state.size());
+    state.setBytes(Generators::fileSize(input));
+    std::remove(output.c_str());
+}
+
+}
+
+void addPointCloudBenchmarks(BenchmarkSuite &suite, const std::string &workDir)
+{
+    std::vector<size_t> sizes;
+    sizes.push_back(1000000);
+    sizes.push_back(4000000);
+    sizes.push_back(16000000);
+
+    suite.add("filterpoints/read_ply", [workDir](BenchmarkState &state) { readPly(state, workDir); }, sizes, false);
+    suite.add("filterpoints/pipeline", [workDir](BenchmarkState &state) { filterPipeline(state, workDir); }, sizes, true);
+    suite.add("filterpoints/sample", [workDir](BenchmarkState &state) { samplePoints(state, workDir); }, sizes, true);
+    suite.add("filterpoints/tiled", [workDir](BenchmarkState &state) { filterTiled(state, workDir); }, sizes, true);
+}
@@ -0,0 +1,151 @@
+// Benchmarks the hot paths of the ODM modules on synthetic data.
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "Benchmarks.hpp"
+#include "Profile.hpp"
+
+namespace
+{
+
+void printHelp()
+{
+    std::cout << "odm_benchmarks\n\n";
+    std::cout << "Purpose:\n";
+    std::cout << "Benchmark the mesh readers and writers, odm_georef, odm_orthophoto and odm_filterpoints on synthetic data,\n";
+    std::cout << "over input sizes and thread counts.\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "odm_benchmarks [-list] [-filter <text>] [-threads <n,n,...>] [-scale <factor>] [-minTime <seconds>]\n";
+    std::cout << "               [-maxIterations <n>] [-workDir <path>] [-json <path>]\n\n";
+    std::cout << "\"-list\" prints the benchmarks and their sizes. \"-filter\" only runs the benchmarks whose name contains the text.\n";
+    std::cout << "\"-threads\" gives the thread counts of the threaded benchmarks, by default 1 and all hardware threads.\n";
+    std::cout << "\"-scale\" scales all sizes, as 0.1 for a quick check. Every case runs until its iterations took \"-minTime\",\n";
+    std::cout << "1 second by default, at most \"-maxIterations\" times, 100 by default. The synthetic inputs are written to\n";
+    std::cout << "\"-workDir\", \"benchmark_data\" by default. \"-json\" writes the results, to compare runs.\n";
+}
+
+bool parseThreads(const std::string &text, std::vector<int> &threads)
+{
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        int count = std::atoi(item.c_str());
+        if (count < 1)
+        {
+            return false;
+        }
+        threads.push_back(count);
+    }
+    return !threads.empty();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkSuite suite;
+    std::string workDir = "benchmark_data";
+    std::string jsonFile;
+    bool list = false;
+
+    for (int argIndex = 1; argIndex < argc; ++argIndex)
+    {
+        std::string argument = argv[argIndex];
+        bool hasValue = argIndex + 1 < argc;
+        if (argument == "-help")
+        {
+            printHelp();
+            return EXIT_SUCCESS;
+        }
+        else if (argument == "-list")
+        {
+            list = true;
+        }
+        else if (argument == "-filter" && hasValue)
+        {
+            suite.setFilter(argv[++argIndex]);
+        }
+        else if (argument == "-threads" && hasValue)
+        {
+            std::vector<int> threads;
+            if (!parseThreads(argv[++argIndex], threads))
+            {
+                std::cerr << "Argument '-threads' expects a list of positive integers.\n";
+                return EXIT_FAILURE;
+            }
+            suite.setThreads(threads);
+        }
+        else if (argument == "-scale" && hasValue)
+        {
+            double scale = std::atof(argv[++argIndex]);
+            if (!(scale > 0.0))
+            {
+                std::cerr << "Argument '-scale' expects a positive number.\n";
+                return EXIT_FAILURE;
+            }
+            suite.setScale(scale);
+        }
+        else if (argument == "-minTime" && hasValue)
+        {
+            suite.setMinSeconds(std::atof(argv[++argIndex]));
+        }
+        else if (argument == "-maxIterations" && hasValue)
+        {
+            int iterations = std::atoi(argv[++argIndex]);
+            if (iterations < 1)
+            {
+                std::cerr << "Argument '-maxIterations' expects a positive integer.\n";
+                return EXIT_FAILURE;
+            }
+            suite.setMaxIterations(static_cast<size_t>(iterations));
+        }
+        else if (argument == "-workDir" && hasValue)
+        {
+            workDir = argv[++argIndex];
+        }
+        else if (argument == "-json" && hasValue)
+        {
+            jsonFile = argv[++argIndex];
+        }
+        else
+        {
+            printHelp();
+            return EXIT_FAILURE;
+        }
+    }
+
+    addMeshIOBenchmarks(suite, workDir);
+    addGeorefBenchmarks(suite, workDir);
+    addOrthoPhotoBenchmarks(suite, workDir);
+    addPointCloudBenchmarks(suite, workDir);
+
+    if (list)
+    {
+        suite.list();
+        return EXIT_SUCCESS;
+    }
+
+    if (mkdir(workDir.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        std::cerr << "Could not create the work directory " << workDir << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // The phases of the modules are collected, and reported per case. The profile itself is not written.
+    Profile::instance().enable("odm_benchmarks", "");
+
+    bool ok = suite.run();
+    if (!jsonFile.empty() && !suite.writeJson(jsonFile))
+    {
+        std::cerr << "Could not write " << jsonFile << "\n";
+        return EXIT_FAILURE;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,210 @@
+#include "PartitionedDecimation.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <vtkCellArray.h>
+#include <vtkDecimatePro.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include "Logger.h"
+
+namespace {
+
+// The grid of cells in the XY plane that triangles are assigned to.
+struct CellGrid{
+    double originX, originY;
+    double cellWidth, cellHeight;
+    int cols, rows;
+
+    int cellOf( double x , double y ) const{
+        int col = std::min( std::max( static_cast<int>( std::floor( ( x - originX ) / cellWidth ) ) , 0 ) , cols - 1 );
+        int row = std::min( std::max( static_cast<int>( std::floor( ( y - originY ) / cellHeight ) ) , 0 ) , rows - 1 );
+        return row * cols + col;
+    }
+};
+
+// A cell of the mesh, and the part of it left by decimation.
+struct Cell{
+    std::vector<vtkIdType> triangles;   // The triangles of the cell, as indices into the triangle list.
+    std::vector<vtkIdType> points;      // The original ids of the vertices left, in the order of the output.
+    std::vector<vtkIdType> faces;       // The triangles left, three indices into points each.
+};
+
+// Returns a grid of about cellCount cells of about square shape over the bounds,
+// shifted by half a cell and one cell larger in each direction if shifted is set.
+CellGrid makeGrid( const double bounds[6] , int cellCount , bool shifted ){
+    double width = std::max( bounds[1] - bounds[0] , 1e-9 );
+    double height = std::max( bounds[3] - bounds[2] , 1e-9 );
+
+    CellGrid grid;
+    grid.cols = std::max( 1 , static_cast<int>( std::round( std::sqrt( cellCount * width / height ) ) ) );
+    grid.rows = std::max( 1 , ( cellCount + grid.cols - 1 ) / grid.cols );
+    grid.cellWidth = width / grid.cols;
+    grid.cellHeight = height / grid.rows;
+    grid.originX = bounds[0];
+    grid.originY = bounds[2];
+    if( shifted ){
+        grid.originX -= grid.cellWidth / 2;
+        grid.originY -= grid.cellHeight / 2;
+        grid.cols++;
+        grid.rows++;
+    }
+    return grid;
+}
+
+// Decimates the triangles of a cell. The vertices on the boundary of the cell
+// are never deleted, which keeps the seams to the neighbouring cells intact.
+void decimateCell( vtkPoints* meshPoints , const std::vector<vtkIdType>& triangleIds , double reduction , Cell& cell ){
+    std::vector<vtkIdType> originalIds;
+    originalIds.reserve( cell.triangles.size() * 3 );
+    for( size_t t=0 ; t<cell.triangles.size() ; t++ )
+        for( int k=0 ; k<3 ; k++ ) originalIds.push_back( triangleIds[ 3*cell.triangles[t] + k ] );
+    std::sort( originalIds.begin() , originalIds.end() );
+    originalIds.erase( std::unique( originalIds.begin() , originalIds.end() ) , originalIds.end() );
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataTypeToDouble();
+    points->SetNumberOfPoints( static_cast<vtkIdType>( originalIds.size() ) );
+    vtkSmartPointer<vtkIdTypeArray> ids = vtkSmartPointer<vtkIdTypeArray>::New();
+    ids->SetName( "OriginalIds" );
+    ids->SetNumberOfTuples( static_cast<vtkIdType>( originalIds.size() ) );
+    for( size_t i=0 ; i<originalIds.size() ; i++ ){
+        double p[3];
+        meshPoints->GetPoint( originalIds[i] , p );
+        points->SetPoint( static_cast<vtkIdType>( i ) , p );
+        ids->SetValue( static_cast<vtkIdType>( i ) , originalIds[i] );
+    }
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->Allocate( polys->EstimateSize( static_cast<vtkIdType>( cell.triangles.size() ) , 3 ) );
+    for( size_t t=0 ; t<cell.triangles.size() ; t++ ){
+        vtkIdType local[3];
+        for( int k=0 ; k<3 ; k++ )
+            local[k] = std::lower_bound( originalIds.begin() , originalIds.end() , triangleIds[ 3*cell.triangles[t] + k ] ) - originalIds.begin();
+        polys->InsertNextCell( 3 , local );
+    }
+    std::vector<vtkIdType>().swap( cell.triangles );
+
+    vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+    input->SetPoints( points );
+    input->SetPolys( polys );
+    input->GetPointData()->AddArray( ids );
+
+    vtkPolyData* output = input;
+    vtkSmartPointer<vtkDecimatePro> decimationFilter = vtkSmartPointer<vtkDecimatePro>::New();
+    if( reduction > 0 ){
+        // Vertices are only deleted, never moved or split, so the kept ones stay shared with the neighbours.
+        decimationFilter->SetInputData( input );
+        decimationFilter->SetTargetReduction( reduction );
+        decimationFilter->PreserveTopologyOff();
+        decimationFilter->SplittingOff();
+        decimationFilter->BoundaryVertexDeletionOff();
+        decimationFilter->Update();
+        output = decimationFilter->GetOutput();
+    }
+
+    vtkIdTypeArray* outputIds = vtkIdTypeArray::SafeDownCast( output->GetPointData()->GetArray( "OriginalIds" ) );
+    cell.points.resize( static_cast<size_t>( output->GetNumberOfPoints() ) );
+    for( size_t i=0 ; i<cell.points.size() ; i++ ) cell.points[i] = outputIds->GetValue( static_cast<vtkIdType>( i ) );
+
+    vtkCellArray* outputPolys = output->GetPolys();
+    cell.faces.clear();
+    cell.faces.reserve( static_cast<size_t>( outputPolys->GetNumberOfCells() ) * 3 );
+    vtkIdType npts;
+    vtkIdType* pts;
+    outputPolys->InitTraversal();
+    while( outputPolys->GetNextCell( npts , pts ) ){
+        if( npts != 3 ) continue;
+        cell.faces.insert( cell.faces.end() , pts , pts + 3 );
+    }
+}
+
+// One pass of the partitioned decimation.
+vtkSmartPointer<vtkPolyData> decimatePass( vtkPolyData* mesh , int targetVertexCount , int cellCount , int threads , bool shifted , Logger& logWriter ){
+    vtkPoints* meshPoints = mesh->GetPoints();
+    vtkCellArray* meshPolys = mesh->GetPolys();
+
+    // The vertices of all triangles, three per triangle. Other polygons are dropped, as by the decimation filters.
+    std::vector<vtkIdType> triangleIds;
+    triangleIds.reserve( static_cast<size_t>( meshPolys->GetNumberOfCells() ) * 3 );
+    vtkIdType npts;
+    vtkIdType* pts;
+    meshPolys->InitTraversal();
+    while( meshPolys->GetNextCell( npts , pts ) ){
+        if( npts != 3 ) continue;
+        triangleIds.insert( triangleIds.end() , pts , pts + 3 );
+    }
+
+    double bounds[6];
+    meshPoints->GetBounds( bounds );
+    CellGrid grid = makeGrid( bounds , cellCount , shifted );
+    std::vector<Cell> cells( static_cast<size_t>( grid.cols ) * grid.rows );
+
+    for( size_t t=0 ; t<triangleIds.size()/3 ; t++ ){
+        double x = 0 , y = 0;
+        for( int k=0 ; k<3 ; k++ ){
+            double p[3];
+            meshPoints->GetPoint( triangleIds[ 3*t + k ] , p );
+            x += p[0] / 3;
+            y += p[1] / 3;
+        }
+        cells[ grid.cellOf( x , y ) ].triangles.push_back( static_cast<vtkIdType>( t ) );
+    }
+
+    // Every cell keeps the same share of its vertices, which divides the target between the cells in proportion to their size.
+    vtkIdType vertexCount = mesh->GetNumberOfPoints();
+    double reduction = vertexCount > targetVertexCount ? 1.0 - static_cast<double>( targetVertexCount ) / static_cast<double>( vertexCount ) : 0.0;
+    logWriter( "Decimating %d x %d cells on %d threads, target reduction %f\n" , grid.cols , grid.rows , threads , reduction );
+
+    std::atomic<size_t> nextCell( 0 );
+    std::vector<std::thread> workers;
+    for( int w=0 ; w<threads ; w++ ){
+        workers.push_back( std::thread( [&](){
+            for( size_t c=nextCell++ ; c<cells.size() ; c=nextCell++ )
+                if( !cells[c].triangles.empty() ) decimateCell( meshPoints , triangleIds , reduction , cells[c] );
+        } ) );
+    }
+    for( size_t w=0 ; w<workers.size() ; w++ ) workers[w].join();
+    std::vector<vtkIdType>().swap( triangleIds );
+
+    // Stitch the cells, merging the vertices they share by original id.
+    std::vector<vtkIdType> stitchedIds( static_cast<size_t>( vertexCount ) , -1 );
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataType( meshPoints->GetDataType() );
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    for( size_t c=0 ; c<cells.size() ; c++ ){
+        Cell& cell = cells[c];
+        for( size_t f=0 ; f<cell.faces.size() ; f+=3 ){
+            vtkIdType face[3];
+            for( int k=0 ; k<3 ; k++ ){
+                vtkIdType original = cell.points[ static_cast<size_t>( cell.faces[f+k] ) ];
+                if( stitchedIds[ static_cast<size_t>( original ) ]<0 ) stitchedIds[ static_cast<size_t>( original ) ] = points->InsertNextPoint( meshPoints->GetPoint( original ) );
+                face[k] = stitchedIds[ static_cast<size_t>( original ) ];
+            }
+            polys->InsertNextCell( 3 , face );
+        }
+        std::vector<vtkIdType>().swap( cell.points );
+        std::vector<vtkIdType>().swap( cell.faces );
+    }
+
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    output->SetPoints( points );
+    output->SetPolys( polys );
+    logWriter( "Vertex count after pass: %d\n" , static_cast<int>( output->GetNumberOfPoints() ) );
+    return output;
+}
+
+}
+
+vtkSmartPointer<vtkPolyData> decimatePartitioned( vtkPolyData* mesh , int targetVertexCount , int cellCount , int threads , bool seamPass , Logger& logWriter ){
+    threads = std::max( threads , 1 );
+    vtkSmartPointer<vtkPolyData> output = decimatePass( mesh , targetVertexCount , cellCount , threads , false , logWriter );
+    if( seamPass ){
+        logWriter( "Decimating the seams\n" );
+        output = decimatePass( output , targetVertexCount , cellCount , threads , true , logWriter );
+    }
+    return output;
+}
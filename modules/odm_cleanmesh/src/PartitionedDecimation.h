@@ -0,0 +1,19 @@
+#ifndef PARTITIONED_DECIMATION_INCLUDED
+#define PARTITIONED_DECIMATION_INCLUDED
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+struct Logger;
+
+// Decimates a triangle mesh in parallel, over a grid of cells in the XY plane.
+// Every triangle belongs to the cell of its centroid. The cells are decimated
+// independently with their boundary vertices kept, so they share their seams
+// and are stitched back by original vertex. The target vertex count is divided
+// between the cells in proportion to their vertex count.
+//
+// With seamPass set, the stitched mesh is decimated a second time over the grid
+// shifted by half a cell, whose cells hold the seams of the first pass inside.
+vtkSmartPointer<vtkPolyData> decimatePartitioned( vtkPolyData* mesh , int targetVertexCount , int cellCount , int threads , bool seamPass , Logger& logWriter );
+
+#endif // PARTITIONED_DECIMATION_INCLUDED
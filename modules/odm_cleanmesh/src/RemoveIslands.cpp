@@ -0,0 +1,185 @@
+#include "RemoveIslands.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <vtkCellArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include "Logger.h"
+
+namespace {
+
+// A union-find forest that threads can merge sets of concurrently.
+// Roots are always linked to the smaller root, so the forest stays acyclic
+// whatever the order of the unions.
+class ConcurrentUnionFind{
+public:
+    explicit ConcurrentUnionFind( size_t size ) : parents( size ){
+        for( size_t i=0 ; i<size ; i++ ) parents[i].store( static_cast<vtkIdType>( i ) , std::memory_order_relaxed );
+    }
+
+    vtkIdType find( vtkIdType x ){
+        for( ;; ){
+            vtkIdType parent = parents[x].load( std::memory_order_relaxed );
+            if( parent==x ) return x;
+            // Path halving; a failed exchange only means another thread shortened the path first.
+            vtkIdType grandParent = parents[parent].load( std::memory_order_relaxed );
+            parents[x].compare_exchange_weak( parent , grandParent , std::memory_order_relaxed );
+            x = grandParent;
+        }
+    }
+
+    void unite( vtkIdType a , vtkIdType b ){
+        for( ;; ){
+            a = find( a );
+            b = find( b );
+            if( a==b ) return;
+            if( a<b ) std::swap( a , b );
+            vtkIdType expected = a;
+            if( parents[a].compare_exchange_strong( expected , b , std::memory_order_relaxed ) ) return;
+        }
+    }
+
+private:
+    std::vector<std::atomic<vtkIdType> > parents;
+};
+
+// Calls work( begin , end ) on threads for chunks of [0, count).
+template< class Work >
+void parallelFor( size_t count , int threads , Work work ){
+    const size_t chunk = 1 << 16;
+    std::atomic<size_t> next( 0 );
+    std::vector<std::thread> workers;
+    for( int w=0 ; w<threads ; w++ ){
+        workers.push_back( std::thread( [&](){
+            for( size_t begin=next.fetch_add( chunk ) ; begin<count ; begin=next.fetch_add( chunk ) )
+                work( begin , std::min( begin + chunk , count ) );
+        } ) );
+    }
+    for( size_t w=0 ; w<workers.size() ; w++ ) workers[w].join();
+}
+
+double triangleArea( const double a[3] , const double b[3] , const double c[3] ){
+    double u[3] = { b[0]-a[0] , b[1]-a[1] , b[2]-a[2] };
+    double v[3] = { c[0]-a[0] , c[1]-a[1] , c[2]-a[2] };
+    double n[3] = { u[1]*v[2]-u[2]*v[1] , u[2]*v[0]-u[0]*v[2] , u[0]*v[1]-u[1]*v[0] };
+    return std::sqrt( n[0]*n[0] + n[1]*n[1] + n[2]*n[2] ) / 2;
+}
+
+}
+
+vtkSmartPointer<vtkPolyData> removeIslands( vtkPolyData* mesh , int minFaces , double minArea , int threads , Logger& logWriter ){
+    threads = std::max( threads , 1 );
+    vtkPoints* meshPoints = mesh->GetPoints();
+    vtkCellArray* meshPolys = mesh->GetPolys();
+    size_t pointCount = static_cast<size_t>( mesh->GetNumberOfPoints() );
+
+    // The faces as flat index arrays, shared read-only by the threads.
+    std::vector<vtkIdType> faceOffsets( 1 , 0 );
+    std::vector<vtkIdType> faceIds;
+    faceOffsets.reserve( static_cast<size_t>( meshPolys->GetNumberOfCells() ) + 1 );
+    faceIds.reserve( static_cast<size_t>( meshPolys->GetNumberOfCells() ) * 3 );
+    vtkIdType npts;
+    vtkIdType* pts;
+    meshPolys->InitTraversal();
+    while( meshPolys->GetNextCell( npts , pts ) ){
+        faceIds.insert( faceIds.end() , pts , pts + npts );
+        faceOffsets.push_back( static_cast<vtkIdType>( faceIds.size() ) );
+    }
+    size_t faceCount = faceOffsets.size() - 1;
+
+    ConcurrentUnionFind components( pointCount );
+    parallelFor( faceCount , threads , [&]( size_t begin , size_t end ){
+        for( size_t f=begin ; f<end ; f++ )
+            for( vtkIdType i=faceOffsets[f]+1 ; i<faceOffsets[f+1] ; i++ ) components.unite( faceIds[ faceOffsets[f] ] , faceIds[i] );
+    } );
+
+    // The root of every vertex, and the area of every face (fan triangulated).
+    std::vector<vtkIdType> roots( pointCount );
+    parallelFor( pointCount , threads , [&]( size_t begin , size_t end ){
+        for( size_t v=begin ; v<end ; v++ ) roots[v] = components.find( static_cast<vtkIdType>( v ) );
+    } );
+    std::vector<double> faceAreas( minArea>0 ? faceCount : 0 );
+    if( minArea>0 ){
+        parallelFor( faceCount , threads , [&]( size_t begin , size_t end ){
+            for( size_t f=begin ; f<end ; f++ ){
+                double area = 0 , a[3] , b[3] , c[3];
+                if( faceOffsets[f+1] - faceOffsets[f] >= 3 ) meshPoints->GetPoint( faceIds[ faceOffsets[f] ] , a );
+                for( vtkIdType i=faceOffsets[f]+2 ; i<faceOffsets[f+1] ; i++ ){
+                    meshPoints->GetPoint( faceIds[i-1] , b );
+                    meshPoints->GetPoint( faceIds[i] , c );
+                    area += triangleArea( a , b , c );
+                }
+                faceAreas[f] = area;
+            }
+        } );
+    }
+
+    // Sizes of the components, indexed by root. Summed in face order, so the areas do not depend on the threads.
+    std::vector<vtkIdType> componentFaces( pointCount , 0 );
+    std::vector<double> componentAreas( minArea>0 ? pointCount : 0 , 0 );
+    for( size_t f=0 ; f<faceCount ; f++ ){
+        if( faceOffsets[f+1]==faceOffsets[f] ) continue;
+        vtkIdType root = roots[ faceIds[ faceOffsets[f] ] ];
+        componentFaces[root]++;
+        if( minArea>0 ) componentAreas[root] += faceAreas[f];
+    }
+    std::vector<double>().swap( faceAreas );
+
+    std::vector<char> keep( pointCount , 0 );
+    size_t componentCount = 0 , keptCount = 0;
+    if( minFaces<=0 && minArea<=0 ){
+        vtkIdType largest = -1;
+        for( size_t v=0 ; v<pointCount ; v++ ){
+            if( !componentFaces[v] ) continue;
+            componentCount++;
+            if( largest<0 || componentFaces[v]>componentFaces[largest] ) largest = static_cast<vtkIdType>( v );
+        }
+        if( largest>=0 ) keep[largest] = 1 , keptCount = 1;
+    }else{
+        for( size_t v=0 ; v<pointCount ; v++ ){
+            if( !componentFaces[v] ) continue;
+            componentCount++;
+            if( componentFaces[v]>=minFaces && ( minArea<=0 || componentAreas[v]>=minArea ) ) keep[v] = 1 , keptCount++;
+        }
+    }
+    logWriter( "Keeping %d of %d components\n" , static_cast<int>( keptCount ) , static_cast<int>( componentCount ) );
+
+    // Compact the vertices of the kept components that are used by a face, in one pass.
+    std::vector<vtkIdType> newIds( pointCount , -1 );
+    for( size_t f=0 ; f<faceCount ; f++ )
+        if( faceOffsets[f+1]>faceOffsets[f] && keep[ roots[ faceIds[ faceOffsets[f] ] ] ] )
+            for( vtkIdType i=faceOffsets[f] ; i<faceOffsets[f+1] ; i++ ) newIds[ faceIds[i] ] = 0;
+    vtkIdType outputCount = 0;
+    for( size_t v=0 ; v<pointCount ; v++ ) if( !newIds[v] ) newIds[v] = outputCount++;
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataType( meshPoints->GetDataType() );
+    points->SetNumberOfPoints( outputCount );
+    vtkPointData* meshPointData = mesh->GetPointData();
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    vtkPointData* pointData = output->GetPointData();
+    pointData->CopyAllocate( meshPointData , outputCount );
+    for( size_t v=0 ; v<pointCount ; v++ ){
+        if( newIds[v]<0 ) continue;
+        double p[3];
+        meshPoints->GetPoint( static_cast<vtkIdType>( v ) , p );
+        points->SetPoint( newIds[v] , p );
+        pointData->CopyData( meshPointData , static_cast<vtkIdType>( v ) , newIds[v] );
+    }
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    std::vector<vtkIdType> face;
+    for( size_t f=0 ; f<faceCount ; f++ ){
+        if( faceOffsets[f+1]==faceOffsets[f] || !keep[ roots[ faceIds[ faceOffsets[f] ] ] ] ) continue;
+        face.clear();
+        for( vtkIdType i=faceOffsets[f] ; i<faceOffsets[f+1] ; i++ ) face.push_back( newIds[ faceIds[i] ] );
+        polys->InsertNextCell( static_cast<vtkIdType>( face.size() ) , &face[0] );
+    }
+
+    output->SetPoints( points );
+    output->SetPolys( polys );
+    return output;
+}
@@ -0,0 +1,17 @@
+#ifndef REMOVE_ISLANDS_INCLUDED
+#define REMOVE_ISLANDS_INCLUDED
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+struct Logger;
+
+// Removes the small connected components of a polygon mesh.
+// Components are labelled by a concurrent union-find over the vertices of the
+// faces. A component is kept when it has at least minFaces faces and at least
+// minArea of surface; with neither threshold set (both <= 0) only the component
+// with the most faces is kept. The vertices of the kept components are compacted
+// in their original order, with their point data, and unused vertices dropped.
+vtkSmartPointer<vtkPolyData> removeIslands( vtkPolyData* mesh , int minFaces , double minArea , int threads , Logger& logWriter );
+
+#endif // REMOVE_ISLANDS_INCLUDED
@@ -1,28 +1,38 @@
 #include <iostream>
 #include <string>
 #include <fstream>
-#include <vtkPolyDataConnectivityFilter.h>
 #include <vtkSmartPointer.h>
 #include <vtkPLYReader.h>
 #include <vtkPLYWriter.h>
 #include <vtkAlgorithmOutput.h>
 #include <vtkQuadricDecimation.h>
+#include <thread>
 #include "CmdLineParser.h"
 #include "Logger.h"
+#include "PartitionedDecimation.h"
+#include "RemoveIslands.h"
+#include "Profile.hpp"
 
 Logger logWriter;
 
 cmdLineParameter< char* >
     InputFile( "inputFile" ) ,
-    OutputFile( "outputFile" );
+    OutputFile( "outputFile" ) ,
+    ProfileFile( "profile" );
 cmdLineParameter< int >
-    DecimateMesh( "decimateMesh" );
+    DecimateMesh( "decimateMesh" ) ,
+    DecimateCells( "decimateCells" ) ,
+    MinIslandFaces( "minIslandFaces" ) ,
+    Threads( "threads" );
+cmdLineParameter< float >
+    MinIslandArea( "minIslandArea" );
 cmdLineReadable
     RemoveIslands( "removeIslands" ) ,
+    DecimateSeams( "decimateSeams" ) ,
 	Verbose( "verbose" );
 
 cmdLineReadable* params[] = {
-    &InputFile , &OutputFile , &DecimateMesh, &RemoveIslands, &Verbose ,
+    &InputFile , &OutputFile , &DecimateMesh, &DecimateCells, &DecimateSeams, &Threads, &RemoveIslands, &MinIslandFaces, &MinIslandArea, &ProfileFile, &Verbose ,
     NULL
 };
 
@@ -31,7 +41,14 @@ void help(char *ex){
               << "\t -" << InputFile.name << " <input polygon mesh>" << std::endl
               << "\t -" << OutputFile.name << " <output polygon mesh>" << std::endl
               << "\t [-" << DecimateMesh.name << " <target number of vertices>]" << std::endl
+              << "\t [-" << DecimateCells.name << " <number of cells decimated in parallel, 0 to decimate the whole mesh at once>]" << std::endl
+              << "\t [-" << DecimateSeams.name << "] (decimate the seams between cells in a second pass)" << std::endl
+              << "\t [-" << Threads.name << " <number of threads, default: number of cores>]" << std::endl
               << "\t [-" << RemoveIslands.name << "]" << std::endl
+              << "\t [-" << MinIslandFaces.name << " <smallest number of faces of a component kept by -" << RemoveIslands.name << ">]" << std::endl
+              << "\t [-" << MinIslandArea.name << " <smallest area of a component kept by -" << RemoveIslands.name << ">]" << std::endl
+              << "\t   (without either, -" << RemoveIslands.name << " keeps the largest component only)" << std::endl
+              << "\t [-" << ProfileFile.name << " <output JSON file with the time of every phase, counters and peak memory>]" << std::endl
 
               << "\t [-" << Verbose.name << "]" << std::endl;
     exit(EXIT_FAILURE);
@@ -60,36 +77,48 @@ int main(int argc, char **argv) {
     logWriter.verbose = Verbose.set;
     // logWriter.outputFile = "odm_cleanmesh_log.txt";
     logArgs(params, logWriter);
+    if (ProfileFile.set) Profile::instance().enable("odm_cleanmesh", ProfileFile.value);
 
 	vtkSmartPointer<vtkPLYReader> reader =
     vtkSmartPointer<vtkPLYReader>::New();
         reader->SetFileName ( InputFile.value );
-    reader->Update();
+    {
+        ProfilePhase phase("read_mesh");
+        reader->Update();
+    }
 
     vtkPolyData *nextOutput = reader->GetOutput();
-
-    vtkSmartPointer<vtkPolyDataConnectivityFilter> connectivityFilter =
-    vtkSmartPointer<vtkPolyDataConnectivityFilter>::New();
-    connectivityFilter->SetExtractionModeToLargestRegion();
+    Profile::instance().addFileSize("bytes_read", InputFile.value);
+    Profile::instance().addCount("vertices_read", static_cast<uint64_t>(nextOutput->GetNumberOfPoints()));
+    Profile::instance().addCount("faces_read", static_cast<uint64_t>(nextOutput->GetNumberOfPolys()));
 
     vtkSmartPointer<vtkQuadricDecimation> decimationFilter =
     vtkSmartPointer<vtkQuadricDecimation>::New();
 
+    int threads = Threads.set ? Threads.value : static_cast<int>(std::thread::hardware_concurrency());
+    vtkSmartPointer<vtkPolyData> islandsOutput;
+    vtkSmartPointer<vtkPolyData> partitionedOutput;
+
     if (RemoveIslands.set){
         logWriter("Removing islands\n");
-        connectivityFilter->SetInputData(nextOutput);
-        connectivityFilter->Update();
-        nextOutput = connectivityFilter->GetOutput();
+        ProfilePhase phase("remove_islands");
+        islandsOutput = removeIslands(nextOutput, MinIslandFaces.set ? MinIslandFaces.value : 0,
+                                      MinIslandArea.set ? MinIslandArea.value : 0.0, threads, logWriter);
+        nextOutput = islandsOutput;
     }
 
     if (DecimateMesh.set){
         logWriter("Decimating mesh\n");
+        ProfilePhase phase("decimate");
 
         int vertexCount = nextOutput->GetNumberOfPoints();
         logWriter("Current vertex count: %d\n", vertexCount);
         logWriter("Wanted vertex count: %d\n", DecimateMesh.value);
 
-        if (vertexCount > DecimateMesh.value){
+        if (vertexCount > DecimateMesh.value && DecimateCells.set && DecimateCells.value > 1){
+            partitionedOutput = decimatePartitioned(nextOutput, DecimateMesh.value, DecimateCells.value, threads, DecimateSeams.set, logWriter);
+            nextOutput = partitionedOutput;
+        }else if (vertexCount > DecimateMesh.value){
             double targetReduction = 1.0 - static_cast<double>(DecimateMesh.value) / static_cast<double>(vertexCount);
             logWriter("Target reduction set to %f\n", targetReduction);
             decimationFilter->SetTargetReduction(targetReduction);
@@ -108,7 +137,15 @@ int main(int argc, char **argv) {
     plyWriter->SetFileName(OutputFile.value);
     plyWriter->SetFileTypeToBinary();
     plyWriter->SetInputData(nextOutput);
-    plyWriter->Write();
+    {
+        ProfilePhase phase("write_mesh");
+        plyWriter->Write();
+    }
+    Profile::instance().addFileSize("bytes_written", OutputFile.value);
+    Profile::instance().addCount("vertices_written", static_cast<uint64_t>(nextOutput->GetNumberOfPoints()));
+    Profile::instance().addCount("faces_written", static_cast<uint64_t>(nextOutput->GetNumberOfPolys()));
+
+    if (ProfileFile.set && !Profile::instance().write()) logWriter("Could not write the profile to %s\n", ProfileFile.value);
 
     logWriter("OK\n");
 }
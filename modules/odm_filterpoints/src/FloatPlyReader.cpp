@@ -35,7 +35,9 @@
 // Modified to not cast to double and to use certain type identifier ("float" vs "float32")
 
 #include "FloatPlyReader.hpp"
+#include "Profile.hpp"
 
+#include <algorithm>
 #include <sstream>
 
 #include <pdal/PDALUtils.hpp>
@@ -45,8 +47,23 @@
 namespace pdal
 {
 
+namespace
+{
+
+// Binary vertices are read in blocks of about this many bytes.
+const size_t c_blockBytes = 1 << 22;
+
+bool hostIsLittleEndian()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+} // unnamed namespace
 
-FloatPlyReader::FloatPlyReader() : m_vertexElt(nullptr)
+
+FloatPlyReader::FloatPlyReader() : m_vertexElt(nullptr), m_bulk(false),
+    m_recordSize(0), m_blockPos(0), m_blockEnd(0)
 {}
 
 
@@ -393,6 +410,55 @@ void FloatPlyReader::readElement(Element& elt, PointRef& point)
 }
 
 
+// The vertex element has only simple properties, so a binary vertex is
+// a record of fixed size, which is read straight from a block of records
+// without going through the stream for every property.
+void FloatPlyReader::compileLayout()
+{
+    m_fields.clear();
+    m_recordSize = 0;
+    for (auto& prop : m_vertexElt->m_properties)
+    {
+        auto vprop = static_cast<SimpleProperty *>(prop.get());
+        m_fields.push_back({ vprop->m_dim, vprop->m_type, m_recordSize });
+        m_recordSize += Dimension::size(vprop->m_type);
+    }
+    m_bulk = m_format == Format::BinaryLe && hostIsLittleEndian() &&
+        m_recordSize > 0;
+    if (m_bulk)
+        m_block.resize(std::max(c_blockBytes / m_recordSize,
+            static_cast<size_t>(1)) * m_recordSize);
+    m_blockPos = 0;
+    m_blockEnd = 0;
+}
+
+
+void FloatPlyReader::readBlock()
+{
+    size_t count = std::min(m_block.size() / m_recordSize,
+        static_cast<size_t>(m_vertexElt->m_count - m_index));
+    size_t bytes = count * m_recordSize;
+    m_stream->read(m_block.data(), static_cast<std::streamsize>(bytes));
+    size_t got = static_cast<size_t>(m_stream->gcount());
+    if (got != bytes)
+        throwError("Error reading data for point/element " +
+            std::to_string(m_index + got / m_recordSize) + ".");
+    m_blockPos = 0;
+    m_blockEnd = bytes;
+}
+
+
+void FloatPlyReader::readRecord(PointRef& point)
+{
+    if (m_blockPos == m_blockEnd)
+        readBlock();
+    const char *record = m_block.data() + m_blockPos;
+    for (const RecordField& field : m_fields)
+        point.setField(field.m_dim, field.m_type, record + field.m_offset);
+    m_blockPos += m_recordSize;
+}
+
+
 void FloatPlyReader::ready(PointTableRef table)
 {
     m_stream = Utils::openFile(m_filename, true);
@@ -415,6 +481,7 @@ void FloatPlyReader::ready(PointTableRef table)
             readElement(elt, point);
     }
     m_index = 0;
+    compileLayout();
 }
 
 
@@ -422,7 +489,10 @@ bool FloatPlyReader::processOne(PointRef& point)
 {
     if (m_index < m_vertexElt->m_count)
     {
-        readElement(*m_vertexElt, point);
+        if (m_bulk)
+            readRecord(point);
+        else
+            readElement(*m_vertexElt, point);
         m_index++;
         return true;
     }
@@ -433,6 +503,7 @@ bool FloatPlyReader::processOne(PointRef& point)
 // We're just reading the vertex element here.
 point_count_t FloatPlyReader::read(PointViewPtr view, point_count_t num)
 {
+    ProfilePhase phase("read_ply");
     point_count_t cnt(0);
 
     PointRef point(view->point(0));
@@ -448,7 +519,10 @@ point_count_t FloatPlyReader::read(PointViewPtr view, point_count_t num)
 
 void FloatPlyReader::done(PointTableRef table)
 {
+    Profile::instance().addCount("points_read", m_index);
     Utils::closeFile(m_stream);
+    m_stream = nullptr;
+    std::vector<char>().swap(m_block);
 }
 
 } // namespace pdal
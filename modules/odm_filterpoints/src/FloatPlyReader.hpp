@@ -43,12 +43,13 @@
 
 #include <pdal/Dimension.hpp>
 #include <pdal/Reader.hpp>
+#include <pdal/Streamable.hpp>
 #include <pdal/StageFactory.hpp>
 
 namespace pdal
 {
 
-class PDAL_DLL FloatPlyReader : public Reader
+class PDAL_DLL FloatPlyReader : public Reader, public Streamable
 {
 public:
     std::string getName() const;
@@ -120,6 +121,14 @@ private:
         std::vector<std::unique_ptr<Property>> m_properties;
     };
 
+    // A vertex property at a fixed offset of a binary record.
+    struct RecordField
+    {
+        Dimension::Id m_dim;
+        Dimension::Type m_type;
+        size_t m_offset;
+    };
+
     Format m_format;
     std::string m_line;
     std::string::size_type m_linePos;
@@ -129,6 +138,14 @@ private:
     std::vector<Element> m_elements;
     PointId m_index;
     Element *m_vertexElt;
+    // The vertex record layout and the block of records read ahead, when
+    // the vertices are binary in the byte order of the host.
+    bool m_bulk;
+    std::vector<RecordField> m_fields;
+    size_t m_recordSize;
+    std::vector<char> m_block;
+    size_t m_blockPos;
+    size_t m_blockEnd;
 
     virtual void initialize();
     virtual void addDimensions(PointLayoutPtr layout);
@@ -150,6 +167,9 @@ private:
     void extractHeader();
     void readElement(Element& elt, PointRef& point);
     bool readProperty(Property *prop, PointRef& point);
+    void compileLayout();
+    void readBlock();
+    void readRecord(PointRef& point);
 };
 
 } // namespace pdal
@@ -0,0 +1,117 @@
+#include "KdTree.hpp"
+
+#include <algorithm>
+
+namespace pdal
+{
+
+namespace
+{
+
+const size_t c_leafSize = 16;
+
+} // unnamed namespace
+
+KdTree::KdTree(const std::vector<double>& points) :
+    m_order(points.size() / 3), m_points(points.size())
+{
+    for (size_t i = 0; i < m_order.size(); ++i)
+        m_order[i] = i;
+
+    if (!m_order.empty())
+        build(0, m_order.size(), points);
+
+    for (size_t i = 0; i < m_order.size(); ++i)
+        std::copy(&points[3 * m_order[i]], &points[3 * m_order[i]] + 3,
+            &m_points[3 * i]);
+}
+
+
+size_t KdTree::build(size_t begin, size_t end, const std::vector<double>& points)
+{
+    size_t index = m_nodes.size();
+    m_nodes.push_back(Node());
+    Node node { begin, end, -1, 0.0, 0 };
+
+    if (end - begin > c_leafSize)
+    {
+        double low[3], high[3];
+        for (int c = 0; c < 3; ++c)
+            low[c] = high[c] = points[3 * m_order[begin] + c];
+        for (size_t i = begin + 1; i < end; ++i)
+            for (int c = 0; c < 3; ++c)
+            {
+                low[c] = std::min(low[c], points[3 * m_order[i] + c]);
+                high[c] = std::max(high[c], points[3 * m_order[i] + c]);
+            }
+
+        int axis = 0;
+        for (int c = 1; c < 3; ++c)
+            if (high[c] - low[c] > high[axis] - low[axis])
+                axis = c;
+
+        // Points on the split plane may end up on either side; the search
+        // visits both sides when the plane is close enough.
+        size_t middle = begin + (end - begin) / 2;
+        std::nth_element(m_order.begin() + begin, m_order.begin() + middle,
+            m_order.begin() + end, [&points, axis](size_t a, size_t b)
+            { return points[3 * a + axis] < points[3 * b + axis]; });
+
+        node.axis = axis;
+        node.split = points[3 * m_order[middle] + axis];
+        build(begin, middle, points);
+        node.right = build(middle, end, points);
+    }
+    m_nodes[index] = node;
+    return index;
+}
+
+
+void KdTree::knn(const double *query, size_t k, std::vector<double>& sqrDists) const
+{
+    sqrDists.clear();
+    if (!m_nodes.empty() && k > 0)
+        search(0, query, k, sqrDists);
+    std::sort_heap(sqrDists.begin(), sqrDists.end());
+}
+
+
+// Keeps the k smallest squared distances found so far in a max-heap.
+void KdTree::search(size_t index, const double *query, size_t k,
+    std::vector<double>& heap) const
+{
+    const Node& node = m_nodes[index];
+    if (node.axis < 0)
+    {
+        for (size_t i = node.begin; i < node.end; ++i)
+        {
+            const double *p = &m_points[3 * i];
+            double dx = query[0] - p[0];
+            double dy = query[1] - p[1];
+            double dz = query[2] - p[2];
+            double d = dx * dx + dy * dy + dz * dz;
+            if (heap.size() < k)
+            {
+                heap.push_back(d);
+                std::push_heap(heap.begin(), heap.end());
+            }
+            else if (d < heap.front())
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = d;
+                std::push_heap(heap.begin(), heap.end());
+            }
+        }
+        return;
+    }
+
+    double diff = query[node.axis] - node.split;
+    size_t nearChild = diff < 0 ? index + 1 : node.right;
+    size_t farChild = diff < 0 ? node.right : index + 1;
+
+    search(nearChild, query, k, heap);
+    if (heap.size() < k || diff * diff < heap.front())
+        search(farChild, query, k, heap);
+}
+
+} // namespace pdal
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace pdal
+{
+
+/*!
+ * \brief   A static kd-tree for nearest neighbor queries on 3D points.
+ * \details The points are kept in tree order, so the points of a leaf, and the
+ *          points of neighboring leaves, are close together in memory.
+ */
+class KdTree
+{
+public:
+    /*!
+     * \brief KdTree    Builds the tree.
+     * \param points    The coordinates, x, y and z of every point after each other.
+     */
+    KdTree(const std::vector<double>& points);
+
+    size_t size() const
+        { return m_order.size(); }
+
+    // The index of the point at position i of the tree, in the points the
+    // tree was built from.
+    size_t index(size_t i) const
+        { return m_order[i]; }
+
+    // The coordinates of the point at position i of the tree.
+    const double *point(size_t i) const
+        { return &m_points[3 * i]; }
+
+    /*!
+     * \brief knn       Finds the squared distances from query to its k nearest points.
+     * \param query     The x, y and z of the query.
+     * \param k         The number of neighbors.
+     * \param sqrDists  The squared distances in increasing order; a point at the query
+     *                  position itself is included with a distance of 0.
+     */
+    void knn(const double *query, size_t k, std::vector<double>& sqrDists) const;
+
+private:
+    struct Node
+    {
+        size_t begin;
+        size_t end;
+        int axis;           // -1 for leaves
+        double split;
+        size_t right;       // the left child directly follows its parent
+    };
+
+    size_t build(size_t begin, size_t end, const std::vector<double>& points);
+    void search(size_t index, const double *query, size_t k,
+        std::vector<double>& heap) const;
+
+    std::vector<size_t> m_order;
+    std::vector<double> m_points;
+    std::vector<Node> m_nodes;
+};
+
+} // namespace pdal
@@ -35,7 +35,10 @@
 // Modified to output certain property names in normalized format ("nx", "ny", ... instead of "normalx", "normaly", etc.)
 
 #include "ModifiedPlyWriter.hpp"
+#include "Profile.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 #include <sstream>
 
@@ -45,10 +48,26 @@
 namespace pdal
 {
 
+namespace
+{
+
+// Binary records are written in blocks of about this many bytes.
+const size_t c_bufferBytes = 1 << 22;
+
+bool hostIsLittleEndian()
+{
+    const uint16_t one = 1;
+    return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
+} // unnamed namespace
+
+
 std::string ModifiedPlyWriter::getName() const { return "ModifiedPlyWriter"; }
 
 
-ModifiedPlyWriter::ModifiedPlyWriter()
+ModifiedPlyWriter::ModifiedPlyWriter() : m_stream(nullptr), m_bulk(false),
+    m_recordSize(0), m_bufferPos(0)
 {}
 
 
@@ -59,6 +78,8 @@ void ModifiedPlyWriter::addArgs(ProgramArgs& args)
     args.add("dims", "Dimension names", m_dimNames);
     args.add("faces", "Write faces", m_faces);
     m_precisionArg = &args.add("precision", "Output precision", m_precision, 3);
+    m_vertexCountArg = &args.add("vertex_count", "Number of points written "
+        "when streaming", m_vertexCount);
 }
 
 
@@ -119,7 +140,9 @@ void ModifiedPlyWriter::writeHeader(PointLayoutPtr layout) const
     *m_stream << "ply" << std::endl;
     *m_stream << "format " << m_format << " 1.0" << std::endl;
     *m_stream << "comment Generated by odm_filterpoints" << std::endl;
-    *m_stream << "element vertex " << pointCount() << std::endl;
+    // A streamed header is written before any point has been seen.
+    *m_stream << "element vertex " <<
+        (m_vertexCountArg->set() ? m_vertexCount : pointCount()) << std::endl;
 
     auto ni = m_dimNames.begin();
     for (auto dim : m_dims)
@@ -160,7 +183,45 @@ void ModifiedPlyWriter::ready(PointTableRef table)
         *m_stream << std::fixed;
         m_stream->precision(m_precision);
     }
+    m_layout = table.layout();
     writeHeader(table.layout());
+
+    m_bulk = m_format == Format::BinaryLe && hostIsLittleEndian();
+    m_types.clear();
+    m_recordSize = 0;
+    for (auto dim : m_dims)
+    {
+        m_types.push_back(m_layout->dimType(dim));
+        m_recordSize += Dimension::size(m_types.back());
+    }
+    if (m_bulk)
+        m_buffer.resize(c_bufferBytes);
+    m_bufferPos = 0;
+}
+
+
+// Returns room for a record of the given size in the buffer, writing out
+// the buffer first when it is full.
+char *ModifiedPlyWriter::reserve(size_t bytes)
+{
+    if (m_bufferPos + bytes > m_buffer.size())
+    {
+        flush();
+        if (bytes > m_buffer.size())
+            m_buffer.resize(bytes);
+    }
+    char *record = m_buffer.data() + m_bufferPos;
+    m_bufferPos += bytes;
+    return record;
+}
+
+
+void ModifiedPlyWriter::flush()
+{
+    if (m_bufferPos)
+        m_stream->write(m_buffer.data(),
+            static_cast<std::streamsize>(m_bufferPos));
+    m_bufferPos = 0;
 }
 
 
@@ -170,6 +231,13 @@ void ModifiedPlyWriter::write(const PointViewPtr data)
 }
 
 
+bool ModifiedPlyWriter::processOne(PointRef& point)
+{
+    writePoint(point, m_layout);
+    return true;
+}
+
+
 void ModifiedPlyWriter::writeValue(PointRef& point, Dimension::Id dim,
     Dimension::Type type)
 {
@@ -197,6 +265,17 @@ void ModifiedPlyWriter::writeValue(PointRef& point, Dimension::Id dim,
 
 void ModifiedPlyWriter::writePoint(PointRef& point, PointLayoutPtr layout)
 {
+    if (m_bulk)
+    {
+        char *record = reserve(m_recordSize);
+        for (size_t i = 0; i < m_dims.size(); ++i)
+        {
+            point.getField(record, m_dims[i], m_types[i]);
+            record += Dimension::size(m_types[i]);
+        }
+        return;
+    }
+
     for (auto it = m_dims.begin(); it != m_dims.end();)
     {
         Dimension::Id dim = *it;
@@ -217,6 +296,15 @@ void ModifiedPlyWriter::writeTriangle(const Triangle& t, size_t offset)
         *m_stream << "3 " << (t.m_a + offset) << " " <<
             (t.m_b + offset) << " " << (t.m_c + offset) << std::endl;
     }
+    else if (m_bulk)
+    {
+        unsigned char count = 3;
+        uint32_t indices[3] = { (uint32_t)(t.m_a + offset),
+            (uint32_t)(t.m_b + offset), (uint32_t)(t.m_c + offset) };
+        char *record = reserve(sizeof(count) + sizeof(indices));
+        std::memcpy(record, &count, sizeof(count));
+        std::memcpy(record + sizeof(count), indices, sizeof(indices));
+    }
     else if (m_format == Format::BinaryLe)
     {
         OLeStream out(m_stream);
@@ -242,6 +330,7 @@ void ModifiedPlyWriter::writeTriangle(const Triangle& t, size_t offset)
 // point views to be written.
 void ModifiedPlyWriter::done(PointTableRef table)
 {
+    ProfilePhase phase("write_ply");
     for (auto& v : m_views)
     {
         PointRef point(*v, 0);
@@ -268,6 +357,10 @@ void ModifiedPlyWriter::done(PointTableRef table)
             offset += v->size();
         }
     }
+    flush();
+    std::vector<char>().swap(m_buffer);
+    Profile::instance().addCount("points_written",
+        m_vertexCountArg->set() ? m_vertexCount : pointCount());
     Utils::closeFile(m_stream);
     m_stream = nullptr;
     getMetadata().addList("filename", m_filename);
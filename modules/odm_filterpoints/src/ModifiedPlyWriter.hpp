@@ -34,13 +34,14 @@
 
 #include <pdal/PointView.hpp>
 #include <pdal/Writer.hpp>
+#include <pdal/Streamable.hpp>
 
 namespace pdal
 {
 
 class Triangle;
 
-class PDAL_DLL ModifiedPlyWriter : public Writer
+class PDAL_DLL ModifiedPlyWriter : public Writer, public Streamable
 {
 public:
     enum class Format
@@ -59,6 +60,7 @@ private:
     virtual void prepared(PointTableRef table);
     virtual void ready(PointTableRef table);
     virtual void write(const PointViewPtr data);
+    virtual bool processOne(PointRef& point);
     virtual void done(PointTableRef table);
 
     std::string getType(Dimension::Type type) const;
@@ -66,6 +68,8 @@ private:
     void writeValue(PointRef& point, Dimension::Id dim, Dimension::Type type);
     void writePoint(PointRef& point, PointLayoutPtr layout);
     void writeTriangle(const Triangle& t, size_t offset);
+    char *reserve(size_t bytes);
+    void flush();
 
     std::ostream *m_stream;
     std::string m_filename;
@@ -75,7 +79,17 @@ private:
     Dimension::IdList m_dims;
     int m_precision;
     Arg *m_precisionArg;
+    point_count_t m_vertexCount;
+    Arg *m_vertexCountArg;
+    PointLayoutPtr m_layout;
     std::vector<PointViewPtr> m_views;
+    // Binary records in the byte order of the host are packed into a
+    // buffer and written in large blocks.
+    bool m_bulk;
+    std::vector<Dimension::Type> m_types;
+    size_t m_recordSize;
+    std::vector<char> m_buffer;
+    size_t m_bufferPos;
 };
 
 inline std::istream& operator>>(std::istream& in, ModifiedPlyWriter::Format& f)
@@ -0,0 +1,322 @@
+#include "PoissonSampleFilter.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <pdal/util/ProgramArgs.hpp>
+
+namespace pdal
+{
+
+namespace
+{
+
+// The integer coordinates of a cell of the grid.
+struct CellKey
+{
+    int32_t x;
+    int32_t y;
+    int32_t z;
+
+    bool operator==(const CellKey& other) const
+        { return x == other.x && y == other.y && z == other.z; }
+
+    // The pass of the cell, by the parity of its coordinates.
+    size_t pass() const
+        { return static_cast<size_t>((x & 1) | ((y & 1) << 1) | ((z & 1) << 2)); }
+};
+
+struct CellKeyHash
+{
+    size_t operator()(const CellKey& key) const
+    {
+        return (static_cast<size_t>(static_cast<uint32_t>(key.x)) * 73856093u) ^
+            (static_cast<size_t>(static_cast<uint32_t>(key.y)) * 19349663u) ^
+            (static_cast<size_t>(static_cast<uint32_t>(key.z)) * 83492791u);
+    }
+};
+
+typedef std::unordered_map<CellKey, size_t, CellKeyHash> CellMap;
+
+// Calls fn(first, last) for chunks of [0, count) on all threads.
+template <typename Fn>
+void parallelChunks(size_t threads, size_t count, size_t chunkSize, Fn fn)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t first = next.fetch_add(chunkSize); first < count;
+            first = next.fetch_add(chunkSize))
+            fn(first, std::min(first + chunkSize, count));
+    };
+
+    threads = std::min(threads, (count + chunkSize - 1) / chunkSize);
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
+
+} // unnamed namespace
+
+
+std::string PoissonSampleFilter::getName() const
+{
+    return "PoissonSampleFilter";
+}
+
+
+PoissonSampleFilter::PoissonSampleFilter()
+{}
+
+
+void PoissonSampleFilter::addArgs(ProgramArgs& args)
+{
+    args.add("radius", "Minimum distance between the kept points", m_radius,
+        1.0);
+    args.add("threads", "Number of threads, 0 for all hardware threads",
+        m_threads, 0);
+}
+
+
+PointViewSet PoissonSampleFilter::run(PointViewPtr view)
+{
+    PointViewSet viewSet;
+    point_count_t np = view->size();
+    if (np == 0 || !(m_radius > 0.0))
+    {
+        viewSet.insert(view);
+        return viewSet;
+    }
+
+    ProfilePhase phase("sample");
+    size_t threads = m_threads > 0 ? static_cast<size_t>(m_threads) :
+        std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunkSize = 1 << 16;
+    size_t chunks = (np + chunkSize - 1) / chunkSize;
+
+    // The cells are relative to the first point, so their coordinates stay small.
+    double x0 = view->getFieldAs<double>(Dimension::Id::X, 0);
+    double y0 = view->getFieldAs<double>(Dimension::Id::Y, 0);
+    double z0 = view->getFieldAs<double>(Dimension::Id::Z, 0);
+
+    // Every shard of the hashed grid holds the cells hashed to it, with their points.
+    size_t shards = 16 * threads;
+    std::vector<double> points(3 * np);
+    std::vector<CellKey> keys(np);
+    std::vector<size_t> shardCounts(chunks * shards, 0);
+    CellKeyHash hash;
+
+    // The cell coordinates are computed in double and must fit an int32 with room for the
+    // neighbors, else the radius is too small for the extent of the cloud.
+    const double maxCell = static_cast<double>(std::numeric_limits<int32_t>::max() - 1);
+    std::atomic<bool> outOfRange(false);
+    auto cell = [&](double offset) -> int32_t
+    {
+        double c = std::floor(offset / m_radius);
+        if (!(std::abs(c) <= maxCell))
+        {
+            outOfRange = true;
+            return 0;
+        }
+        return static_cast<int32_t>(c);
+    };
+
+    parallelChunks(threads, np, chunkSize, [&](size_t first, size_t last)
+    {
+        size_t *counts = &shardCounts[first / chunkSize * shards];
+        for (size_t i = first; i < last; ++i)
+        {
+            double x = view->getFieldAs<double>(Dimension::Id::X, i);
+            double y = view->getFieldAs<double>(Dimension::Id::Y, i);
+            double z = view->getFieldAs<double>(Dimension::Id::Z, i);
+            points[3 * i] = x;
+            points[3 * i + 1] = y;
+            points[3 * i + 2] = z;
+
+            CellKey &key = keys[i];
+            key.x = cell(x - x0);
+            key.y = cell(y - y0);
+            key.z = cell(z - z0);
+            counts[hash(key) % shards]++;
+        }
+    });
+
+    if (outOfRange)
+        throwError("Radius " + std::to_string(m_radius) +
+            " is too small for the extent of the cloud, or a point is not finite.");
+
+    // The points of each shard are contiguous, and in input order.
+    std::vector<size_t> shardBegin(shards + 1, 0);
+    size_t offset = 0;
+    for (size_t s = 0; s < shards; ++s)
+    {
+        shardBegin[s] = offset;
+        for (size_t c = 0; c < chunks; ++c)
+        {
+            size_t count = shardCounts[c * shards + s];
+            shardCounts[c * shards + s] = offset;
+            offset += count;
+        }
+    }
+    shardBegin[shards] = offset;
+
+    std::vector<PointId> order(np);
+    parallelChunks(threads, np, chunkSize, [&](size_t first, size_t last)
+    {
+        size_t *offsets = &shardCounts[first / chunkSize * shards];
+        for (size_t i = first; i < last; ++i)
+            order[offsets[hash(keys[i]) % shards]++] = i;
+    });
+    std::vector<size_t>().swap(shardCounts);
+
+    // The cells of each shard, numbered in the order of their first point. The points of a
+    // shard are grouped by cell, still in input order within a cell.
+    std::vector<std::vector<size_t>> shardCells(shards);
+    std::vector<CellMap> cellMaps(shards);
+    parallelChunks(threads, shards, 1, [&](size_t first, size_t last)
+    {
+        for (size_t s = first; s < last; ++s)
+        {
+            size_t begin = shardBegin[s];
+            size_t count = shardBegin[s + 1] - begin;
+            CellMap &map = cellMaps[s];
+            std::vector<size_t> &starts = shardCells[s];
+            std::vector<size_t> pointCells(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto inserted = map.insert(std::make_pair(keys[order[begin + i]], starts.size()));
+                if (inserted.second)
+                    starts.push_back(0);
+                pointCells[i] = inserted.first->second;
+                starts[pointCells[i]]++;
+            }
+
+            size_t start = begin;
+            for (auto& cellStart : starts)
+            {
+                size_t points = cellStart;
+                cellStart = start;
+                start += points;
+            }
+
+            std::vector<size_t> next(starts);
+            std::vector<PointId> shardOrder(order.begin() + static_cast<std::ptrdiff_t>(begin),
+                order.begin() + static_cast<std::ptrdiff_t>(begin + count));
+            for (size_t i = 0; i < count; ++i)
+                order[next[pointCells[i]]++] = shardOrder[i];
+        }
+    });
+
+    std::vector<size_t> shardCellBegin(shards + 1, 0);
+    for (size_t s = 0; s < shards; ++s)
+        shardCellBegin[s + 1] = shardCellBegin[s] + shardCells[s].size();
+    size_t cellCount = shardCellBegin[shards];
+
+    std::vector<CellKey> cellKeys(cellCount);
+    std::vector<size_t> cellBegin(cellCount);
+    std::vector<size_t> cellEnd(cellCount);
+    parallelChunks(threads, shards, 1, [&](size_t first, size_t last)
+    {
+        for (size_t s = first; s < last; ++s)
+        {
+            const std::vector<size_t> &cells = shardCells[s];
+            for (size_t j = 0; j < cells.size(); ++j)
+            {
+                size_t cell = shardCellBegin[s] + j;
+                cellKeys[cell] = keys[order[cells[j]]];
+                cellBegin[cell] = cells[j];
+                cellEnd[cell] = j + 1 < cells.size() ? cells[j + 1] : shardBegin[s + 1];
+            }
+            std::vector<size_t>().swap(shardCells[s]);
+        }
+    });
+    std::vector<CellKey>().swap(keys);
+
+    std::vector<std::vector<size_t>> passCells(8);
+    for (size_t cell = 0; cell < cellCount; ++cell)
+        passCells[cellKeys[cell].pass()].push_back(cell);
+
+    // The kept points of a cell are moved to the start of its range in order.
+    std::vector<size_t> keptCounts(cellCount, 0);
+    std::vector<char> keep(np, 0);
+    double sqrRadius = m_radius * m_radius;
+    for (size_t pass = 0; pass < passCells.size(); ++pass)
+    {
+        const std::vector<size_t> &cells = passCells[pass];
+        parallelChunks(threads, cells.size(), 64, [&](size_t first, size_t last)
+        {
+            std::vector<size_t> neighbors;
+            for (size_t c = first; c < last; ++c)
+            {
+                size_t cell = cells[c];
+                const CellKey &key = cellKeys[cell];
+
+                // The cells of later passes have no kept points yet.
+                neighbors.clear();
+                for (int32_t dx = -1; dx <= 1; ++dx)
+                    for (int32_t dy = -1; dy <= 1; ++dy)
+                        for (int32_t dz = -1; dz <= 1; ++dz)
+                        {
+                            CellKey other = { key.x + dx, key.y + dy, key.z + dz };
+                            size_t shard = hash(other) % shards;
+                            auto it = cellMaps[shard].find(other);
+                            if (it == cellMaps[shard].end())
+                                continue;
+                            size_t neighbor = shardCellBegin[shard] + it->second;
+                            if (neighbor == cell || keptCounts[neighbor] > 0)
+                                neighbors.push_back(neighbor);
+                        }
+
+                size_t &kept = keptCounts[cell];
+                for (size_t i = cellBegin[cell]; i < cellEnd[cell]; ++i)
+                {
+                    PointId p = order[i];
+                    const double *point = &points[3 * p];
+                    bool free = true;
+                    for (size_t n = 0; n < neighbors.size() && free; ++n)
+                    {
+                        size_t neighbor = neighbors[n];
+                        size_t end = cellBegin[neighbor] + keptCounts[neighbor];
+                        for (size_t j = cellBegin[neighbor]; j < end; ++j)
+                        {
+                            const double *other = &points[3 * order[j]];
+                            double dx = point[0] - other[0];
+                            double dy = point[1] - other[1];
+                            double dz = point[2] - other[2];
+                            if (dx * dx + dy * dy + dz * dz < sqrRadius)
+                            {
+                                free = false;
+                                break;
+                            }
+                        }
+                    }
+                    if (free)
+                    {
+                        order[cellBegin[cell] + kept++] = p;
+                        keep[p] = 1;
+                    }
+                }
+            }
+        });
+    }
+
+    PointViewPtr output = view->makeNew();
+    for (PointId i = 0; i < np; ++i)
+        if (keep[i])
+            output->appendPoint(*view, i);
+    Profile::instance().addCount("points_sampled_out", np - output->size());
+
+    viewSet.insert(output);
+    return viewSet;
+}
+
+} // namespace pdal
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <pdal/Filter.hpp>
+#include <pdal/PointView.hpp>
+
+namespace pdal
+{
+
+/*!
+ * \brief   Multi-threaded Poisson sampling, in place of filters.sample.
+ * \details Keeps a subset of the points in which no two points are closer than radius, while
+ *          every dropped point has a kept point closer than radius, as filters.sample does.
+ *
+ *          The points are binned into a hashed grid of cells as large as the radius, so the
+ *          points conflicting with a point lie in the 27 cells around its own. The cells are
+ *          sampled in 8 passes, by the parity of their coordinates: the cells of a pass are never
+ *          neighbors, so they are sampled in parallel, each one against itself and the cells of
+ *          the passes before. Within a cell the points are taken in input order, and the kept
+ *          points keep their input order.
+ *
+ *          The cell coordinates are 32-bit integers. A radius which would need more than 2^31 cells
+ *          along an axis of the cloud is an error, as is a point that is not finite.
+ *
+ *          The result does not depend on the number of threads. It differs from the one of
+ *          filters.sample, which takes the points of the whole cloud in input order.
+ */
+class PDAL_DLL PoissonSampleFilter : public Filter
+{
+public:
+    std::string getName() const;
+
+    PoissonSampleFilter();
+
+private:
+    virtual void addArgs(ProgramArgs& args);
+    virtual PointViewSet run(PointViewPtr view);
+
+    double m_radius;
+    int m_threads;
+};
+
+} // namespace pdal
@@ -0,0 +1,144 @@
+#include "StatisticalOutlierFilter.hpp"
+#include "KdTree.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include <pdal/util/ProgramArgs.hpp>
+
+namespace pdal
+{
+
+std::string StatisticalOutlierFilter::getName() const
+{
+    return "StatisticalOutlierFilter";
+}
+
+
+StatisticalOutlierFilter::StatisticalOutlierFilter()
+{}
+
+
+double StatisticalOutlierFilter::meanDistance(const std::vector<double>& sqrDists)
+{
+    // Same running mean as OutlierFilter, so that the results are identical.
+    double distance = 0.0;
+    for (size_t j = 1; j < sqrDists.size(); ++j)
+    {
+        double delta = std::sqrt(sqrDists[j]) - distance;
+        distance += (delta / static_cast<double>(j));
+    }
+    return distance;
+}
+
+
+void StatisticalOutlierFilter::addArgs(ProgramArgs& args)
+{
+    args.add("mean_k", "Mean number of neighbors", m_meanK, 8);
+    args.add("multiplier", "Standard deviation threshold", m_multiplier, 2.0);
+    args.add("class", "Class to use for noise points", m_class, uint8_t(7));
+    args.add("threads", "Number of threads, 0 for all hardware threads",
+        m_threads, 0);
+}
+
+
+void StatisticalOutlierFilter::addDimensions(PointLayoutPtr layout)
+{
+    layout->registerDim(Dimension::Id::Classification);
+}
+
+
+void StatisticalOutlierFilter::filter(PointView& view)
+{
+    point_count_t np = view.size();
+    if (np == 0)
+        return;
+
+    ProfilePhase phase("outlier_filter");
+    std::vector<double> points(3 * np);
+    for (PointId i = 0; i < np; ++i)
+    {
+        points[3 * i] = view.getFieldAs<double>(Dimension::Id::X, i);
+        points[3 * i + 1] = view.getFieldAs<double>(Dimension::Id::Y, i);
+        points[3 * i + 2] = view.getFieldAs<double>(Dimension::Id::Z, i);
+    }
+    KdTree tree(points);
+    std::vector<double>().swap(points);
+
+    // The query point itself is found with a distance of 0, so one more
+    // neighbor than asked for is searched.
+    size_t count = static_cast<size_t>(
+        std::min(static_cast<point_count_t>(m_meanK) + 1, np));
+
+    // Queries are made in tree order, so consecutive queries visit the
+    // same leaves.
+    std::vector<double> distances(np, 0.0);
+    std::atomic<size_t> next(0);
+    const size_t chunkSize = 4096;
+
+    auto worker = [&]()
+    {
+        std::vector<double> sqrDists;
+        sqrDists.reserve(count);
+        for (size_t first = next.fetch_add(chunkSize); first < tree.size();
+            first = next.fetch_add(chunkSize))
+        {
+            size_t last = std::min(first + chunkSize, tree.size());
+            for (size_t i = first; i < last; ++i)
+            {
+                tree.knn(tree.point(i), count, sqrDists);
+                distances[tree.index(i)] = meanDistance(sqrDists);
+            }
+        }
+    };
+
+    size_t threads = m_threads > 0 ? static_cast<size_t>(m_threads) :
+        std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, (tree.size() + chunkSize - 1) / chunkSize);
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+
+    DistanceStatistics statistics;
+    for (auto const& d : distances)
+        statistics.add(d);
+    double threshold = statistics.threshold(m_multiplier);
+
+    point_count_t outliers = 0;
+    for (PointId i = 0; i < np; ++i)
+        if (distances[i] > threshold)
+        {
+            view.setField(Dimension::Id::Classification, i, m_class);
+            outliers++;
+        }
+    Profile::instance().addCount("points_filtered", outliers);
+}
+
+
+void DistanceStatistics::add(double d)
+{
+    size_t n1(m_n);
+    m_n++;
+    double delta = d - m_M1;
+    double delta_n = delta / static_cast<double>(m_n);
+    m_M1 += delta_n;
+    m_M2 += delta * delta_n * static_cast<double>(n1);
+}
+
+
+double DistanceStatistics::threshold(double multiplier) const
+{
+    double mean = m_M1;
+    double variance = m_M2 / (static_cast<double>(m_n) - 1.0);
+    double stdev = std::sqrt(variance);
+    return mean + multiplier * stdev;
+}
+
+} // namespace pdal
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <pdal/Filter.hpp>
+#include <pdal/PointView.hpp>
+
+#include <vector>
+
+namespace pdal
+{
+
+/*!
+ * \brief   Multi-threaded version of the statistical method of filters.outlier.
+ * \details For every point the mean distance to its mean_k nearest neighbors is computed;
+ *          points whose mean distance exceeds the mean of all of them by more than multiplier
+ *          standard deviations are classified as noise (7). The neighbor statistics match
+ *          OutlierFilter, the nearest neighbor queries run on all threads.
+ */
+class PDAL_DLL StatisticalOutlierFilter : public Filter
+{
+public:
+    std::string getName() const;
+
+    StatisticalOutlierFilter();
+
+    /*!
+     * \brief meanDistance  The mean distance from a point to its neighbors.
+     * \param sqrDists      The squared distances to the nearest points in increasing order,
+     *                      starting with the point itself.
+     */
+    static double meanDistance(const std::vector<double>& sqrDists);
+
+private:
+    virtual void addArgs(ProgramArgs& args);
+    virtual void addDimensions(PointLayoutPtr layout);
+    virtual void filter(PointView& view);
+
+    int m_meanK;
+    double m_multiplier;
+    uint8_t m_class;
+    int m_threads;
+};
+
+/*!
+ * \brief   The running mean and variance of the mean neighbor distances.
+ * \details The distances must be added in point order; the order of the
+ *          operations is the one of OutlierFilter, so the threshold is too.
+ */
+class PDAL_DLL DistanceStatistics
+{
+public:
+    DistanceStatistics() : m_n(0), m_M1(0.0), m_M2(0.0)
+        {}
+
+    void add(double d);
+
+    // Distances above mean + multiplier * standard deviation are outliers.
+    double threshold(double multiplier) const;
+
+private:
+    size_t m_n;
+    double m_M1;
+    double m_M2;
+};
+
+} // namespace pdal
@@ -0,0 +1,617 @@
+#include "TiledFilter.hpp"
+#include "FloatPlyReader.hpp"
+#include "ModifiedPlyWriter.hpp"
+#include "StatisticalOutlierFilter.hpp"
+#include "KdTree.hpp"
+#include "Profile.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <pdal/Streamable.hpp>
+#include <pdal/filters/RangeFilter.hpp>
+
+namespace pdal
+{
+
+namespace
+{
+
+// Hands every streamed point to a callback; a point is dropped when the
+// callback returns false.
+class PointCallbackFilter : public Filter, public Streamable
+{
+public:
+    typedef std::function<bool (PointRef&)> Callback;
+
+    PointCallbackFilter(Callback callback, bool classify) :
+        m_callback(callback), m_classify(classify)
+    {}
+
+    std::string getName() const
+        { return "PointCallbackFilter"; }
+
+private:
+    virtual void addDimensions(PointLayoutPtr layout)
+    {
+        if (m_classify)
+            layout->registerDim(Dimension::Id::Classification);
+    }
+
+    virtual bool processOne(PointRef& point)
+        { return m_callback(point); }
+
+    Callback m_callback;
+    bool m_classify;
+};
+
+
+// The reader and the optional confidence filter, the start of every pass.
+class Source
+{
+public:
+    Source(const std::string& inputFile, bool useConfidence, float confidence)
+    {
+        Options readerOpts;
+        readerOpts.add("filename", inputFile);
+        m_reader.setOptions(readerOpts);
+        m_last = &m_reader;
+
+        if (useConfidence)
+        {
+            Options confidenceOpts;
+            std::ostringstream confidenceLimit;
+            confidenceLimit << "confidence[" << confidence << ":1]";
+            confidenceOpts.add("limits", confidenceLimit.str());
+            m_confidenceFilter.setOptions(confidenceOpts);
+            m_confidenceFilter.setInput(m_reader);
+            m_last = &m_confidenceFilter;
+        }
+    }
+
+    Stage& last()
+        { return *m_last; }
+
+private:
+    FloatPlyReader m_reader;
+    RangeFilter m_confidenceFilter;
+    Stage *m_last;
+};
+
+
+void stream(Stage& stage)
+{
+    FixedPointTable table(10000);
+    stage.prepare(table);
+    stage.execute(table);
+}
+
+
+const double c_infinity = std::numeric_limits<double>::infinity();
+
+// A neighbor distance is compared against the distance to a border with
+// some slack, so that rounding can only cause needless repairs.
+bool inside(double distance, double border)
+{
+    return distance * (1.0 + 1e-6) < border;
+}
+
+
+size_t threadCount(int threads, size_t jobs)
+{
+    size_t count = threads > 0 ? static_cast<size_t>(threads) :
+        std::max(1u, std::thread::hardware_concurrency());
+    return std::max(static_cast<size_t>(1), std::min(count, jobs));
+}
+
+
+// Runs job(0) ... job(jobs - 1) on count threads.
+void parallel(size_t count, size_t jobs, std::function<void (size_t)> job)
+{
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t j = next++; j < jobs; j = next++)
+            job(j);
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < count; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
+
+} // unnamed namespace
+
+
+struct TiledFilter::Record
+{
+    PointId id;
+    double x;
+    double y;
+    double z;
+};
+
+
+struct TiledFilter::Uncertain
+{
+    PointId id;
+    double x;
+    double y;
+    double z;
+    double radius;      // an upper bound of the distance to the farthest neighbor
+};
+
+
+struct TiledFilter::Grid
+{
+    double minX;
+    double minY;
+    double maxX;
+    double maxY;
+    double size;
+    double margin;
+    size_t tilesX;
+    size_t tilesY;
+
+    size_t tiles() const
+        { return tilesX * tilesY; }
+
+    size_t cell(double v, double min, size_t count) const
+    {
+        double c = std::floor((v - min) / size);
+        if (!(c > 0.0))
+            return 0;
+        return std::min(static_cast<size_t>(c), count - 1);
+    }
+
+    size_t column(double x) const
+        { return cell(x, minX, tilesX); }
+
+    size_t row(double y) const
+        { return cell(y, minY, tilesY); }
+
+    // The tile owning the point.
+    size_t tile(double x, double y) const
+        { return row(y) * tilesX + column(x); }
+
+    // The box around a tile, grown by grow on every side.
+    void box(size_t tile, double grow, double& lowX, double& lowY,
+        double& highX, double& highY) const
+    {
+        double x = static_cast<double>(tile % tilesX);
+        double y = static_cast<double>(tile / tilesX);
+        lowX = minX + x * size - grow;
+        lowY = minY + y * size - grow;
+        highX = minX + (x + 1.0) * size + grow;
+        highY = minY + (y + 1.0) * size + grow;
+    }
+
+    bool contains(size_t tile, double grow, double x, double y) const
+    {
+        double lowX, lowY, highX, highY;
+        box(tile, grow, lowX, lowY, highX, highY);
+        return x >= lowX && x <= highX && y >= lowY && y <= highY;
+    }
+
+    // The distance from the point to the nearest side of the grown box
+    // that has points beyond it.
+    double border(size_t tile, double grow, double x, double y) const
+    {
+        double lowX, lowY, highX, highY;
+        box(tile, grow, lowX, lowY, highX, highY);
+        double distance = c_infinity;
+        if (lowX > minX) distance = std::min(distance, x - lowX);
+        if (lowY > minY) distance = std::min(distance, y - lowY);
+        if (highX < maxX) distance = std::min(distance, highX - x);
+        if (highY < maxY) distance = std::min(distance, highY - y);
+        return distance;
+    }
+};
+
+
+TiledFilter::TiledFilter(const std::string& inputFile,
+        const std::string& outputFile, Log log) :
+    m_inputFile(inputFile), m_outputFile(outputFile), m_log(log),
+    m_useConfidence(false), m_confidence(0.0f), m_meanK(8), m_multiplier(2.0),
+    m_tileSize(100.0), m_threads(0), m_count(0)
+{}
+
+
+void TiledFilter::setConfidence(float confidence)
+{
+    m_useConfidence = true;
+    m_confidence = confidence;
+}
+
+
+std::string TiledFilter::tileFile(size_t tile) const
+{
+    return m_outputFile + ".tile" + std::to_string(tile) + ".tmp";
+}
+
+
+void TiledFilter::run()
+{
+    if (!(m_tileSize > 0.0))
+        throw std::runtime_error("The tile size must be positive.");
+
+    Grid grid;
+    {
+        ProfilePhase phase("read_bounds");
+        readBounds(grid);
+    }
+    std::ostringstream message;
+    message << "Filtering " << m_count << " points in " << grid.tilesX <<
+        " x " << grid.tilesY << " tiles\n";
+    m_log(message.str());
+
+    std::string distanceFile = m_outputFile + ".distances.tmp";
+    double *distances = nullptr;
+    size_t mappedSize = static_cast<size_t>(m_count) * sizeof(double);
+    int fd = -1;
+
+    try
+    {
+        if (m_count > 0)
+        {
+            {
+                ProfilePhase phase("write_tiles");
+                writeTiles(grid);
+            }
+
+            fd = open(distanceFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0 || ftruncate(fd, static_cast<off_t>(mappedSize)) != 0)
+                throw std::runtime_error("Could not create " + distanceFile);
+            void *mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED)
+                throw std::runtime_error("Could not map " + distanceFile);
+            distances = static_cast<double *>(mapped);
+
+            // Tiles are written to by one thread each, and only at the
+            // points they own.
+            std::vector<std::vector<Uncertain>> uncertain(grid.tiles());
+            size_t threads = threadCount(m_threads, grid.tiles());
+            {
+                ProfilePhase phase("filter_tiles");
+                parallel(threads, grid.tiles(), [&](size_t tile)
+                    { filterTile(grid, tile, distances, uncertain[tile]); });
+            }
+
+            size_t repairs = 0;
+            for (auto const& u : uncertain)
+                repairs += u.size();
+            if (repairs)
+            {
+                m_log("Querying " + std::to_string(repairs) +
+                    " points near tile borders again\n");
+                ProfilePhase phase("repair_tiles");
+                parallel(threads, grid.tiles(), [&](size_t tile)
+                    { repairTile(grid, tile, distances, uncertain[tile]); });
+            }
+            Profile::instance().addCount("points_repaired", repairs);
+
+            for (size_t tile = 0; tile < grid.tiles(); ++tile)
+                std::remove(tileFile(tile).c_str());
+        }
+
+        DistanceStatistics statistics;
+        for (PointId i = 0; i < m_count; ++i)
+            statistics.add(distances[i]);
+        double threshold = statistics.threshold(m_multiplier);
+
+        point_count_t outliers = 0;
+        for (PointId i = 0; i < m_count; ++i)
+            if (distances[i] > threshold)
+                outliers++;
+        for (auto const& id : m_noise)
+            if (!(distances[id] > threshold))
+                outliers++;
+        m_log("Removing " + std::to_string(outliers) + " outliers\n");
+        Profile::instance().addCount("points_filtered", outliers);
+
+        ProfilePhase phase("write_output");
+        writeOutput(distances, threshold, m_count - outliers);
+    }
+    catch (...)
+    {
+        for (size_t tile = 0; tile < grid.tiles(); ++tile)
+            std::remove(tileFile(tile).c_str());
+        if (distances)
+            munmap(distances, mappedSize);
+        if (fd >= 0)
+        {
+            close(fd);
+            std::remove(distanceFile.c_str());
+        }
+        throw;
+    }
+
+    if (distances)
+        munmap(distances, mappedSize);
+    if (fd >= 0)
+    {
+        close(fd);
+        std::remove(distanceFile.c_str());
+    }
+}
+
+
+void TiledFilter::readBounds(Grid& grid)
+{
+    grid.minX = grid.minY = c_infinity;
+    grid.maxX = grid.maxY = -c_infinity;
+    m_count = 0;
+    m_noise.clear();
+
+    Source source(m_inputFile, m_useConfidence, m_confidence);
+    PointCallbackFilter bounds([&](PointRef& point)
+    {
+        double x = point.getFieldAs<double>(Dimension::Id::X);
+        double y = point.getFieldAs<double>(Dimension::Id::Y);
+        grid.minX = std::min(grid.minX, x);
+        grid.minY = std::min(grid.minY, y);
+        grid.maxX = std::max(grid.maxX, x);
+        grid.maxY = std::max(grid.maxY, y);
+
+        // The output drops points classified as noise in the input too.
+        if (point.hasDim(Dimension::Id::Classification) &&
+            point.getFieldAs<int>(Dimension::Id::Classification) == 7)
+            m_noise.push_back(m_count);
+        m_count++;
+        return true;
+    }, false);
+    bounds.setInput(source.last());
+    stream(bounds);
+
+    grid.size = m_tileSize;
+    grid.margin = m_tileSize / 10.0;
+    grid.tilesX = grid.tilesY = 1;
+    if (m_count > 0)
+    {
+        grid.tilesX = static_cast<size_t>(std::max(1.0,
+            std::ceil((grid.maxX - grid.minX) / grid.size)));
+        grid.tilesY = static_cast<size_t>(std::max(1.0,
+            std::ceil((grid.maxY - grid.minY) / grid.size)));
+    }
+}
+
+
+void TiledFilter::writeTiles(const Grid& grid)
+{
+    const size_t bufferSize = 2048;
+    std::vector<std::vector<Record>> buffers(grid.tiles());
+
+    // Appending and closing keeps the number of open files down.
+    auto flush = [&](size_t tile)
+    {
+        std::vector<Record>& buffer = buffers[tile];
+        FILE *fp = fopen(tileFile(tile).c_str(), "ab");
+        if (!fp || fwrite(buffer.data(), sizeof(Record), buffer.size(), fp) !=
+            buffer.size())
+        {
+            if (fp)
+                fclose(fp);
+            throw std::runtime_error("Could not write " + tileFile(tile));
+        }
+        fclose(fp);
+        buffer.clear();
+    };
+
+    for (size_t tile = 0; tile < grid.tiles(); ++tile)
+        std::remove(tileFile(tile).c_str());
+
+    PointId id = 0;
+    Source source(m_inputFile, m_useConfidence, m_confidence);
+    PointCallbackFilter split([&](PointRef& point)
+    {
+        Record record { id++, point.getFieldAs<double>(Dimension::Id::X),
+            point.getFieldAs<double>(Dimension::Id::Y),
+            point.getFieldAs<double>(Dimension::Id::Z) };
+
+        // The margin is smaller than a tile, so only the neighboring tiles
+        // can need the point.
+        size_t column = grid.column(record.x);
+        size_t row = grid.row(record.y);
+        for (size_t r = row > 0 ? row - 1 : 0; r <= std::min(row + 1, grid.tilesY - 1); ++r)
+            for (size_t c = column > 0 ? column - 1 : 0; c <= std::min(column + 1, grid.tilesX - 1); ++c)
+            {
+                size_t tile = r * grid.tilesX + c;
+                if ((r == row && c == column) ||
+                    grid.contains(tile, grid.margin, record.x, record.y))
+                {
+                    buffers[tile].push_back(record);
+                    if (buffers[tile].size() >= bufferSize)
+                        flush(tile);
+                }
+            }
+        return true;
+    }, false);
+    split.setInput(source.last());
+    stream(split);
+
+    for (size_t tile = 0; tile < grid.tiles(); ++tile)
+        if (!buffers[tile].empty())
+            flush(tile);
+}
+
+
+void TiledFilter::readTile(size_t tile, std::vector<Record>& records) const
+{
+    records.clear();
+    FILE *fp = fopen(tileFile(tile).c_str(), "rb");
+    if (!fp)
+        return;     // no points in or near the tile
+
+    Record buffer[1024];
+    size_t read;
+    while ((read = fread(buffer, sizeof(Record), 1024, fp)) > 0)
+        records.insert(records.end(), buffer, buffer + read);
+    bool failed = ferror(fp) != 0;
+    fclose(fp);
+    if (failed)
+        throw std::runtime_error("Could not read " + tileFile(tile));
+}
+
+
+void TiledFilter::filterTile(const Grid& grid, size_t tile, double *distances,
+    std::vector<Uncertain>& uncertain)
+{
+    std::vector<Record> records;
+    readTile(tile, records);
+    if (records.empty())
+        return;
+
+    std::vector<double> points(3 * records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        points[3 * i] = records[i].x;
+        points[3 * i + 1] = records[i].y;
+        points[3 * i + 2] = records[i].z;
+    }
+    KdTree tree(points);
+    std::vector<double>().swap(points);
+
+    size_t count = static_cast<size_t>(std::min(
+        static_cast<point_count_t>(m_meanK) + 1, m_count));
+    std::vector<double> sqrDists;
+    sqrDists.reserve(count);
+
+    for (size_t i = 0; i < tree.size(); ++i)
+    {
+        const Record& record = records[tree.index(i)];
+        if (grid.tile(record.x, record.y) != tile)
+            continue;   // owned by a neighboring tile
+
+        tree.knn(tree.point(i), count, sqrDists);
+        distances[record.id] = StatisticalOutlierFilter::meanDistance(sqrDists);
+
+        // Nearer points outside the tile and its margin are possible when
+        // the farthest neighbor found is not closer than the border.
+        if (sqrDists.size() < count)
+            uncertain.push_back({ record.id, record.x, record.y, record.z,
+                grid.margin });
+        else if (!inside(std::sqrt(sqrDists.back()),
+            grid.border(tile, grid.margin, record.x, record.y)))
+            uncertain.push_back({ record.id, record.x, record.y, record.z,
+                std::sqrt(sqrDists.back()) });
+    }
+}
+
+
+void TiledFilter::repairTile(const Grid& grid, size_t tile, double *distances,
+    const std::vector<Uncertain>& uncertain)
+{
+    if (uncertain.empty())
+        return;
+
+    double grow = 0.0;
+    for (auto const& u : uncertain)
+        grow = std::max(grow, u.radius);
+
+    size_t count = static_cast<size_t>(std::min(
+        static_cast<point_count_t>(m_meanK) + 1, m_count));
+    std::vector<double> sqrDists;
+    std::vector<double> results(uncertain.size());
+    std::vector<Record> records;
+
+    for (;;)
+    {
+        // All points owned by the tiles around, within grow of the tile.
+        double lowX, lowY, highX, highY;
+        grid.box(tile, grow, lowX, lowY, highX, highY);
+        std::vector<double> points;
+        for (size_t r = grid.row(lowY); r <= grid.row(highY); ++r)
+            for (size_t c = grid.column(lowX); c <= grid.column(highX); ++c)
+            {
+                size_t other = r * grid.tilesX + c;
+                readTile(other, records);
+                for (auto const& record : records)
+                    if (grid.tile(record.x, record.y) == other &&
+                        grid.contains(tile, grow, record.x, record.y))
+                    {
+                        points.push_back(record.x);
+                        points.push_back(record.y);
+                        points.push_back(record.z);
+                    }
+            }
+        KdTree tree(points);
+        std::vector<double>().swap(points);
+
+        double farthest = grow;
+        bool exact = true;
+        for (size_t i = 0; i < uncertain.size(); ++i)
+        {
+            const Uncertain& u = uncertain[i];
+            double query[3] = { u.x, u.y, u.z };
+            tree.knn(query, count, sqrDists);
+            results[i] = StatisticalOutlierFilter::meanDistance(sqrDists);
+
+            if (sqrDists.size() < count)
+                exact = false;
+            else if (!inside(std::sqrt(sqrDists.back()),
+                grid.border(tile, grow, u.x, u.y)))
+            {
+                exact = false;
+                farthest = std::max(farthest, std::sqrt(sqrDists.back()));
+            }
+        }
+
+        if (exact)
+            break;
+
+        // Once the region covers the whole cloud every query is exact.
+        grow = std::max(2.0 * grow, farthest);
+    }
+
+    for (size_t i = 0; i < uncertain.size(); ++i)
+        distances[uncertain[i].id] = results[i];
+}
+
+
+void TiledFilter::writeOutput(const double *distances, double threshold,
+    point_count_t vertexCount)
+{
+    PointId id = 0;
+    Source source(m_inputFile, m_useConfidence, m_confidence);
+    PointCallbackFilter classify([&](PointRef& point)
+    {
+        if (distances[id++] > threshold)
+            point.setField(Dimension::Id::Classification, uint8_t(7));
+        return true;
+    }, true);
+    classify.setInput(source.last());
+
+    Options rangeOpts;
+    rangeOpts.add("limits", "Classification![7:7]"); // Remove outliers
+
+    RangeFilter rangeFilter;
+    rangeFilter.setInput(classify);
+    rangeFilter.setOptions(rangeOpts);
+
+    Options outPlyOpts;
+    outPlyOpts.add("storage_mode", "little endian");
+    outPlyOpts.add("filename", m_outputFile);
+    outPlyOpts.add("vertex_count", vertexCount);
+
+    ModifiedPlyWriter plyWriter;
+    plyWriter.setOptions(outPlyOpts);
+    plyWriter.setInput(rangeFilter);
+    stream(plyWriter);
+}
+
+} // namespace pdal
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <pdal/pdal_types.hpp>
+
+namespace pdal
+{
+
+/*!
+ * \brief   Runs the confidence and statistical outlier filters of odm_filterpoints on
+ *          XY tiles of the cloud, with the same result as filtering the whole cloud at once.
+ * \details The input is streamed three times. The first pass computes the bounds. The second
+ *          copies the coordinates into one file per tile; each tile also gets the points within
+ *          a margin around it. The tiles are then filtered in parallel. A point whose nearest
+ *          neighbors may lie outside its tile and margin is queried again against a larger
+ *          region, so every mean neighbor distance is exact. The last pass streams the points
+ *          to the output and drops the outliers. Only the tiles being filtered are held in
+ *          memory; the mean distances are kept in a memory mapped file.
+ */
+class TiledFilter
+{
+public:
+    typedef std::function<void (const std::string&)> Log;
+
+    TiledFilter(const std::string& inputFile, const std::string& outputFile,
+        Log log);
+
+    // Keep only points with a confidence of at least confidence.
+    void setConfidence(float confidence);
+
+    void setMeanK(int meanK)
+        { m_meanK = meanK; }
+
+    void setMultiplier(double multiplier)
+        { m_multiplier = multiplier; }
+
+    // The width and height of a tile, in the units of the cloud.
+    void setTileSize(double tileSize)
+        { m_tileSize = tileSize; }
+
+    // The number of tiles filtered at the same time, 0 for all hardware threads.
+    void setThreads(int threads)
+        { m_threads = threads; }
+
+    void run();
+
+private:
+    struct Record;
+    struct Grid;
+    struct Uncertain;
+
+    void readBounds(Grid& grid);
+    void writeTiles(const Grid& grid);
+    void filterTile(const Grid& grid, size_t tile, double *distances,
+        std::vector<Uncertain>& uncertain);
+    void repairTile(const Grid& grid, size_t tile, double *distances,
+        const std::vector<Uncertain>& uncertain);
+    void readTile(size_t tile, std::vector<Record>& records) const;
+    void writeOutput(const double *distances, double threshold,
+        point_count_t vertexCount);
+
+    std::string tileFile(size_t tile) const;
+
+    std::string m_inputFile;
+    std::string m_outputFile;
+    Log m_log;
+    bool m_useConfidence;
+    float m_confidence;
+    int m_meanK;
+    double m_multiplier;
+    double m_tileSize;
+    int m_threads;
+
+    point_count_t m_count;
+    std::vector<PointId> m_noise;    // points already classified as noise
+};
+
+} // namespace pdal
@@ -1,28 +1,34 @@
 #include <iostream>
 #include <algorithm>
-#include <pdal/filters/OutlierFilter.hpp>
 #include <pdal/filters/RangeFilter.hpp>
-#include <pdal/filters/SampleFilter.hpp>
 #include "CmdLineParser.h"
 #include "Logger.h"
 #include "FloatPlyReader.hpp"
 #include "ModifiedPlyWriter.hpp"
+#include "PoissonSampleFilter.hpp"
+#include "StatisticalOutlierFilter.hpp"
+#include "TiledFilter.hpp"
+#include "Profile.hpp"
 
 Logger logWriter;
 
 cmdLineParameter< char* >
     InputFile( "inputFile" ) ,
-    OutputFile( "outputFile" );
+    OutputFile( "outputFile" ) ,
+    ProfileFile( "profile" );
 cmdLineParameter< float >
     StandardDeviation( "sd" ) ,
     MeanK ( "meank" ) ,
     Confidence ( "confidence" ) ,
-    Sample ( "sample" );
+    Sample ( "sample" ) ,
+    TileSize ( "tileSize" );
+cmdLineParameter< int >
+    Threads ( "threads" );
 cmdLineReadable
 	Verbose( "verbose" );
 
 cmdLineReadable* params[] = {
-    &InputFile , &OutputFile , &StandardDeviation, &MeanK, &Confidence, &Sample, &Verbose ,
+    &InputFile , &OutputFile , &StandardDeviation, &MeanK, &Confidence, &Sample, &TileSize, &Threads, &ProfileFile, &Verbose ,
     NULL
 };
 
@@ -33,6 +39,10 @@ void help(char *ex){
               << "\t [-" << StandardDeviation.name << " <standard deviation threshold>]" << std::endl
               << "\t [-" << MeanK.name << " <mean number of neighbors >]" << std::endl
               << "\t [-" << Confidence.name << " <lower bound filter for confidence property>]" << std::endl
+              << "\t [-" << Sample.name << " <keep no two points closer than this radius>]" << std::endl
+              << "\t [-" << TileSize.name << " <filter in tiles of this size, to bound memory use>]" << std::endl
+              << "\t [-" << Threads.name << " <number of threads, all hardware threads by default>]" << std::endl
+              << "\t [-" << ProfileFile.name << " <write the time, memory and counters of the run to this JSON file>]" << std::endl
 
               << "\t [-" << Verbose.name << "]" << std::endl;
     exit(EXIT_FAILURE);
@@ -52,6 +62,14 @@ void logArgs(cmdLineReadable* params[], Logger& logWriter){
 }
 
 
+void writeProfile(){
+    Profile::instance().addFileSize("bytes_written", OutputFile.value);
+    if (!Profile::instance().write()){
+        logWriter("Could not write the profile to %s\n", ProfileFile.value);
+    }
+}
+
+
 int main(int argc, char **argv) {
     cmdLineParse( argc-1 , &argv[1] , params );
     if( !InputFile.set || !OutputFile.set ) help(argv[0]);
@@ -60,9 +78,31 @@ int main(int argc, char **argv) {
 
     logWriter.verbose = Verbose.set;
     logArgs(params, logWriter);
+    if (ProfileFile.set) Profile::instance().enable("odm_filterpoints", ProfileFile.value);
+    Profile::instance().addFileSize("bytes_read", InputFile.value);
 
     logWriter("Filtering point cloud...\n");
 
+    if (TileSize.set && TileSize.value > 0.0f){
+        if (Sample.set && Sample.value > 0.0f){
+            // Radius sampling needs the kept points across the tile borders.
+            logWriter("Radius sampling is not supported in tiles, filtering the whole point cloud\n");
+        }else{
+            pdal::TiledFilter tiledFilter(InputFile.value, OutputFile.value,
+                [](const std::string &message){ logWriter("%s", message.c_str()); });
+            if (Confidence.set) tiledFilter.setConfidence(std::min(1.0f, std::max(Confidence.value, 0.0f)));
+            tiledFilter.setMeanK(static_cast<int>(MeanK.value));
+            tiledFilter.setMultiplier(StandardDeviation.value);
+            tiledFilter.setTileSize(TileSize.value);
+            if (Threads.set) tiledFilter.setThreads(Threads.value);
+            tiledFilter.run();
+
+            writeProfile();
+            logWriter("Done!\n");
+            return 0;
+        }
+    }
+
     pdal::Options inPlyOpts;
     inPlyOpts.add("filename", InputFile.value);
 
@@ -86,22 +126,23 @@ int main(int argc, char **argv) {
         confidenceFilter.setOptions(confidenceFilterOpts);
     }
 
-    pdal::SampleFilter sampleFilter;
+    pdal::PoissonSampleFilter sampleFilter;
     if (Sample.set && Sample.value > 0.0f){
         logWriter("Radius sampling\n");
         pdal::Options sampleFilterOpts;
         sampleFilterOpts.add("radius", Sample.value);
+        if (Threads.set) sampleFilterOpts.add("threads", Threads.value);
         sampleFilter.setOptions(sampleFilterOpts);
         sampleFilter.setInput(*currentStage);
         currentStage = &sampleFilter;
     }
 
     pdal::Options outlierOpts;
-    outlierOpts.add("method", "statistical");
     outlierOpts.add("mean_k", MeanK.value);
     outlierOpts.add("multiplier", StandardDeviation.value);
+    if (Threads.set) outlierOpts.add("threads", Threads.value);
 
-    pdal::OutlierFilter outlierFilter;
+    pdal::StatisticalOutlierFilter outlierFilter;
     outlierFilter.setInput(*currentStage);
     outlierFilter.setOptions(outlierOpts);
 
@@ -122,5 +163,6 @@ int main(int argc, char **argv) {
     plyWriter.prepare(table);
     plyWriter.execute(table);
 
+    writeProfile();
     logWriter("Done!\n");
 }
@@ -1,6 +1,89 @@
+// C++
+#include <random>
+#include <limits>
+#include <algorithm>
+
+// Eigen
+#include <Eigen/Geometry>
+
 // This
 #include "FindTransform.hpp"
 
+namespace
+{
+
+/*!
+  * \brief Whether three points are too close to a line to define a transform.
+  **/
+bool isDegenerate(const Vec3 &a, const Vec3 &b, const Vec3 &c)
+{
+    Vec3 ab = b - a;
+    Vec3 ac = c - a;
+    double scale = std::max(ab.dot(ab), ac.dot(ac));
+    return !(ab.cross(ac).length() > 1e-6 * scale);
+}
+
+/*!
+  * \brief Fits a similarity transform to the given pairs, into transform.
+  **/
+bool fitSimilarity(const std::vector<Vec3> &from, const std::vector<Vec3> &to, const std::vector<size_t> &indices, Mat4 &transform)
+{
+    if (indices.size() < 3)
+    {
+        return false;
+    }
+
+    Eigen::Matrix3Xd source(3, indices.size());
+    Eigen::Matrix3Xd target(3, indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        const Vec3 &f = from[indices[i]];
+        const Vec3 &t = to[indices[i]];
+        Eigen::Index col = static_cast<Eigen::Index>(i);
+        source.col(col) << f.x_, f.y_, f.z_;
+        target.col(col) << t.x_, t.y_, t.z_;
+    }
+
+    Eigen::Matrix4d m = Eigen::umeyama(source, target, true);
+    if (!m.allFinite() || m.block<3, 3>(0, 0).determinant() <= 0.0)
+    {
+        return false;
+    }
+
+    transform.r1c1_ = m(0, 0); transform.r1c2_ = m(0, 1); transform.r1c3_ = m(0, 2); transform.r1c4_ = m(0, 3);
+    transform.r2c1_ = m(1, 0); transform.r2c2_ = m(1, 1); transform.r2c3_ = m(1, 2); transform.r2c4_ = m(1, 3);
+    transform.r3c1_ = m(2, 0); transform.r3c2_ = m(2, 1); transform.r3c3_ = m(2, 2); transform.r3c4_ = m(2, 3);
+    transform.r4c1_ = 0.0;     transform.r4c2_ = 0.0;     transform.r4c3_ = 0.0;     transform.r4c4_ = 1.0;
+    return true;
+}
+
+/*!
+  * \brief The truncated squared error of a transform and its inliers.
+  **/
+double scoreTransform(Mat4 &transform, const std::vector<Vec3> &from, const std::vector<Vec3> &to, double threshold, std::vector<size_t> &inliers)
+{
+    double thresholdSquared = threshold * threshold;
+    double cost = 0.0;
+    inliers.clear();
+    for (size_t i = 0; i < from.size(); ++i)
+    {
+        Vec3 d = transform * from[i] - to[i];
+        double errorSquared = d.dot(d);
+        if (errorSquared < thresholdSquared)
+        {
+            cost += errorSquared;
+            inliers.push_back(i);
+        }
+        else
+        {
+            cost += thresholdSquared;
+        }
+    }
+    return cost;
+}
+
+}
+
 Vec3::Vec3(double x, double y, double z) :x_(x), y_(y), z_(z)
 {
     
@@ -147,3 +230,111 @@ double FindTransform::error(Vec3 fromA, Vec3 toA)
 {
     return (transform_*fromA - toA).length();
 }
+
+bool FindTransform::findTransformLeastSquares(const std::vector<Vec3> &from, const std::vector<Vec3> &to)
+{
+    if (from.size() != to.size())
+    {
+        return false;
+    }
+
+    std::vector<size_t> all(from.size());
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        all[i] = i;
+    }
+    return fitSimilarity(from, to, all, transform_);
+}
+
+size_t FindTransform::findTransformRansac(const std::vector<Vec3> &from, const std::vector<Vec3> &to, double threshold, std::vector<size_t> &inliers,
+                                          size_t maxIterations, double confidence)
+{
+    inliers.clear();
+    size_t n = from.size();
+    if (n < 3 || n != to.size())
+    {
+        return 0;
+    }
+
+    // A fixed seed keeps the result reproducible between runs.
+    std::mt19937 generator(5489u);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+
+    double bestCost = std::numeric_limits<double>::infinity();
+    Mat4 bestTransform;
+    std::vector<size_t> bestInliers;
+    std::vector<size_t> sample(3);
+    std::vector<size_t> candidateInliers;
+
+    size_t requiredIterations = maxIterations;
+    size_t iteration = 0;
+    for (; iteration < requiredIterations; ++iteration)
+    {
+        sample[0] = pick(generator);
+        do { sample[1] = pick(generator); } while (sample[1] == sample[0]);
+        do { sample[2] = pick(generator); } while (sample[2] == sample[0] || sample[2] == sample[1]);
+
+        if (isDegenerate(from[sample[0]], from[sample[1]], from[sample[2]]) ||
+            isDegenerate(to[sample[0]], to[sample[1]], to[sample[2]]))
+        {
+            continue;
+        }
+
+        Mat4 candidate;
+        if (!fitSimilarity(from, to, sample, candidate))
+        {
+            continue;
+        }
+
+        double cost = scoreTransform(candidate, from, to, threshold, candidateInliers);
+        if (cost < bestCost)
+        {
+            bestCost = cost;
+            bestTransform = candidate;
+            bestInliers.swap(candidateInliers);
+
+            // Enough iterations to have drawn an all-inlier triplet with the given confidence.
+            double inlierRatio = static_cast<double>(bestInliers.size()) / static_cast<double>(n);
+            double allInliers = inlierRatio * inlierRatio * inlierRatio;
+            if (allInliers >= 1.0)
+            {
+                requiredIterations = iteration + 1;
+            }
+            else if (allInliers > 0.0)
+            {
+                double required = std::ceil(std::log(1.0 - confidence) / std::log(1.0 - allInliers));
+                if (required < static_cast<double>(requiredIterations))
+                {
+                    requiredIterations = std::max(iteration + 1, static_cast<size_t>(required));
+                }
+            }
+        }
+    }
+
+    if (bestInliers.empty())
+    {
+        return 0;
+    }
+
+    // Refine on the inliers, and once more on the inliers of the refined transform.
+    transform_ = bestTransform;
+    inliers = bestInliers;
+    for (int refinement = 0; refinement < 2; ++refinement)
+    {
+        Mat4 refined;
+        if (!fitSimilarity(from, to, inliers, refined))
+        {
+            break;
+        }
+        double cost = scoreTransform(refined, from, to, threshold, candidateInliers);
+        if (cost > bestCost)
+        {
+            break;
+        }
+        bestCost = cost;
+        transform_ = refined;
+        inliers = candidateInliers;
+    }
+
+    return iteration;
+}
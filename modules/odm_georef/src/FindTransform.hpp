@@ -1,6 +1,7 @@
 // C++
 #include <math.h>
 #include <string>
+#include <vector>
 #include <iomanip>
 #include <sstream>
 #include <iostream>
@@ -160,6 +161,27 @@ public:
       * \brief error     Returns the distance beteween the 'from' and 'to' vectors, after the transform has been applied.
       **/ 
     double error(Vec3 fromA, Vec3 toA);
-    
+
+    /*!
+      * \brief findTransformLeastSquares   Generates the similarity transform (rotation, uniform scale and translation)
+      *                                     minimizing the squared distances between transform * from[i] and to[i] (Umeyama).
+      * \return                            False if there are fewer than three pairs or they are degenerate.
+      **/
+    bool findTransformLeastSquares(const std::vector<Vec3> &from, const std::vector<Vec3> &to);
+
+    /*!
+      * \brief findTransformRansac     Robustly generates a similarity transform from the 'from' to the 'to' vectors.
+      *                                 Minimal triplets are sampled until, with the given confidence, a triplet without
+      *                                 outliers has been tried; candidates are scored by their truncated squared error (MSAC).
+      *                                 The transform is then refined by a least squares fit on the inliers.
+      * \param threshold               The largest distance for a pair to count as an inlier.
+      * \param inliers                 The indices of the inliers of the final transform.
+      * \param maxIterations           The largest number of triplets to try.
+      * \param confidence              The probability of having tried at least one triplet without outliers.
+      * \return                        The number of iterations run, 0 if no transform could be found.
+      **/
+    size_t findTransformRansac(const std::vector<Vec3> &from, const std::vector<Vec3> &to, double threshold, std::vector<size_t> &inliers,
+                               size_t maxIterations = 100000, double confidence = 0.999);
+
     Mat4 transform_;    /**< The affine transform. **/
 };
@@ -1,6 +1,8 @@
 // to format log_ output; version 2018-02-18, skip gcp comments and empty lines.
 #include <iostream>
 #include <iomanip>
+#include <chrono>
+#include <tuple>
 using namespace std;
 // PCL
 #include <pcl/io/obj_io.h>
@@ -13,6 +15,19 @@ using namespace std;
 // This
 #include "Georef.hpp"
 
+// Mesh IO
+#include "ObjReader.hpp"
+#include "BinaryMesh.hpp"
+
+// Point cloud IO
+#include "FloatPlyReader.hpp"
+
+// Profiling
+#include "Profile.hpp"
+
+// Image headers
+#include "ImageSize.hpp"
+
 std::ostream& operator<<(std::ostream &os, const GeorefSystem &geo)
 {
     return os << setiosflags(ios::fixed) << setprecision(7) << geo.system_ << "\n" << geo.eastingOffset_ << " " << geo.northingOffset_;
@@ -241,10 +256,15 @@ Georef::Georef() : log_(false)
     outputCoordFilename_ = "";
     inputObjFilename_ = "";
     outputObjFilename_ = "";
+    outputBinaryMeshFilename_ = "";
     transformFilename_ = "";
     exportCoordinateFile_ = false;
     exportGeorefSystem_ = false;
     useTransform_ = false;
+    useRansac_ = true;
+    ransacThreshold_ = 0.0;
+    outputSpecified_ = false;
+    writeMesh_ = true;
 }
 
 Georef::~Georef()
@@ -252,16 +272,30 @@ Georef::~Georef()
 }
 
 int Georef::run(int argc, char *argv[])
+{
+    pcl::TextureMesh mesh;
+    return run(argc, argv, mesh, true);
+}
+
+int Georef::run(int argc, char *argv[], pcl::TextureMesh &mesh)
+{
+    return run(argc, argv, mesh, false);
+}
+
+int Georef::run(int argc, char *argv[], pcl::TextureMesh &mesh, bool writeMesh)
 {
     try
     {
         parseArguments(argc, argv);
-        createGeoreferencedModel();
+        log_.open(logFile_);
+        writeMesh_ = writeMesh || outputSpecified_;
+        georeferenceMesh(mesh);
     }
     catch (const GeorefException& e)
     {
         log_.setIsPrintingInCout(true);
         log_ << e.what() << "\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
@@ -270,6 +304,7 @@ int Georef::run(int argc, char *argv[])
         log_.setIsPrintingInCout(true);
         log_ << "Error in Georef:\n";
         log_ << e.what() << "\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
@@ -277,18 +312,27 @@ int Georef::run(int argc, char *argv[])
     {
         log_.setIsPrintingInCout(true);
         log_ << "Unknown error, terminating:\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
     
+    writeProfile();
     log_.print(logFile_);
     
     return EXIT_SUCCESS;
 }
 
+void Georef::writeProfile()
+{
+    if (!profileFile_.empty() && !Profile::instance().write())
+    {
+        log_ << "Warning: could not write the profile to " << profileFile_ << "\n";
+    }
+}
+
 void Georef::parseArguments(int argc, char *argv[])
 {
-    bool outputSpecified = false;
     bool outputPointCloudSpecified = false;
     bool imageListSpecified = false;
     bool gcpFileSpecified = false;
@@ -328,6 +372,21 @@ void Georef::parseArguments(int argc, char *argv[])
         {
             log_.setIsPrintingInCout(true);
         }
+        else if (argument == "-logLevel")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw GeorefException("Missing argument for '" + argument + "'.");
+            }
+            Logger::Level level;
+            if (!Logger::parseLevel(argv[argIndex], level))
+            {
+                throw GeorefException("Argument '" + argument + "' has a bad value (must be debug, info, warning or error).");
+            }
+            log_.setLevel(level);
+            log_ << "Log level was set to: " << argv[argIndex] << "\n";
+        }
         else if (argument == "-logFile")
         {
             ++argIndex;
@@ -502,7 +561,65 @@ void Georef::parseArguments(int argc, char *argv[])
             }
             outputObjFilename_ = std::string(argv[argIndex]);
             log_ << "Writing output to: " << outputObjFilename_ << "\n";
-            outputSpecified = true;
+            outputSpecified_ = true;
+        }
+        else if(argument == "-profile" && argIndex < argc)
+        {
+            argIndex++;
+            if (argIndex >= argc)
+            {
+                throw GeorefException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            profileFile_ = std::string(argv[argIndex]);
+            Profile::instance().enable("odm_georef", profileFile_);
+            log_ << "Writing the profile to: " << profileFile_ << "\n";
+        }
+        else if(argument == "-solver" && argIndex < argc)
+        {
+            argIndex++;
+            if (argIndex >= argc)
+            {
+                throw GeorefException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::string solver = std::string(argv[argIndex]);
+            if (solver == "ransac")
+            {
+                useRansac_ = true;
+            }
+            else if (solver == "bruteforce")
+            {
+                useRansac_ = false;
+            }
+            else
+            {
+                throw GeorefException("Argument '" + argument + "' has a bad value, expected ransac or bruteforce.");
+            }
+            log_ << "Transform solver: " << solver << "\n";
+        }
+        else if(argument == "-ransacThreshold" && argIndex < argc)
+        {
+            argIndex++;
+            if (argIndex >= argc)
+            {
+                throw GeorefException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> ransacThreshold_;
+            if (ss.fail() || ransacThreshold_ <= 0.0)
+            {
+                throw GeorefException("Argument '" + argument + "' has a bad value.");
+            }
+            log_ << "RANSAC inlier threshold: " << ransacThreshold_ << "\n";
+        }
+        else if(argument == "-outputBinaryMeshFile" && argIndex < argc)
+        {
+            argIndex++;
+            if (argIndex >= argc)
+            {
+                throw GeorefException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            outputBinaryMeshFilename_ = std::string(argv[argIndex]);
+            log_ << "Writing binary mesh to: " << outputBinaryMeshFilename_ << "\n";
         }
         else if(argument == "-outputPointCloudFile" && argIndex < argc)
         {
@@ -542,7 +659,7 @@ void Georef::parseArguments(int argc, char *argv[])
         setDefaultPointCloudOutput();
     }
 
-    if(!outputSpecified)
+    if(!outputSpecified_)
     {
         setDefaultOutput();
     }
@@ -563,7 +680,8 @@ void Georef::printHelp()
     
     log_ << "The following flags are available\n";
     log_ << "Call the program with flag \"-help\", or without parameters to print this message, or check any generated log file.\n";
-    log_ << "Call the program with flag \"-verbose\", to print log messages in the standard output stream as well as in the log file.\n\n";
+    log_ << "Call the program with flag \"-verbose\", to print log messages in the standard output stream as well as in the log file.\n";
+    log_ << "Call the program with \"-logLevel <debug|info|warning|error>\", to only log the messages of that level and above, info by default.\n\n";
     
     log_ << "Parameters are specified as: \"-<argument name> <argument>\", (without <>), and the following parameters are configureable: " << "\n";
     log_ << "\"-bundleFile <path>\" (mandatory)" << "\n";
@@ -601,11 +719,25 @@ void Georef::printHelp()
     log_ << "\"-outputFile <path>\" (optional, default <inputFile>_geo)" << "\n";
     log_ << "Output obj file that will contain the georeferenced texture mesh.\n\n";
 
+    log_ << "\"-solver <ransac|bruteforce>\" (optional, default ransac)" << "\n";
+    log_ << "How the transform is found: ransac samples triplets until one without outliers has most likely been tried, then fits all inliers with least squares; bruteforce scores every triplet against all points.\n";
+    log_ << "If ransac finds fewer than 3 inliers, the bruteforce result is used with a warning.\n\n";
+
+    log_ << "\"-ransacThreshold <meters>\" (optional, default 5% of the spread of the reference positions)" << "\n";
+    log_ << "The largest distance between a reference position and the transformed model position for the point to count as an inlier.\n";
+    log_ << "The spread is the root mean square distance of the reference positions from their centroid.\n\n";
+
+    log_ << "\"-outputBinaryMeshFile <path>\" (optional)" << "\n";
+    log_ << "Also write the georeferenced texture mesh as a binary mesh file, which odm_orthophoto reads without parsing.\n\n";
+
     log_ << "\"-outputPointCloudFile <path>\" (mandatory if georeferencing a point cloud)" << "\n";
     log_ << "Output las/laz file that will contain the georeferenced point cloud.\n\n";
     
     log_ << "\"-outputPointCloudSrs <srs>\" (recommended if georeferencing a point cloud)" << "\n";
     log_ << "Output spatial reference system to use for output point cloud.\n\n";
+
+    log_ << "\"-profile <path>\" (optional)" << "\n";
+    log_ << "Output JSON file for the time of every phase, the counters of the work done and the peak memory of the run.\n\n";
     
     log_.setIsPrintingInCout(printInCoutPop);
 }
@@ -652,19 +784,19 @@ void Georef::setDefaultPointCloudOutput()
     log_ << "Writing output to: " << outputPointCloudFilename_ << "\n";
 }
 
-void Georef::createGeoreferencedModel()
+void Georef::georeferenceMesh(pcl::TextureMesh &mesh)
 {
     if (useGCP_)
     {
-        createGeoreferencedModelFromGCPData();
+        createGeoreferencedModelFromGCPData(mesh);
     }
     else if (useTransform_)
     {
-        createGeoreferencedModelFromSFM();
+        createGeoreferencedModelFromSFM(mesh);
     }
     else
     {
-        createGeoreferencedModelFromExifData();
+        createGeoreferencedModelFromExifData(mesh);
     }
 }
 
@@ -821,32 +953,109 @@ pcl::PointXYZ Georef::barycentricCoordinates(pcl::PointXY point, pcl::PointXYZ v
     return res;
 }
 
-void Georef::performGeoreferencingWithGCP()
+void Georef::performGeoreferencingWithGCP(pcl::TextureMesh &mesh)
 {
-    log_ << '\n';
-    log_ << "Reading mesh file " << inputObjFilename_ <<"\n";
-    log_ << '\n';
-    pcl::TextureMesh mesh;
-    if (!loadObjFile(inputObjFilename_, mesh))
-    {
-        throw GeorefException("Error when reading model from:\n" + inputObjFilename_ + "\n");
-    }
-    else
+    if (mesh.cloud.data.empty())
     {
-        log_ << "Successfully loaded " << inputObjFilename_ << ".\n";
+        log_ << '\n';
+        log_ << "Reading mesh file " << inputObjFilename_ <<"\n";
+        log_ << '\n';
+        if (!loadObjFile(inputObjFilename_, mesh))
+        {
+            throw GeorefException("Error when reading model from:\n" + inputObjFilename_ + "\n");
+        }
+        else
+        {
+            log_ << "Successfully loaded " << inputObjFilename_ << ".\n";
+        }
     }
 
     // Convert vertices to pcl::PointXYZ cloud
     pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
     pcl::fromPCLPointCloud2 (mesh.cloud, *meshCloud);
 
+    // Index all faces once, so that every GCP only tests the faces along its ray.
+    MeshIntersector intersector(*meshCloud, mesh.tex_polygons);
+
+    std::vector<GeorefGCPIntersection> intersections(gcps_.size());
+    pool_.run(boost::bind(&Georef::findGCPIntersections, this, boost::cref(intersector), boost::cref(*meshCloud), boost::ref(intersections), _1, pool_.size()));
+
     // The number of GCP that is usable
     int nrGCPUsable = 0;
 
     for (size_t gcpIndex = 0; gcpIndex < gcps_.size(); ++gcpIndex)
     {
-        // Bool to check if the GCP is intersecting any triangle
-        bool exists = false;
+        const GeorefGCPIntersection &intersection = intersections[gcpIndex];
+        if (!intersection.warning_.empty())
+        {
+            log_ << intersection.warning_ << "\n";
+        }
+
+        if(intersection.exists_)
+        {
+            pcl::PointXYZ gcpLocal = intersection.local_;
+
+            log_ << "Position in model for gcp " << gcpIndex + 1<< ": x=" <<gcpLocal.x<<" y="<<gcpLocal.y<<" z="<<gcpLocal.z<<"\n";
+            gcps_[gcpIndex].localX_ = gcpLocal.x;
+            gcps_[gcpIndex].localY_ = gcpLocal.y;
+            gcps_[gcpIndex].localZ_ = gcpLocal.z;
+            gcps_[gcpIndex].use_ = true;
+            ++nrGCPUsable;
+        }
+    }
+
+    if (nrGCPUsable < 3)
+    {
+        throw GeorefException("Fewer than 3 GCPs have correspondences in the generated model.");
+    }
+
+    FindTransform transFinal;
+    std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+    bool solved = false;
+    if (useRansac_)
+    {
+        std::vector<Vec3> from, to;
+        for (size_t gcpIndex = 0; gcpIndex < gcps_.size(); ++gcpIndex)
+        {
+            if (gcps_[gcpIndex].use_)
+            {
+                from.push_back(gcps_[gcpIndex].getPos());
+                to.push_back(gcps_[gcpIndex].getReferencedPos());
+            }
+        }
+        log_ << '\n';
+        log_ << "Finding transform from " << from.size() << " gcps with RANSAC...\n";
+        solved = solveTransformRansac(from, to, transFinal);
+    }
+    if (!solved)
+    {
+        size_t gcp0; size_t gcp1; size_t gcp2;
+        log_ << '\n';
+        log_ << "Choosing optimal gcp triplet...\n";
+        chooseBestGCPTriplet(gcp0, gcp1, gcp2);
+        log_ << "Optimal gcp triplet chosen: ";
+        log_ << gcp0 << ", " << gcp1 << ", " << gcp2 << '\n';
+        transFinal.findTransform(gcps_[gcp0].getPos(), gcps_[gcp1].getPos(), gcps_[gcp2].getPos(),
+                                 gcps_[gcp0].getReferencedPos(), gcps_[gcp1].getReferencedPos(), gcps_[gcp2].getReferencedPos());
+    }
+    log_ << "Transform found in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - solveStart).count() << " s.\n";
+    log_ << '\n';
+    log_ << "Final transform:\n";
+    log_ << transFinal.transform_ << '\n';
+    
+    // The transform used to transform model into the georeferenced system.
+    performFinalTransform(transFinal.transform_, mesh, meshCloud, true);
+}
+
+void Georef::findGCPIntersections(const MeshIntersector &intersector, const pcl::PointCloud<pcl::PointXYZ> &meshCloud,
+                                  std::vector<GeorefGCPIntersection> &intersections, size_t offset, size_t stride)
+{
+    std::vector<size_t> candidates;
+
+    for (size_t gcpIndex = offset; gcpIndex < gcps_.size(); gcpIndex += stride)
+    {
+        GeorefGCPIntersection &intersection = intersections[gcpIndex];
+        intersection.exists_ = false;
 
         // Translate the GeoreferenceCamera to pcl-format in order to use pcl-functions
         pcl::TextureMapping<pcl::PointXYZ>::Camera cam;
@@ -854,111 +1063,88 @@ void Georef::performGeoreferencingWithGCP()
         cam.pose = *(cameras_[gcps_[gcpIndex].cameraIndex_].pose_);
         cam.texture_file = imagesLocation_ + '/' + gcps_[gcpIndex].image_;
 
-        cv::Mat image = cv::imread(cam.texture_file);
-        cam.height = static_cast<double>(image.rows);
-        cam.width = static_cast<double>(image.cols);
+        // Only the size of the image is needed, read it from the header when possible.
+        int imageWidth = 0, imageHeight = 0;
+        if (!readImageSize(cam.texture_file, imageWidth, imageHeight))
+        {
+            cv::Mat image = cv::imread(cam.texture_file);
+            imageWidth = image.cols;
+            imageHeight = image.rows;
+        }
+        if (imageWidth <= 0 || imageHeight <= 0)
+        {
+            intersection.warning_ = "Could not read the size of image " + cam.texture_file + " for gcp " + std::to_string(gcpIndex + 1) + ".";
+            continue;
+        }
+        cam.height = static_cast<double>(imageHeight);
+        cam.width = static_cast<double>(imageWidth);
 
         // The pixel position for the GCP in pcl-format in order to use pcl-functions
         pcl::PointXY gcpPos;
         gcpPos.x = static_cast<float>(gcps_[gcpIndex].pixelX_);
         gcpPos.y = static_cast<float>(gcps_[gcpIndex].pixelY_);
 
-        // Move vertices in mesh into the camera coordinate system
-        pcl::PointCloud<pcl::PointXYZ>::Ptr cameraCloud (new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::transformPointCloud (*meshCloud, *cameraCloud, cam.pose.inverse());
+        // The ray from the camera through the GCP pixel, the inverse of the projection in getPixelCoordinates.
+        Eigen::Vector3d rayCamera((gcpPos.x - cam.width / 2.0) / cam.focal_length, (gcpPos.y - cam.height / 2.0) / cam.focal_length, 1.0);
+        Eigen::Vector3d rayOrigin = cam.pose.translation().cast<double>();
+        Eigen::Vector3d rayDirection = cam.pose.linear().cast<double>() * rayCamera;
 
-        // The vertex indicies to be used in order to calculate the GCP in the models coordinates
-        size_t vert0Index = 0; size_t vert1Index = 0; size_t vert2Index = 0;
+        intersector.intersect(rayOrigin, rayDirection, candidates);
+
+        // Moves vertices into the camera coordinate system
+        Eigen::Affine3f cameraTransform = cam.pose.inverse();
 
+        size_t vert0Index = 0; size_t vert1Index = 0; size_t vert2Index = 0;
         pcl::PointXY bestPixelPos0; pcl::PointXY bestPixelPos1; pcl::PointXY bestPixelPos2;
 
         // The closest distance of a triangle to the camera
         double bestDistance = std::numeric_limits<double>::infinity();
 
-        // Loop through all submeshes in model
-        for (size_t meshIndex = 0; meshIndex < mesh.tex_polygons.size(); ++meshIndex)
+        // Apply the exact test of the projection to the faces along the ray.
+        for (size_t c = 0; c < candidates.size(); ++c)
         {
-            // Loop through all faces in submesh and check if inside polygon
-            for (size_t faceIndex = 0; faceIndex < mesh.tex_polygons[meshIndex].size(); ++faceIndex)
+            const uint32_t *face = intersector.face(candidates[c]);
+
+            pcl::PointXYZ cameraPoints[3];
+            for (size_t v = 0; v < 3; ++v)
+            {
+                Eigen::Vector3f p = cameraTransform * meshCloud.points[face[v]].getVector3fMap();
+                cameraPoints[v] = pcl::PointXYZ(p[0], p[1], p[2]);
+            }
+
+            // Variables for the vertices in face as projections in the camera plane
+            pcl::PointXY pixelPos0; pcl::PointXY pixelPos1; pcl::PointXY pixelPos2;
+            if (isFaceProjected(cam, cameraPoints[0], cameraPoints[1], cameraPoints[2], pixelPos0, pixelPos1, pixelPos2) &&
+                checkPointInsideTriangle(pixelPos0, pixelPos1, pixelPos2, gcpPos))
             {
-                // Variables for the vertices in face as projections in the camera plane
-                pcl::PointXY pixelPos0; pcl::PointXY pixelPos1; pcl::PointXY pixelPos2;
-                if (isFaceProjected(cam,
-                                    cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[0]],
-                                    cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[1]],
-                                    cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[2]],
-                                    pixelPos0, pixelPos1, pixelPos2))
+                // Calculate largest distance of the vertices to the camera
+                double distance = std::max(cameraPoints[0].z, std::max(cameraPoints[1].z, cameraPoints[2].z));
+
+                // If the triangle is closer to the camera use this triangle
+                if (distance < bestDistance)
                 {
-                    // If the pixel position of the GCP is inside the current triangle
-                    if (checkPointInsideTriangle(pixelPos0, pixelPos1, pixelPos2, gcpPos))
-                    {
-                        // Extract distances for all vertices for face to camera
-                        double d0 = cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[0]].z;
-                        double d1 = cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[1]].z;
-                        double d2 = cameraCloud->points[mesh.tex_polygons[meshIndex][faceIndex].vertices[2]].z;
-
-                        // Calculate largest distance and store in distance variable
-                        double distance = std::max(d0, std::max(d1,d2));
-
-                        // If the triangle is closer to the camera use this triangle
-                        if (distance < bestDistance)
-                        {
-                            // Update variables for the closest polygon
-                            bestDistance = distance;
-                            vert0Index = mesh.tex_polygons[meshIndex][faceIndex].vertices[0];
-                            vert1Index = mesh.tex_polygons[meshIndex][faceIndex].vertices[1];
-                            vert2Index = mesh.tex_polygons[meshIndex][faceIndex].vertices[2];
-                            bestPixelPos0 = pixelPos0;
-                            bestPixelPos1 = pixelPos1;
-                            bestPixelPos2 = pixelPos2;
-                            exists = true;
-                            ++nrGCPUsable;
-                        }
-                    }
+                    bestDistance = distance;
+                    vert0Index = face[0];
+                    vert1Index = face[1];
+                    vert2Index = face[2];
+                    bestPixelPos0 = pixelPos0;
+                    bestPixelPos1 = pixelPos1;
+                    bestPixelPos2 = pixelPos2;
+                    intersection.exists_ = true;
                 }
             }
         }
 
-        if(exists)
+        if (intersection.exists_)
         {
-            // Shorthands for the vertices
-            pcl::PointXYZ v0 = meshCloud->points[vert0Index];
-            pcl::PointXYZ v1 = meshCloud->points[vert1Index];
-            pcl::PointXYZ v2 = meshCloud->points[vert2Index];
             // Use barycentric coordinates to calculate position for the polygon intersection
-            pcl::PointXYZ gcpLocal = barycentricCoordinates(gcpPos, v0, v1, v2, bestPixelPos0, bestPixelPos1, bestPixelPos2);
-
-            log_ << "Position in model for gcp " << gcpIndex + 1<< ": x=" <<gcpLocal.x<<" y="<<gcpLocal.y<<" z="<<gcpLocal.z<<"\n";
-            gcps_[gcpIndex].localX_ = gcpLocal.x;
-            gcps_[gcpIndex].localY_ = gcpLocal.y;
-            gcps_[gcpIndex].localZ_ = gcpLocal.z;
-            gcps_[gcpIndex].use_ = true;
+            intersection.local_ = barycentricCoordinates(gcpPos, meshCloud.points[vert0Index], meshCloud.points[vert1Index], meshCloud.points[vert2Index],
+                                                         bestPixelPos0, bestPixelPos1, bestPixelPos2);
         }
     }
-
-    if (nrGCPUsable < 3)
-    {
-        throw GeorefException("Fewer than 3 GCPs have correspondences in the generated model.");
-    }
-
-    size_t gcp0; size_t gcp1; size_t gcp2;
-    log_ << '\n';
-    log_ << "Choosing optimal gcp triplet...\n";
-    chooseBestGCPTriplet(gcp0, gcp1, gcp2);
-    log_ << "Optimal gcp triplet chosen: ";
-    log_ << gcp0 << ", " << gcp1 << ", " << gcp2 << '\n';
-    log_ << '\n';
-    FindTransform transFinal;
-    transFinal.findTransform(gcps_[gcp0].getPos(), gcps_[gcp1].getPos(), gcps_[gcp2].getPos(),
-                             gcps_[gcp0].getReferencedPos(), gcps_[gcp1].getReferencedPos(), gcps_[gcp2].getReferencedPos());
-    log_ << "Final transform:\n";
-    log_ << transFinal.transform_ << '\n';
-    
-    // The transform used to transform model into the georeferenced system.
-    performFinalTransform(transFinal.transform_, mesh, meshCloud, true);
 }
 
-void Georef::createGeoreferencedModelFromGCPData()
+void Georef::createGeoreferencedModelFromGCPData(pcl::TextureMesh &mesh)
 {
     readCameras();
 
@@ -966,11 +1152,11 @@ void Georef::createGeoreferencedModelFromGCPData()
 
     calculateGCPOffset();
 
-    performGeoreferencingWithGCP();
+    performGeoreferencingWithGCP(mesh);
 
 }
 
-void Georef::createGeoreferencedModelFromExifData()
+void Georef::createGeoreferencedModelFromExifData(pcl::TextureMesh &mesh)
 {
     readCameras();
 
@@ -1025,27 +1211,41 @@ void Georef::createGeoreferencedModelFromExifData()
     cameras_.clear();
     cameras_ = goodCameras;
 
-    // The optimal camera triplet.
-    size_t cam0, cam1, cam2;
-    
-    log_ << '\n';
-    log_ << "Choosing optimal camera triplet...\n";
-    chooseBestCameraTriplet(cam0, cam1, cam2);
-    log_ << "... optimal camera triplet chosen:\n";    
-    log_ << cam0 << ", " << cam1 << ", " << cam2 << '\n';
-    log_ << '\n';
     FindTransform transFinal;
-    transFinal.findTransform(cameras_[cam0].getPos(), cameras_[cam1].getPos(), cameras_[cam2].getPos(),
-                             cameras_[cam0].getReferencedPos(), cameras_[cam1].getReferencedPos(), cameras_[cam2].getReferencedPos());
+    std::chrono::steady_clock::time_point solveStart = std::chrono::steady_clock::now();
+    bool solved = false;
+    if (useRansac_)
+    {
+        std::vector<Vec3> from, to;
+        for (size_t cameraIndex = 0; cameraIndex < cameras_.size(); ++cameraIndex)
+        {
+            from.push_back(cameras_[cameraIndex].getPos());
+            to.push_back(cameras_[cameraIndex].getReferencedPos());
+        }
+        log_ << '\n';
+        log_ << "Finding transform from " << from.size() << " cameras with RANSAC...\n";
+        solved = solveTransformRansac(from, to, transFinal);
+    }
+    if (!solved)
+    {
+        // The optimal camera triplet.
+        size_t cam0, cam1, cam2;
+
+        log_ << '\n';
+        log_ << "Choosing optimal camera triplet...\n";
+        chooseBestCameraTriplet(cam0, cam1, cam2);
+        log_ << "... optimal camera triplet chosen:\n";
+        log_ << cam0 << ", " << cam1 << ", " << cam2 << '\n';
+        transFinal.findTransform(cameras_[cam0].getPos(), cameras_[cam1].getPos(), cameras_[cam2].getPos(),
+                                 cameras_[cam0].getReferencedPos(), cameras_[cam1].getReferencedPos(), cameras_[cam2].getReferencedPos());
+    }
+    log_ << "Transform found in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - solveStart).count() << " s.\n";
+    log_ << '\n';
     
     log_ << "Final transform:\n";
     log_ << transFinal.transform_ << '\n';
     
-    log_ << '\n';
-    log_ << "Reading mesh file...\n";
-    pcl::TextureMesh mesh;
-    loadObjFile(inputObjFilename_, mesh);
-    log_ << ".. mesh file read.\n";
+    readMesh(mesh);
 
     // Contains the vertices of the mesh.
     pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
@@ -1054,7 +1254,7 @@ void Georef::createGeoreferencedModelFromExifData()
     performFinalTransform(transFinal.transform_, mesh, meshCloud, true);
 }
 
-void Georef::createGeoreferencedModelFromSFM()
+void Georef::createGeoreferencedModelFromSFM(pcl::TextureMesh &mesh)
 {
     // Read coordinate system from coord file generated by extract_utm tool
     // UTM coordinates from OpenSfM transform
@@ -1095,11 +1295,7 @@ void Georef::createGeoreferencedModelFromSFM()
     georefSystem_.northingOffset_ = transform.r2c4_;
 
     // load mesh
-    log_ << '\n';
-    log_ << "Reading mesh file...\n";
-    pcl::TextureMesh mesh;
-    loadObjFile(inputObjFilename_, mesh);
-    log_ << ".. mesh file read.\n";
+    readMesh(mesh);
 
     // Contains the vertices of the mesh.
     pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
@@ -1109,149 +1305,215 @@ void Georef::createGeoreferencedModelFromSFM()
     performFinalTransform(transform, mesh, meshCloud, false);
 }
 
-void Georef::chooseBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2)
+bool Georef::solveTransformRansac(const std::vector<Vec3> &from, const std::vector<Vec3> &to, FindTransform &transform)
 {
-    size_t numThreads = boost::thread::hardware_concurrency();
-    boost::thread_group threads;
-    std::vector<GeorefBestTriplet*> triplets;
-    for(size_t t = 0; t < numThreads; ++t)
+    ProfilePhase phase("solve_transform");
+
+    // Without a threshold given, it scales with the spread of the reference positions, as GPS errors grow with the survey.
+    double threshold = ransacThreshold_;
+    if (threshold <= 0.0)
     {
-        GeorefBestTriplet* triplet = new GeorefBestTriplet();
-        triplets.push_back(triplet);
-        threads.create_thread(boost::bind(&Georef::findBestGCPTriplet, this, boost::ref(triplet->t_), boost::ref(triplet->s_), boost::ref(triplet->p_), t, numThreads, boost::ref(triplet->err_)));
+        Vec3 centroid;
+        for (size_t i = 0; i < to.size(); ++i)
+        {
+            centroid = centroid + to[i];
+        }
+        centroid = centroid * (1.0 / static_cast<double>(std::max(to.size(), static_cast<size_t>(1))));
+        double squaredSpread = 0.0;
+        for (size_t i = 0; i < to.size(); ++i)
+        {
+            double distance = (to[i] - centroid).length();
+            squaredSpread += distance * distance;
+        }
+        threshold = 0.05 * std::sqrt(squaredSpread / static_cast<double>(std::max(to.size(), static_cast<size_t>(1))));
+        log_ << "RANSAC inlier threshold: " << threshold << " (5% of the spread of the reference positions)\n";
     }
 
-    threads.join_all();
+    std::vector<size_t> inliers;
+    size_t iterations = threshold > 0.0 ? transform.findTransformRansac(from, to, threshold, inliers) : 0;
+    if (iterations == 0)
+    {
+        log_.warning() << "Warning: RANSAC could not find a transform, the positions may be degenerate. Using the best triplet instead.\n";
+        return false;
+    }
+    if (inliers.size() < 3)
+    {
+        log_.warning() << "Warning: RANSAC found " << inliers.size() << " of " << from.size() << " positions within " << threshold
+                       << " m of the transform, fewer than 3. Using the best triplet instead, a larger -ransacThreshold may help.\n";
+        return false;
+    }
 
-    double minTotError = std::numeric_limits<double>::infinity();
-    for(size_t t = 0; t<numThreads; t++)
+    std::vector<bool> isInlier(from.size(), false);
+    for (size_t i = 0; i < inliers.size(); ++i)
     {
-        GeorefBestTriplet* triplet = triplets[t];
-        if(minTotError > triplet->err_)
+        isInlier[inliers[i]] = true;
+    }
+
+    double totError = 0.0, inlierError = 0.0, inlierSquaredError = 0.0, inlierMaxError = 0.0;
+    for (size_t i = 0; i < from.size(); ++i)
+    {
+        double error = transform.error(from[i], to[i]);
+        totError += error;
+        if (isInlier[i])
         {
-            minTotError = triplet->err_;
-            gcp0 = triplet->t_;
-            gcp1 = triplet->s_;
-            gcp2 = triplet->p_;
+            inlierError += error;
+            inlierSquaredError += error * error;
+            inlierMaxError = std::max(inlierMaxError, error);
         }
-        delete triplet;
     }
+    double inlierCount = static_cast<double>(inliers.size());
 
-    log_ << "Mean georeference error " << minTotError / static_cast<double>(gcps_.size()) << '\n';
+    log_ << "RANSAC finished after " << iterations << " iterations, " << inliers.size() << " of " << from.size() << " inliers.\n";
+    log_ << "Inlier residuals: mean " << inlierError / inlierCount << ", rms " << std::sqrt(inlierSquaredError / inlierCount) << ", max " << inlierMaxError << '\n';
+    log_ << "Mean georeference error " << totError / static_cast<double>(from.size()) << '\n';
+    return true;
 }
 
-void Georef::findBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2, size_t offset, size_t stride, double &minTotError)
+void Georef::chooseBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2)
 {
-    minTotError = std::numeric_limits<double>::infinity();
-
-    for(size_t t = offset; t < gcps_.size(); t+=stride)
+    // Triplets are made of the usable GCPs, but scored against all of them.
+    std::vector<size_t> candidates;
+    std::vector<Vec3> from, to;
+    for(size_t gcpIndex = 0; gcpIndex < gcps_.size(); ++gcpIndex)
     {
-        if (gcps_[t].use_)
+        if (gcps_[gcpIndex].use_)
         {
-            for(size_t s = t; s < gcps_.size(); ++s)
-            {
-                if (gcps_[s].use_)
-                {
-                    for(size_t p = s; p < gcps_.size(); ++p)
-                    {
-                        if (gcps_[p].use_)
-                        {
-                            FindTransform trans;
-                            trans.findTransform(gcps_[t].getPos(), gcps_[s].getPos(), gcps_[p].getPos(),
-                                                gcps_[t].getReferencedPos(), gcps_[s].getReferencedPos(), gcps_[p].getReferencedPos());
-
-                            // The total error for the curren camera triplet.
-                            double totError = 0.0;
-
-                            for(size_t r = 0; r < gcps_.size(); ++r)
-                            {
-                                totError += trans.error(gcps_[r].getPos(), gcps_[r].getReferencedPos());
-                            }
-
-                            if(minTotError > totError)
-                            {
-                                minTotError = totError;
-                                gcp0 = t;
-                                gcp1 = s;
-                                gcp2 = p;
-                            }
-                        }
-                    }
-                }
-            }
+            candidates.push_back(gcpIndex);
         }
+        from.push_back(gcps_[gcpIndex].getPos());
+        to.push_back(gcps_[gcpIndex].getReferencedPos());
     }
 
-    log_ << '[' << offset+1 << " of " << stride << "] Mean georeference error " << minTotError / static_cast<double>(gcps_.size());
-    log_ << " (" << gcp0 << ", " << gcp1 << ", " << gcp2 << ")\n";
+    GeorefBestTriplet best;
+    chooseBestTriplet(candidates, from, to, best);
+    gcp0 = best.t_;
+    gcp1 = best.s_;
+    gcp2 = best.p_;
+
+    log_ << "Mean georeference error " << best.err_ / static_cast<double>(gcps_.size()) << '\n';
 }
 
 void Georef::chooseBestCameraTriplet(size_t &cam0, size_t &cam1, size_t &cam2)
 {
-    size_t numThreads = boost::thread::hardware_concurrency();
-    boost::thread_group threads;
-    std::vector<GeorefBestTriplet*> triplets;
-    for(size_t t = 0; t < numThreads; ++t)
+    std::vector<size_t> candidates;
+    std::vector<Vec3> from, to;
+    for(size_t cameraIndex = 0; cameraIndex < cameras_.size(); ++cameraIndex)
     {
-        GeorefBestTriplet* triplet = new GeorefBestTriplet();
-        triplets.push_back(triplet);
-        threads.create_thread(boost::bind(&Georef::findBestCameraTriplet, this, boost::ref(triplet->t_), boost::ref(triplet->s_), boost::ref(triplet->p_), t, numThreads, boost::ref(triplet->err_)));
+        candidates.push_back(cameraIndex);
+        from.push_back(cameras_[cameraIndex].getPos());
+        to.push_back(cameras_[cameraIndex].getReferencedPos());
     }
 
-    threads.join_all();
+    GeorefBestTriplet best;
+    chooseBestTriplet(candidates, from, to, best);
+    cam0 = best.t_;
+    cam1 = best.s_;
+    cam2 = best.p_;
+
+    log_ << "Mean georeference error " << best.err_ / static_cast<double>(cameras_.size()) << '\n';
+}
 
-    double minTotError = std::numeric_limits<double>::infinity();
-    for(size_t t = 0; t<numThreads; t++)
+void Georef::chooseBestTriplet(const std::vector<size_t> &candidates, const std::vector<Vec3> &from, const std::vector<Vec3> &to, GeorefBestTriplet &best)
+{
+    if (candidates.empty())
     {
-        GeorefBestTriplet* triplet = triplets[t];
-        if(minTotError > triplet->err_)
+        throw GeorefException("No positions to choose a triplet from.");
+    }
+
+    // Every (t, s) pair is followed by a loop over p, so the chunks hold many pairs and are still small
+    // enough for the workers to finish at about the same time.
+    size_t m = candidates.size();
+    size_t pairCount = m * (m + 1) / 2;
+    size_t chunkSize = std::max(static_cast<size_t>(1), pairCount / (64 * pool_.size()));
+
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<double> minTotError(std::numeric_limits<double>::infinity());
+    std::vector<GeorefBestTriplet> triplets(pool_.size());
+    pool_.run([&](size_t worker){
+        findBestTriplet(candidates, from, to, nextChunk, chunkSize, minTotError, triplets[worker]);
+    });
+
+    best = triplets[0];
+    for(size_t t = 1; t < triplets.size(); ++t)
+    {
+        const GeorefBestTriplet &triplet = triplets[t];
+        if (triplet.err_ < best.err_ || (triplet.err_ == best.err_ &&
+            std::make_tuple(triplet.t_, triplet.s_, triplet.p_) < std::make_tuple(best.t_, best.s_, best.p_)))
         {
-            minTotError = triplet->err_;
-            cam0 = triplet->t_;
-            cam1 = triplet->s_;
-            cam2 = triplet->p_;
+            best = triplet;
         }
-        delete triplet;
     }
 
-    log_ << "Mean georeference error " << minTotError / static_cast<double>(cameras_.size()) << '\n';
+    if (!(best.err_ < std::numeric_limits<double>::infinity()))
+    {
+        throw GeorefException("Could not find a triplet that gives a valid transform.");
+    }
 }
 
-void Georef::findBestCameraTriplet(size_t &cam0, size_t &cam1, size_t &cam2, size_t offset, size_t stride, double &minTotError)
+void Georef::findBestTriplet(const std::vector<size_t> &candidates, const std::vector<Vec3> &from, const std::vector<Vec3> &to,
+                             std::atomic<size_t> &nextChunk, size_t chunkSize, std::atomic<double> &minTotError, GeorefBestTriplet &best)
 {
-    minTotError = std::numeric_limits<double>::infinity();
-    
-    for(size_t t = offset; t < cameras_.size(); t+=stride)
+    best.t_ = best.s_ = best.p_ = std::numeric_limits<size_t>::max();
+    best.err_ = std::numeric_limits<double>::infinity();
+
+    size_t m = candidates.size();
+    size_t pairCount = m * (m + 1) / 2;
+
+    for(size_t first = chunkSize * nextChunk++; first < pairCount; first = chunkSize * nextChunk++)
     {
-        for(size_t s = t; s < cameras_.size(); ++s)
+        // Row t holds the m - t pairs (t, t) ... (t, m - 1) and starts at pair t * m - t * (t - 1) / 2.
+        size_t low = 0, high = m - 1;
+        while (low < high)
+        {
+            size_t middle = (low + high + 1) / 2;
+            if (middle * m - middle * (middle - 1) / 2 <= first) low = middle;
+            else high = middle - 1;
+        }
+        size_t t = low;
+        size_t s = t + (first - (t * m - t * (t - 1) / 2));
+
+        size_t last = std::min(first + chunkSize, pairCount);
+        for(size_t pair = first; pair < last; ++pair)
         {
-            for(size_t p = s; p < cameras_.size(); ++p)
+            for(size_t p = s; p < m; ++p)
             {
                 FindTransform trans;
-                trans.findTransform(cameras_[t].getPos(), cameras_[s].getPos(), cameras_[p].getPos(),
-                                    cameras_[t].getReferencedPos(), cameras_[s].getReferencedPos(), cameras_[p].getReferencedPos());
-                
-                // The total error for the current camera triplet.
+                trans.findTransform(from[candidates[t]], from[candidates[s]], from[candidates[p]],
+                                    to[candidates[t]], to[candidates[s]], to[candidates[p]]);
+
+                // Errors are never negative, so a triplet is worse than the best as soon as its partial error is.
+                double bound = std::min(best.err_, minTotError.load(std::memory_order_relaxed));
+
+                // The total error for the current triplet.
                 double totError = 0.0;
-                
-                for(size_t r = 0; r < cameras_.size(); ++r)
+
+                for(size_t r = 0; r < from.size() && !(totError > bound); ++r)
                 {
-                    totError += trans.error(cameras_[r].getPos(), cameras_[r].getReferencedPos());
+                    totError += trans.error(from[r], to[r]);
                 }
-                
-                if(minTotError > totError)
+
+                // Chunks are taken in increasing order, so a tie never beats the triplet found before it.
+                if(totError < best.err_ && !(totError > bound))
                 {
-                    minTotError = totError;
-                    cam0 = t;
-                    cam1 = s;
-                    cam2 = p;
+                    best.err_ = totError;
+                    best.t_ = candidates[t];
+                    best.s_ = candidates[s];
+                    best.p_ = candidates[p];
+
+                    double current = minTotError.load(std::memory_order_relaxed);
+                    while (totError < current && !minTotError.compare_exchange_weak(current, totError, std::memory_order_relaxed))
+                    {
+                    }
                 }
             }
+
+            if (++s == m)
+            {
+                ++t;
+                s = t;
+            }
         }
     }
-
-    log_ << '[' << offset+1 << " of " << stride << "] Mean georeference error " << minTotError / static_cast<double>(cameras_.size());
-    log_ << " (" << cam0 << ", " << cam1 << ", " << cam2 << ")\n";
 }
 
 void Georef::printGeorefSystem()
@@ -1272,8 +1534,7 @@ void Georef::printGeorefSystem()
     //tmp = tmp.substr(0, findPos);
     
     //tmp = tmp + "_georef_system.txt";
-    log_ << '\n';
-    log_ << "Saving georeference system file to \'" << georefFilename_ << "\'...\n";
+    log_.info() << "Saving georeference system file to \'" << georefFilename_ << "\'...\n";
     std::ofstream geoStream(georefFilename_.c_str());
     geoStream << georefSystem_ << std::endl;
     geoStream.close();
@@ -1296,8 +1557,7 @@ void Georef::printFinalTransform(const Eigen::Transform<Scalar, 3, Eigen::Affine
         throw GeorefException("Tried to generate default ouptut file, could not find .obj in the output file:\n\'"+outputObjFilename_+"\'");
     }
     
-    log_ << '\n';
-    log_ << "Saving final transform file to \'" << finalTransformFile_ << "\'...\n";
+    log_.info() << "Saving final transform file to \'" << finalTransformFile_ << "\'...\n";
     std::ofstream transformStream(finalTransformFile_.c_str());
     transformStream  << setiosflags(ios::fixed) << setprecision(7) << 
       "[ " << transform(0, 0) << ",\t" << transform(0, 1) << ",\t" << transform(0, 2) << ",\t" << transform(0, 3) << " ]" << std::endl << 
@@ -1342,13 +1602,95 @@ void Georef::performFinalTransform(Mat4 &transMat, pcl::TextureMesh &mesh, pcl::
     transform(3, 3) = static_cast<double>(transMat.r4c4_);
 
     log_ << '\n';
+    // GCPs and EXIF modes includes a translation
+    // but not UTM offsets. We want our point cloud
+    // and odm_georeferencing_model_geo.txt file 
+    // to include the UTM offset.
+    // OpenSfM already has UTM offsets
+    Eigen::Transform<double, 3, Eigen::Affine> outputTransform = transform;
+    if (addUTM){
+        outputTransform(0, 3) = georefSystem_.eastingOffset_ + transX;
+        outputTransform(1, 3) = georefSystem_.northingOffset_ + transY;
+    }else{
+        outputTransform(0, 3) = transX;
+        outputTransform(1, 3) = transY;
+    }
+
+    // The outputs only depend on the transform, and each is bound by its own I/O, so they are written concurrently.
+    std::vector<OutputTask> tasks;
+    tasks.push_back(OutputTask("mesh", [&]{ writeTransformedMesh(transform, mesh, meshCloud); }));
+    tasks.push_back(OutputTask("final transform", [&]{ printFinalTransform(outputTransform); }));
+    if(georeferencePointCloud_)
+    {
+        tasks.push_back(OutputTask("point cloud", [&]{
+            transformPointCloud(inputPointCloudFilename_.c_str(), outputTransform, outputPointCloudFilename_.c_str());
+        }));
+    }
+    if(exportCoordinateFile_)
+    {
+        tasks.push_back(OutputTask("camera positions", [&]{ printCameraPositions(transMat); }));
+    }
+    if(exportGeorefSystem_)
+    {
+        tasks.push_back(OutputTask("georeference system", [this]{ printGeorefSystem(); }));
+    }
+    runOutputTasks(tasks);
+}
+
+void Georef::runOutputTasks(const std::vector<OutputTask> &tasks)
+{
+    std::vector<std::string> errors(tasks.size());
+    boost::thread_group threads;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        threads.create_thread([&tasks, &errors, i]{
+            try
+            {
+                tasks[i].second();
+            }
+            catch (const std::exception &e)
+            {
+                errors[i] = e.what();
+            }
+            catch (...)
+            {
+                errors[i] = "Unknown error.";
+            }
+        });
+    }
+    threads.join_all();
+
+    // All failures are reported, not only the first one.
+    std::string message;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        if (!errors[i].empty())
+        {
+            message += "Writing the " + tasks[i].first + " failed:\n" + errors[i] + "\n";
+        }
+    }
+    if (!message.empty())
+    {
+        throw GeorefException(message);
+    }
+}
+
+void Georef::writeTransformedMesh(const Eigen::Transform<double, 3, Eigen::Affine> &transform, pcl::TextureMesh &mesh, pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud)
+{
     log_ << "Applying transform to mesh...\n";
     // Move the mesh into position.
-    pcl::transformPointCloud(*meshCloud, *meshCloud, transform);
-    log_ << ".. mesh transformed.\n";
-    
-    // Update the mesh.
-    pcl::toPCLPointCloud2 (*meshCloud, mesh.cloud);
+    {
+        ProfilePhase phase("transform_mesh");
+        pcl::transformPointCloud(*meshCloud, *meshCloud, transform);
+        log_ << ".. mesh transformed.\n";
+
+        // Update the mesh.
+        pcl::toPCLPointCloud2 (*meshCloud, mesh.cloud);
+    }
+
+    // The files refer to the textures relative to themselves, while the mesh kept in memory
+    // refers to them by the paths they were read from.
+    std::vector<pcl::TexMaterial> materials = mesh.tex_materials;
 
     // Iterate over each part of the mesh (one per material), to make texture file paths relative the .mtl file.
     for(size_t t = 0; t < mesh.tex_materials.size(); ++t)
@@ -1363,72 +1705,70 @@ void Georef::performFinalTransform(Mat4 &transMat, pcl::TextureMesh &mesh, pcl::
         }
     }
 
-    log_ << '\n';
-    if (saveOBJFile(outputObjFilename_, mesh, 8) == -1)
-    {
-        throw GeorefException("Error when saving model:\n" + outputObjFilename_ + "\n");
-    }
-    else
-    {
-        log_ << "Successfully saved model.\n";
-    }
-
-    // GCPs and EXIF modes includes a translation
-    // but not UTM offsets. We want our point cloud
-    // and odm_georeferencing_model_geo.txt file 
-    // to include the UTM offset.
-    // OpenSfM already has UTM offsets
-    if (addUTM){
-        transform(0, 3) = georefSystem_.eastingOffset_ + transX;
-        transform(1, 3) = georefSystem_.northingOffset_ + transY;
-    }else{
-        transform(0, 3) = transX;
-        transform(1, 3) = transY;
-    }
-
-    printFinalTransform(transform);
-
-    if(georeferencePointCloud_)
+    if (writeMesh_)
     {
-        Georef::transformPointCloud(inputPointCloudFilename_.c_str(), transform, outputPointCloudFilename_.c_str());
+        ProfilePhase phase("write_mesh");
+        if (saveOBJFile(outputObjFilename_, mesh, 8, &pool_) == -1)
+        {
+            mesh.tex_materials.swap(materials);
+            throw GeorefException("Error when saving model:\n" + outputObjFilename_ + "\n");
+        }
+        else
+        {
+            Profile::instance().addFileSize("bytes_written", outputObjFilename_);
+            log_ << "Successfully saved model.\n";
+        }
     }
 
-    if(exportCoordinateFile_)
+    if (!outputBinaryMeshFilename_.empty())
     {
-        log_ << '\n';
-        log_ << "Saving georeferenced camera positions to ";
-        log_ << outputCoordFilename_;
-        log_<< "\n";
-        std::ofstream coordStream(outputCoordFilename_.c_str());
-        coordStream << georefSystem_.system_ <<std::endl;
-        coordStream << static_cast<int>(georefSystem_.eastingOffset_) << " " << static_cast<int>(georefSystem_.northingOffset_) << std::endl;
-        for(size_t cameraIndex = 0; cameraIndex < cameras_.size(); ++cameraIndex)
+        try
         {
-            Vec3 globalCameraPosition = (transMat)*(cameras_[cameraIndex].getPos());
-            coordStream << globalCameraPosition.x_ << " " << globalCameraPosition.y_ << " " << globalCameraPosition.z_ << std::endl;
+            ProfilePhase phase("write_binary_mesh");
+            BinaryMesh::write(outputBinaryMeshFilename_, mesh);
+            Profile::instance().addFileSize("bytes_written", outputBinaryMeshFilename_);
         }
-        coordStream.close();
-        log_ << "...coordinate file saved.\n";
+        catch (const MeshIOException &e)
+        {
+            mesh.tex_materials.swap(materials);
+            throw GeorefException("Error when saving binary model:\n" + outputBinaryMeshFilename_ + "\n" + e.what());
+        }
+        log_ << "Successfully saved binary model.\n";
     }
 
-    if(exportGeorefSystem_)
+    mesh.tex_materials.swap(materials);
+}
+
+void Georef::printCameraPositions(Mat4 &transMat)
+{
+    log_.info() << "Saving georeferenced camera positions to " << outputCoordFilename_ << "\n";
+    std::ofstream coordStream(outputCoordFilename_.c_str());
+    coordStream << georefSystem_.system_ <<std::endl;
+    coordStream << static_cast<int>(georefSystem_.eastingOffset_) << " " << static_cast<int>(georefSystem_.northingOffset_) << std::endl;
+    for(size_t cameraIndex = 0; cameraIndex < cameras_.size(); ++cameraIndex)
     {
-        printGeorefSystem();
+        Vec3 globalCameraPosition = (transMat)*(cameras_[cameraIndex].getPos());
+        coordStream << globalCameraPosition.x_ << " " << globalCameraPosition.y_ << " " << globalCameraPosition.z_ << std::endl;
     }
+    coordStream.close();
+    log_ << "...coordinate file saved.\n";
 }
 
 template <typename Scalar>
 void Georef::transformPointCloud(const char *inputFile, const Eigen::Transform<Scalar, 3, Eigen::Affine> &transform, const char *outputFile){
     try{
+        ProfilePhase phase("transform_point_cloud");
         log_ << "Transforming point cloud...\n";
 
         // PDAL pipeline: ply reader --> matrix transform --> las writer.
+        // The pipeline is streamed, so only one chunk of points is in memory at a time.
+        // The reader of odm_filterpoints reads the binary vertices in blocks.
 
         pdal::Options inPlyOpts;
         inPlyOpts.add("filename", inputFile);
 
-        pdal::PointTable table;
-        pdal::PlyReader plyReader;
+        pdal::FixedPointTable table(10000);
+        pdal::FloatPlyReader plyReader;
         plyReader.setOptions(inPlyOpts);
 
         pdal::MatrixTransformFilter<Scalar> transformFilter(transform);
@@ -1457,6 +1797,8 @@ void Georef::transformPointCloud(const char *inputFile, const Eigen::Transform<S
         lasWriter.setInput(transformFilter);
         lasWriter.prepare(table);
         lasWriter.execute(table);
+        Profile::instance().addFileSize("bytes_read", inputFile);
+        Profile::instance().addFileSize("bytes_written", outputFile);
 
         log_ << "Point cloud file saved.\n";
     }
@@ -1466,365 +1808,39 @@ void Georef::transformPointCloud(const char *inputFile, const Eigen::Transform<S
     }
 }
 
-bool Georef::loadObjFile(std::string inputFile, pcl::TextureMesh &mesh)
+void Georef::readMesh(pcl::TextureMesh &mesh)
 {
-    int data_type;
-    unsigned int data_idx;
-    int file_version;
-    int offset = 0;
-    Eigen::Vector4f origin;
-    Eigen::Quaternionf orientation;
-
-    if (!readHeader(inputFile, mesh.cloud, origin, orientation, file_version, data_type, data_idx, offset))
-    {
-        throw GeorefException("Problem reading header in modelfile!\n");
-    }
-
-    std::ifstream fs;
-
-    fs.open (inputFile.c_str (), std::ios::binary);
-    if (!fs.is_open () || fs.fail ())
-    {
-        //PCL_ERROR ("[pcl::OBJReader::readHeader] Could not open file '%s'! Error : %s\n", file_name.c_str (), strerror(errno));
-        fs.close ();
-        log_<<"Could not read mesh from file ";
-        log_ << inputFile.c_str();
-        log_ <<"\n";
-
-        throw GeorefException("Problem reading mesh from file!\n");
-    }
-
-    // Seek at the given offset
-    fs.seekg (data_idx, std::ios::beg);
-
-    // Get normal_x field indices
-    int normal_x_field = -1;
-    for (std::size_t i = 0; i < mesh.cloud.fields.size (); ++i)
-    {
-        if (mesh.cloud.fields[i].name == "normal_x")
-        {
-            normal_x_field = i;
-            break;
-        }
-    }
-
-    std::size_t v_idx = 0;
-    std::size_t vn_idx = 0;
-    std::size_t vt_idx = 0;
-    std::size_t f_idx = 0;
-    std::string line;
-    std::vector<std::string> st;
-    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > coordinates;
-    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > allTexCoords;
-
-    std::map<int, int> f2vt;
-
-    try
+    if (!mesh.cloud.data.empty())
     {
-        while (!fs.eof ())
-        {
-            getline (fs, line);
-            // Ignore empty lines
-            if (line == "")
-                continue;
-
-            // Tokenize the line
-            std::stringstream sstream (line);
-            sstream.imbue (std::locale::classic ());
-            line = sstream.str ();
-            boost::trim (line);
-            boost::split (st, line, boost::is_any_of ("\t\r "), boost::token_compress_on);
-
-            // Ignore comments
-            if (st[0] == "#")
-                continue;
-            // Vertex
-            if (st[0] == "v")
-            {
-                try
-                {
-                    for (int i = 1, f = 0; i < 4; ++i, ++f)
-                    {
-                        float value = boost::lexical_cast<float> (st[i]);
-                        memcpy (&mesh.cloud.data[v_idx * mesh.cloud.point_step + mesh.cloud.fields[f].offset], &value, sizeof (float));
-                    }
-
-                    ++v_idx;
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex coordinates!\n";
-                    throw GeorefException("Unable to convert %s to vertex coordinates!");
-                }
-                continue;
-            }
-            // Vertex normal
-            if (st[0] == "vn")
-            {
-                try
-                {
-                    for (int i = 1, f = normal_x_field; i < 4; ++i, ++f)
-                    {
-                        float value = boost::lexical_cast<float> (st[i]);
-                        memcpy (&mesh.cloud.data[vn_idx * mesh.cloud.point_step + mesh.cloud.fields[f].offset],
-                        &value,
-                        sizeof (float));
-                    }
-                    ++vn_idx;
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex normal!\n";
-                    throw GeorefException("Unable to convert %s to vertex normal!");
-                }
-                continue;
-            }
-            // Texture coordinates
-            if (st[0] == "vt")
-            {
-                try
-                {
-                    Eigen::Vector3f c (0, 0, 0);
-                    for (std::size_t i = 1; i < st.size (); ++i)
-                        c[i-1] = boost::lexical_cast<float> (st[i]);
-
-                    if (c[2] == 0)
-                        coordinates.push_back (Eigen::Vector2f (c[0], c[1]));
-                    else
-                        coordinates.push_back (Eigen::Vector2f (c[0]/c[2], c[1]/c[2]));
-                    ++vt_idx;
-
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex texture coordinates!\n";
-                    throw GeorefException("Unable to convert %s to vertex texture coordinates!");
-                }
-                continue;
-            }
-            // Material
-            if (st[0] == "usemtl")
-            {
-                mesh.tex_polygons.push_back (std::vector<pcl::Vertices> ());
-                mesh.tex_materials.push_back (pcl::TexMaterial ());
-                for (std::size_t i = 0; i < companions_.size (); ++i)
-                {
-                    std::vector<pcl::TexMaterial>::const_iterator mat_it = companions_[i].getMaterial (st[1]);
-                    if (mat_it != companions_[i].materials_.end ())
-                    {
-                        mesh.tex_materials.back () = *mat_it;
-                        break;
-                    }
-                }
-                // We didn't find the appropriate material so we create it here with name only.
-                if (mesh.tex_materials.back ().tex_name == "")
-                    mesh.tex_materials.back ().tex_name = st[1];
-                mesh.tex_coordinates.push_back (coordinates);
-                coordinates.clear ();
-                continue;
-            }
-            // Face
-            if (st[0] == "f")
-            {
-                //We only care for vertices indices
-                pcl::Vertices face_v; face_v.vertices.resize (st.size () - 1);
-                for (std::size_t i = 1; i < st.size (); ++i)
-                {
-                    int v;
-                    sscanf (st[i].c_str (), "%d", &v);
-                    v = (v < 0) ? v_idx + v : v - 1;
-                    face_v.vertices[i-1] = v;
-
-                    int v2, vt, vn;
-                    sscanf (st[i].c_str (), "%d/%d/%d", &v2, &vt, &vn);
-                    f2vt[3*(f_idx) + i-1] = vt-1;
-                }
-                mesh.tex_polygons.back ().push_back (face_v);
-                ++f_idx;
-                continue;
-            }
-        }
-    }
-    catch (const char *exception)
-    {
-        fs.close ();
-        log_<<"Unable to read file!\n";
-        throw GeorefException("Unable to read file!");
-    }
-
-    if (vt_idx != v_idx)
-    {
-        std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > texcoordinates = std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >(0);
-        texcoordinates.reserve(3*f_idx);
-
-        for (size_t faceIndex = 0; faceIndex < f_idx; ++faceIndex)
-        {
-            for(size_t i = 0; i < 3; ++i)
-            {
-                Eigen::Vector2f vt = mesh.tex_coordinates[0][f2vt[3*faceIndex+i]];
-                texcoordinates.push_back(vt);
-            }
-        }
-
-        mesh.tex_coordinates.clear();
-        mesh.tex_coordinates.push_back(texcoordinates);
+        return;
     }
 
-    fs.close();
-    return true;
+    log_ << '\n';
+    log_ << "Reading mesh file...\n";
+    loadObjFile(inputObjFilename_, mesh);
+    log_ << ".. mesh file read.\n";
 }
 
-bool Georef::readHeader (const std::string &file_name, pcl::PCLPointCloud2 &cloud,
-                         Eigen::Vector4f &origin, Eigen::Quaternionf &orientation,
-                         int &file_version, int &data_type, unsigned int &data_idx,
-                         const int offset)
+bool Georef::loadObjFile(std::string inputFile, pcl::TextureMesh &mesh)
 {
-    origin       = Eigen::Vector4f::Zero ();
-    orientation  = Eigen::Quaternionf::Identity ();
-    file_version = 0;
-    cloud.width  = cloud.height = cloud.point_step = cloud.row_step = 0;
-    cloud.data.clear ();
-    data_type = 0;
-    data_idx = offset;
-
-    std::ifstream fs;
-    std::string line;
-
-    if (file_name == "" || !boost::filesystem::exists (file_name))
-    {
-        return false;
-    }
-
-    // Open file in binary mode to avoid problem of
-    // std::getline() corrupting the result of ifstream::tellg()
-    fs.open (file_name.c_str (), std::ios::binary);
-    if (!fs.is_open () || fs.fail ())
-    {
-        fs.close ();
-        return false;
-    }
-
-    // Seek at the given offset
-    fs.seekg (offset, std::ios::beg);
-
-    // Read the header and fill it in with wonderful values
-    bool vertex_normal_found = false;
-    bool vertex_texture_found = false;
-    // Material library, skip for now!
-    // bool material_found = false;
-    std::vector<std::string> material_files;
-    std::size_t nr_point = 0;
-    std::vector<std::string> st;
+    ObjReader reader;
 
     try
     {
-        while (!fs.eof ())
-        {
-            getline (fs, line);
-            // Ignore empty lines
-            if (line == "")
-            continue;
-
-            // Tokenize the line
-            std::stringstream sstream (line);
-            sstream.imbue (std::locale::classic ());
-            line = sstream.str ();
-            boost::trim (line);
-            boost::split (st, line, boost::is_any_of ("\t\r "), boost::token_compress_on);
-            // Ignore comments
-            if (st.at (0) == "#")
-                continue;
-
-            // Vertex
-            if (st.at (0) == "v")
-            {
-                ++nr_point;
-                continue;
-            }
-
-            // Vertex texture
-            if ((st.at (0) == "vt") && !vertex_texture_found)
-            {
-                vertex_texture_found = true;
-                continue;
-            }
-
-            // Vertex normal
-            if ((st.at (0) == "vn") && !vertex_normal_found)
-            {
-                vertex_normal_found = true;
-                continue;
-            }
-
-            // Material library, skip for now!
-            if (st.at (0) == "mtllib")
-            {
-                material_files.push_back (st.at (1));
-                continue;
-            }
-        }
-    }
-    catch (const char *exception)
-    {
-        fs.close ();
-        return false;
+        ProfilePhase phase("read_mesh");
+        reader.read(inputFile, mesh, companions_);
+        Profile::instance().addFileSize("bytes_read", inputFile);
     }
-
-    if (!nr_point)
+    catch (const MeshIOException &e)
     {
-        fs.close ();
-        return false;
-    }
-
-    int field_offset = 0;
-    for (int i = 0; i < 3; ++i, field_offset += 4)
-    {
-        cloud.fields.push_back (pcl::PCLPointField ());
-        cloud.fields[i].offset   = field_offset;
-        cloud.fields[i].datatype = pcl::PCLPointField::FLOAT32;
-        cloud.fields[i].count    = 1;
-    }
-
-    cloud.fields[0].name = "x";
-    cloud.fields[1].name = "y";
-    cloud.fields[2].name = "z";
-
-    if (vertex_normal_found)
-    {
-        std::string normals_names[3] = { "normal_x", "normal_y", "normal_z" };
-        for (int i = 0; i < 3; ++i, field_offset += 4)
-        {
-            cloud.fields.push_back (pcl::PCLPointField ());
-            pcl::PCLPointField& last = cloud.fields.back ();
-            last.name     = normals_names[i];
-            last.offset   = field_offset;
-            last.datatype = pcl::PCLPointField::FLOAT32;
-            last.count    = 1;
-        }
+        log_ << e.what() << "\n";
+        throw GeorefException("Problem reading mesh from file!\n");
     }
 
-    if (material_files.size () > 0)
+    for (size_t i = 0; i < reader.getWarnings().size(); ++i)
     {
-        for (std::size_t i = 0; i < material_files.size (); ++i)
-        {
-            pcl::MTLReader companion;
-
-            if (companion.read (file_name, material_files[i]))
-            {
-                log_<<"Problem reading material file.";
-            }
-
-            companions_.push_back (companion);
-        }
+        log_ << reader.getWarnings()[i] << "\n";
     }
 
-    cloud.point_step = field_offset;
-    cloud.width      = nr_point;
-    cloud.height     = 1;
-    cloud.row_step   = cloud.point_step * cloud.width;
-    cloud.is_dense   = true;
-    cloud.data.resize (cloud.point_step * nr_point);
-    fs.close ();
     return true;
 }
-
@@ -4,6 +4,7 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <atomic>
 
 // PCL
 #include <pcl/common/eigen.h>
@@ -21,6 +22,12 @@
 // PDAL matrix transform filter
 #include "MatrixTransformFilter.hpp"
 
+// Ray casting
+#include "MeshIntersector.hpp"
+
+// Threading
+#include "ThreadPool.hpp"
+
 /*!
  * \brief   The GeorefSystem struct is used to store information about a georeference system.
  */
@@ -132,6 +139,16 @@ struct GeorefBestTriplet
     double err_;        /**< Error of this triplet. **/
 };
 
+/*!
+ * \brief   The GeorefGCPIntersection struct is used to store where a GCP was found in the model.
+ */
+struct GeorefGCPIntersection
+{
+    bool exists_;               /**< Whether the GCP intersects any face of the model. **/
+    pcl::PointXYZ local_;       /**< The position of the GCP in the model. **/
+    std::string warning_;       /**< Set if the GCP could not be looked up. **/
+};
+
 /*!
  * \brief   The Georef class is used to transform a mesh into a georeferenced system.
  *          The class reads camera positions from a bundle file.
@@ -146,10 +163,39 @@ public:
     Georef();
     ~Georef();
     
+    /*!
+     * \brief run      Georeferences the input mesh and writes the output files given by the arguments.
+     * \param argc     Application argument count.
+     * \param argv     Argument values.
+     * \return         EXIT_SUCCESS if successful.
+     */
     int run(int argc, char* argv[]);
+
+    /*!
+     * \brief run      Georeferences the input mesh and keeps the result in mesh, to be handed to the next step without
+     *                 serialization. The output mesh file is only written when "-outputFile" is given.
+     * \param argc     Application argument count.
+     * \param argv     Argument values.
+     * \param mesh     The georeferenced mesh. If it is not empty, it is georeferenced instead of the input file.
+     * \return         EXIT_SUCCESS if successful.
+     */
+    int run(int argc, char* argv[], pcl::TextureMesh &mesh);
+
+    /*!
+     * \brief georeferenceMesh     Georeferences mesh in place, with the arguments parsed by run.
+     *                             An empty mesh is read from the input file first. Texture paths are kept as they are,
+     *                             the written mesh files refer to their textures relative to themselves.
+     */
+    void georeferenceMesh(pcl::TextureMesh &mesh);
     
 private:
     
+    /*!
+     * \brief run      Parses the arguments and georeferences mesh, catching and logging any error.
+     * \param writeMesh    Write the output mesh file even if "-outputFile" was not given.
+     */
+    int run(int argc, char* argv[], pcl::TextureMesh &mesh, bool writeMesh);
+    
     /*!
      * \brief parseArguments    Parses command line arguments.
      * \param   argc            Application argument count.
@@ -172,11 +218,6 @@ private:
       */
     void setDefaultPointCloudOutput();
 
-    /*!
-     * \brief createGeoreferencedModel    Makes the input file georeferenced and saves it to the output file.
-     */
-    void createGeoreferencedModel();
-
     /*!
      * \brief readCameras      Reads the camera information from the bundle file.
      */
@@ -200,27 +241,35 @@ private:
     /*!
       * \brief performGeoreferencingWithGCP     Performs the georeferencing of the model with the ground control points.
       */
-    void performGeoreferencingWithGCP();
+    void performGeoreferencingWithGCP(pcl::TextureMesh &mesh);
+
+    /*!
+      * \brief findGCPIntersections     Partitioned lookup of the GCPs in the model, by casting a ray from the camera through the GCP pixel.
+      */
+    void findGCPIntersections(const MeshIntersector &intersector, const pcl::PointCloud<pcl::PointXYZ> &meshCloud,
+                              std::vector<GeorefGCPIntersection> &intersections, size_t offset, size_t stride);
 
     /*!
      * \brief createGeoreferencedModelFromGCPData    Makes the input file georeferenced and saves it to the output file.
      */
-    void createGeoreferencedModelFromGCPData();
+    void createGeoreferencedModelFromGCPData(pcl::TextureMesh &mesh);
 
     /*!
      * \brief createGeoreferencedModelFromExifData    Makes the input file georeferenced and saves it to the output file.
      */
-    void createGeoreferencedModelFromExifData();
+    void createGeoreferencedModelFromExifData(pcl::TextureMesh &mesh);
     
     /*!
-     *  \brief chooseBestGCPTriplet    Chooses the best triplet of GCPs to use when making the model georeferenced.
+     *  \brief solveTransformRansac    Finds the transform from the local to the georeferenced positions with RANSAC, and logs the residuals.
+     *  \return                        False, with a warning, if no transform with at least 3 inliers was found.
      */
-    void chooseBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2);
+    bool solveTransformRansac(const std::vector<Vec3> &from, const std::vector<Vec3> &to, FindTransform &transform);
 
     /*!
-     * \brief findBestGCPTriplet    Partitioned version of chooseBestGCPTriplet.
+     *  \brief chooseBestGCPTriplet    Chooses the best triplet of GCPs to use when making the model georeferenced.
      */
-    void findBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2, size_t offset, size_t stride, double &minTotError);
+    void chooseBestGCPTriplet(size_t &gcp0, size_t &gcp1, size_t &gcp2);
+
 
     /*!
      * \brief chooseBestCameraTriplet    Chooses the best triplet of cameras to use when making the model georeferenced.
@@ -228,9 +277,24 @@ private:
     void chooseBestCameraTriplet(size_t &cam0, size_t &cam1, size_t &cam2);
 
     /*!
-     * \brief findBestCameraTriplet    Partitioned version of chooseBestCameraTriplet.
+     * \brief chooseBestTriplet     Chooses the triplet of candidates whose transform has the smallest total error over all positions.
+     * \details                     Ties are resolved in favour of the lexicographically smallest triplet, so the result
+     *                              does not depend on the number of threads.
+     * \param candidates            The indices of the positions a triplet may be made of, in increasing order.
+     * \param from                  The local positions.
+     * \param to                    The georeferenced positions.
+     * \param best                  The best triplet found, as indices into from and to.
      */
-    void findBestCameraTriplet(size_t &cam0, size_t &cam1, size_t &cam2, size_t offset, size_t stride, double &minTotError);
+    void chooseBestTriplet(const std::vector<size_t> &candidates, const std::vector<Vec3> &from, const std::vector<Vec3> &to, GeorefBestTriplet &best);
+
+    /*!
+     * \brief findBestTriplet       Worker of chooseBestTriplet.
+     * \details                     The triplets (t, s, p) with t <= s <= p are split into chunks of (t, s) pairs, which the
+     *                              workers take from nextChunk until none are left. Scoring a triplet stops as soon as its
+     *                              partial error exceeds the best total error found by any worker.
+     */
+    void findBestTriplet(const std::vector<size_t> &candidates, const std::vector<Vec3> &from, const std::vector<Vec3> &to,
+                         std::atomic<size_t> &nextChunk, size_t chunkSize, std::atomic<double> &minTotError, GeorefBestTriplet &best);
     
     /*!
       * \brief printGeorefSystem        Prints a file containing information about the georeference system, next to the ouptut file.
@@ -245,7 +309,7 @@ private:
 
     
     /*!
-      * \brief Loads a model from an .obj file (replacement for the pcl obj loader).
+      * \brief Loads a model from an .obj file, using the parallel reader of the mesh IO library.
       *
       * \param inputFile Path to the .obj file.
       * \param mesh The model.
@@ -254,16 +318,19 @@ private:
     bool loadObjFile(std::string inputFile, pcl::TextureMesh &mesh);
 
     /*!
-      * \brief Function is compied straight from the function in the pcl::io module.
+      * \brief readMesh     Reads the input mesh file into mesh, unless mesh already holds a model.
       */
-    bool readHeader (const std::string &file_name, pcl::PCLPointCloud2 &cloud,
-                     Eigen::Vector4f &origin, Eigen::Quaternionf &orientation,
-                     int &file_version, int &data_type, unsigned int &data_idx,
-                     const int offset);
+    void readMesh(pcl::TextureMesh &mesh);
+
+    /*!
+      * \brief writeProfile Writes the "-profile" report, if one was asked for.
+      */
+    void writeProfile();
 
 
     Logger          log_;                       /**< Logging object. */
     std::string     logFile_;                   /**< The path to the output log file. */
+    std::string     profileFile_;               /**< The path to the profile report, empty if not profiling. */
     
     std::string     finalTransformFile_;        /**< The path to the file for the final transform. */
     
@@ -276,16 +343,21 @@ private:
     std::string     imagesLocation_;            /**< The folder containing the images in the image list. **/
     std::string     inputObjFilename_;          /**< The path to the input mesh obj file. **/
     std::string     outputObjFilename_;         /**< The path to the output mesh obj file. **/
+    std::string     outputBinaryMeshFilename_;  /**< The path to the optional output binary mesh file. **/
     std::string     inputPointCloudFilename_;   /**< The path to the input point cloud file. **/
     std::string     outputPointCloudFilename_;  /**< The path to the output point cloud file. **/
     std::string     georefFilename_;            /**< The path to the output offset file. **/
     std::string     outputPointCloudSrs_;                       /**< The spatial reference system of the point cloud file to be written. Can be an EPSG string (e.g. “EPSG:26910”) or a WKT string. **/
 
+    bool            outputSpecified_;           /**< Set if the output mesh file was given with "-outputFile". **/
+    bool            writeMesh_;                 /**< Write the georeferenced mesh to the output mesh file. **/
     bool            georeferencePointCloud_;
     bool            exportCoordinateFile_;
     bool            exportGeorefSystem_;
     bool            useGCP_;                    /**< Check if GCP-file is present and use this to georeference the model. **/
     bool            useTransform_;
+    bool            useRansac_;                 /**< Find the transform with RANSAC and least squares, instead of trying every triplet. **/
+    double          ransacThreshold_;           /**< The largest distance of an inlier to the transformed position, in meters, 0 to scale it with the spread of the positions. **/
     // double          bundleResizedTo_;           /**< The size used in the previous steps to calculate the camera focal_length. */
 
     std::vector<GeorefCamera> cameras_;         /**< A vector of all cameras. **/
@@ -297,12 +369,39 @@ private:
     bool            multiMaterial_;     /**< True if the mesh has multiple materials. **/
 
     std::vector<pcl::MTLReader> companions_; /**< Materials (used by loadOBJFile). **/
+
+    ThreadPool      pool_;              /**< The workers shared by the parallel searches. **/
+
+    /*!
+      * \brief An output written once the transform is known: its name in error messages and the function writing it.
+      **/
+    typedef std::pair<std::string, boost::function<void ()> > OutputTask;
+
+    /*!
+      * \brief performFinalTransform    Transforms the mesh and writes all outputs, concurrently.
+      **/
     void performFinalTransform(Mat4 &transMat, pcl::TextureMesh &mesh, pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, bool addUTM);
+
+    /*!
+      * \brief runOutputTasks           Runs the tasks on a thread each and waits for all of them.
+      * \throws GeorefException         Holding the errors of all the tasks which failed.
+      **/
+    void runOutputTasks(const std::vector<OutputTask> &tasks);
+
+    /*!
+      * \brief writeTransformedMesh     Moves the mesh into position and writes the OBJ and binary mesh files asked for.
+      **/
+    void writeTransformedMesh(const Eigen::Transform<double, 3, Eigen::Affine> &transform, pcl::TextureMesh &mesh, pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud);
+
+    /*!
+      * \brief printCameraPositions     Prints the georeferenced camera positions to the output coordinate file.
+      **/
+    void printCameraPositions(Mat4 &transMat);
     
     template <typename Scalar>
     void transformPointCloud(const char *inputFile, const Eigen::Transform<Scalar, 3, Eigen::Affine> &transform, const char *outputFile);
     
-    void createGeoreferencedModelFromSFM();
+    void createGeoreferencedModelFromSFM(pcl::TextureMesh &mesh);
 };
 
 /*!
@@ -0,0 +1,186 @@
+#include "ImageSize.hpp"
+
+// C++
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace
+{
+
+/*!
+ * \brief   Reads an unsigned integer of the given number of bytes.
+ */
+bool readUnsigned(std::istream &in, size_t bytes, bool bigEndian, uint32_t &value)
+{
+    unsigned char buffer[4];
+    if (!in.read(reinterpret_cast<char *>(buffer), static_cast<std::streamsize>(bytes)))
+    {
+        return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        size_t shift = bigEndian ? 8 * (bytes - 1 - i) : 8 * i;
+        value |= static_cast<uint32_t>(buffer[i]) << shift;
+    }
+    return true;
+}
+
+/*!
+ * \brief   Reads the image size and orientation from the first IFD of a TIFF structure starting at base.
+ *          Tags that are missing are left unchanged.
+ */
+bool readTiffTags(std::istream &in, std::streamoff base, uint32_t &width, uint32_t &height, uint32_t &orientation)
+{
+    char byteOrder[2];
+    in.seekg(base);
+    if (!in.read(byteOrder, 2))
+    {
+        return false;
+    }
+
+    bool bigEndian;
+    if (byteOrder[0] == 'I' && byteOrder[1] == 'I') bigEndian = false;
+    else if (byteOrder[0] == 'M' && byteOrder[1] == 'M') bigEndian = true;
+    else return false;
+
+    uint32_t magic, ifdOffset, entryCount;
+    if (!readUnsigned(in, 2, bigEndian, magic) || magic != 42 ||
+        !readUnsigned(in, 4, bigEndian, ifdOffset))
+    {
+        return false;
+    }
+
+    in.seekg(base + static_cast<std::streamoff>(ifdOffset));
+    if (!readUnsigned(in, 2, bigEndian, entryCount))
+    {
+        return false;
+    }
+
+    for (uint32_t e = 0; e < entryCount; ++e)
+    {
+        uint32_t tag, type, count, value;
+        if (!readUnsigned(in, 2, bigEndian, tag) || !readUnsigned(in, 2, bigEndian, type) || !readUnsigned(in, 4, bigEndian, count))
+        {
+            return false;
+        }
+
+        // SHORT values are left-justified in the 4 byte value field.
+        if (type == 3)
+        {
+            uint32_t padding;
+            if (!readUnsigned(in, 2, bigEndian, value) || !readUnsigned(in, 2, bigEndian, padding)) return false;
+        }
+        else if (!readUnsigned(in, 4, bigEndian, value))
+        {
+            return false;
+        }
+
+        if (count != 1 || (type != 3 && type != 4)) continue;
+
+        if (tag == 256) width = value;
+        else if (tag == 257) height = value;
+        else if (tag == 274) orientation = value;
+    }
+    return true;
+}
+
+bool readJpegSize(std::istream &in, uint32_t &width, uint32_t &height, uint32_t &orientation)
+{
+    in.seekg(2);
+    for (;;)
+    {
+        // Markers may be preceded by any number of fill bytes.
+        int byte = in.get();
+        if (byte != 0xFF) return false;
+        while (byte == 0xFF) byte = in.get();
+        if (byte == EOF) return false;
+
+        int marker = byte;
+        // Markers without a payload.
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;
+        if (marker == 0xD9 || marker == 0xDA) return false;
+
+        uint32_t length;
+        if (!readUnsigned(in, 2, true, length) || length < 2) return false;
+        std::streamoff payload = in.tellg();
+
+        // Start of frame, except DHT (C4), JPG (C8) and DAC (CC).
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            uint32_t precision;
+            if (!readUnsigned(in, 1, true, precision) || !readUnsigned(in, 2, true, height) || !readUnsigned(in, 2, true, width))
+            {
+                return false;
+            }
+            return true;
+        }
+
+        // EXIF
+        if (marker == 0xE1 && length > 8)
+        {
+            std::string segment(length - 2, '\0');
+            if (!in.read(&segment[0], static_cast<std::streamsize>(segment.size()))) return false;
+            if (segment.compare(0, 6, std::string("Exif\0\0", 6)) == 0)
+            {
+                std::istringstream exif(segment.substr(6));
+                uint32_t ignored = 0;
+                readTiffTags(exif, 0, ignored, ignored, orientation);
+            }
+        }
+
+        in.clear();
+        in.seekg(payload + static_cast<std::streamoff>(length - 2));
+    }
+}
+
+}
+
+bool readImageSize(const std::string &filename, int &width, int &height)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    unsigned char signature[8];
+    if (!in.read(reinterpret_cast<char *>(signature), sizeof(signature)))
+    {
+        return false;
+    }
+
+    uint32_t w = 0, h = 0, orientation = 1;
+
+    if (signature[0] == 0xFF && signature[1] == 0xD8)
+    {
+        if (!readJpegSize(in, w, h, orientation)) return false;
+
+        // cv::imread applies the EXIF orientation of JPEG images, orientations 5 to 8 transpose the image.
+        if (orientation >= 5 && orientation <= 8) std::swap(w, h);
+    }
+    else if (memcmp(signature, "\x89PNG\r\n\x1a\n", 8) == 0)
+    {
+        // IHDR is always the first chunk.
+        char chunk[8];
+        if (!in.read(chunk, 8) || memcmp(chunk + 4, "IHDR", 4) != 0 ||
+            !readUnsigned(in, 4, true, w) || !readUnsigned(in, 4, true, h))
+        {
+            return false;
+        }
+    }
+    else if ((signature[0] == 'I' && signature[1] == 'I') || (signature[0] == 'M' && signature[1] == 'M'))
+    {
+        if (!readTiffTags(in, 0, w, h, orientation)) return false;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (w == 0 || h == 0 || w > 0x7FFFFFFF || h > 0x7FFFFFFF)
+    {
+        return false;
+    }
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// C++
+#include <string>
+
+/*!
+ * \brief readImageSize Reads the size of a JPEG, PNG or TIFF image from its header, without decoding it.
+ * \details             The size is the one cv::imread would return, so JPEG images with an EXIF
+ *                      orientation that rotates by 90 degrees get their width and height swapped.
+ * \param filename      Path to the image.
+ * \param width         The width of the image in pixels.
+ * \param height        The height of the image in pixels.
+ * \return              False if the format is not recognized or the header is damaged.
+ */
+bool readImageSize(const std::string &filename, int &width, int &height);
@@ -7,10 +7,12 @@
 #include <pdal/io/LasWriter.hpp>
 #include <pdal/Options.hpp>
 #include <pdal/Filter.hpp>
+#include <pdal/Streamable.hpp>
+#include <algorithm>
 
 namespace pdal{
     template <typename Scalar>
-    class MatrixTransformFilter : public Filter{
+    class MatrixTransformFilter : public Filter, public Streamable{
         Eigen::Transform<Scalar, 3, Eigen::Affine> transform;
 
         public:
@@ -19,20 +21,55 @@ namespace pdal{
 
             std::string getName() const { return "MatrixTransformFilter"; }
 
+            // The coordinates are stored as doubles whatever the reader gives, so georeferenced points keep their precision.
+            virtual void addDimensions(PointLayoutPtr layout)
+            {
+                layout->registerDim(Dimension::Id::X, Dimension::Type::Double);
+                layout->registerDim(Dimension::Id::Y, Dimension::Type::Double);
+                layout->registerDim(Dimension::Id::Z, Dimension::Type::Double);
+            }
+
+            // Transforms the points in batches, so that the matrix product runs over many points at once.
             virtual void filter(PointView &view)
             {
-                for (PointId id = 0; id < view.size(); ++id)
+                const PointId batchSize = 4096;
+                Eigen::Matrix<Scalar, 3, Eigen::Dynamic> points(3, static_cast<Eigen::Index>(batchSize));
+
+                for (PointId first = 0; first < view.size(); first += batchSize)
                 {
-                    Scalar x = view.getFieldAs<Scalar>(Dimension::Id::X, id);
-                    Scalar y = view.getFieldAs<Scalar>(Dimension::Id::Y, id);
-                    Scalar z = view.getFieldAs<Scalar>(Dimension::Id::Z, id);
+                    PointId count = std::min(batchSize, view.size() - first);
+                    for (PointId i = 0; i < count; ++i)
+                    {
+                        Eigen::Index col = static_cast<Eigen::Index>(i);
+                        points(0, col) = view.getFieldAs<Scalar>(Dimension::Id::X, first + i);
+                        points(1, col) = view.getFieldAs<Scalar>(Dimension::Id::Y, first + i);
+                        points(2, col) = view.getFieldAs<Scalar>(Dimension::Id::Z, first + i);
+                    }
 
-                    view.setField(pdal::Dimension::Id::X, id, transform (0, 0) * x + transform (0, 1) * y + transform (0, 2) * z + transform (0, 3));
-                    view.setField(pdal::Dimension::Id::Y, id, transform (1, 0) * x + transform (1, 1) * y + transform (1, 2) * z + transform (1, 3));
-                    view.setField(pdal::Dimension::Id::Z, id, transform (2, 0) * x + transform (2, 1) * y + transform (2, 2) * z + transform (2, 3));
+                    Eigen::Index cols = static_cast<Eigen::Index>(count);
+                    points.leftCols(cols) = (transform.linear() * points.leftCols(cols)).colwise() + transform.translation();
+
+                    for (PointId i = 0; i < count; ++i)
+                    {
+                        Eigen::Index col = static_cast<Eigen::Index>(i);
+                        view.setField(pdal::Dimension::Id::X, first + i, points(0, col));
+                        view.setField(pdal::Dimension::Id::Y, first + i, points(1, col));
+                        view.setField(pdal::Dimension::Id::Z, first + i, points(2, col));
+                    }
                 }
             }
 
-        // TODO: implement streaming mode
+            virtual bool processOne(PointRef &point)
+            {
+                Eigen::Matrix<Scalar, 3, 1> p(point.getFieldAs<Scalar>(Dimension::Id::X),
+                                              point.getFieldAs<Scalar>(Dimension::Id::Y),
+                                              point.getFieldAs<Scalar>(Dimension::Id::Z));
+                p = transform * p;
+
+                point.setField(pdal::Dimension::Id::X, p(0));
+                point.setField(pdal::Dimension::Id::Y, p(1));
+                point.setField(pdal::Dimension::Id::Z, p(2));
+                return true;
+            }
     };
 }
\ No newline at end of file
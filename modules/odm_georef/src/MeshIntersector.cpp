@@ -0,0 +1,214 @@
+#include "MeshIntersector.hpp"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+/*!
+ * \brief   The largest number of faces in a leaf.
+ */
+const size_t leafSize = 4;
+
+/*!
+ * \brief   How far outside a triangle, in barycentric units, a ray still counts as hitting it.
+ */
+const double barycentricTolerance = 1e-3;
+
+}
+
+MeshIntersector::MeshIntersector(const pcl::PointCloud<pcl::PointXYZ> &vertices, const std::vector<std::vector<pcl::Vertices> > &polygons)
+    : vertices_(vertices)
+{
+    size_t faceCount = 0;
+    for (size_t m = 0; m < polygons.size(); ++m)
+    {
+        faceCount += polygons[m].size();
+    }
+
+    faces_.reserve(3 * faceCount);
+    for (size_t m = 0; m < polygons.size(); ++m)
+    {
+        for (size_t f = 0; f < polygons[m].size(); ++f)
+        {
+            faces_.insert(faces_.end(), polygons[m][f].vertices.begin(), polygons[m][f].vertices.begin() + 3);
+        }
+    }
+
+    // The centroid and the (slightly padded) bounding box of every face.
+    std::vector<float> centroids(3 * faceCount);
+    std::vector<float> bounds(6 * faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        const pcl::PointXYZ &p0 = vertices_.points[faces_[3 * f]];
+        const pcl::PointXYZ &p1 = vertices_.points[faces_[3 * f + 1]];
+        const pcl::PointXYZ &p2 = vertices_.points[faces_[3 * f + 2]];
+        float low[3] = { std::min(p0.x, std::min(p1.x, p2.x)), std::min(p0.y, std::min(p1.y, p2.y)), std::min(p0.z, std::min(p1.z, p2.z)) };
+        float high[3] = { std::max(p0.x, std::max(p1.x, p2.x)), std::max(p0.y, std::max(p1.y, p2.y)), std::max(p0.z, std::max(p1.z, p2.z)) };
+
+        float extent = std::max(high[0] - low[0], std::max(high[1] - low[1], high[2] - low[2]));
+        float magnitude = std::max(std::max(std::fabs(low[0]), std::fabs(high[0])), std::max(std::max(std::fabs(low[1]), std::fabs(high[1])), std::max(std::fabs(low[2]), std::fabs(high[2]))));
+        float pad = static_cast<float>(barycentricTolerance) * extent + 1e-5f * magnitude;
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            bounds[6 * f + c] = low[c] - pad;
+            bounds[6 * f + 3 + c] = high[c] + pad;
+            centroids[3 * f + c] = 0.5f * (low[c] + high[c]);
+        }
+    }
+
+    order_.resize(faceCount);
+    for (size_t f = 0; f < faceCount; ++f)
+    {
+        order_[f] = static_cast<uint32_t>(f);
+    }
+
+    if (faceCount > 0)
+    {
+        nodes_.reserve(2 * (faceCount / leafSize + 1));
+        build(0, faceCount, centroids, bounds);
+    }
+}
+
+uint32_t MeshIntersector::build(size_t begin, size_t end, const std::vector<float> &centroids, const std::vector<float> &bounds)
+{
+    uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.push_back(Node());
+
+    Node node;
+    float centroidMin[3], centroidMax[3];
+    for (size_t c = 0; c < 3; ++c)
+    {
+        node.min[c] = centroidMin[c] = std::numeric_limits<float>::max();
+        node.max[c] = centroidMax[c] = -std::numeric_limits<float>::max();
+    }
+    for (size_t i = begin; i < end; ++i)
+    {
+        uint32_t f = order_[i];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            node.min[c] = std::min(node.min[c], bounds[6 * f + c]);
+            node.max[c] = std::max(node.max[c], bounds[6 * f + 3 + c]);
+            centroidMin[c] = std::min(centroidMin[c], centroids[3 * f + c]);
+            centroidMax[c] = std::max(centroidMax[c], centroids[3 * f + c]);
+        }
+    }
+
+    if (end - begin <= leafSize)
+    {
+        node.first = static_cast<uint32_t>(begin);
+        node.count = static_cast<uint32_t>(end - begin);
+        nodes_[index] = node;
+        return index;
+    }
+
+    // Split at the median centroid along the longest axis.
+    size_t axis = 0;
+    for (size_t c = 1; c < 3; ++c)
+    {
+        if (centroidMax[c] - centroidMin[c] > centroidMax[axis] - centroidMin[axis]) axis = c;
+    }
+    size_t middle = begin + (end - begin) / 2;
+    std::nth_element(order_.begin() + static_cast<std::ptrdiff_t>(begin), order_.begin() + static_cast<std::ptrdiff_t>(middle), order_.begin() + static_cast<std::ptrdiff_t>(end),
+                     [&centroids, axis](uint32_t a, uint32_t b){ return centroids[3 * a + axis] < centroids[3 * b + axis]; });
+
+    build(begin, middle, centroids, bounds);
+    node.first = build(middle, end, centroids, bounds);
+    node.count = 0;
+    nodes_[index] = node;
+    return index;
+}
+
+bool MeshIntersector::hitsBox(const Node &node, const Eigen::Vector3d &origin, const Eigen::Vector3d &inverseDirection) const
+{
+    double tMin = 0.0;
+    double tMax = std::numeric_limits<double>::infinity();
+    for (int c = 0; c < 3; ++c)
+    {
+        double t0 = (static_cast<double>(node.min[c]) - origin[c]) * inverseDirection[c];
+        double t1 = (static_cast<double>(node.max[c]) - origin[c]) * inverseDirection[c];
+        if (t0 > t1) std::swap(t0, t1);
+        // NaN (a ray lying in a slab plane) compares false and leaves the interval unchanged.
+        if (t0 > tMin) tMin = t0;
+        if (t1 < tMax) tMax = t1;
+        if (tMin > tMax) return false;
+    }
+    return true;
+}
+
+bool MeshIntersector::hitsTriangle(size_t f, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction) const
+{
+    const pcl::PointXYZ &p0 = vertices_.points[faces_[3 * f]];
+    const pcl::PointXYZ &p1 = vertices_.points[faces_[3 * f + 1]];
+    const pcl::PointXYZ &p2 = vertices_.points[faces_[3 * f + 2]];
+    Eigen::Vector3d v0(p0.x, p0.y, p0.z);
+    Eigen::Vector3d edge1 = Eigen::Vector3d(p1.x, p1.y, p1.z) - v0;
+    Eigen::Vector3d edge2 = Eigen::Vector3d(p2.x, p2.y, p2.z) - v0;
+
+    // Moller-Trumbore
+    Eigen::Vector3d p = direction.cross(edge2);
+    double determinant = edge1.dot(p);
+    if (std::fabs(determinant) <= std::numeric_limits<double>::min())
+    {
+        return false;
+    }
+    double inverseDeterminant = 1.0 / determinant;
+
+    Eigen::Vector3d s = origin - v0;
+    double u = s.dot(p) * inverseDeterminant;
+    if (u < -barycentricTolerance || u > 1.0 + barycentricTolerance) return false;
+
+    Eigen::Vector3d q = s.cross(edge1);
+    double v = direction.dot(q) * inverseDeterminant;
+    if (v < -barycentricTolerance || u + v > 1.0 + barycentricTolerance) return false;
+
+    return edge2.dot(q) * inverseDeterminant > 0.0;
+}
+
+void MeshIntersector::intersect(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, std::vector<size_t> &faces) const
+{
+    faces.clear();
+    if (nodes_.empty())
+    {
+        return;
+    }
+
+    Eigen::Vector3d inverseDirection(1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]);
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    while (!stack.empty())
+    {
+        const Node &node = nodes_[stack.back()];
+        uint32_t index = stack.back();
+        stack.pop_back();
+
+        if (!hitsBox(node, origin, inverseDirection))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                if (hitsTriangle(order_[i], origin, direction))
+                {
+                    faces.push_back(order_[i]);
+                }
+            }
+        }
+        else
+        {
+            stack.push_back(node.first);
+            stack.push_back(index + 1);
+        }
+    }
+
+    // Report the faces in mesh order, independent of the layout of the hierarchy.
+    std::sort(faces.begin(), faces.end());
+}
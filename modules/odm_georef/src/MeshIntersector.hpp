@@ -0,0 +1,66 @@
+#pragma once
+
+// C++
+#include <vector>
+#include <cstdint>
+
+// PCL
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/TextureMesh.h>
+
+/*!
+ * \brief   The MeshIntersector class finds the faces of a mesh hit by a ray.
+ * \details A bounding volume hierarchy is built once over all faces of all submeshes,
+ *          after which each ray only visits the few nodes it passes through.
+ */
+class MeshIntersector
+{
+public:
+    /*!
+     * \brief MeshIntersector   Builds the hierarchy over the triangles of the mesh.
+     * \param vertices          The vertices of the mesh.
+     * \param polygons          The faces of the submeshes of the mesh.
+     */
+    MeshIntersector(const pcl::PointCloud<pcl::PointXYZ> &vertices, const std::vector<std::vector<pcl::Vertices> > &polygons);
+
+    /*!
+     * \brief intersect     Collects the faces hit by the ray, as indices into the flattened submeshes.
+     * \details             The hit test is slightly conservative, so faces grazed at an edge or a vertex are
+     *                      included; callers apply their own exact test to the candidates.
+     * \param origin        The start of the ray.
+     * \param direction     The direction of the ray.
+     * \param faces         The faces found.
+     */
+    void intersect(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, std::vector<size_t> &faces) const;
+
+    /*!
+     * \brief face          The vertex indices of a face, by its index in the flattened submeshes.
+     */
+    const uint32_t* face(size_t f) const { return &faces_[3 * f]; }
+
+private:
+    /*!
+     * \brief   A node of the hierarchy, either with two children or with a range of faces.
+     */
+    struct Node
+    {
+        float min[3];       /**< The lower corner of the bounding box. */
+        float max[3];       /**< The upper corner of the bounding box. */
+        uint32_t first;     /**< The first face of a leaf, or the index of the second child of an inner node. */
+        uint32_t count;     /**< The number of faces of a leaf, 0 for inner nodes. */
+    };
+
+    /*!
+     * \brief build         Builds the subtree over order_[begin, end) and returns its index.
+     */
+    uint32_t build(size_t begin, size_t end, const std::vector<float> &centroids, const std::vector<float> &bounds);
+
+    bool hitsBox(const Node &node, const Eigen::Vector3d &origin, const Eigen::Vector3d &inverseDirection) const;
+    bool hitsTriangle(size_t f, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction) const;
+
+    const pcl::PointCloud<pcl::PointXYZ> &vertices_;   /**< The vertices of the mesh. */
+    std::vector<uint32_t> faces_;                       /**< The vertex indices of all faces. */
+    std::vector<uint32_t> order_;                       /**< The faces, sorted so that the faces of each leaf are consecutive. */
+    std::vector<Node> nodes_;                           /**< The nodes, the root first. */
+};
@@ -0,0 +1,98 @@
+#include "ThreadPool.hpp"
+
+// C++
+#include <algorithm>
+
+// Boost
+#include <boost/bind.hpp>
+
+ThreadPool::ThreadPool(size_t threads)
+    : generation_(0), running_(0), stopping_(false)
+{
+    if (threads == 0)
+    {
+        threads = std::max(static_cast<size_t>(1), static_cast<size_t>(boost::thread::hardware_concurrency()));
+    }
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers_.push_back(new boost::thread(boost::bind(&ThreadPool::work, this, t)));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    started_.notify_all();
+    for (size_t t = 0; t < workers_.size(); ++t)
+    {
+        workers_[t]->join();
+        delete workers_[t];
+    }
+}
+
+void ThreadPool::run(const boost::function<void (size_t)> &job)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    job_ = job;
+    running_ = workers_.size();
+    ++generation_;
+    started_.notify_all();
+    while (running_ > 0)
+    {
+        finished_.wait(lock);
+    }
+    job_.clear();
+
+    if (error_)
+    {
+        boost::exception_ptr error = error_;
+        error_ = boost::exception_ptr();
+        boost::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::work(size_t worker)
+{
+    size_t done = 0;
+    for (;;)
+    {
+        boost::function<void (size_t)> job;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (!stopping_ && generation_ == done)
+            {
+                started_.wait(lock);
+            }
+            if (stopping_)
+            {
+                return;
+            }
+            done = generation_;
+            job = job_;
+        }
+
+        // An exception must not end the worker, run would wait for it forever.
+        boost::exception_ptr error;
+        try
+        {
+            job(worker);
+        }
+        catch (...)
+        {
+            error = boost::current_exception();
+        }
+
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        if (error && !error_)
+        {
+            error_ = error;
+        }
+        if (--running_ == 0)
+        {
+            finished_.notify_one();
+        }
+    }
+}
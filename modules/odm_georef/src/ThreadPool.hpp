@@ -0,0 +1,56 @@
+#pragma once
+
+// C++
+#include <vector>
+
+// Boost
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/exception_ptr.hpp>
+
+/*!
+ * \brief   The ThreadPool class keeps a fixed set of worker threads alive between parallel jobs.
+ * \details A job is a function called once on every worker with the index of the worker. Jobs that
+ *          need balanced work share a counter and keep taking chunks of work until none is left.
+ */
+class ThreadPool
+{
+public:
+    /*!
+     * \brief ThreadPool    Starts the workers.
+     * \param threads       The number of workers, 0 for one per hardware thread.
+     */
+    explicit ThreadPool(size_t threads = 0);
+
+    /*!
+     * \brief Destructor, stops and joins the workers.
+     */
+    ~ThreadPool();
+
+    /*!
+     * \brief size          The number of workers.
+     */
+    size_t size() const { return workers_.size(); }
+
+    /*!
+     * \brief run           Calls job on every worker and waits until all calls have returned.
+     *                      The first exception thrown by a call is rethrown once they all have.
+     */
+    void run(const boost::function<void (size_t)> &job);
+
+private:
+    ThreadPool(const ThreadPool &);
+    ThreadPool& operator=(const ThreadPool &);
+
+    void work(size_t worker);
+
+    std::vector<boost::thread*> workers_;  /**< The worker threads. */
+    boost::mutex mutex_;                    /**< Guards the members below. */
+    boost::condition_variable started_;     /**< Signalled when a job is posted or the pool stops. */
+    boost::condition_variable finished_;    /**< Signalled when the last worker finishes a job. */
+    boost::function<void (size_t)> job_;    /**< The current job. */
+    boost::exception_ptr error_;            /**< The first exception thrown by the current job, if any. */
+    size_t generation_;                     /**< The number of jobs posted so far. */
+    size_t running_;                        /**< The number of workers still running the current job. */
+    bool stopping_;                         /**< Set when the workers are to exit. */
+};
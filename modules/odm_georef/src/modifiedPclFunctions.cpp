@@ -37,7 +37,210 @@
 
 #include "modifiedPclFunctions.hpp"
 
-int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh, unsigned precision)
+#include <cstdio>
+
+namespace
+{
+
+/*!
+ * \brief   The number of lines formatted by one task of the OBJ writer.
+ */
+const size_t objChunkLines = 16384;
+
+/*!
+ * \brief   Appends an unsigned integer in decimal.
+ */
+void appendUnsigned(std::string &out, size_t value)
+{
+    char buffer[24];
+    char *end = buffer + sizeof(buffer);
+    char *begin = end;
+    do
+    {
+        *--begin = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    while (value != 0);
+    out.append(begin, end);
+}
+
+/*!
+ * \brief   Appends a printf formatted line, matching the default floating point notation of an ostream
+ *          with the same precision, which is printf's %g.
+ */
+template <typename... Values>
+void appendFormatted(std::string &out, const char *format, Values... values)
+{
+    char buffer[256];
+    int length = snprintf(buffer, sizeof(buffer), format, values...);
+    if (length < 0)
+    {
+        return;
+    }
+    if (static_cast<size_t>(length) < sizeof(buffer))
+    {
+        out.append(buffer, static_cast<size_t>(length));
+        return;
+    }
+    // Only reached for very large precisions.
+    std::vector<char> large(static_cast<size_t>(length) + 1);
+    snprintf(&large[0], large.size(), format, values...);
+    out.append(&large[0], static_cast<size_t>(length));
+}
+
+/*!
+ * \brief   The ChunkWriter class formats a block of lines in parallel chunks and writes the chunks to a
+ *          stream in order.
+ * \details At most a fixed number of chunks are held in memory; a task waits for the chunks before it to be
+ *          written before it formats a chunk beyond that window. Whichever task completes the next chunk
+ *          in order writes it, together with any completed chunks after it.
+ */
+class ChunkWriter
+{
+public:
+    typedef boost::function<void (size_t, size_t, std::string &)> Formatter;
+
+    ChunkWriter(std::ostream &out, size_t lines, const Formatter &format, size_t capacity)
+        : out_(out), lines_(lines), format_(format),
+          chunks_((lines + objChunkLines - 1) / objChunkLines), slots_(capacity), ready_(capacity, false),
+          taken_(0), written_(0), writing_(false)
+    {
+    }
+
+    /*!
+     * \brief run       Writes all lines, on the workers of pool when given.
+     */
+    void run(ThreadPool *pool)
+    {
+        if (pool == NULL || pool->size() < 2 || chunks_ < 2)
+        {
+            std::string text;
+            for (size_t c = 0; c < chunks_; ++c)
+            {
+                text.clear();
+                formatChunk(c, text);
+                out_.write(text.data(), static_cast<std::streamsize>(text.size()));
+            }
+            return;
+        }
+        pool->run(boost::bind(&ChunkWriter::work, this));
+    }
+
+private:
+    void formatChunk(size_t chunk, std::string &text)
+    {
+        size_t begin = chunk * objChunkLines;
+        format_(begin, std::min(lines_, begin + objChunkLines), text);
+    }
+
+    void work()
+    {
+        std::string text;
+        for (;;)
+        {
+            size_t chunk;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex_);
+                if (taken_ == chunks_)
+                {
+                    return;
+                }
+                chunk = taken_++;
+                while (chunk >= written_ + slots_.size())
+                {
+                    writtenChanged_.wait(lock);
+                }
+            }
+
+            text.clear();
+            formatChunk(chunk, text);
+
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            size_t slot = chunk % slots_.size();
+            slots_[slot].swap(text);
+            ready_[slot] = true;
+            if (writing_)
+            {
+                continue;
+            }
+
+            writing_ = true;
+            while (ready_[written_ % slots_.size()])
+            {
+                std::string &next = slots_[written_ % slots_.size()];
+                lock.unlock();
+                out_.write(next.data(), static_cast<std::streamsize>(next.size()));
+                lock.lock();
+                ready_[written_ % slots_.size()] = false;
+                ++written_;
+                writtenChanged_.notify_all();
+            }
+            writing_ = false;
+        }
+    }
+
+    std::ostream &out_;                         /**< The stream written to. */
+    size_t lines_;                              /**< The number of lines to write. */
+    Formatter format_;                          /**< Appends the lines in a range to a string. */
+    size_t chunks_;                             /**< The number of chunks. */
+    std::vector<std::string> slots_;            /**< The formatted chunks not yet written, by chunk modulo capacity. */
+    std::vector<bool> ready_;                   /**< Set for slots holding a formatted chunk. */
+    size_t taken_;                              /**< The number of chunks handed to tasks. */
+    size_t written_;                            /**< The number of chunks written. */
+    bool writing_;                              /**< Set while a task is writing chunks. */
+    boost::mutex mutex_;                        /**< Guards the members above. */
+    boost::condition_variable writtenChanged_;  /**< Signalled when a chunk has been written. */
+};
+
+void formatVertices(const pcl::TextureMesh &tex_mesh, const size_t *offsets, size_t point_size, int precision,
+                    size_t begin, size_t end, std::string &text)
+{
+    const uint8_t *data = &tex_mesh.cloud.data[0];
+    float xyz[3];
+    for (size_t i = begin; i < end; ++i)
+    {
+        for (size_t k = 0; k < 3; ++k)
+        {
+            memcpy(&xyz[k], data + i * point_size + offsets[k], sizeof(float));
+        }
+        appendFormatted(text, "v %.*g %.*g %.*g\n", precision, static_cast<double>(xyz[0]),
+                        precision, static_cast<double>(xyz[1]), precision, static_cast<double>(xyz[2]));
+    }
+}
+
+void formatTextureCoordinates(const pcl::TextureMesh &tex_mesh, size_t m, int precision,
+                              size_t begin, size_t end, std::string &text)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        const Eigen::Vector2f &uv = tex_mesh.tex_coordinates[m][i];
+        appendFormatted(text, "vt %.*g %.*g\n", precision, static_cast<double>(uv[0]),
+                        precision, static_cast<double>(uv[1]));
+    }
+}
+
+void formatFaces(const pcl::TextureMesh &tex_mesh, size_t m, size_t f_idx, size_t begin, size_t end, std::string &text)
+{
+    for (size_t i = begin; i < end; ++i)
+    {
+        // There's one UV per vertex per face, i.e., the same vertex can have
+        // different UV depending on the face.
+        const std::vector<uint32_t> &vertices = tex_mesh.tex_polygons[m][i].vertices;
+        text += 'f';
+        for (size_t j = 0; j < vertices.size(); ++j)
+        {
+            text += ' ';
+            appendUnsigned(text, static_cast<unsigned int>(vertices[j] + 1));
+            text += '/';
+            appendUnsigned(text, 3 * (i + f_idx) + j + 1);
+        }
+        text += '\n';
+    }
+}
+
+}
+
+int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh, unsigned precision, ThreadPool *pool)
 {
   if (tex_mesh.cloud.data.empty ())
   {
@@ -45,14 +248,10 @@ int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh,
     return (-1);
   }
 
-  std::ostringstream fs;
-  fs.precision (precision);
-
   // Define material file
   std::string mtl_file_name = file_name.substr (0, file_name.find_last_of (".")) + ".mtl";
   // Strip path for "mtllib" command
   std::string mtl_file_name_nopath = mtl_file_name;
-  //std::cout << mtl_file_name_nopath << std::endl;
   mtl_file_name_nopath.erase (0, mtl_file_name.find_last_of ('/') + 1);
 
   /* Write 3D information */
@@ -60,6 +259,25 @@ int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh,
   int nr_points  = tex_mesh.cloud.width * tex_mesh.cloud.height;
   int point_size = tex_mesh.cloud.data.size () / nr_points;
 
+  // The offsets of the first three float "x", "y" or "z" fields, in field order, written as the vertex.
+  size_t xyz_offsets[3];
+  int xyz = 0;
+  for (size_t d = 0; d < tex_mesh.cloud.fields.size () && xyz < 3; ++d)
+  {
+    if ((tex_mesh.cloud.fields[d].datatype == pcl::PCLPointField::FLOAT32) && (
+              tex_mesh.cloud.fields[d].name == "x" ||
+              tex_mesh.cloud.fields[d].name == "y" ||
+              tex_mesh.cloud.fields[d].name == "z"))
+    {
+      xyz_offsets[xyz++] = tex_mesh.cloud.fields[d].offset;
+    }
+  }
+  if (xyz != 3 && nr_points > 0)
+  {
+    PCL_ERROR ("[pcl::io::saveOBJFile] Input point cloud has no XYZ data!\n");
+    return (-2);
+  }
+
   // mesh size
   int nr_meshes = tex_mesh.tex_polygons.size ();
   // number of faces for header
@@ -67,116 +285,46 @@ int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh,
   for (int m = 0; m < nr_meshes; ++m)
     nr_faces += tex_mesh.tex_polygons[m].size ();
 
+  std::ofstream fs (file_name.c_str ());
+  if (!fs)
+  {
+    PCL_ERROR ("[pcl::io::saveOBJFile] Could not open %s for writing!\n", file_name.c_str ());
+    return (-1);
+  }
+
+  // Each task formats a chunk of lines, two chunks per worker are held in memory.
+  size_t capacity = 2 * (pool != NULL ? pool->size () : 1);
+  int text_precision = static_cast<int> (precision);
+
   // Write the header information
-  fs << "####" << std::endl;
-  fs << "# OBJ dataFile simple version. File name: " << file_name << std::endl;
-  fs << "# Vertices: " << nr_points << std::endl;
-  fs << "# Faces: " <<nr_faces << std::endl;
-  fs << "# Material information:" << std::endl;
-  fs << "mtllib " << mtl_file_name_nopath << std::endl;
-  fs << "####" << std::endl;
+  fs << "####" << '\n';
+  fs << "# OBJ dataFile simple version. File name: " << file_name << '\n';
+  fs << "# Vertices: " << nr_points << '\n';
+  fs << "# Faces: " <<nr_faces << '\n';
+  fs << "# Material information:" << '\n';
+  fs << "mtllib " << mtl_file_name_nopath << '\n';
+  fs << "####" << '\n';
 
   // Write vertex coordinates
-  fs << "# Vertices" << std::endl;
-  for (int i = 0; i < nr_points; ++i)
-  {
-    int xyz = 0;
-    // "v" just be written one
-    bool v_written = false;
-    for (size_t d = 0; d < tex_mesh.cloud.fields.size (); ++d)
-    {
-      int count = tex_mesh.cloud.fields[d].count;
-      if (count == 0)
-        count = 1;          // we simply cannot tolerate 0 counts (coming from older converter code)
-      int c = 0;
-      // adding vertex
-      if ((tex_mesh.cloud.fields[d].datatype == pcl::PCLPointField::FLOAT32) /*sensor_msgs::PointField::FLOAT32)*/ && (
-                tex_mesh.cloud.fields[d].name == "x" ||
-                tex_mesh.cloud.fields[d].name == "y" ||
-                tex_mesh.cloud.fields[d].name == "z"))
-      {
-        if (!v_written)
-        {
-            // write vertices beginning with v
-            fs << "v ";
-            v_written = true;
-        }
-        float value;
-        memcpy (&value, &tex_mesh.cloud.data[i * point_size + tex_mesh.cloud.fields[d].offset + c * sizeof (float)], sizeof (float));
-        fs << value;
-        if (++xyz == 3)
-            break;
-        fs << " ";
-      }
-    }
-    if (xyz != 3)
-    {
-      PCL_ERROR ("[pcl::io::saveOBJFile] Input point cloud has no XYZ data!\n");
-      return (-2);
-    }
-    fs << std::endl;
-  }
-  fs << "# "<< nr_points <<" vertices" << std::endl;
-
-//  // Write vertex normals
-//  for (int i = 0; i < nr_points; ++i)
-//  {
-//    int xyz = 0;
-//    // "vn" just be written one
-//    bool v_written = false;
-//    for (size_t d = 0; d < tex_mesh.cloud.fields.size (); ++d)
-//    {
-//      int count = tex_mesh.cloud.fields[d].count;
-//      if (count == 0)
-//      count = 1;          // we simply cannot tolerate 0 counts (coming from older converter code)
-//      int c = 0;
-//      // adding vertex
-//      if ((tex_mesh.cloud.fields[d].datatype == pcl::PCLPointField::FLOAT32) && (
-//      tex_mesh.cloud.fields[d].name == "normal_x" ||
-//      tex_mesh.cloud.fields[d].name == "normal_y" ||
-//      tex_mesh.cloud.fields[d].name == "normal_z"))
-//      {
-//        if (!v_written)
-//        {
-//          // write vertices beginning with vn
-//          fs << "vn ";
-//          v_written = true;
-//        }
-//        float value;
-//        memcpy (&value, &tex_mesh.cloud.data[i * point_size + tex_mesh.cloud.fields[d].offset + c * sizeof (float)], sizeof (float));
-//        fs << value;
-//        if (++xyz == 3)
-//          break;
-//        fs << " ";
-//      }
-//    }
-//    if (xyz != 3)
-//    {
-//    //PCL_ERROR ("[pcl::io::saveOBJFile] Input point cloud has no normals!\n");
-//    //return (-2);
-//    }
-//    fs << std::endl;
-//  }
-  // Write vertex texture with "vt" (adding latter)
+  fs << "# Vertices" << '\n';
+  ChunkWriter (fs, static_cast<size_t> (std::max (nr_points, 0)),
+               boost::bind (&formatVertices, boost::cref (tex_mesh), &xyz_offsets[0], static_cast<size_t> (point_size), text_precision, _1, _2, _3),
+               capacity).run (pool);
+  fs << "# "<< nr_points <<" vertices" << '\n';
 
+  // Write vertex texture with "vt"
   for (int m = 0; m < nr_meshes; ++m)
   {
     if(tex_mesh.tex_coordinates.size() == 0)
       continue;
 
-    //PCL_INFO ("%d vertex textures in submesh %d\n", tex_mesh.tex_coordinates[m].size (), m);
-    fs << "# " << tex_mesh.tex_coordinates[m].size() << " vertex textures in submesh " << m <<  std::endl;
-    for (size_t i = 0; i < tex_mesh.tex_coordinates[m].size (); ++i)
-    {
-      fs << "vt ";
-      fs <<  tex_mesh.tex_coordinates[m][i][0] << " " << tex_mesh.tex_coordinates[m][i][1] << std::endl;
-    }
+    fs << "# " << tex_mesh.tex_coordinates[m].size() << " vertex textures in submesh " << m << '\n';
+    ChunkWriter (fs, tex_mesh.tex_coordinates[m].size (),
+                 boost::bind (&formatTextureCoordinates, boost::cref (tex_mesh), static_cast<size_t> (m), text_precision, _1, _2, _3),
+                 capacity).run (pool);
   }
 
-  int f_idx = 0;
-
-  // int idx_vt =0;
-  //PCL_INFO ("Writting faces...\n");
+  size_t f_idx = 0;
   for (int m = 0; m < nr_meshes; ++m)
   {
     if (m > 0)
@@ -184,71 +332,53 @@ int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh,
 
     if(tex_mesh.tex_materials.size() !=0)
     {
-      fs << "# The material will be used for mesh " << m << std::endl;
+      fs << "# The material will be used for mesh " << m << '\n';
       //TODO pbl here with multi texture and unseen faces
-      fs << "usemtl " <<  tex_mesh.tex_materials[m].tex_name << std::endl;
-      fs << "# Faces" << std::endl;
-    }
-    for (size_t i = 0; i < tex_mesh.tex_polygons[m].size(); ++i)
-    {
-      // Write faces with "f"
-      fs << "f";
-      size_t j = 0;
-      // There's one UV per vertex per face, i.e., the same vertex can have
-      // different UV depending on the face.
-      for (j = 0; j < tex_mesh.tex_polygons[m][i].vertices.size (); ++j)
-      {
-        unsigned int idx = tex_mesh.tex_polygons[m][i].vertices[j] + 1;
-        fs << " " << idx
-        << "/" << 3*(i+f_idx) +j+1;
-        //<< "/" << idx; // vertex index in obj file format starting with 1
-      }
-      fs << std::endl;
+      fs << "usemtl " <<  tex_mesh.tex_materials[m].tex_name << '\n';
+      fs << "# Faces" << '\n';
     }
-    //PCL_INFO ("%d faces in mesh %d \n", tex_mesh.tex_polygons[m].size () , m);
-    fs << "# "<< tex_mesh.tex_polygons[m].size() << " faces in mesh " << m << std::endl;
+    ChunkWriter (fs, tex_mesh.tex_polygons[m].size (),
+                 boost::bind (&formatFaces, boost::cref (tex_mesh), static_cast<size_t> (m), f_idx, _1, _2, _3),
+                 capacity).run (pool);
+    fs << "# "<< tex_mesh.tex_polygons[m].size() << " faces in mesh " << m << '\n';
   }
-  fs << "# End of File";
+  fs << "# End of File" << '\n';
 
   // Close obj file
-  //PCL_INFO ("Closing obj file\n");
-  std::ofstream ofs(file_name.c_str ());
-  ofs << fs.str() << std::endl;
-  ofs.close ();
+  fs.close ();
+  if (fs.fail ())
+  {
+    PCL_ERROR ("[pcl::io::saveOBJFile] Could not write %s!\n", file_name.c_str ());
+    return (-1);
+  }
 
   /* Write material defination for OBJ file*/
-  // Open file
-  //PCL_INFO ("Writing material files\n");
   //dont do it if no material to write
   if(tex_mesh.tex_materials.size() ==0)
     return (0);
 
-  // Empty string stream
-  fs.str("");
+  std::ofstream omfs(mtl_file_name.c_str ());
+  omfs.precision (precision);
 
-  //std::cout << "MTL file is located at_ " << mtl_file_name << std::endl;
   // default
-  fs << "#" << std::endl;
-  fs << "# Wavefront material file" << std::endl;
-  fs << "#" << std::endl;
+  omfs << "#" << '\n';
+  omfs << "# Wavefront material file" << '\n';
+  omfs << "#" << '\n';
   for(int m = 0; m < nr_meshes; ++m)
   {
-    fs << "newmtl " << tex_mesh.tex_materials[m].tex_name << std::endl;
-    fs << "Ka "<< tex_mesh.tex_materials[m].tex_Ka.r << " " << tex_mesh.tex_materials[m].tex_Ka.g << " " << tex_mesh.tex_materials[m].tex_Ka.b << std::endl; // defines the ambient color of the material to be (r,g,b).
-    fs << "Kd "<< tex_mesh.tex_materials[m].tex_Kd.r << " " << tex_mesh.tex_materials[m].tex_Kd.g << " " << tex_mesh.tex_materials[m].tex_Kd.b << std::endl; // defines the diffuse color of the material to be (r,g,b).
-    fs << "Ks "<< tex_mesh.tex_materials[m].tex_Ks.r << " " << tex_mesh.tex_materials[m].tex_Ks.g << " " << tex_mesh.tex_materials[m].tex_Ks.b << std::endl; // defines the specular color of the material to be (r,g,b). This color shows up in highlights.
-    fs << "d " << tex_mesh.tex_materials[m].tex_d << std::endl; // defines the transparency of the material to be alpha.
-    fs << "Ns "<< tex_mesh.tex_materials[m].tex_Ns  << std::endl; // defines the shininess of the material to be s.
-    fs << "illum "<< tex_mesh.tex_materials[m].tex_illum << std::endl; // denotes the illumination model used by the material.
+    omfs << "newmtl " << tex_mesh.tex_materials[m].tex_name << '\n';
+    omfs << "Ka "<< tex_mesh.tex_materials[m].tex_Ka.r << " " << tex_mesh.tex_materials[m].tex_Ka.g << " " << tex_mesh.tex_materials[m].tex_Ka.b << '\n'; // defines the ambient color of the material to be (r,g,b).
+    omfs << "Kd "<< tex_mesh.tex_materials[m].tex_Kd.r << " " << tex_mesh.tex_materials[m].tex_Kd.g << " " << tex_mesh.tex_materials[m].tex_Kd.b << '\n'; // defines the diffuse color of the material to be (r,g,b).
+    omfs << "Ks "<< tex_mesh.tex_materials[m].tex_Ks.r << " " << tex_mesh.tex_materials[m].tex_Ks.g << " " << tex_mesh.tex_materials[m].tex_Ks.b << '\n'; // defines the specular color of the material to be (r,g,b). This color shows up in highlights.
+    omfs << "d " << tex_mesh.tex_materials[m].tex_d << '\n'; // defines the transparency of the material to be alpha.
+    omfs << "Ns "<< tex_mesh.tex_materials[m].tex_Ns  << '\n'; // defines the shininess of the material to be s.
+    omfs << "illum "<< tex_mesh.tex_materials[m].tex_illum << '\n'; // denotes the illumination model used by the material.
     // illum = 1 indicates a flat material with no specular highlights, so the value of Ks is not used.
     // illum = 2 denotes the presence of specular highlights, and so a specification for Ks is required.
-    fs << "map_Kd " << tex_mesh.tex_materials[m].tex_file << std::endl;
-    fs << "###" << std::endl;
+    omfs << "map_Kd " << tex_mesh.tex_materials[m].tex_file << '\n';
+    omfs << "###" << '\n';
   }
-
-
-  std::ofstream omfs(mtl_file_name.c_str ());
-  omfs << fs.str() << std::endl;
+  omfs << '\n';
   omfs.close ();
 
   return (0);
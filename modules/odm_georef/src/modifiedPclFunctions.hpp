@@ -9,7 +9,14 @@
 #include <pcl/surface/texture_mapping.h>
 #include <pcl/io/obj_io.h>
 
-int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh, unsigned precision);
+#include "ThreadPool.hpp"
+
+/*!
+ * \brief   Writes a textured mesh as an OBJ file and its materials as an MTL file next to it.
+ * \details The vertex, texture coordinate and face lines are formatted in chunks on the workers of pool, when
+ *          given, and streamed to the file in order.
+ */
+int saveOBJFile(const std::string &file_name, const pcl::TextureMesh &tex_mesh, unsigned precision, ThreadPool *pool = NULL);
 
 bool getPixelCoordinates(const pcl::PointXYZ &pt, const pcl::TextureMapping<pcl::PointXYZ>::Camera &cam, pcl::PointXY &UV_coordinates);
 
@@ -0,0 +1,112 @@
+// Georeferences textured meshes and renders them into an ortho photo in one process.
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Georef.hpp"
+#include "OdmOrthoPhoto.hpp"
+#include "Profile.hpp"
+
+namespace
+{
+
+void printHelp()
+{
+    std::cout << "odm_georef_ortho\n\n";
+    std::cout << "Purpose:\n";
+    std::cout << "Georeference textured meshes and render them into an ortho photo, handing the meshes over in memory.\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "odm_georef_ortho [-profile <path>] -georef <odm_georef arguments> [-georef <odm_georef arguments> ...] -ortho <odm_orthophoto arguments>\n\n";
+    std::cout << "Every \"-georef\" group georeferences one mesh, as odm_georef does with the same arguments. The georeferenced mesh\n";
+    std::cout << "is only written when the group gives \"-outputFile\". The meshes are rendered in the order of the groups, one per\n";
+    std::cout << "band group of \"-bands\", as odm_orthophoto does with the \"-ortho\" arguments, which must not give \"-inputFiles\".\n";
+    std::cout << "\"-profile\" writes one report of the time, memory and counters of all groups to a JSON file. The groups should not\n";
+    std::cout << "give \"-profile\" themselves.\n";
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    // The arguments of each -georef group and of the -ortho group, each starting with the program name.
+    std::vector<std::vector<char *> > georefArgs;
+    std::vector<char *> orthoArgs;
+    std::vector<char *> *current = NULL;
+    std::string profileFile;
+
+    for (int argIndex = 1; argIndex < argc; ++argIndex)
+    {
+        std::string argument = argv[argIndex];
+        if (argument == "-profile" && current == NULL && argIndex + 1 < argc)
+        {
+            profileFile = argv[++argIndex];
+        }
+        else if (argument == "-georef")
+        {
+            georefArgs.push_back(std::vector<char *>(1, argv[0]));
+            current = &georefArgs.back();
+        }
+        else if (argument == "-ortho")
+        {
+            if (!orthoArgs.empty())
+            {
+                std::cerr << "Argument '-ortho' can only be given once.\n";
+                return EXIT_FAILURE;
+            }
+            orthoArgs.push_back(argv[0]);
+            current = &orthoArgs;
+        }
+        else if (current == NULL)
+        {
+            printHelp();
+            return EXIT_FAILURE;
+        }
+        else
+        {
+            current->push_back(argv[argIndex]);
+        }
+    }
+
+    if (georefArgs.empty() || orthoArgs.empty())
+    {
+        printHelp();
+        return EXIT_FAILURE;
+    }
+
+    if (!profileFile.empty())
+    {
+        Profile::instance().enable("odm_georef_ortho", profileFile);
+    }
+
+    std::vector<pcl::TextureMesh> meshes(georefArgs.size());
+    std::vector<std::string> names;
+    for (size_t g = 0; g < georefArgs.size(); ++g)
+    {
+        std::vector<char *> &args = georefArgs[g];
+
+        // Models are named after their input file in the log.
+        names.push_back("model " + std::to_string(g + 1));
+        for (size_t a = 1; a + 1 < args.size(); ++a)
+        {
+            if (std::string(args[a]) == "-inputFile")
+            {
+                names.back() = args[a + 1];
+            }
+        }
+
+        Georef ref;
+        if (ref.run(static_cast<int>(args.size()), &args[0], meshes[g]) != EXIT_SUCCESS)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    OdmOrthoPhoto orthoPhotoGenerator;
+    int result = orthoPhotoGenerator.run(static_cast<int>(orthoArgs.size()), &orthoArgs[0], meshes, names);
+
+    if (!Profile::instance().write())
+    {
+        std::cerr << "Warning: could not write the profile to " << profileFile << "\n";
+    }
+    return result;
+}
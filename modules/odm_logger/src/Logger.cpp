@@ -0,0 +1,271 @@
+#include "Logger.hpp"
+
+// STL
+#include <atomic>
+#include <chrono>
+#include <map>
+
+namespace
+{
+
+const size_t pendingBytes = 1 << 20;            // The pending text with the file open, writers wait above it.
+const size_t unopenedBytes = 16 << 20;          // The text kept before the file is opened, more is dropped.
+const std::chrono::milliseconds writeInterval(500); // The writer thread writes at least this often.
+const size_t maxLineBytes = 64 << 10;           // A line given with << is added once this long, even without its end.
+
+std::atomic<uint64_t> nextSerial(0);
+
+}
+
+Logger::Message::Message(Logger *log) : log_(log)
+{
+    if (log_)
+    {
+        stream_.reset(new std::ostringstream());
+    }
+}
+
+Logger::Message::Message(Message &&other) : log_(other.log_), stream_(std::move(other.stream_))
+{
+    other.log_ = nullptr;
+}
+
+Logger::Message::~Message()
+{
+    if (log_ && stream_)
+    {
+        std::unique_lock<std::mutex> lock(log_->mutex_);
+        log_->append(lock, stream_->str());
+    }
+}
+
+Logger::Logger(bool isPrintingInCout) : isPrintingInCout_(isPrintingInCout), serial_(nextSerial++), level_(Info), isWriting_(false),
+    isFlushing_(false), isStopping_(false), droppedBytes_(0)
+{
+
+}
+
+Logger::~Logger()
+{
+    close();
+}
+
+bool Logger::open(const std::string &filePath)
+{
+    close();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.open(filePath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file_.is_open())
+    {
+        return false;
+    }
+    if (droppedBytes_ > 0)
+    {
+        pending_ += "Warning: " + std::to_string(droppedBytes_) + " bytes of log messages were dropped before the log file was opened.\n";
+        droppedBytes_ = 0;
+    }
+    isStopping_ = false;
+    writer_ = std::thread(&Logger::writeLoop, this);
+    return true;
+}
+
+void Logger::print(std::string filePath)
+{
+    bool isOpen;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isOpen = writer_.joinable();
+    }
+    if (!isOpen)
+    {
+        open(filePath);
+    }
+    flush();
+}
+
+void Logger::flush()
+{
+    appendThreadLine();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!writer_.joinable())
+    {
+        return;
+    }
+    isFlushing_ = true;
+    pendingCondition_.notify_one();
+    writtenCondition_.wait(lock, [this]{ return pending_.empty() && !isWriting_; });
+    isFlushing_ = false;
+}
+
+bool Logger::isPrintingInCout() const
+{
+    return isPrintingInCout_;
+}
+
+void Logger::setIsPrintingInCout(bool isPrintingInCout)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    isPrintingInCout_ = isPrintingInCout;
+}
+
+Logger::Level Logger::level() const
+{
+    return level_;
+}
+
+void Logger::setLevel(Level level)
+{
+    level_ = level;
+}
+
+bool Logger::parseLevel(const std::string &name, Level &level)
+{
+    if (name == "debug")
+    {
+        level = Debug;
+    }
+    else if (name == "info")
+    {
+        level = Info;
+    }
+    else if (name == "warning")
+    {
+        level = Warning;
+    }
+    else if (name == "error")
+    {
+        level = Error;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+Logger::ThreadLine& Logger::threadLine()
+{
+    // The lines of the logs used by the thread. Serials are never reused, so a new log never gets a stale line.
+    thread_local std::map<uint64_t, std::unique_ptr<ThreadLine> > lines;
+    std::unique_ptr<ThreadLine> &line = lines[serial_];
+    if (!line)
+    {
+        line.reset(new ThreadLine());
+    }
+    return *line;
+}
+
+void Logger::appendLines(ThreadLine &line)
+{
+    size_t end = line.text_.rfind('\n');
+    if (end == std::string::npos && line.text_.size() < maxLineBytes)
+    {
+        return;
+    }
+    size_t length = end == std::string::npos ? line.text_.size() : end + 1;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        append(lock, line.text_.substr(0, length));
+    }
+    line.text_.erase(0, length);
+}
+
+void Logger::appendThreadLine()
+{
+    ThreadLine &line = threadLine();
+    if (!line.text_.empty())
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        append(lock, line.text_);
+        line.text_.clear();
+    }
+}
+
+void Logger::append(std::unique_lock<std::mutex> &lock, const std::string &text)
+{
+    // If console printing is enabled.
+    if (isPrintingInCout_)
+    {
+        std::cout << text;
+        std::cout.flush();
+    }
+
+    if (!writer_.joinable())
+    {
+        // Kept until the file is opened, up to the bound.
+        if (pending_.size() + text.size() > unopenedBytes)
+        {
+            droppedBytes_ += text.size();
+            return;
+        }
+        pending_ += text;
+        return;
+    }
+
+    if (pending_.size() >= pendingBytes)
+    {
+        pendingCondition_.notify_one();
+        writtenCondition_.wait(lock, [this]{ return pending_.size() < pendingBytes || isStopping_; });
+    }
+    pending_ += text;
+    if (pending_.size() >= pendingBytes / 2)
+    {
+        pendingCondition_.notify_one();
+    }
+}
+
+void Logger::close()
+{
+    appendThreadLine();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!writer_.joinable())
+        {
+            return;
+        }
+        isStopping_ = true;
+        pendingCondition_.notify_one();
+    }
+    writer_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_.close();
+    isStopping_ = false;
+    writtenCondition_.notify_all();
+}
+
+void Logger::writeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        pendingCondition_.wait_for(lock, writeInterval, [this]{
+            return isStopping_ || (isFlushing_ && !pending_.empty()) || pending_.size() >= pendingBytes / 2;
+        });
+
+        if (!pending_.empty())
+        {
+            writing_.swap(pending_);
+            isWriting_ = true;
+            writtenCondition_.notify_all();
+
+            lock.unlock();
+            file_.write(writing_.data(), static_cast<std::streamsize>(writing_.size()));
+            file_.flush();
+            writing_.clear();
+            lock.lock();
+
+            isWriting_ = false;
+        }
+        writtenCondition_.notify_all();
+
+        if (isStopping_ && pending_.empty())
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+// STL
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+/*!
+ * \brief   The Logger class is used to store program messages in a log file.
+ * \details By using the << operator while printInCout is set, the class writes both to
+ *          cout and to file, if the flag is not set, output is written to file only.
+ *
+ *          Messages are kept in memory until the log file is opened, after that a background
+ *          thread appends them to the file as they come. The memory held is bounded: while the
+ *          file is open writers wait for the thread when the pending text is full, before it
+ *          is opened the messages over the bound are dropped and their size is noted in the log.
+ *
+ *          Messages given through debug(), info(), warning() and error() are only formatted
+ *          when their level is at least the level of the log, so disabled messages cost a
+ *          comparison in hot loops. Messages given directly with << are always written.
+ *
+ *          Every thread formats the text given with << into its own line, with its own manipulators,
+ *          and adds it to the log once the line is complete. The lines of concurrent writers therefore
+ *          never interleave, and the precision set by one thread does not leak into another.
+ */
+class Logger
+{
+public:
+    /*!
+     * \brief The levels of the messages, in increasing order.
+     */
+    enum Level
+    {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    /*!
+     * \brief   A message of a level, added to the log when it is destroyed.
+     * \details A message below the level of the log ignores its input.
+     */
+    class Message
+    {
+    public:
+        Message(Logger *log);
+        Message(Message &&other);
+        ~Message();
+
+        template<class T>
+        Message& operator<< (const T &t)
+        {
+            if (stream_)
+            {
+                *stream_ << t;
+            }
+            return *this;
+        }
+
+    private:
+        Logger *log_;                                   /**< The log, or null for an ignored message. */
+        std::unique_ptr<std::ostringstream> stream_;    /**< The text of the message. */
+    };
+
+    /*!
+     * \brief Logger        Contains functionality for printing and displaying log information.
+     * \param printInCout   Flag toggling if operator << also writes to cout.
+     */
+    Logger(bool isPrintingInCout = true);
+
+    /*!
+     *  \brief Destructor, writes the pending messages and closes the log file.
+     */
+    ~Logger();
+
+    /*!
+     * \brief open      Starts writing the log to file, the messages so far first. A file opened before is closed.
+     * \param filePath  Path specifying where to write the log.
+     * \return          False if the file could not be opened, the messages are then still kept in memory.
+     */
+    bool open(const std::string &filePath);
+
+    /*!
+     * \brief print     Writes the log to file and waits until it is written. Opens the file if it is not open yet,
+     *                  following messages are appended to it.
+     * \param filePath  Path specifying where to write the log.
+     */
+    void print(std::string filePath);
+
+    /*!
+     * \brief flush     Waits until the messages so far are written to the open log file.
+     */
+    void flush();
+
+    /*!
+     * \brief isPrintingInCout  Check if console printing flag is set.
+     * \return                  Console printing flag.
+     */
+    bool isPrintingInCout() const;
+
+    /*!
+     * \brief setIsPrintingInCout   Set console printing flag.
+     * \param isPrintingInCout      Value, if true, messages added to the log are also printed in cout.
+     */
+    void setIsPrintingInCout(bool isPrintingInCout);
+
+    /*!
+     * \brief level     The lowest level of the messages written, Info by default.
+     */
+    Level level() const;
+
+    /*!
+     * \brief setLevel  Set the lowest level of the messages written.
+     */
+    void setLevel(Level level);
+
+    /*!
+     * \brief isEnabled True if messages of the level are written.
+     */
+    bool isEnabled(Level level) const { return level >= level_; }
+
+    /*!
+     * \brief parseLevel    Parses "debug", "info", "warning" or "error".
+     * \return              False if the name is none of them.
+     */
+    static bool parseLevel(const std::string &name, Level &level);
+
+    /*!
+     * \brief Messages of the levels, for example log.warning() << "Warning: " << count << " faces skipped.\n";
+     */
+    Message debug() { return Message(isEnabled(Debug) ? this : nullptr); }
+    Message info() { return Message(isEnabled(Info) ? this : nullptr); }
+    Message warning() { return Message(isEnabled(Warning) ? this : nullptr); }
+    Message error() { return Message(isEnabled(Error) ? this : nullptr); }
+
+    /*!
+     *  Operator for printing messages to log and in the standard output stream if desired.
+     */
+    template<class T>
+    friend Logger& operator<< (Logger &log, const T &t)
+    {
+        // The stream of the thread keeps the manipulators given before, as for the precision.
+        ThreadLine &line = log.threadLine();
+        line.format_.str(std::string());
+        line.format_ << t;
+        line.text_ += line.format_.str();
+        log.appendLines(line);
+
+        return log;
+    }
+
+private:
+    /*!
+     * \brief The text given with << by one thread, not added to the log yet.
+     */
+    struct ThreadLine
+    {
+        std::ostringstream format_;     /**< Formats the text, with the manipulators of the thread. */
+        std::string text_;              /**< The incomplete line. */
+    };
+
+    /*!
+     * \brief threadLine    The line of the calling thread for this log.
+     */
+    ThreadLine& threadLine();
+
+    /*!
+     * \brief appendLines   Adds the complete lines of the text of a thread to the log, or all of the text if it is long.
+     */
+    void appendLines(ThreadLine &line);
+
+    /*!
+     * \brief appendThreadLine  Adds the incomplete line of the calling thread to the log.
+     */
+    void appendThreadLine();
+
+    /*!
+     * \brief append    Adds formatted text to the log and prints it in cout if desired.
+     * \param lock      The lock of the mutex, released while waiting for the writer thread.
+     */
+    void append(std::unique_lock<std::mutex> &lock, const std::string &text);
+
+    /*!
+     * \brief close     Writes the pending messages, stops the writer thread and closes the file.
+     */
+    void close();
+
+    /*!
+     * \brief writeLoop The writer thread, appends the pending text to the file.
+     */
+    void writeLoop();
+
+    bool isPrintingInCout_;             /**< If flag is set, log is printed in cout and written to the log. */
+    uint64_t serial_;                   /**< Identifies the log in the lines of the threads, never reused. */
+    Level level_;                       /**< The lowest level of the messages written. */
+
+    std::mutex mutex_;                  /**< Guards the members below. */
+    std::condition_variable pendingCondition_;  /**< Wakes the writer thread. */
+    std::condition_variable writtenCondition_;  /**< Wakes the writers waiting for space, and flush(). */
+    std::string pending_;               /**< The text not written yet. */
+    std::string writing_;               /**< The text written by the writer thread, its capacity is kept. */
+    bool isWriting_;                    /**< True while the writer thread writes. */
+    bool isFlushing_;                   /**< True while flush() waits. */
+    bool isStopping_;                   /**< Stops the writer thread. */
+    size_t droppedBytes_;               /**< The size of the messages dropped before the file was opened. */
+
+    std::ofstream file_;                /**< The log file, written by the writer thread while it runs. */
+    std::thread writer_;                /**< The writer thread, running while the file is open. */
+};
@@ -0,0 +1,422 @@
+#include "BinaryMesh.hpp"
+
+// C++
+#include <fstream>
+#include <cstring>
+#include <vector>
+
+// POSIX
+#include <unistd.h>
+
+namespace
+{
+
+const char magicBytes[8] = { 'O', 'D', 'M', 'M', 'E', 'S', 'H', '\0' };
+const uint32_t formatVersion = 1;
+const uint32_t byteOrderMark = 0x01020304;
+
+uint64_t alignTo8(uint64_t offset)
+{
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+/*!
+ * \brief   Checks that count elements of the given size starting at offset fit in the file.
+ */
+bool fitsInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize)
+{
+    if (offset % 8 != 0 || offset > fileSize) return false;
+    return count <= (fileSize - offset) / elementSize;
+}
+
+void writePadding(std::ofstream &fs, uint64_t &position)
+{
+    static const char zeros[8] = { 0 };
+    uint64_t aligned = alignTo8(position);
+    fs.write(zeros, static_cast<std::streamsize>(aligned - position));
+    position = aligned;
+}
+
+/*!
+ * \brief   The absolute path of a file, with ".", ".." and repeated separators resolved without following links.
+ */
+std::vector<std::string> absolutePath(const std::string &path)
+{
+    std::string full = path;
+    if (full.empty() || full[0] != '/')
+    {
+        std::vector<char> cwd(4096);
+        if (getcwd(cwd.data(), cwd.size()) == nullptr)
+        {
+            throw MeshIOException("Could not resolve the path of " + path + ".");
+        }
+        full = std::string(cwd.data()) + "/" + full;
+    }
+
+    std::vector<std::string> parts;
+    size_t begin = 0;
+    while (begin <= full.size())
+    {
+        size_t end = full.find('/', begin);
+        if (end == std::string::npos) end = full.size();
+        std::string part = full.substr(begin, end - begin);
+        if (part == "..")
+        {
+            if (!parts.empty()) parts.pop_back();
+        }
+        else if (!part.empty() && part != ".")
+        {
+            parts.push_back(part);
+        }
+        begin = end + 1;
+    }
+    return parts;
+}
+
+/*!
+ * \brief   The path of a file relative to the directory of another one, as textureFile resolves it.
+ */
+std::string relativePath(const std::string &path, const std::string &from)
+{
+    std::vector<std::string> target = absolutePath(path);
+    std::vector<std::string> directory = absolutePath(from);
+    directory.pop_back();
+
+    size_t common = 0;
+    while (common < target.size() && common < directory.size() && target[common] == directory[common])
+    {
+        ++common;
+    }
+
+    std::string relative;
+    for (size_t i = common; i < directory.size(); ++i)
+    {
+        relative += "../";
+    }
+    for (size_t i = common; i < target.size(); ++i)
+    {
+        relative += target[i];
+        if (i + 1 < target.size()) relative += "/";
+    }
+    return relative;
+}
+
+template <typename T>
+void writeArray(std::ofstream &fs, uint64_t &position, const std::vector<T> &values)
+{
+    fs.write(reinterpret_cast<const char *>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+    position += values.size() * sizeof(T);
+}
+
+}
+
+BinaryMesh::BinaryMesh(const std::string &filename)
+    : file_(filename), directory_(), header_(nullptr), vertices_(nullptr), faces_(nullptr), texCoords_(nullptr), materials_(nullptr), strings_(nullptr)
+{
+    size_t separator = filename.find_last_of("/\\");
+    if (separator != std::string::npos)
+    {
+        directory_ = filename.substr(0, separator + 1);
+    }
+
+    const char *data = file_.data();
+    uint64_t size = file_.size();
+
+    if (size < sizeof(BinaryMeshHeader) || memcmp(data, magicBytes, sizeof(magicBytes)) != 0)
+    {
+        throw MeshIOException(filename + " is not a binary mesh file.");
+    }
+
+    header_ = reinterpret_cast<const BinaryMeshHeader *>(data);
+    if (header_->byteOrder != byteOrderMark)
+    {
+        throw MeshIOException(filename + " was written with a different byte order.");
+    }
+    if (header_->version != formatVersion)
+    {
+        throw MeshIOException(filename + " has an unsupported binary mesh version.");
+    }
+
+    if (!fitsInFile(header_->verticesOffset, header_->vertexCount, 3 * sizeof(float), size) ||
+        !fitsInFile(header_->facesOffset, header_->faceCount, 3 * sizeof(uint32_t), size) ||
+        !fitsInFile(header_->texCoordsOffset, header_->faceCount, 6 * sizeof(float), size) ||
+        !fitsInFile(header_->materialsOffset, header_->materialCount, sizeof(BinaryMeshMaterial), size) ||
+        !fitsInFile(header_->stringsOffset, header_->stringsSize, 1, size))
+    {
+        throw MeshIOException(filename + " is truncated or corrupt.");
+    }
+
+    vertices_ = reinterpret_cast<const float *>(data + header_->verticesOffset);
+    faces_ = reinterpret_cast<const uint32_t *>(data + header_->facesOffset);
+    texCoords_ = reinterpret_cast<const float *>(data + header_->texCoordsOffset);
+    materials_ = reinterpret_cast<const BinaryMeshMaterial *>(data + header_->materialsOffset);
+    strings_ = data + header_->stringsOffset;
+
+    for (uint64_t m = 0; m < header_->materialCount; ++m)
+    {
+        const BinaryMeshMaterial &material = materials_[m];
+        if (material.faceBegin > header_->faceCount || material.faceCount > header_->faceCount - material.faceBegin ||
+            static_cast<uint64_t>(material.nameOffset) + material.nameLength > header_->stringsSize ||
+            static_cast<uint64_t>(material.textureOffset) + material.textureLength > header_->stringsSize)
+        {
+            throw MeshIOException(filename + " has an invalid material.");
+        }
+    }
+
+    uint64_t vertexCount = header_->vertexCount;
+    for (uint64_t i = 0; i < 3 * header_->faceCount; ++i)
+    {
+        if (faces_[i] >= vertexCount)
+        {
+            throw MeshIOException(filename + " has a face vertex index out of range.");
+        }
+    }
+}
+
+bool BinaryMesh::isBinaryMesh(const std::string &filename)
+{
+    std::ifstream fs(filename.c_str(), std::ios::binary);
+    char magic[sizeof(magicBytes)];
+    if (!fs.read(magic, sizeof(magic)))
+    {
+        return false;
+    }
+    return memcmp(magic, magicBytes, sizeof(magicBytes)) == 0;
+}
+
+BinaryMeshFaces BinaryMesh::materialFaces(size_t m) const
+{
+    BinaryMeshFaces faces;
+    faces.indices = faces_ + 3 * materials_[m].faceBegin;
+    faces.texCoords = texCoords_ + 6 * materials_[m].faceBegin;
+    faces.count = static_cast<size_t>(materials_[m].faceCount);
+    return faces;
+}
+
+std::string BinaryMesh::materialName(size_t m) const
+{
+    return std::string(strings_ + materials_[m].nameOffset, materials_[m].nameLength);
+}
+
+std::string BinaryMesh::textureFile(size_t m) const
+{
+    std::string texture(strings_ + materials_[m].textureOffset, materials_[m].textureLength);
+    if (texture.empty() || texture[0] == '/')
+    {
+        return texture;
+    }
+    return directory_ + texture;
+}
+
+pcl::TexMaterial BinaryMesh::texMaterial(size_t m) const
+{
+    const BinaryMeshMaterial &source = materials_[m];
+
+    pcl::TexMaterial material;
+    material.tex_name = materialName(m);
+    material.tex_file = textureFile(m);
+    material.tex_Ka.r = source.ambient[0]; material.tex_Ka.g = source.ambient[1]; material.tex_Ka.b = source.ambient[2];
+    material.tex_Kd.r = source.diffuse[0]; material.tex_Kd.g = source.diffuse[1]; material.tex_Kd.b = source.diffuse[2];
+    material.tex_Ks.r = source.specular[0]; material.tex_Ks.g = source.specular[1]; material.tex_Ks.b = source.specular[2];
+    material.tex_d = source.transparency;
+    material.tex_Ns = source.shininess;
+    material.tex_illum = source.illumination;
+    return material;
+}
+
+void BinaryMesh::toTextureMesh(pcl::TextureMesh &mesh) const
+{
+    uint64_t vertexCount = header_->vertexCount;
+    uint64_t faceCount = header_->faceCount;
+
+    // The vertices are stored exactly like a cloud with the fields x, y and z.
+    pcl::PCLPointCloud2 &cloud = mesh.cloud;
+    cloud.fields.clear();
+    const char *fieldNames[3] = { "x", "y", "z" };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        pcl::PCLPointField field;
+        field.name = fieldNames[i];
+        field.offset = 4 * i;
+        field.datatype = pcl::PCLPointField::FLOAT32;
+        field.count = 1;
+        cloud.fields.push_back(field);
+    }
+    cloud.point_step = 12;
+    cloud.width = static_cast<uint32_t>(vertexCount);
+    cloud.height = 1;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = true;
+    cloud.data.resize(static_cast<size_t>(vertexCount) * cloud.point_step);
+    memcpy(cloud.data.data(), vertices_, cloud.data.size());
+
+    mesh.tex_polygons.clear();
+    mesh.tex_materials.clear();
+    mesh.tex_coordinates.clear();
+
+    for (size_t m = 0; m < materialCount(); ++m)
+    {
+        mesh.tex_materials.push_back(texMaterial(m));
+
+        BinaryMeshFaces faces = materialFaces(m);
+        mesh.tex_polygons.push_back(std::vector<pcl::Vertices>(faces.count));
+        std::vector<pcl::Vertices> &polygons = mesh.tex_polygons.back();
+        for (size_t f = 0; f < faces.count; ++f)
+        {
+            polygons[f].vertices.assign(faces.indices + 3 * f, faces.indices + 3 * f + 3);
+        }
+    }
+
+    mesh.tex_coordinates.push_back(std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >());
+    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > &coordinates = mesh.tex_coordinates.back();
+    coordinates.reserve(static_cast<size_t>(3 * faceCount));
+    for (uint64_t i = 0; i < 3 * faceCount; ++i)
+    {
+        coordinates.push_back(Eigen::Vector2f(texCoords_[2 * i], texCoords_[2 * i + 1]));
+    }
+}
+
+void BinaryMesh::write(const std::string &filename, const pcl::TextureMesh &mesh)
+{
+    const pcl::PCLPointCloud2 &cloud = mesh.cloud;
+    uint64_t vertexCount = static_cast<uint64_t>(cloud.width) * cloud.height;
+
+    // Locate the coordinates in the cloud.
+    int xyzOffsets[3] = { -1, -1, -1 };
+    const char *fieldNames[3] = { "x", "y", "z" };
+    for (size_t d = 0; d < cloud.fields.size(); ++d)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            if (cloud.fields[d].name == fieldNames[i] && cloud.fields[d].datatype == pcl::PCLPointField::FLOAT32)
+            {
+                xyzOffsets[i] = static_cast<int>(cloud.fields[d].offset);
+            }
+        }
+    }
+    if (xyzOffsets[0] < 0 || xyzOffsets[1] < 0 || xyzOffsets[2] < 0 || cloud.data.size() < vertexCount * cloud.point_step)
+    {
+        throw MeshIOException("Input point cloud has no XYZ data!");
+    }
+
+    std::vector<float> vertices(static_cast<size_t>(3 * vertexCount));
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            memcpy(&vertices[3 * i + static_cast<size_t>(c)], &cloud.data[i * cloud.point_step + static_cast<size_t>(xyzOffsets[c])], sizeof(float));
+        }
+    }
+
+    // All texture coordinates, as saveOBJFile numbers them.
+    std::vector<const Eigen::Vector2f *> sourceTexCoords;
+    for (size_t t = 0; t < mesh.tex_coordinates.size(); ++t)
+    {
+        for (size_t i = 0; i < mesh.tex_coordinates[t].size(); ++i)
+        {
+            sourceTexCoords.push_back(&mesh.tex_coordinates[t][i]);
+        }
+    }
+
+    std::vector<uint32_t> faces;
+    std::vector<float> texCoords;
+    std::vector<BinaryMeshMaterial> materials;
+    std::string strings;
+
+    for (size_t m = 0; m < mesh.tex_polygons.size(); ++m)
+    {
+        BinaryMeshMaterial material;
+        memset(&material, 0, sizeof(material));
+        material.faceBegin = faces.size() / 3;
+        material.faceCount = mesh.tex_polygons[m].size();
+
+        if (m < mesh.tex_materials.size())
+        {
+            const pcl::TexMaterial &source = mesh.tex_materials[m];
+            material.nameOffset = static_cast<uint32_t>(strings.size());
+            material.nameLength = static_cast<uint32_t>(source.tex_name.size());
+            strings += source.tex_name;
+            // The reader resolves a relative texture against the directory of the mesh file, not the working directory.
+            std::string texture = source.tex_file;
+            if (!texture.empty() && texture[0] != '/')
+            {
+                texture = relativePath(texture, filename);
+            }
+            material.textureOffset = static_cast<uint32_t>(strings.size());
+            material.textureLength = static_cast<uint32_t>(texture.size());
+            strings += texture;
+            material.ambient[0] = source.tex_Ka.r; material.ambient[1] = source.tex_Ka.g; material.ambient[2] = source.tex_Ka.b;
+            material.diffuse[0] = source.tex_Kd.r; material.diffuse[1] = source.tex_Kd.g; material.diffuse[2] = source.tex_Kd.b;
+            material.specular[0] = source.tex_Ks.r; material.specular[1] = source.tex_Ks.g; material.specular[2] = source.tex_Ks.b;
+            material.transparency = source.tex_d;
+            material.shininess = source.tex_Ns;
+            material.illumination = source.tex_illum;
+        }
+        materials.push_back(material);
+
+        for (size_t i = 0; i < mesh.tex_polygons[m].size(); ++i)
+        {
+            const std::vector<uint32_t> &vertexIndices = mesh.tex_polygons[m][i].vertices;
+            if (vertexIndices.size() != 3)
+            {
+                throw MeshIOException("Binary meshes can only hold triangles.");
+            }
+
+            size_t corner = faces.size();
+            for (size_t j = 0; j < 3; ++j)
+            {
+                faces.push_back(vertexIndices[j]);
+                if (corner + j < sourceTexCoords.size())
+                {
+                    texCoords.push_back((*sourceTexCoords[corner + j])[0]);
+                    texCoords.push_back((*sourceTexCoords[corner + j])[1]);
+                }
+                else
+                {
+                    texCoords.push_back(0.0f);
+                    texCoords.push_back(0.0f);
+                }
+            }
+        }
+    }
+
+    BinaryMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magicBytes, sizeof(magicBytes));
+    header.version = formatVersion;
+    header.byteOrder = byteOrderMark;
+    header.vertexCount = vertexCount;
+    header.faceCount = faces.size() / 3;
+    header.materialCount = materials.size();
+    header.verticesOffset = alignTo8(sizeof(BinaryMeshHeader));
+    header.facesOffset = alignTo8(header.verticesOffset + vertices.size() * sizeof(float));
+    header.texCoordsOffset = alignTo8(header.facesOffset + faces.size() * sizeof(uint32_t));
+    header.materialsOffset = alignTo8(header.texCoordsOffset + texCoords.size() * sizeof(float));
+    header.stringsOffset = alignTo8(header.materialsOffset + materials.size() * sizeof(BinaryMeshMaterial));
+    header.stringsSize = strings.size();
+
+    std::ofstream fs(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!fs.is_open())
+    {
+        throw MeshIOException("Could not open " + filename + " for writing.");
+    }
+
+    uint64_t position = sizeof(BinaryMeshHeader);
+    fs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    writePadding(fs, position);
+    writeArray(fs, position, vertices);
+    writePadding(fs, position);
+    writeArray(fs, position, faces);
+    writePadding(fs, position);
+    writeArray(fs, position, texCoords);
+    writePadding(fs, position);
+    writeArray(fs, position, materials);
+    writePadding(fs, position);
+    fs.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+    fs.close();
+    if (fs.fail())
+    {
+        throw MeshIOException("Could not write " + filename + ".");
+    }
+}
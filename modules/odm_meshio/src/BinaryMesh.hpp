@@ -0,0 +1,146 @@
+#pragma once
+
+// C++
+#include <string>
+#include <cstdint>
+
+// PCL
+#include <pcl/TextureMesh.h>
+
+// Mesh IO
+#include "MappedFile.hpp"
+
+/*!
+ * \brief   The header at the start of a binary mesh file.
+ * \details A binary mesh file holds a triangle mesh with one texture coordinate per face corner,
+ *          laid out so that it can be memory mapped and used as is:
+ *          - the header,
+ *          - vertexCount vertices, as float x, y, z,
+ *          - faceCount faces, as uint32 vertex indices v1, v2, v3,
+ *          - 3*faceCount texture coordinates, as float u, v, in face order,
+ *          - materialCount BinaryMeshMaterial, each one covering a range of consecutive faces,
+ *          - the strings referenced by the materials.
+ *          All sections start at a multiple of 8 bytes and are stored in the byte order of the writer,
+ *          which the reader checks against byteOrder.
+ */
+struct BinaryMeshHeader
+{
+    char magic[8];              /**< "ODMMESH" followed by a null byte. */
+    uint32_t version;           /**< The format version. */
+    uint32_t byteOrder;         /**< 0x01020304 in the byte order of the file. */
+    uint64_t vertexCount;       /**< The number of vertices. */
+    uint64_t faceCount;         /**< The number of triangles. */
+    uint64_t materialCount;     /**< The number of materials. */
+    uint64_t verticesOffset;    /**< File offset of the vertices. */
+    uint64_t facesOffset;       /**< File offset of the faces. */
+    uint64_t texCoordsOffset;   /**< File offset of the texture coordinates. */
+    uint64_t materialsOffset;   /**< File offset of the materials. */
+    uint64_t stringsOffset;     /**< File offset of the strings. */
+    uint64_t stringsSize;       /**< The size of the strings in bytes. */
+};
+
+/*!
+ * \brief   A material of a binary mesh file, and the faces using it.
+ */
+struct BinaryMeshMaterial
+{
+    uint64_t faceBegin;         /**< The first face of the material. */
+    uint64_t faceCount;         /**< The number of faces of the material. */
+    uint32_t nameOffset;        /**< Offset of the material name in the strings. */
+    uint32_t nameLength;        /**< Length of the material name. */
+    uint32_t textureOffset;     /**< Offset of the texture file in the strings. */
+    uint32_t textureLength;     /**< Length of the texture file, relative to the directory of the mesh file unless absolute. */
+    float ambient[3];           /**< Ka */
+    float diffuse[3];           /**< Kd */
+    float specular[3];          /**< Ks */
+    float transparency;         /**< d */
+    float shininess;            /**< Ns */
+    int32_t illumination;       /**< illum */
+};
+
+/*!
+ * \brief   A view onto the faces of a material in a binary mesh file, with their texture coordinates.
+ */
+struct BinaryMeshFaces
+{
+    const uint32_t *indices;    /**< The vertex indices, three per face. */
+    const float *texCoords;     /**< The texture coordinates, u and v per face corner. */
+    size_t count;               /**< The number of faces. */
+};
+
+/*!
+ * \brief   The BinaryMesh class gives access to a memory mapped binary mesh file.
+ *          The arrays point into the mapping and stay valid as long as the object.
+ */
+class BinaryMesh
+{
+public:
+    /*!
+     * \brief BinaryMesh    Maps and validates the file, throws a MeshIOException if it is not a valid binary mesh.
+     *                      The vertex indices of all faces are checked, so that the views can be used without checks.
+     * \param filename      Path to the binary mesh file.
+     */
+    explicit BinaryMesh(const std::string &filename);
+
+    /*!
+     * \brief isBinaryMesh  Checks whether the file starts like a binary mesh file.
+     */
+    static bool isBinaryMesh(const std::string &filename);
+
+    /*!
+     * \brief write         Writes a textured mesh as a binary mesh file, throws a MeshIOException on failure.
+     * \details             The faces must be triangles. Texture coordinates are taken per face corner from the concatenated
+     *                      tex_coordinates, as saveOBJFile in odm_georef writes them, and are (0, 0) where there are none.
+     *                      Relative texture files, taken against the working directory, are stored relative to the directory
+     *                      of filename; absolute ones are stored as is.
+     * \param filename      Path to the binary mesh file.
+     * \param mesh          The model.
+     */
+    static void write(const std::string &filename, const pcl::TextureMesh &mesh);
+
+    const BinaryMeshHeader& header() const { return *header_; }
+
+    const float* vertices() const { return vertices_; }
+    const uint32_t* faces() const { return faces_; }
+    const float* texCoords() const { return texCoords_; }
+    const BinaryMeshMaterial& material(size_t m) const { return materials_[m]; }
+
+    size_t vertexCount() const { return static_cast<size_t>(header_->vertexCount); }
+    size_t faceCount() const { return static_cast<size_t>(header_->faceCount); }
+    size_t materialCount() const { return static_cast<size_t>(header_->materialCount); }
+
+    /*!
+     * \brief materialFaces The faces of a material and their texture coordinates, in the mapping.
+     */
+    BinaryMeshFaces materialFaces(size_t m) const;
+
+    std::string materialName(size_t m) const;
+
+    /*!
+     * \brief textureFile   The texture file of a material, with relative paths resolved against the directory of the mesh file.
+     */
+    std::string textureFile(size_t m) const;
+
+    /*!
+     * \brief texMaterial   A material with its name and resolved texture file, as a pcl::TexMaterial.
+     */
+    pcl::TexMaterial texMaterial(size_t m) const;
+
+    /*!
+     * \brief toTextureMesh Copies the model into a pcl::TextureMesh with one submesh per material and the texture
+     *                      coordinates per face corner in tex_coordinates[0], like ObjReader does for such models.
+     *                      Only for callers that need the model in PCL, the others should use the views.
+     */
+    void toTextureMesh(pcl::TextureMesh &mesh) const;
+
+private:
+    MappedFile file_;                       /**< The mapped file. */
+    std::string directory_;                 /**< The directory of the file, with a trailing separator. */
+
+    const BinaryMeshHeader *header_;        /**< The header in the mapping. */
+    const float *vertices_;                 /**< The vertices in the mapping. */
+    const uint32_t *faces_;                 /**< The faces in the mapping. */
+    const float *texCoords_;                /**< The texture coordinates in the mapping. */
+    const BinaryMeshMaterial *materials_;   /**< The materials in the mapping. */
+    const char *strings_;                   /**< The strings in the mapping. */
+};
@@ -0,0 +1,50 @@
+#include "MappedFile.hpp"
+
+// POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile(const std::string &filename)
+    : data_(nullptr), size_(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw MeshIOException("Could not open " + filename);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw MeshIOException("Could not stat " + filename);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+
+    if (size_ > 0)
+    {
+        void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            close(fd);
+            throw MeshIOException("Could not map " + filename + " into memory");
+        }
+
+        // The file is read front to back.
+        madvise(addr, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(addr);
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_ != nullptr)
+    {
+        munmap(const_cast<char *>(data_), size_);
+    }
+}
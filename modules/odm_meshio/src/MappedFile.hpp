@@ -0,0 +1,54 @@
+#pragma once
+
+// C++
+#include <string>
+#include <cstddef>
+#include <exception>
+
+/*!
+ * \brief   The MappedFile class maps a whole file read-only into memory.
+ * \details The mapping is released when the object is destroyed.
+ */
+class MappedFile
+{
+public:
+    /*!
+     * \brief MappedFile    Maps the file, throws a MeshIOException if it cannot be opened or mapped.
+     * \param filename      Path of the file.
+     */
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    /*!
+     * \brief data  The first byte of the file, nullptr for an empty file.
+     */
+    const char* data() const { return data_; }
+
+    /*!
+     * \brief size  The size of the file in bytes.
+     */
+    size_t size() const { return size_; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile& operator=(const MappedFile &);
+
+    const char *data_;  /**< Start of the mapping. */
+    size_t size_;       /**< Length of the mapping. */
+};
+
+/*!
+ * \brief The MeshIOException class
+ */
+class MeshIOException : public std::exception
+{
+
+public:
+    MeshIOException() : message("Error in mesh IO") {}
+    MeshIOException(std::string msgInit) : message("Error in mesh IO:\n" + msgInit) {}
+    ~MeshIOException() throw() {}
+    virtual const char* what() const throw() {return message.c_str(); }
+
+private:
+    std::string message;    /**< The error message **/
+};
@@ -0,0 +1,184 @@
+#pragma once
+
+// C++
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+/*!
+ * \brief   Parsers for numbers in text meshes, working directly on a character range.
+ * \details Every parser reads one token starting at p, which must end at 'end' or at
+ *          a blank, and advances p past it. They return false if the token is not a
+ *          number, mirroring boost::lexical_cast which they replace.
+ */
+namespace NumberParsing
+{
+
+/*!
+ * \brief isBlank   True for the characters separating tokens on a line.
+ */
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/*!
+ * \brief parseFloatSlow    Parses a token with strtof, used for everything the fast path does not handle.
+ */
+inline bool parseFloatSlow(const char *&p, const char *end, float &value)
+{
+    const char *tokenEnd = p;
+    while (tokenEnd != end && !isBlank(*tokenEnd) && *tokenEnd != '\n') ++tokenEnd;
+
+    size_t length = static_cast<size_t>(tokenEnd - p);
+    char buffer[128];
+    if (length == 0 || length >= sizeof(buffer)) return false;
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+
+    char *parsedEnd = nullptr;
+    value = strtof(buffer, &parsedEnd);
+    if (parsedEnd != buffer + length) return false;
+
+    p = tokenEnd;
+    return true;
+}
+
+/*!
+ * \brief parseFloat    Parses a decimal float, correctly rounded.
+ * \details Mantissas of up to 19 digits with a small decimal exponent are converted
+ *          exactly in double precision and then rounded to float. The one case where this
+ *          double rounding could differ from rounding the decimal value directly, a double
+ *          exactly halfway between two floats, goes through strtof, as does anything else
+ *          (long mantissas, large exponents, nan, inf).
+ */
+inline bool parseFloat(const char *&p, const char *end, float &value)
+{
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char *q = p;
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+'))
+    {
+        negative = *q == '-';
+        ++q;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+
+    // Leading zeros do not count towards the 19 digit limit.
+    while (q != end && *q == '0') { ++q; anyDigit = true; }
+    while (q != end && *q >= '0' && *q <= '9')
+    {
+        if (digits < 19) mantissa = mantissa * 10 + static_cast<uint64_t>(*q - '0');
+        else ++exponent;
+        ++digits;
+        ++q;
+        anyDigit = true;
+    }
+    if (q != end && *q == '.')
+    {
+        ++q;
+        if (digits == 0)
+        {
+            while (q != end && *q == '0') { ++q; --exponent; anyDigit = true; }
+        }
+        while (q != end && *q >= '0' && *q <= '9')
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*q - '0');
+                --exponent;
+            }
+            ++digits;
+            ++q;
+            anyDigit = true;
+        }
+    }
+    if (!anyDigit) return parseFloatSlow(p, end, value);
+
+    if (q != end && (*q == 'e' || *q == 'E'))
+    {
+        const char *e = q + 1;
+        bool negativeExponent = false;
+        if (e != end && (*e == '-' || *e == '+'))
+        {
+            negativeExponent = *e == '-';
+            ++e;
+        }
+        if (e == end || *e < '0' || *e > '9') return parseFloatSlow(p, end, value);
+
+        int exp = 0;
+        while (e != end && *e >= '0' && *e <= '9')
+        {
+            if (exp < 10000) exp = exp * 10 + (*e - '0');
+            ++e;
+        }
+        exponent += negativeExponent ? -exp : exp;
+        q = e;
+    }
+
+    // The token must end here.
+    if (q != end && !isBlank(*q) && *q != '\n') return false;
+
+    if (digits > 19 || mantissa > (static_cast<uint64_t>(1) << 53) || exponent < -22 || exponent > 22)
+    {
+        return parseFloatSlow(p, end, value);
+    }
+
+    double d = static_cast<double>(mantissa);
+    if (exponent < 0) d /= powersOf10[-exponent];
+    else d *= powersOf10[exponent];
+
+    float f = static_cast<float>(d);
+    if (std::isinf(f)) return parseFloatSlow(p, end, value);
+    if (static_cast<double>(f) != d)
+    {
+        // Exactly between two floats: the double rounding may be wrong.
+        float other = std::nextafter(f, static_cast<double>(f) < d ? INFINITY : -INFINITY);
+        if ((static_cast<double>(f) + static_cast<double>(other)) / 2.0 == d)
+        {
+            return parseFloatSlow(p, end, value);
+        }
+    }
+
+    value = negative ? -f : f;
+    p = q;
+    return true;
+}
+
+/*!
+ * \brief parseInt  Parses a decimal integer with an optional sign, like sscanf's %d.
+ *                  Unlike the float parser, the integer may be followed by any character.
+ */
+inline bool parseInt(const char *&p, const char *end, long long &value)
+{
+    const char *q = p;
+    bool negative = false;
+    if (q != end && (*q == '-' || *q == '+'))
+    {
+        negative = *q == '-';
+        ++q;
+    }
+    if (q == end || *q < '0' || *q > '9') return false;
+
+    long long v = 0;
+    while (q != end && *q >= '0' && *q <= '9')
+    {
+        if (v < (1LL << 40)) v = v * 10 + (*q - '0');
+        ++q;
+    }
+
+    value = negative ? -v : v;
+    p = q;
+    return true;
+}
+
+}
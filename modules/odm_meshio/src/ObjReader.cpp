@@ -0,0 +1,551 @@
+#include "ObjReader.hpp"
+#include "NumberParsing.hpp"
+
+// C++
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+
+using NumberParsing::isBlank;
+using NumberParsing::parseFloat;
+using NumberParsing::parseInt;
+
+namespace
+{
+
+const uint32_t noIndex = std::numeric_limits<uint32_t>::max();
+
+/*!
+ * \brief   A usemtl line, with the number of faces and texture coordinates of its chunk read before it.
+ */
+struct MaterialUse
+{
+    std::string name;
+    size_t face;
+    size_t texCoord;
+};
+
+/*!
+ * \brief   The elements read from one chunk of the file, with indices resolved as far as
+ *          possible without knowing what the previous chunks contain.
+ */
+struct ObjChunk
+{
+    const char *begin;
+    const char *end;
+
+    std::vector<float> vertices;            /**< x, y, z per vertex. */
+    std::vector<float> normals;             /**< x, y, z per normal. */
+    std::vector<float> texCoords;           /**< u, v per texture coordinate. */
+
+    std::vector<uint32_t> corners;          /**< Vertex index of every face corner. */
+    std::vector<uint32_t> faceSizes;        /**< Number of corners of every face. */
+    std::vector<uint32_t> faceTexCoords;    /**< Texture coordinate index of the first three corners of every face. */
+
+    /*!
+     * Negative (relative) indices are stored as an offset from the first vertex or texture
+     * coordinate of the chunk, and listed here to be fixed up once that is known.
+     */
+    std::vector<size_t> relativeCorners;
+    std::vector<size_t> relativeTexCoords;
+
+    std::vector<MaterialUse> materials;     /**< The usemtl lines. */
+    std::vector<std::string> libraries;     /**< The mtllib lines. */
+
+    std::string error;                      /**< Set if the chunk could not be parsed. */
+};
+
+/*!
+ * \brief   Returns the token starting at p (after skipping blanks) and moves p past it.
+ */
+inline void nextToken(const char *&p, const char *end, const char *&tokenBegin, const char *&tokenEnd)
+{
+    while (p != end && isBlank(*p)) ++p;
+    tokenBegin = p;
+    while (p != end && !isBlank(*p) && *p != '\n') ++p;
+    tokenEnd = p;
+}
+
+inline bool isToken(const char *tokenBegin, const char *tokenEnd, const char *keyword)
+{
+    size_t length = strlen(keyword);
+    return static_cast<size_t>(tokenEnd - tokenBegin) == length && memcmp(tokenBegin, keyword, length) == 0;
+}
+
+/*!
+ * \brief   Parses count floats into values, and the optional ones up to maxCount (left as 0 when missing).
+ */
+bool parseFloats(const char *&p, const char *end, int count, int maxCount, float *values)
+{
+    for (int i = 0; i < maxCount; ++i)
+    {
+        values[i] = 0.0f;
+        while (p != end && isBlank(*p)) ++p;
+        if (p == end || *p == '\n')
+        {
+            if (i < count) return false;
+            continue;
+        }
+        if (!parseFloat(p, end, values[i])) return false;
+    }
+    return true;
+}
+
+std::string lineAt(const char *p, const char *end)
+{
+    const char *lineEnd = p;
+    while (lineEnd != end && *lineEnd != '\n' && *lineEnd != '\r') ++lineEnd;
+    return std::string(p, lineEnd);
+}
+
+void parseChunk(ObjChunk &chunk)
+{
+    const char *p = chunk.begin;
+    const char *end = chunk.end;
+    const char *tokenBegin, *tokenEnd;
+
+    while (p != end)
+    {
+        const char *lineBegin = p;
+        nextToken(p, end, tokenBegin, tokenEnd);
+
+        if (tokenBegin == tokenEnd)
+        {
+            // Empty line
+        }
+        // Vertex
+        else if (isToken(tokenBegin, tokenEnd, "v"))
+        {
+            float values[3];
+            if (!parseFloats(p, end, 3, 3, values))
+            {
+                chunk.error = "Unable to convert '" + lineAt(lineBegin, end) + "' to vertex coordinates!";
+                return;
+            }
+            chunk.vertices.insert(chunk.vertices.end(), values, values + 3);
+        }
+        // Vertex normal
+        else if (isToken(tokenBegin, tokenEnd, "vn"))
+        {
+            float values[3];
+            if (!parseFloats(p, end, 3, 3, values))
+            {
+                chunk.error = "Unable to convert '" + lineAt(lineBegin, end) + "' to vertex normal!";
+                return;
+            }
+            chunk.normals.insert(chunk.normals.end(), values, values + 3);
+        }
+        // Texture coordinates
+        else if (isToken(tokenBegin, tokenEnd, "vt"))
+        {
+            float c[3];
+            if (!parseFloats(p, end, 0, 3, c))
+            {
+                chunk.error = "Unable to convert '" + lineAt(lineBegin, end) + "' to vertex texture coordinates!";
+                return;
+            }
+            if (c[2] == 0)
+            {
+                chunk.texCoords.push_back(c[0]);
+                chunk.texCoords.push_back(c[1]);
+            }
+            else
+            {
+                chunk.texCoords.push_back(c[0] / c[2]);
+                chunk.texCoords.push_back(c[1] / c[2]);
+            }
+        }
+        // Face
+        else if (isToken(tokenBegin, tokenEnd, "f"))
+        {
+            uint32_t size = 0;
+            uint32_t texCoords[3] = { noIndex, noIndex, noIndex };
+            long long localVertices = static_cast<long long>(chunk.vertices.size() / 3);
+            long long localTexCoords = static_cast<long long>(chunk.texCoords.size() / 2);
+
+            for (;;)
+            {
+                nextToken(p, end, tokenBegin, tokenEnd);
+                if (tokenBegin == tokenEnd) break;
+
+                const char *q = tokenBegin;
+                long long v;
+                if (!parseInt(q, tokenEnd, v) || v == 0)
+                {
+                    chunk.error = "Unable to convert '" + lineAt(lineBegin, end) + "' to a face!";
+                    return;
+                }
+                if (v < 0)
+                {
+                    chunk.relativeCorners.push_back(chunk.corners.size());
+                    v = localVertices + v;
+                }
+                else
+                {
+                    v = v - 1;
+                }
+                chunk.corners.push_back(static_cast<uint32_t>(v));
+
+                long long vt;
+                if (q != tokenEnd && *q == '/' && parseInt(++q, tokenEnd, vt) && size < 3 && vt != 0)
+                {
+                    if (vt < 0)
+                    {
+                        chunk.relativeTexCoords.push_back(chunk.faceTexCoords.size() + size);
+                        vt = localTexCoords + vt;
+                    }
+                    else
+                    {
+                        vt = vt - 1;
+                    }
+                    texCoords[size] = static_cast<uint32_t>(vt);
+                }
+                ++size;
+            }
+
+            chunk.faceSizes.push_back(size);
+            chunk.faceTexCoords.insert(chunk.faceTexCoords.end(), texCoords, texCoords + 3);
+        }
+        // Material
+        else if (isToken(tokenBegin, tokenEnd, "usemtl"))
+        {
+            MaterialUse use;
+            nextToken(p, end, tokenBegin, tokenEnd);
+            use.name.assign(tokenBegin, tokenEnd);
+            use.face = chunk.faceSizes.size();
+            use.texCoord = chunk.texCoords.size() / 2;
+            chunk.materials.push_back(use);
+        }
+        // Material library
+        else if (isToken(tokenBegin, tokenEnd, "mtllib"))
+        {
+            nextToken(p, end, tokenBegin, tokenEnd);
+            if (tokenBegin != tokenEnd)
+            {
+                chunk.libraries.push_back(std::string(tokenBegin, tokenEnd));
+            }
+        }
+
+        // Skip the rest of the line (comments, unknown elements, extra values).
+        const char *newline = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        p = newline ? newline + 1 : end;
+    }
+}
+
+/*!
+ * \brief   Runs func(i) for i in [0, count) on up to count threads, one index each.
+ */
+template <typename Func>
+void runParallel(size_t count, Func func)
+{
+    if (count <= 1)
+    {
+        if (count == 1) func(0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        threads.push_back(std::thread(func, i));
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        threads[i].join();
+    }
+}
+
+}
+
+ObjReader::ObjReader()
+    : threads_(0)
+{
+}
+
+void ObjReader::setThreads(int threads)
+{
+    threads_ = std::max(threads, 0);
+}
+
+const std::vector<std::string>& ObjReader::getWarnings() const
+{
+    return warnings_;
+}
+
+void ObjReader::read(const std::string &filename, pcl::TextureMesh &mesh, std::vector<pcl::MTLReader> &companions)
+{
+    warnings_.clear();
+
+    MappedFile file(filename);
+    const char *data = file.data();
+    const char *dataEnd = data + file.size();
+
+    // Split the file into chunks at line boundaries. Chunks smaller than
+    // a few megabytes are not worth a thread.
+    size_t numChunks = threads_ > 0 ? static_cast<size_t>(threads_) : std::max(1u, std::thread::hardware_concurrency());
+    numChunks = std::max(static_cast<size_t>(1), std::min(numChunks, file.size() / (4 * 1024 * 1024)));
+
+    std::vector<ObjChunk> chunks(numChunks);
+    const char *chunkBegin = data;
+    for (size_t c = 0; c < numChunks; ++c)
+    {
+        const char *chunkEnd = c + 1 == numChunks ? dataEnd : data + file.size() / numChunks * (c + 1);
+        if (chunkEnd < chunkBegin) chunkEnd = chunkBegin;
+        if (chunkEnd != dataEnd)
+        {
+            const char *newline = static_cast<const char *>(memchr(chunkEnd, '\n', static_cast<size_t>(dataEnd - chunkEnd)));
+            chunkEnd = newline ? newline + 1 : dataEnd;
+        }
+        chunks[c].begin = chunkBegin;
+        chunks[c].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    runParallel(numChunks, [&chunks](size_t c){
+        try
+        {
+            parseChunk(chunks[c]);
+        }
+        catch (const std::bad_alloc &)
+        {
+            chunks[c].error = "Out of memory";
+        }
+    });
+
+    // Where each chunk starts in the whole file.
+    std::vector<size_t> vertexBase(numChunks + 1, 0), normalBase(numChunks + 1, 0), texCoordBase(numChunks + 1, 0), faceBase(numChunks + 1, 0);
+    for (size_t c = 0; c < numChunks; ++c)
+    {
+        if (!chunks[c].error.empty())
+        {
+            throw MeshIOException("Unable to read " + filename + ": " + chunks[c].error);
+        }
+        vertexBase[c + 1] = vertexBase[c] + chunks[c].vertices.size() / 3;
+        normalBase[c + 1] = normalBase[c] + chunks[c].normals.size() / 3;
+        texCoordBase[c + 1] = texCoordBase[c] + chunks[c].texCoords.size() / 2;
+        faceBase[c + 1] = faceBase[c] + chunks[c].faceSizes.size();
+    }
+    size_t numVertices = vertexBase[numChunks];
+    size_t numNormals = normalBase[numChunks];
+    size_t numTexCoords = texCoordBase[numChunks];
+
+    if (numVertices == 0)
+    {
+        throw MeshIOException("No vertices found in " + filename);
+    }
+
+    // Material libraries, in file order.
+    for (size_t c = 0; c < numChunks; ++c)
+    {
+        for (size_t i = 0; i < chunks[c].libraries.size(); ++i)
+        {
+            pcl::MTLReader companion;
+            if (companion.read(filename, chunks[c].libraries[i]))
+            {
+                warnings_.push_back("Problem reading material file " + chunks[c].libraries[i] + ".");
+            }
+            companions.push_back(companion);
+        }
+    }
+
+    // The cloud layout.
+    pcl::PCLPointCloud2 &cloud = mesh.cloud;
+    cloud.fields.clear();
+    const char *fieldNames[6] = { "x", "y", "z", "normal_x", "normal_y", "normal_z" };
+    int numFields = numNormals > 0 ? 6 : 3;
+    for (int i = 0; i < numFields; ++i)
+    {
+        pcl::PCLPointField field;
+        field.name = fieldNames[i];
+        field.offset = static_cast<uint32_t>(4 * i);
+        field.datatype = pcl::PCLPointField::FLOAT32;
+        field.count = 1;
+        cloud.fields.push_back(field);
+    }
+    cloud.point_step = static_cast<uint32_t>(4 * numFields);
+    cloud.width = static_cast<uint32_t>(numVertices);
+    cloud.height = 1;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = true;
+    cloud.data.assign(static_cast<size_t>(cloud.point_step) * numVertices, 0);
+
+    // Submeshes: every usemtl starts one, faces found before the first usemtl go to an unnamed one.
+    mesh.tex_polygons.clear();
+    mesh.tex_materials.clear();
+    mesh.tex_coordinates.clear();
+
+    // Where the faces of each chunk go, as (submesh, first face in chunk, end face in chunk, first face in submesh).
+    struct Segment { size_t submesh, begin, end, target; };
+    std::vector<std::vector<Segment> > segments(numChunks);
+    std::vector<size_t> submeshSizes;
+    size_t texCoordMark = 0;
+
+    for (size_t c = 0; c < numChunks; ++c)
+    {
+        const ObjChunk &chunk = chunks[c];
+        size_t faceStart = 0;
+        for (size_t m = 0; m <= chunk.materials.size(); ++m)
+        {
+            size_t faceEnd = m < chunk.materials.size() ? chunk.materials[m].face : chunk.faceSizes.size();
+            if (faceEnd > faceStart)
+            {
+                if (submeshSizes.empty())
+                {
+                    mesh.tex_polygons.push_back(std::vector<pcl::Vertices>());
+                    mesh.tex_materials.push_back(pcl::TexMaterial());
+                    submeshSizes.push_back(0);
+                    warnings_.push_back("Faces found before the first usemtl in " + filename + ".");
+                }
+                Segment s = { submeshSizes.size() - 1, faceStart, faceEnd, submeshSizes.back() };
+                segments[c].push_back(s);
+                submeshSizes.back() += faceEnd - faceStart;
+            }
+            faceStart = faceEnd;
+
+            if (m < chunk.materials.size())
+            {
+                const std::string &name = chunk.materials[m].name;
+                mesh.tex_polygons.push_back(std::vector<pcl::Vertices>());
+                mesh.tex_materials.push_back(pcl::TexMaterial());
+                submeshSizes.push_back(0);
+                for (size_t i = 0; i < companions.size(); ++i)
+                {
+                    std::vector<pcl::TexMaterial>::const_iterator mat_it = companions[i].getMaterial(name);
+                    if (mat_it != companions[i].materials_.end())
+                    {
+                        mesh.tex_materials.back() = *mat_it;
+                        break;
+                    }
+                }
+                // We didn't find the appropriate material so we create it here with name only.
+                if (mesh.tex_materials.back().tex_name == "")
+                    mesh.tex_materials.back().tex_name = name;
+
+                // The texture coordinates read since the previous usemtl.
+                size_t texCoordEnd = texCoordBase[c] + chunk.materials[m].texCoord;
+                std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > coordinates;
+                coordinates.reserve(texCoordEnd - texCoordMark);
+                for (size_t i = texCoordMark; i < texCoordEnd; ++i)
+                {
+                    size_t owner = static_cast<size_t>(std::upper_bound(texCoordBase.begin(), texCoordBase.end(), i) - texCoordBase.begin()) - 1;
+                    const float *uv = &chunks[owner].texCoords[2 * (i - texCoordBase[owner])];
+                    coordinates.push_back(Eigen::Vector2f(uv[0], uv[1]));
+                }
+                mesh.tex_coordinates.push_back(coordinates);
+                texCoordMark = texCoordEnd;
+            }
+        }
+    }
+
+    for (size_t s = 0; s < submeshSizes.size(); ++s)
+    {
+        mesh.tex_polygons[s].resize(submeshSizes[s]);
+    }
+
+    bool perCornerTexCoords = numTexCoords != numVertices;
+    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > cornerTexCoords;
+    if (perCornerTexCoords)
+    {
+        cornerTexCoords.resize(3 * faceBase[numChunks]);
+    }
+
+    int numNormalFields = numNormals > 0 ? 1 : 0;
+    std::vector<std::string> chunkErrors(numChunks);
+
+    // Fill the cloud, the faces and the per corner texture coordinates, each chunk in its own thread.
+    runParallel(numChunks, [&](size_t c){
+        ObjChunk &chunk = chunks[c];
+
+        for (size_t i = 0; i < chunk.relativeCorners.size(); ++i)
+        {
+            uint32_t &corner = chunk.corners[chunk.relativeCorners[i]];
+            corner = static_cast<uint32_t>(static_cast<int64_t>(static_cast<int32_t>(corner)) + static_cast<int64_t>(vertexBase[c]));
+        }
+        for (size_t i = 0; i < chunk.relativeTexCoords.size(); ++i)
+        {
+            uint32_t &texCoord = chunk.faceTexCoords[chunk.relativeTexCoords[i]];
+            texCoord = static_cast<uint32_t>(static_cast<int64_t>(static_cast<int32_t>(texCoord)) + static_cast<int64_t>(texCoordBase[c]));
+        }
+
+        // Vertices
+        size_t numChunkVertices = chunk.vertices.size() / 3;
+        uint8_t *target = &cloud.data[vertexBase[c] * cloud.point_step];
+        for (size_t i = 0; i < numChunkVertices; ++i, target += cloud.point_step)
+        {
+            memcpy(target, &chunk.vertices[3 * i], 3 * sizeof(float));
+        }
+        std::vector<float>().swap(chunk.vertices);
+
+        // Normals, in the order they were read, for as many vertices as there are.
+        if (numNormalFields)
+        {
+            size_t numChunkNormals = chunk.normals.size() / 3;
+            for (size_t i = 0; i < numChunkNormals && normalBase[c] + i < numVertices; ++i)
+            {
+                memcpy(&cloud.data[(normalBase[c] + i) * cloud.point_step + 12], &chunk.normals[3 * i], 3 * sizeof(float));
+            }
+        }
+
+        // Faces
+        size_t corner = 0;
+        for (size_t s = 0; s < segments[c].size(); ++s)
+        {
+            const Segment &segment = segments[c][s];
+            std::vector<pcl::Vertices> &polygons = mesh.tex_polygons[segment.submesh];
+            for (size_t f = segment.begin; f < segment.end; ++f)
+            {
+                pcl::Vertices &face = polygons[segment.target + f - segment.begin];
+                face.vertices.assign(chunk.corners.begin() + static_cast<std::ptrdiff_t>(corner),
+                                     chunk.corners.begin() + static_cast<std::ptrdiff_t>(corner + chunk.faceSizes[f]));
+                corner += chunk.faceSizes[f];
+
+                for (size_t i = 0; i < face.vertices.size(); ++i)
+                {
+                    if (face.vertices[i] >= numVertices && chunkErrors[c].empty())
+                    {
+                        chunkErrors[c] = "Face vertex index out of range.";
+                    }
+                }
+            }
+        }
+
+        // Texture coordinates of every face corner.
+        if (perCornerTexCoords)
+        {
+            for (size_t f = 0; f < chunk.faceSizes.size(); ++f)
+            {
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    uint32_t index = chunk.faceTexCoords[3 * f + i];
+                    Eigen::Vector2f &uv = cornerTexCoords[3 * (faceBase[c] + f) + i];
+                    if (index < numTexCoords)
+                    {
+                        size_t owner = static_cast<size_t>(std::upper_bound(texCoordBase.begin(), texCoordBase.end(), static_cast<size_t>(index)) - texCoordBase.begin()) - 1;
+                        const float *source = &chunks[owner].texCoords[2 * (index - texCoordBase[owner])];
+                        uv = Eigen::Vector2f(source[0], source[1]);
+                    }
+                    else
+                    {
+                        uv = Eigen::Vector2f(0.0f, 0.0f);
+                    }
+                }
+            }
+        }
+    });
+
+    for (size_t c = 0; c < numChunks; ++c)
+    {
+        if (!chunkErrors[c].empty())
+        {
+            throw MeshIOException("Unable to read " + filename + ": " + chunkErrors[c]);
+        }
+    }
+
+    if (perCornerTexCoords)
+    {
+        mesh.tex_coordinates.clear();
+        mesh.tex_coordinates.push_back(cornerTexCoords);
+    }
+}
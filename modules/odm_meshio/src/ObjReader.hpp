@@ -0,0 +1,50 @@
+#pragma once
+
+// C++
+#include <string>
+#include <vector>
+
+// PCL
+#include <pcl/TextureMesh.h>
+#include <pcl/io/obj_io.h>
+
+// Mesh IO
+#include "MappedFile.hpp"
+
+/*!
+ * \brief   The ObjReader class reads a textured mesh from an OBJ-file into a pcl::TextureMesh.
+ * \details The file is memory mapped and split into chunks at line boundaries, which are
+ *          parsed in parallel without any per-line allocation. The result is the same as
+ *          the one of the loader based on the pcl::io module that it replaces:
+ *          - the cloud has the fields x, y, z, and normal_x, normal_y, normal_z if the file has normals,
+ *          - every usemtl line starts a new submesh, with the texture coordinates read since the previous one,
+ *          - if the number of texture coordinates differs from the number of vertices, the texture
+ *            coordinates are instead stored once per face corner, in face order, in tex_coordinates[0].
+ */
+class ObjReader
+{
+public:
+    ObjReader();
+
+    /*!
+     * \brief setThreads    Sets the number of threads used for parsing, 0 to use one per core.
+     */
+    void setThreads(int threads);
+
+    /*!
+     * \brief read          Reads a textured mesh. Throws a MeshIOException if the file cannot be read.
+     * \param filename      Path to the .obj file.
+     * \param mesh          The model.
+     * \param companions    The material libraries referenced by the model.
+     */
+    void read(const std::string &filename, pcl::TextureMesh &mesh, std::vector<pcl::MTLReader> &companions);
+
+    /*!
+     * \brief getWarnings   Problems found by the last read which did not stop it.
+     */
+    const std::vector<std::string>& getWarnings() const;
+
+private:
+    int threads_;                           /**< The number of parser threads, 0 for one per core. */
+    std::vector<std::string> warnings_;     /**< Warnings of the last read. */
+};
@@ -1,10 +1,26 @@
 #include <math.h>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <memory>
 #include <Eigen/StdVector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "OdmOrthoPhoto.hpp"
 
+// Textures
+#include "TextureQueue.hpp"
+
+// Mesh IO
+#include "ObjReader.hpp"
+#include "BinaryMesh.hpp"
+
+// Profiling
+#include "Profile.hpp"
+
 OdmOrthoPhoto::OdmOrthoPhoto()
     :log_(false){
     outputFile_ = "ortho.tif";
@@ -13,9 +29,27 @@ OdmOrthoPhoto::OdmOrthoPhoto()
     bandsOrder = "red,green,blue";
 
     resolution_ = 0.0f;
+    threads_ = 1;
+    tileSize_ = 256;
+    blockWidth_ = tileSize_;
+    blockHeight_ = tileSize_;
+    tiled_ = true;
+    maxMemory_ = 0;
+    prefetchTextures_ = 2;
+    prefetchMemory_ = 0;
+    textureBytes_ = 0;
+    textureCacheMemory_ = 256;
+    textureDepth_ = -1;
+
+    utmEastOffset_ = 0.0;
+    utmNorthOffset_ = 0.0;
+    hasWindowBounds_ = false;
 
-    alphaBand = nullptr;
     currentBandIndex = 0;
+    bandCount_ = 0;
+    depthBits_ = 32;
+    depthMin_ = 0.0f;
+    depthScale_ = 0.0f;
 }
 
 OdmOrthoPhoto::~OdmOrthoPhoto()
@@ -23,16 +57,39 @@ OdmOrthoPhoto::~OdmOrthoPhoto()
 }
 
 int OdmOrthoPhoto::run(int argc, char *argv[])
+{
+    std::vector<pcl::TextureMesh> meshes;
+    return run(argc, argv, meshes, std::vector<std::string>());
+}
+
+int OdmOrthoPhoto::run(int argc, char *argv[], std::vector<pcl::TextureMesh> &meshes, const std::vector<std::string> &names)
 {
     try
     {
         parseArguments(argc, argv);
-        createOrthoPhoto();
+        log_.open(logFile_);
+        if (meshes.empty())
+        {
+            createOrthoPhoto();
+        }
+        else
+        {
+            if (!inputFiles.empty())
+            {
+                throw OdmOrthoPhotoException("The models are given in memory, '-inputFiles' can not be used.");
+            }
+            for (size_t m = 0; m < meshes.size(); m++)
+            {
+                addModel(meshes[m], m < names.size() ? names[m] : "model " + std::to_string(m + 1));
+            }
+            render();
+        }
     }
     catch (const OdmOrthoPhotoException& e)
     {
         log_.setIsPrintingInCout(true);
         log_ << e.what() << "\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
@@ -41,6 +98,7 @@ int OdmOrthoPhoto::run(int argc, char *argv[])
         log_.setIsPrintingInCout(true);
         log_ << "Error in OdmOrthoPhoto:\n";
         log_ << e.what() << "\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
@@ -48,15 +106,25 @@ int OdmOrthoPhoto::run(int argc, char *argv[])
     {
         log_.setIsPrintingInCout(true);
         log_ << "Unknown error, terminating:\n";
+        writeProfile();
         log_.print(logFile_);
         return EXIT_FAILURE;
     }
     
+    writeProfile();
     log_.print(logFile_);
     
     return EXIT_SUCCESS;
 }
 
+void OdmOrthoPhoto::writeProfile()
+{
+    if (!profileFile_.empty() && !Profile::instance().write())
+    {
+        log_ << "Warning: could not write the profile to " << profileFile_ << "\n";
+    }
+}
+
 void OdmOrthoPhoto::parseArguments(int argc, char *argv[])
 {
     logFile_ = std::string(argv[0]) + "_log.txt";
@@ -95,10 +163,197 @@ void OdmOrthoPhoto::parseArguments(int argc, char *argv[])
             ss >> resolution_;
             log_ << "Resolution count was set to: " << resolution_ << "pixels/meter\n";
         }
+        else if(argument == "-threads")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> threads_;
+            if (ss.fail() || threads_ < 1)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be a positive integer).");
+            }
+            log_ << "Number of render threads was set to: " << threads_ << "\n";
+        }
+        else if(argument == "-maxMemory")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> maxMemory_;
+            if (ss.fail() || maxMemory_ < 0)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be a positive number of megabytes).");
+            }
+            log_ << "Maximum memory was set to: " << maxMemory_ << "MB\n";
+        }
+        else if(argument == "-prefetchTextures")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> prefetchTextures_;
+            if (ss.fail() || prefetchTextures_ < 0)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be a non-negative integer).");
+            }
+            log_ << "Number of prefetched textures was set to: " << prefetchTextures_ << "\n";
+        }
+        else if(argument == "-depthBits")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> depthBits_;
+            if (ss.fail() || (depthBits_ != 16 && depthBits_ != 32))
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be 16 or 32).");
+            }
+            log_ << "Depth buffer bits were set to: " << depthBits_ << "\n";
+        }
+        else if(argument == "-prefetchMemory")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> prefetchMemory_;
+            if (ss.fail() || prefetchMemory_ < 0)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be a positive number of megabytes).");
+            }
+            log_ << "Texture prefetch memory was set to: " << prefetchMemory_ << "MB\n";
+        }
+        else if(argument == "-textureCacheMemory")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            ss >> textureCacheMemory_;
+            if (ss.fail() || textureCacheMemory_ < 0)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be a positive number of megabytes).");
+            }
+            log_ << "Texture cache memory was set to: " << textureCacheMemory_ << "MB\n";
+        }
+        else if(argument == "-srs")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            srs_ = std::string(argv[argIndex]);
+            log_ << "Spatial reference system was set to: " << srs_ << "\n";
+        }
+        else if(argument == "-utmOffset")
+        {
+            argIndex += 2;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 2 more inputs following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(std::string(argv[argIndex - 1]) + " " + argv[argIndex]);
+            ss >> utmEastOffset_ >> utmNorthOffset_;
+            if (ss.fail())
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be two numbers).");
+            }
+            log_ << "UTM offset was set to: " << utmEastOffset_ << " " << utmNorthOffset_ << "\n";
+        }
+        else if(argument == "-window")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::string window = std::string(argv[argIndex]);
+            std::replace(window.begin(), window.end(), ',', ' ');
+            std::stringstream ss(window);
+            ss >> windowBounds_.xMin >> windowBounds_.yMin >> windowBounds_.xMax >> windowBounds_.yMax;
+            if (ss.fail() || !(windowBounds_.xMin < windowBounds_.xMax) || !(windowBounds_.yMin < windowBounds_.yMax))
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be xmin,ymin,xmax,ymax with xmin < xmax and ymin < ymax).");
+            }
+            hasWindowBounds_ = true;
+            log_ << "Window was set to: " << windowBounds_.xMin << " " << windowBounds_.yMin << " " << windowBounds_.xMax << " " << windowBounds_.yMax << "\n";
+        }
+        else if(argument == "-co")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::string option = std::string(argv[argIndex]);
+            if (option.find('=') == std::string::npos)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be NAME=VALUE).");
+            }
+            creationOptions_.push_back(option);
+            log_ << "Creation option: " << option << "\n";
+        }
+        else if(argument == "-overviews")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            std::stringstream ss(argv[argIndex]);
+            std::string item;
+            while(std::getline(ss, item, ',')){
+                std::stringstream factorStream(item);
+                int factor = 0;
+                factorStream >> factor;
+                // Windows are a multiple of every factor high, so every window covers whole overview pixels.
+                if (factorStream.fail() || factor < 2 || (factor & (factor - 1)) != 0 || factor > tileSize_)
+                {
+                    throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be powers of two from 2 to " + std::to_string(tileSize_) + ").");
+                }
+                overviews_.push_back(factor);
+            }
+            std::sort(overviews_.begin(), overviews_.end());
+            overviews_.erase(std::unique(overviews_.begin(), overviews_.end()), overviews_.end());
+            log_ << "Number of overviews was set to: " << overviews_.size() << "\n";
+        }
         else if(argument == "-verbose")
         {
             log_.setIsPrintingInCout(true);
         }
+        else if (argument == "-logLevel")
+        {
+            ++argIndex;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Missing argument for '" + argument + "'.");
+            }
+            Logger::Level level;
+            if (!Logger::parseLevel(argv[argIndex], level))
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' has a bad value (must be debug, info, warning or error).");
+            }
+            log_.setLevel(level);
+            log_ << "Log level was set to: " << argv[argIndex] << "\n";
+        }
         else if (argument == "-logFile")
         {
             ++argIndex;
@@ -157,6 +412,17 @@ void OdmOrthoPhoto::parseArguments(int argc, char *argv[])
             outputCornerFile_ = std::string(argv[argIndex]);
             log_ << "Writing corners to: " << outputCornerFile_ << "\n";
         }
+        else if(argument == "-profile")
+        {
+            argIndex++;
+            if (argIndex >= argc)
+            {
+                throw OdmOrthoPhotoException("Argument '" + argument + "' expects 1 more input following it, but no more inputs were provided.");
+            }
+            profileFile_ = std::string(argv[argIndex]);
+            Profile::instance().enable("odm_orthophoto", profileFile_);
+            log_ << "Writing the profile to: " << profileFile_ << "\n";
+        }
         else
         {
             printHelp();
@@ -165,6 +431,8 @@ void OdmOrthoPhoto::parseArguments(int argc, char *argv[])
     }
     log_ << "\n";
 
+    parseBlockSize();
+
     std::stringstream ss(bandsOrder);
     std::string item;
     while(std::getline(ss, item, ',')){
@@ -194,11 +462,12 @@ void OdmOrthoPhoto::printHelp()
 
     log_ << "The following flags are available\n";
     log_ << "Call the program with flag \"-help\", or without parameters to print this message, or check any generated log file.\n";
-    log_ << "Call the program with flag \"-verbose\", to print log messages in the standard output stream as well as in the log file.\n\n";
+    log_ << "Call the program with flag \"-verbose\", to print log messages in the standard output stream as well as in the log file.\n";
+    log_ << "Call the program with \"-logLevel <debug|info|warning|error>\", to only log the messages of that level and above, info by default.\n\n";
 
     log_ << "Parameters are specified as: \"-<argument name> <argument>\", (without <>), and the following parameters are configureable:\n";
     log_ << "\"-inputFiles <path>[,<path2>,<path3>,...]\" (mandatory)\n";
-    log_ << "\"Input obj files that must contain a textured mesh.\n\n";
+    log_ << "\"Input obj files, or binary mesh files written by odm_georef, that must contain a textured mesh.\n\n";
 
     log_ << "\"-outputFile <path>\" (optional, default: ortho.jpg)\n";
     log_ << "\"Target file in which the orthophoto is saved.\n\n";
@@ -212,112 +481,352 @@ void OdmOrthoPhoto::printHelp()
     log_ << "\"-bands red,green,blue,[...]\" (optional)\n";
     log_ << "\"Naming of bands to assign color interpolation values when creating output TIFF.\n\n";
 
+    log_ << "\"-threads <integer>\" (optional, default: 1)\n";
+    log_ << "\"The number of threads used to render the ortho photo. With more than one thread the photo is rendered in tiles.\n\n";
+
+    log_ << "\"-maxMemory <megabytes>\" (optional, default: unlimited)\n";
+    log_ << "\"Upper bound for the memory used while rendering. When the photo does not fit, it is rendered and written in windows of whole rows.\n\n";
+
+    log_ << "\"-textureCacheMemory <megabytes>\" (optional, default: 256)\n";
+    log_ << "\"Memory for the texture pyramid levels kept between materials and windows. Faces covering many texels per pixel are sampled from coarser levels.\n\n";
+
+    log_ << "\"-srs <definition>\" (optional)\n";
+    log_ << "\"The spatial reference system of the photo, as a PROJ.4 string, WKT or EPSG:code.\n\n";
+
+    log_ << "\"-utmOffset <east> <north>\" (optional, default: 0 0)\n";
+    log_ << "\"The offset added to the model coordinates in the geotransform of the photo.\n\n";
+
+    log_ << "\"-window <xmin,ymin,xmax,ymax>\" (optional)\n";
+    log_ << "\"Only renders this part of the model, in model coordinates. The window is widened to the pixel grid from the origin of\n";
+    log_ << "the model coordinates, so photos of windows sharing an edge join without seams. Only the faces overlapping the window are kept.\n\n";
+
+    log_ << "\"-co <NAME=VALUE>\" (optional, repeatable)\n";
+    log_ << "\"A GeoTIFF creation option, for example COMPRESS=DEFLATE or NUM_THREADS=8. BLOCKXSIZE and BLOCKYSIZE must be multiples\n";
+    log_ << "of 16 and default to " << tileSize_ << ", windows are a whole number of blocks high.\n\n";
+
+    log_ << "\"-overviews <factors>\" (optional)\n";
+    log_ << "\"Comma separated overview factors, powers of two up to " << tileSize_ << ". The overviews are written with each window.\n\n";
+
+    log_ << "\"-prefetchTextures <integer>\" (optional, default: 2)\n";
+    log_ << "\"The number of material textures decoded on background threads while the current one is drawn. 0 decodes them on demand.\n\n";
+
+    log_ << "\"-prefetchMemory <megabytes>\" (optional, default: unlimited)\n";
+    log_ << "\"Upper bound for the memory held by prefetched textures. The next texture is always decoded.\n\n";
+
+    log_ << "\"-depthBits <16|32>\" (optional, default: 32)\n";
+    log_ << "\"The precision of the depth buffer. 16 quantizes the depths over the Z range of the models, which saves memory per pixel,\n";
+    log_ << "but faces closer in Z than one step of the range are drawn in submesh order.\n\n";
+
+    log_ << "\"-profile <path>\" (optional)\n";
+    log_ << "\"Target JSON file for the time of every phase, the counters of the work done and the peak memory of the run.\n\n";
+
     log_.setIsPrintingInCout(false);
 }
 
-void OdmOrthoPhoto::saveTIFF(const std::string &filename, GDALDataType dataType){
+template <typename T>
+inline T maxRange(){
+    return static_cast<T>(pow(2, sizeof(T) * 8) - 1);
+}
+
+/*!
+ * \brief The depth buffer of type D. Float depths are stored as they are, 16-bit depths are quantized over the
+ *        Z range of the models to [1, 65535], with 0 as the empty depth. Both compare and blend as floats.
+ */
+template <typename D>
+struct DepthBuffer;
+
+template <>
+struct DepthBuffer<float>{
+    DepthBuffer(float, float) {}
+
+    float quantize(float z) const { return z; }
+
+#if defined(__SSE2__)
+    __m128 quantize(__m128 z) const { return z; }
+    static __m128 load(const float *depth) { return _mm_loadu_ps(depth); }
+    static void store(float *depth, __m128 z) { _mm_storeu_ps(depth, z); }
+#endif
+};
+
+template <>
+struct DepthBuffer<uint16_t>{
+    float min;      /**< The Z quantized to 1. */
+    float scale;    /**< The steps per unit of Z. */
+
+    DepthBuffer(float min, float scale) : min(min), scale(scale) {}
+
+    float quantize(float z) const {
+        float q = (z - min) * scale + 1.0f;
+        if (!(q >= 1.0f)) q = 1.0f;
+        if (q > 65535.0f) q = 65535.0f;
+        return std::floor(q);
+    }
+
+#if defined(__SSE2__)
+    // The same clamping as above, _mm_max_ps returns its second argument for NaN.
+    __m128 quantize(__m128 z) const {
+        __m128 q = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(z, _mm_set1_ps(min)), _mm_set1_ps(scale)), _mm_set1_ps(1.0f));
+        q = _mm_min_ps(_mm_max_ps(q, _mm_set1_ps(1.0f)), _mm_set1_ps(65535.0f));
+        return _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+    }
+    static __m128 load(const uint16_t *depth) {
+        __m128i d = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(depth));
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(d, _mm_setzero_si128()));
+    }
+    // SSE2 only packs with signed saturation, so the values are biased into the signed range and back.
+    static void store(uint16_t *depth, __m128 z) {
+        __m128i d = _mm_sub_epi32(_mm_cvttps_epi32(z), _mm_set1_epi32(32768));
+        d = _mm_xor_si128(_mm_packs_epi32(d, d), _mm_set1_epi16(static_cast<short>(0x8000)));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(depth), d);
+    }
+#endif
+};
+
+void OdmOrthoPhoto::parseBlockSize()
+{
+    char **options = NULL;
+    for (size_t i = 0; i < creationOptions_.size(); i++){
+        options = CSLAddString(options, creationOptions_[i].c_str());
+    }
+    tiled_ = CPLTestBool(CSLFetchNameValueDef(options, "TILED", "YES"));
+
+    const char *names[2] = { "BLOCKXSIZE", "BLOCKYSIZE" };
+    int *sizes[2] = { &blockWidth_, &blockHeight_ };
+    for (int i = 0; i < 2; i++){
+        const char *value = CSLFetchNameValue(options, names[i]);
+        if (!value) continue;
+        if (!tiled_){
+            log_.warning() << "Warning: creation option " << names[i] << " is ignored, the GeoTIFF is not tiled.\n";
+            continue;
+        }
+
+        std::stringstream valueStream(value);
+        int size = 0;
+        valueStream >> size;
+        if (valueStream.fail() || size < 16 || size % 16 != 0){
+            CSLDestroy(options);
+            throw OdmOrthoPhotoException("Creation option " + std::string(names[i]) + " has a bad value (must be a positive multiple of 16).");
+        }
+        *sizes[i] = size;
+    }
+    CSLDestroy(options);
+
+    if (tiled_){
+        log_ << "GeoTIFF blocks of " << blockWidth_ << "x" << blockHeight_ << " pixels\n";
+    }
+}
+
+int OdmOrthoPhoto::getWindowStep() const
+{
+    // Windows are written in whole blocks, which are only compressed once, and cover whole overview pixels.
+    int base = tiled_ ? blockHeight_ : tileSize_;
+    int factor = overviews_.empty() ? 1 : overviews_.back();
+    int step = base;
+    while (step % factor != 0){
+        step += base;
+    }
+    return step;
+}
+
+GDALDatasetH OdmOrthoPhoto::createTIFF(const std::string &filename, GDALDataType dataType, int bandCount, const Bounds &bounds){
     GDALAllRegister();
     GDALDriverH hDriver = GDALGetDriverByName( "GTiff" );
     if (!hDriver){
-        std::cerr << "Cannot initialize GeoTIFF driver. Check your GDAL installation." << std::endl;
-        exit(1);
+        throw OdmOrthoPhotoException("Cannot initialize GeoTIFF driver. Check your GDAL installation.");
     }
+
     char **papszOptions = NULL;
+    papszOptions = CSLSetNameValue(papszOptions, "TILED", "YES");
+    papszOptions = CSLSetNameValue(papszOptions, "BIGTIFF", "IF_SAFER");
+    for (size_t i = 0; i < creationOptions_.size(); i++){
+        papszOptions = CSLAddString(papszOptions, creationOptions_[i].c_str());
+    }
+
+    // The block size given in the creation options, or the render tile size; see parseBlockSize.
+    if (tiled_){
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", std::to_string(blockWidth_).c_str());
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", std::to_string(blockHeight_).c_str());
+    }else{
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKXSIZE", NULL);
+        papszOptions = CSLSetNameValue(papszOptions, "BLOCKYSIZE", NULL);
+    }
+
     GDALDatasetH hDstDS = GDALCreate( hDriver, filename.c_str(), width, height,
-                                      static_cast<int>(bands.size() + 1), dataType, papszOptions );
-    GDALRasterBandH hBand;
+                                      bandCount + 1, dataType, papszOptions );
+    CSLDestroy(papszOptions);
+    if (!hDstDS){
+        throw OdmOrthoPhotoException("Cannot create TIFF " + filename);
+    }
 
-    // Bands
-    size_t i = 0;
-    for (; i < bands.size(); i++){
-        hBand = GDALGetRasterBand( hDstDS, static_cast<int>(i) + 1 );
+    // The top left corner of the photo, and the size of its pixels.
+    double geoTransform[6] = {
+        static_cast<double>(bounds.xMin) + utmEastOffset_, 1.0 / static_cast<double>(resolution_), 0.0,
+        static_cast<double>(bounds.yMax) + utmNorthOffset_, 0.0, -1.0 / static_cast<double>(resolution_)
+    };
+    GDALSetGeoTransform( hDstDS, geoTransform );
+
+    if (!srs_.empty()){
+        OGRSpatialReferenceH hSRS = OSRNewSpatialReference(NULL);
+        char *wkt = NULL;
+        if (OSRSetFromUserInput(hSRS, srs_.c_str()) != OGRERR_NONE || OSRExportToWkt(hSRS, &wkt) != OGRERR_NONE){
+            CPLFree(wkt);
+            OSRDestroySpatialReference(hSRS);
+            GDALClose(hDstDS);
+            throw OdmOrthoPhotoException("Invalid spatial reference system: " + srs_);
+        }
+        GDALSetProjection( hDstDS, wkt );
+        CPLFree(wkt);
+        OSRDestroySpatialReference(hSRS);
+    }
 
+    // Bands
+    int i = 0;
+    for (; i < bandCount; i++){
         GDALColorInterp interp = GCI_GrayIndex;
-        if (i < colorInterps.size()){
-            interp = colorInterps[i];
+        if (static_cast<size_t>(i) < colorInterps.size()){
+            interp = colorInterps[static_cast<size_t>(i)];
         }
-        GDALSetRasterColorInterpretation(hBand, interp );
+        GDALSetRasterColorInterpretation(GDALGetRasterBand( hDstDS, i + 1 ), interp );
+    }
+
+    // Set alpha band
+    GDALSetRasterColorInterpretation(GDALGetRasterBand( hDstDS, i + 1 ), GCI_AlphaBand );
 
-        if (GDALRasterIO( hBand, GF_Write, 0, 0, width, height,
-                    bands[i], width, height, dataType, 0, 0 ) != CE_None){
-            std::cerr << "Cannot write TIFF to " << filename << std::endl;
-            exit(1);
+    // Empty overviews, filled in as the windows are written.
+    if (!overviews_.empty()){
+        if (GDALBuildOverviews( hDstDS, "NONE", static_cast<int>(overviews_.size()), &overviews_[0], 0, NULL, NULL, NULL ) != CE_None){
+            GDALClose(hDstDS);
+            throw OdmOrthoPhotoException("Cannot create the overviews of " + filename);
         }
     }
 
-    // Alpha
-    if (dataType == GDT_Float32){
-        finalizeAlphaBand<float>();
-    }else if (dataType == GDT_UInt16){
-        finalizeAlphaBand<uint16_t>();
-    }else if (dataType == GDT_Byte){
-        finalizeAlphaBand<uint8_t>();
-    }else{
-        throw OdmOrthoPhotoException("Invalid data type");
+    return hDstDS;
+}
+
+template <typename T>
+void OdmOrthoPhoto::writeWindow(GDALDatasetH hDstDS, GDALDataType dataType){
+    int windowWidth = window_.colMax - window_.colMin;
+    int windowHeight = window_.rowMax - window_.rowMin;
+
+    // Bands, from the pixel-interleaved samples.
+    std::vector<int> bandMap(static_cast<size_t>(bandCount_));
+    for (int i = 0; i < bandCount_; i++){
+        bandMap[static_cast<size_t>(i)] = i + 1;
+    }
+    int pixelSpace = static_cast<int>(sizeof(T)) * bandCount_;
+    if (GDALDatasetRasterIO( hDstDS, GF_Write, window_.colMin, window_.rowMin, windowWidth, windowHeight,
+                &raster_[0], windowWidth, windowHeight, dataType, bandCount_, &bandMap[0],
+                pixelSpace, pixelSpace * windowWidth, static_cast<int>(sizeof(T)) ) != CE_None){
+        throw OdmOrthoPhotoException("Cannot write TIFF to " + outputFile_);
     }
 
     // Alpha
-    hBand = GDALGetRasterBand( hDstDS, static_cast<int>(i) + 1 );
+    finalizeAlphaBand();
 
-    // Set alpha band
-    GDALSetRasterColorInterpretation(hBand, GCI_AlphaBand );
+    if (GDALRasterIO( GDALGetRasterBand( hDstDS, bandCount_ + 1 ), GF_Write, window_.colMin, window_.rowMin, windowWidth, windowHeight,
+                &coverage_[0], windowWidth, windowHeight, GDT_Byte, 0, 0 ) != CE_None){
+        throw OdmOrthoPhotoException("Cannot write TIFF (alpha) to " + outputFile_);
+    }
 
-    if (GDALRasterIO( hBand, GF_Write, 0, 0, width, height,
-                alphaBand, width, height, dataType, 0, 0 ) != CE_None){
-        std::cerr << "Cannot write TIFF (alpha) to " << filename << std::endl;
-        exit(1);
+    for (size_t o = 0; o < overviews_.size(); o++){
+        writeOverview<T>(hDstDS, dataType, o);
     }
 
-    GDALClose( hDstDS );
+    // Hand the finished blocks to the file, so that the block cache does not grow with the photo.
+    GDALFlushCache( hDstDS );
 }
 
 template <typename T>
-inline T maxRange(){
-    return static_cast<T>(pow(2, sizeof(T) * 8) - 1);
-}
+void OdmOrthoPhoto::writeOverview(GDALDatasetH hDstDS, GDALDataType dataType, size_t level){
+    int factor = overviews_[level];
+    int windowWidth = window_.colMax - window_.colMin;
+    int bandCount = bandCount_ + 1;
+
+    GDALRasterBandH alphaOverview = GDALGetOverview( GDALGetRasterBand( hDstDS, bandCount ), static_cast<int>(level) );
+    int overviewWidth = GDALGetRasterBandXSize( alphaOverview );
+    int overviewHeight = GDALGetRasterBandYSize( alphaOverview );
+
+    // The window starts on a multiple of the factor, and ends on one unless it is the last.
+    int rowMin = window_.rowMin / factor;
+    int rowMax = std::min(overviewHeight, (window_.rowMax + factor - 1) / factor);
+    if (rowMin >= rowMax) return;
+
+    // Colors are averaged over the covered pixels, the alpha over all pixels.
+    size_t overviewCount = static_cast<size_t>(overviewWidth) * static_cast<size_t>(rowMax - rowMin);
+    std::vector<std::vector<T> > overview(static_cast<size_t>(bandCount), std::vector<T>(overviewCount));
+    std::vector<double> sums(static_cast<size_t>(bandCount));
+    const T *pixels = reinterpret_cast<const T *>(&raster_[0]);
+    const uint8_t *alpha = &coverage_[0];
+
+    for (int r = rowMin; r < rowMax; r++){
+        int rowStart = r * factor;
+        int rowEnd = std::min(rowStart + factor, window_.rowMax);
+        for (int c = 0; c < overviewWidth; c++){
+            int colStart = c * factor;
+            int colEnd = std::min(colStart + factor, window_.colMax);
+
+            std::fill(sums.begin(), sums.end(), 0.0);
+            int covered = 0;
+            for (int row = rowStart; row < rowEnd; row++){
+                size_t idx = static_cast<size_t>(row - window_.rowMin) * static_cast<size_t>(windowWidth) + static_cast<size_t>(colStart - window_.colMin);
+                for (int col = colStart; col < colEnd; col++, idx++){
+                    sums.back() += static_cast<double>(alpha[idx]);
+                    if (alpha[idx] == 0) continue;
+                    covered++;
+                    const T *pixel = pixels + idx * static_cast<size_t>(bandCount_);
+                    for (size_t b = 0; b + 1 < sums.size(); b++){
+                        sums[b] += static_cast<double>(pixel[b]);
+                    }
+                }
+            }
 
-template <typename T>
-void OdmOrthoPhoto::initBands(int count){
-    size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+            size_t o = static_cast<size_t>(r - rowMin) * static_cast<size_t>(overviewWidth) + static_cast<size_t>(c);
+            for (size_t b = 0; b + 1 < sums.size(); b++){
+                overview[b][o] = covered > 0 ? static_cast<T>(sums[b] / covered) : maxRange<T>();
+            }
+            int count = (rowEnd - rowStart) * (colEnd - colStart);
+            overview.back()[o] = static_cast<T>(sums.back() / count);
+        }
+    }
 
-    // Channels
-    for (int i = 0; i < count; i++){
-        T *arr = new T[pixelCount];
-        for (size_t j = 0; j < pixelCount; j++){
-            arr[j] = maxRange<T>();
+    for (int b = 0; b < bandCount; b++){
+        GDALRasterBandH band = GDALGetOverview( GDALGetRasterBand( hDstDS, b + 1 ), static_cast<int>(level) );
+        if (GDALRasterIO( band, GF_Write, 0, rowMin, overviewWidth, rowMax - rowMin,
+                    &overview[static_cast<size_t>(b)][0], overviewWidth, rowMax - rowMin, dataType, 0, 0 ) != CE_None){
+            throw OdmOrthoPhotoException("Cannot write TIFF (overview) to " + outputFile_);
         }
-        bands.push_back(static_cast<void *>(arr));
     }
 }
 
 template <typename T>
-void OdmOrthoPhoto::initAlphaBand(){
-     size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
-     // Alpha
-     if (alphaBand == nullptr){
-         T *arr = new T[pixelCount];
-         for (size_t j = 0; j < pixelCount; j++){
-             arr[j] = 0.0;
-         }
-         alphaBand = static_cast<void *>(arr);
-     }
+void OdmOrthoPhoto::initBands(){
+    size_t pixelCount = static_cast<size_t>(window_.colMax - window_.colMin) * static_cast<size_t>(window_.rowMax - window_.rowMin);
+    size_t sampleCount = pixelCount * static_cast<size_t>(bandCount_);
+
+    raster_.resize(sampleCount * sizeof(T));
+    T *samples = reinterpret_cast<T *>(&raster_[0]);
+    std::fill(samples, samples + sampleCount, maxRange<T>());
+
+    coverage_.assign(pixelCount, 0);
 }
 
-template <typename T>
 void OdmOrthoPhoto::finalizeAlphaBand(){
-     // Adjust alpha band values, only pixels that have
-     // values on all bands should be visible
+    for (size_t j = 0; j < coverage_.size(); j++){
+        coverage_[j] = coverage_[j] >= bandCount_ ? 255 : 0;
+    }
+}
 
-     size_t pixelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
-     int channels = bands.size();
+void OdmOrthoPhoto::releaseBands(){
+    std::vector<uint8_t>().swap(raster_);
+    std::vector<uint8_t>().swap(coverage_);
 
-     T *arr = reinterpret_cast<T *>(alphaBand);
-     for (size_t j = 0; j < pixelCount; j++){
-         arr[j] = arr[j] >= channels ? 255.0 : 0.0;
-     }
+    depth_.release();
+    faceIds_.release();
+    weights_.release();
+    std::vector<size_t>().swap(visiblePixels_);
+    std::vector<uint8_t>().swap(pixelLevels_);
 }
 
-
 void OdmOrthoPhoto::createOrthoPhoto()
 {
     if(inputFiles.size() == 0)
@@ -325,269 +834,816 @@ void OdmOrthoPhoto::createOrthoPhoto()
         throw OdmOrthoPhotoException("Failed to create ortho photo, no texture meshes given.");
     }
 
-    int textureDepth = -1;
-    bool primary = true;
-    Bounds bounds;
-
     for (auto &inputFile : inputFiles){
         log_ << "Reading mesh file... " << inputFile << "\n";
 
-        std::vector<pcl::MTLReader> companions; /**< Materials (used by loadOBJFile). **/
-        pcl::TextureMesh mesh;
-        loadObjFile(inputFile, mesh, companions);
-        log_ << "Mesh file read.\n\n";
-
-        // Does the model have more than one material?
-        bool multiMaterial_ = 1 < mesh.tex_materials.size();
-        bool splitModel = false;
-
-        if(multiMaterial_)
-        {
-            // Need to check relationship between texture coordinates and faces.
-            if(!isModelOk(mesh))
+        if (BinaryMesh::isBinaryMesh(inputFile)){
+            // The model is prepared straight from the mapped arrays, without a pcl::TextureMesh in between.
+            std::unique_ptr<BinaryMesh> binaryMesh;
             {
-                splitModel = true;
+                ProfilePhase phase("read_mesh");
+                try{
+                    binaryMesh.reset(new BinaryMesh(inputFile));
+                }catch (const MeshIOException &e){
+                    log_ << e.what() << "\n";
+                    throw OdmOrthoPhotoException("Problem reading mesh from file!\n");
+                }
             }
+            Profile::instance().addFileSize("bytes_read", inputFile);
+            log_ << "Mesh file mapped.\n\n";
+
+            addModel(*binaryMesh, inputFile);
+            continue;
         }
 
-        Bounds b = computeBoundsForModel(mesh);
+        std::vector<pcl::MTLReader> companions; /**< Materials (used by loadOBJFile). **/
+        pcl::TextureMesh mesh;
+        {
+            ProfilePhase phase("read_mesh");
+            loadObjFile(inputFile, mesh, companions);
+        }
+        Profile::instance().addFileSize("bytes_read", inputFile);
+        log_ << "Mesh file read.\n\n";
 
-        log_ << "Model bounds x : " << b.xMin << " -> " << b.xMax << '\n';
-        log_ << "Model bounds y : " << b.yMin << " -> " << b.yMax << '\n';
+        addModel(mesh, inputFile);
+    }
 
-        if (primary){
-            bounds = b;
-        }else{
-            // Quick check
-            if (b.xMin != bounds.xMin ||
-                    b.xMax != bounds.xMax ||
-                    b.yMin != bounds.yMin ||
-                    b.yMax != bounds.yMax){
-                throw OdmOrthoPhotoException("Bounds between models must all match, but they don't.");
-            }
-        }
+    render();
+}
 
-        // The size of the area.
-        float xDiff = bounds.xMax - bounds.xMin;
-        float yDiff = bounds.yMax - bounds.yMin;
-        log_ << "Model area : " << xDiff*yDiff << "m2\n";
+void OdmOrthoPhoto::addModel(pcl::TextureMesh &mesh, const std::string &name)
+{
+    ProfilePhase phase("prepare_model");
+    bool primary = models_.empty();
+    modelNames_.push_back(name);
 
-        // The resolution necessary to fit the area with the given resolution.
-        height = static_cast<int>(std::ceil(resolution_*yDiff));
-        width = static_cast<int>(std::ceil(resolution_*xDiff));
+    if (mesh.tex_materials.empty())
+    {
+        throw OdmOrthoPhotoException("Model " + name + " has no materials.");
+    }
 
-        depth_ = cv::Mat::zeros(height, width, CV_32F) - std::numeric_limits<float>::infinity();
-        log_ << "Model resolution, width x height : " << width << "x" << height << '\n';
+    // Does the model have more than one material?
+    bool multiMaterial_ = 1 < mesh.tex_materials.size();
+    bool perVertexTexCoords = false;
 
-        // Check size of photo.
-        if(0 >= height*width)
+    if(multiMaterial_)
+    {
+        // Need to check relationship between texture coordinates and faces.
+        if(!isModelOk(mesh))
         {
-            if(0 >= height)
-            {
-                log_ << "Warning: ortho photo has zero area, height = " << height << ". Forcing height = 1.\n";
-                height = 1;
-            }
-            if(0 >= width)
-            {
-                log_ << "Warning: ortho photo has zero area, width = " << width << ". Forcing width = 1.\n";
-                width = 1;
-            }
-            log_ << "New ortho photo resolution, width x height : " << width << "x" << height << '\n';
+            perVertexTexCoords = true;
         }
+    }
 
-        // Contains the vertices of the mesh.
-        pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
-        pcl::fromPCLPointCloud2 (mesh.cloud, *meshCloud);
+    // Contains the vertices of the mesh.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
+    pcl::fromPCLPointCloud2 (mesh.cloud, *meshCloud);
+    mesh.cloud.data.clear();
 
-        // Split model and make copies of vertices and texture coordinates for all faces
-        if (splitModel)
-        {
-            pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloudSplit (new pcl::PointCloud<pcl::PointXYZ>);
-            std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > textureCoordinates = std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >(0);
+    OrthoModel &model = startModel(meshCloud, primary);
+    model.faces.swap(mesh.tex_polygons);
+    model.materials.swap(mesh.tex_materials);
 
-            size_t vertexIndexCount = 0;
-            for(size_t t = 0; t < mesh.tex_polygons.size(); ++t)
-            {
-                vertexIndexCount += 3 * mesh.tex_polygons[t].size();
-            }
-            textureCoordinates.reserve(vertexIndexCount);
+    if (perVertexTexCoords)
+    {
+        // The texture coordinates are per vertex, concatenated over the submeshes. They are looked up per face corner
+        // through the vertex index, the vertices stay shared between the faces.
+        std::vector<Eigen::Vector2f> vertexUVs;
+        for(size_t t = 0; t < mesh.tex_coordinates.size(); ++t)
+        {
+            vertexUVs.insert(vertexUVs.end(), mesh.tex_coordinates[t].begin(), mesh.tex_coordinates[t].end());
+        }
+        mesh.tex_coordinates.clear();
 
-            for(size_t t = 0; t < mesh.tex_polygons.size(); ++t)
-            {
+        size_t nFaces = 0;
+        for(size_t t = 0; t < model.faces.size(); ++t)
+        {
+            nFaces += model.faces[t].size();
+        }
+        model.uvs.resize(3 * nFaces, Eigen::Vector2f(0.0f, 0.0f));
 
-                for(size_t faceIndex = 0; faceIndex < mesh.tex_polygons[t].size(); ++faceIndex)
+        size_t corner = 0;
+        for(size_t t = 0; t < model.faces.size(); ++t)
+        {
+            const std::vector<pcl::Vertices> &faces = model.faces[t];
+            for(size_t faceIndex = 0; faceIndex < faces.size(); ++faceIndex, corner += 3)
+            {
+                const std::vector<uint32_t> &vertices = faces[faceIndex].vertices;
+                for(size_t k = 0; k < 3 && k < vertices.size(); ++k)
                 {
-                    pcl::Vertices polygon = mesh.tex_polygons[t][faceIndex];
+                    if (vertices[k] < vertexUVs.size())
+                    {
+                        model.uvs[corner + k] = vertexUVs[vertices[k]];
+                    }
+                }
+            }
+        }
+    }
+    else
+    {
+        // Flatten texture coordinates.
+        size_t nTextureCoordinates = 0;
+        for(size_t t = 0; t < mesh.tex_coordinates.size(); ++t)
+        {
+            nTextureCoordinates += mesh.tex_coordinates[t].size();
+        }
+        model.uvs.reserve(nTextureCoordinates);
+        for(size_t t = 0; t < mesh.tex_coordinates.size(); ++t)
+        {
+            model.uvs.insert(model.uvs.end(), mesh.tex_coordinates[t].begin(), mesh.tex_coordinates[t].end());
+        }
+        mesh.tex_coordinates.clear();
+    }
 
-                    // The index to the vertices of the polygon.
-                    size_t v1i = polygon.vertices[0];
-                    size_t v2i = polygon.vertices[1];
-                    size_t v3i = polygon.vertices[2];
+    finishModel(model, primary);
+}
 
-                    // The polygon's points.
-                    pcl::PointXYZ v1 = meshCloud->points[v1i];
-                    pcl::PointXYZ v2 = meshCloud->points[v2i];
-                    pcl::PointXYZ v3 = meshCloud->points[v3i];
+void OdmOrthoPhoto::addModel(const BinaryMesh &mesh, const std::string &name)
+{
+    ProfilePhase phase("prepare_model");
+    bool primary = models_.empty();
+    modelNames_.push_back(name);
 
-                    Eigen::Vector2f vt1 = mesh.tex_coordinates[0][3*faceIndex];
-                    Eigen::Vector2f vt2 = mesh.tex_coordinates[0][3*faceIndex + 1];
-                    Eigen::Vector2f vt3 = mesh.tex_coordinates[0][3*faceIndex + 2];
+    if (mesh.materialCount() == 0)
+    {
+        throw OdmOrthoPhotoException("Model " + name + " has no materials.");
+    }
+
+    // The vertices are read once from the mapping, and moved into position in place.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
+    const float *vertices = mesh.vertices();
+    meshCloud->points.resize(mesh.vertexCount());
+    for (size_t i = 0; i < meshCloud->points.size(); ++i)
+    {
+        meshCloud->points[i] = pcl::PointXYZ(vertices[3*i], vertices[3*i + 1], vertices[3*i + 2]);
+    }
+    meshCloud->width = static_cast<uint32_t>(meshCloud->points.size());
+    meshCloud->height = 1;
 
-                    meshCloudSplit->points.push_back(v1);
-                    textureCoordinates.push_back(vt1);
-                    mesh.tex_polygons[t][faceIndex].vertices[0] = vertexIndexCount;
+    OrthoModel &model = startModel(meshCloud, primary);
 
-                    meshCloudSplit->points.push_back(v2);
-                    textureCoordinates.push_back(vt2);
-                    mesh.tex_polygons[t][faceIndex].vertices[1] = vertexIndexCount;
+    // One submesh per material, the texture coordinates are per face corner in the file already.
+    model.faces.resize(mesh.materialCount());
+    model.materials.reserve(mesh.materialCount());
+    model.uvs.reserve(3 * mesh.faceCount());
+    for (size_t m = 0; m < mesh.materialCount(); ++m)
+    {
+        model.materials.push_back(mesh.texMaterial(m));
 
-                    meshCloudSplit->points.push_back(v3);
-                    textureCoordinates.push_back(vt3);
-                    mesh.tex_polygons[t][faceIndex].vertices[2] = vertexIndexCount;
-                }
-            }
+        BinaryMeshFaces faces = mesh.materialFaces(m);
+        std::vector<pcl::Vertices> &polygons = model.faces[m];
+        polygons.resize(faces.count);
+        for (size_t f = 0; f < faces.count; ++f)
+        {
+            polygons[f].vertices.assign(faces.indices + 3*f, faces.indices + 3*f + 3);
+        }
+        for (size_t k = 0; k < 3 * faces.count; ++k)
+        {
+            model.uvs.push_back(Eigen::Vector2f(faces.texCoords[2*k], faces.texCoords[2*k + 1]));
+        }
+    }
 
-            mesh.tex_coordinates.clear();
-            mesh.tex_coordinates.push_back(textureCoordinates);
+    finishModel(model, primary);
+}
 
-            meshCloud = meshCloudSplit;
+OrthoModel &OdmOrthoPhoto::startModel(pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud, bool primary)
+{
+    Bounds b = computeBoundsForModel(*meshCloud);
+
+    log_ << "Model bounds x : " << b.xMin << " -> " << b.xMax << '\n';
+    log_ << "Model bounds y : " << b.yMin << " -> " << b.yMax << '\n';
+
+    if (primary){
+        modelBounds_ = b;
+        bounds_ = hasWindowBounds_ ? getPixelAlignedBounds(windowBounds_) : b;
+        if (hasWindowBounds_){
+            log_ << "Window bounds x : " << bounds_.xMin << " -> " << bounds_.xMax << '\n';
+            log_ << "Window bounds y : " << bounds_.yMin << " -> " << bounds_.yMax << '\n';
+        }
+    }else{
+        // Quick check
+        if (b.xMin != modelBounds_.xMin ||
+                b.xMax != modelBounds_.xMax ||
+                b.yMin != modelBounds_.yMin ||
+                b.yMax != modelBounds_.yMax){
+            throw OdmOrthoPhotoException("Bounds between models must all match, but they don't.");
         }
+    }
 
-        // Creates a transformation which aligns the area for the ortho photo.
-        Eigen::Transform<float, 3, Eigen::Affine> transform = getROITransform(bounds.xMin, -bounds.yMax);
-        log_ << "Translating and scaling mesh...\n";
+    // The size of the area.
+    float xDiff = bounds_.xMax - bounds_.xMin;
+    float yDiff = bounds_.yMax - bounds_.yMin;
+    log_ << "Model area : " << xDiff*yDiff << "m2\n";
 
-        // Move the mesh into position.
-        pcl::transformPointCloud(*meshCloud, *meshCloud, transform);
-        log_ << ".. mesh translated and scaled.\n\n";
+    // The resolution necessary to fit the area with the given resolution. A window holds a whole number of pixels.
+    if (hasWindowBounds_){
+        height = static_cast<int>(std::lround(static_cast<double>(resolution_)*yDiff));
+        width = static_cast<int>(std::lround(static_cast<double>(resolution_)*xDiff));
+    }else{
+        height = static_cast<int>(std::ceil(resolution_*yDiff));
+        width = static_cast<int>(std::ceil(resolution_*xDiff));
+    }
 
-        // Flatten texture coordinates.
-        std::vector<Eigen::Vector2f> uvs;
-        uvs.reserve(mesh.tex_coordinates.size());
-        for(size_t t = 0; t < mesh.tex_coordinates.size(); ++t)
+    log_ << "Model resolution, width x height : " << width << "x" << height << '\n';
+
+    // Check size of photo.
+    if(0 >= height*width)
+    {
+        if(0 >= height)
+        {
+            log_ << "Warning: ortho photo has zero area, height = " << height << ". Forcing height = 1.\n";
+            height = 1;
+        }
+        if(0 >= width)
+        {
+            log_ << "Warning: ortho photo has zero area, width = " << width << ". Forcing width = 1.\n";
+            width = 1;
+        }
+        log_ << "New ortho photo resolution, width x height : " << width << "x" << height << '\n';
+    }
+
+    // Creates a transformation which aligns the area for the ortho photo.
+    Eigen::Transform<float, 3, Eigen::Affine> transform = getROITransform(bounds_.xMin, -bounds_.yMax);
+    log_ << "Translating and scaling mesh...\n";
+
+    // Move the mesh into position.
+    pcl::transformPointCloud(*meshCloud, *meshCloud, transform);
+    log_ << ".. mesh translated and scaled.\n\n";
+
+    models_.push_back(OrthoModel());
+    OrthoModel &model = models_.back();
+    model.meshCloud = meshCloud;
+    return model;
+}
+
+void OdmOrthoPhoto::finishModel(OrthoModel &model, bool primary)
+{
+    if (hasWindowBounds_){
+        cropModel(model);
+    }
+
+    // The first material determines the bit depth and the number of channels.
+    cv::Mat texture = TextureQueue::readTexture(model.materials[0].tex_file);
+    if (primary) textureDepth_ = texture.depth();
+    else if (textureDepth_ != texture.depth()) throw OdmOrthoPhotoException("Texture depth must be the same for all models");
+    model.channels = texture.channels();
+    textureBytes_ = std::max(textureBytes_, texture.total() * texture.elemSize());
+
+    log_ << "Texture channels: " << model.channels << "\n";
+    if (textureDepth_ == CV_8U){
+        log_ << "Texture depth: 8bit\n";
+    }else if (textureDepth_ == CV_16U){
+        log_ << "Texture depth: 16bit\n";
+    }else if (textureDepth_ == CV_32F){
+        log_ << "Texture depth: 32bit (float)\n";
+    }else{
+        throw OdmOrthoPhotoException("Unsupported bit depth value: " + std::to_string(textureDepth_));
+    }
+
+    // The models of a multispectral camera usually share their geometry, which is then rasterized once per window.
+    model.geometry = models_.size() - 1;
+    for (size_t g = 0; g + 1 < models_.size(); g++){
+        if (models_[g].geometry == g && hasSameGeometry(models_[g], model)){
+            log_ << "Geometry matches " << modelNames_[g] << ", reusing its rasterization.\n";
+            model.geometry = g;
+            model.faceOffsets = models_[g].faceOffsets;
+            model.meshCloud.reset();
+            std::vector<std::vector<pcl::Vertices> >().swap(model.faces);
+            break;
+        }
+    }
+
+    if (model.geometry == models_.size() - 1){
+        prepareFaceRows(model);
+    }
+    prepareFootprints(model, models_[model.geometry]);
+}
+
+void OdmOrthoPhoto::render()
+{
+    ProfilePhase phase("render");
+    if (models_.empty())
+    {
+        throw OdmOrthoPhotoException("Failed to create ortho photo, no texture meshes given.");
+    }
+
+    textureCache_.setMaxBytes(static_cast<size_t>(textureCacheMemory_) * 1024 * 1024);
+
+    GDALDataType dataType = GDT_Byte;
+    size_t sampleSize = sizeof(uint8_t);
+    if (textureDepth_ == CV_16U){
+        dataType = GDT_UInt16;
+        sampleSize = sizeof(uint16_t);
+    }else if (textureDepth_ == CV_32F){
+        dataType = GDT_Float32;
+        sampleSize = sizeof(float);
+    }
+
+    int bandCount = 0;
+    for (size_t m = 0; m < models_.size(); m++){
+        bandCount += models_[m].channels;
+    }
+    bandCount_ = bandCount;
+
+    // The coverage counts the band samples drawn per pixel in a byte.
+    if (bandCount_ > 255){
+        throw OdmOrthoPhotoException("At most 255 bands are supported, the models have " + std::to_string(bandCount_) + ".");
+    }
+
+    if (depthBits_ == 16){
+        for (size_t m = 0; m < models_.size(); m++){
+            if (models_[m].geometry == m) setDepthRange(models_[m]);
+        }
+    }
+
+    size_t pixelBytes = getPixelBytes(sampleSize);
+    int windowRows = height;
+
+    if (maxMemory_ > 0)
+    {
+        // The models, the texture being drawn, the prefetched ones and the cache stay in memory for the whole run.
+        size_t residentBytes = textureBytes_ + getPrefetchBytes() + static_cast<size_t>(textureCacheMemory_) * 1024 * 1024;
+        for (size_t m = 0; m < models_.size(); m++){
+            residentBytes += getModelBytes(models_[m]);
+        }
+
+        double budget = static_cast<double>(maxMemory_) * 1024.0 * 1024.0 - static_cast<double>(residentBytes);
+        double rowBytes = static_cast<double>(width) * static_cast<double>(pixelBytes);
+
+        // Windows are a whole number of GeoTIFF blocks high.
+        int step = getWindowStep();
+        long long rows = static_cast<long long>(budget / rowBytes) / step * step;
+        if (rows < step){
+            log_ << "Warning: -maxMemory " << maxMemory_ << "MB is too low to render " << step << " rows at a time (the models need "
+                 << residentBytes / (1024 * 1024) << "MB). Using " << step << " rows per window.\n";
+            rows = step;
+        }
+        windowRows = static_cast<int>(std::min(rows, static_cast<long long>(height)));
+    }
+
+    bool windowed = windowRows < height;
+    if (windowed){
+        log_ << "Rendering in windows of " << width << "x" << windowRows << " pixels\n";
+    }
+
+    log_ << '\n';
+    log_ << "Writing ortho photo to " << outputFile_ << "\n";
+
+    GDALDatasetH hDstDS = createTIFF(outputFile_, dataType, bandCount, bounds_);
+
+    for (int rowStart = 0; rowStart < height; rowStart += windowRows){
+        window_ = Tile(0, width, rowStart, std::min(rowStart + windowRows, height));
+        if (windowed){
+            log_ << "Rendering rows " << window_.rowMin << " -> " << window_.rowMax << "\n";
+        }
+
+        if (textureDepth_ == CV_8U){
+            renderWindow<uint8_t>(models_, hDstDS, dataType);
+        }else if (textureDepth_ == CV_16U){
+            renderWindow<uint16_t>(models_, hDstDS, dataType);
+        }else if (textureDepth_ == CV_32F){
+            renderWindow<float>(models_, hDstDS, dataType);
+        }
+    }
+
+    {
+        ProfilePhase phase("write_tiff");
+        GDALClose( hDstDS );
+    }
+    Profile::instance().addFileSize("bytes_written", outputFile_);
+
+    if (!outputCornerFile_.empty())
+    {
+        log_ << "Writing corner coordinates to " << outputCornerFile_ << "\n";
+        std::ofstream cornerStream(outputCornerFile_.c_str());
+        if (!cornerStream.is_open())
         {
-            uvs.insert(uvs.end(), mesh.tex_coordinates[t].begin(), mesh.tex_coordinates[t].end());
+            throw OdmOrthoPhotoException("Failed opening output corner file " + outputCornerFile_ + ".");
         }
+        cornerStream.setf(std::ios::scientific, std::ios::floatfield);
+        cornerStream.precision(17);
+        cornerStream << bounds_.xMin << " " << bounds_.yMin << " " << bounds_.xMax << " " << bounds_.yMax;
+        cornerStream.close();
+    }
 
-        // The current material texture
-        cv::Mat texture;
+    log_ << "Orthophoto generation done.\n";
+}
 
-        // Used to keep track of the global face index.
-        size_t faceOff = 0;
+template <typename T>
+void OdmOrthoPhoto::renderWindow(const std::vector<OrthoModel> &models, GDALDatasetH hDstDS, GDALDataType dataType)
+{
+    int windowWidth = window_.colMax - window_.colMin;
+    int windowHeight = window_.rowMax - window_.rowMin;
+
+    try{
+        depth_.create(windowHeight, windowWidth, depthBits_ == 16 ? CV_16U : CV_32F);
+        faceIds_.create(windowHeight, windowWidth, CV_32S);
+        weights_.create(windowHeight, windowWidth, CV_32FC2);
+        initBands<T>();
+    }catch(const std::bad_alloc &){
+        std::stringstream ss;
+        ss << "Couldn't allocate enough memory to render the orthophoto (" << windowWidth << "x" << windowHeight << " cells = "
+           << static_cast<unsigned long long>(windowWidth) * static_cast<unsigned long long>(windowHeight) * getPixelBytes(sizeof(T)) << " bytes). Try to lower -maxMemory, increase the --orthophoto-resolution parameter to a larger integer or add more RAM.";
+        throw OdmOrthoPhotoException(ss.str());
+    }
 
-        log_ << "Rendering the ortho photo...\n";
+    currentBandIndex = 0;
 
-        // Iterate over each part of the mesh (one per material).
-        for(size_t t = 0; t < mesh.tex_materials.size(); ++t)
+    // The model whose geometry is in the visibility buffer.
+    size_t rasterized = models.size();
+
+    for (size_t m = 0; m < models.size(); m++){
+        const OrthoModel &model = models[m];
+
+        if (model.geometry != rasterized){
+            const OrthoModel &geometry = models[model.geometry];
+            log_ << "Rasterizing the geometry of " << modelNames_[model.geometry] << "...\n";
+
+            // Every geometry is rasterized on its own, from an empty depth buffer.
+            ProfilePhase phase("rasterize");
+            if (depthBits_ == 16){
+                depth_.setTo(0);
+                depthMin_ = geometry.depthMin;
+                depthScale_ = geometry.depthScale;
+            }else{
+                depth_.setTo(-std::numeric_limits<float>::infinity());
+            }
+            faceIds_.setTo(-1);
+            for(size_t t = 0; t < geometry.faces.size(); ++t)
+            {
+                // The faces of the current submesh which cover the window, in submesh order.
+                std::vector<size_t> faceList = getWindowFaces(geometry.faceRows[t], geometry.maxFaceRows[t]);
+                if (faceList.empty())
+                {
+                    continue; // Nothing to draw in this window.
+                }
+                if (depthBits_ == 16){
+                    rasterizeTriangles<uint16_t>(geometry.faces[t], faceList, geometry.meshCloud, geometry.faceOffsets[t]);
+                }else{
+                    rasterizeTriangles<float>(geometry.faces[t], faceList, geometry.meshCloud, geometry.faceOffsets[t]);
+                }
+                Profile::instance().addCount("faces_rasterized", faceList.size());
+            }
+            sortVisiblePixels(geometry);
+            rasterized = model.geometry;
+            log_ << "... geometry rasterized\n";
+        }
+
+        log_ << "Rendering the ortho photo from " << modelNames_[m] << "...\n";
+
+        // The parts of the mesh (one per material) with visible pixels. The textures of the parts
+        // whose pyramid levels are not all in the cache are decoded ahead.
+        std::vector<size_t> submeshes;
+        std::vector<uint32_t> levels;
+        std::vector<bool> decode;
+        std::vector<std::string> textureFiles;
+        for(size_t t = 0; t < model.materials.size(); ++t)
         {
-            // The material of the current submesh.
-            pcl::TexMaterial material = mesh.tex_materials[t];
-            texture = cv::imread(material.tex_file, cv::IMREAD_ANYDEPTH | cv::IMREAD_UNCHANGED);
+            if (visibleOffsets_[t] == visibleOffsets_[t + 1])
+            {
+                continue; // No visible pixels in this window.
+            }
 
-            // BGR to RGB when necessary
-            if (texture.channels() == 3){
-                cv::cvtColor(texture, texture, cv::COLOR_BGR2RGB);
+            const std::string &file = model.materials[t].tex_file;
+            cv::Size size;
+            uint32_t mask = textureCache_.getSize(file, size) ? setPixelLevels(model, t, size) : 0;
+            bool cached = mask != 0;
+            for (int level = 0; level < 32 && cached; level++){
+                if ((mask & (1u << level)) != 0 && textureCache_.get(file, level).empty()) cached = false;
             }
 
-            // The first material determines the bit depth
-            // Init ortho photo
-            if (t == 0){
-                if (primary) textureDepth = texture.depth();
-                else if (textureDepth != texture.depth()) throw OdmOrthoPhotoException("Texture depth must be the same for all models");
+            submeshes.push_back(t);
+            levels.push_back(mask);
+            decode.push_back(!cached);
+            if (!cached) textureFiles.push_back(file);
+        }
+        TextureQueue textures(textureFiles, static_cast<size_t>(prefetchTextures_), getPrefetchBytes(), textureBytes_, static_cast<size_t>(threads_));
 
-                log_ << "Texture channels: " << texture.channels() << "\n";
+        for(size_t i = 0; i < submeshes.size(); ++i)
+        {
+            size_t t = submeshes[i];
 
-                try{
-                    if (textureDepth == CV_8U){
-                        log_ << "Texture depth: 8bit\n";
-                        initBands<uint8_t>(texture.channels());
-                        if (primary) initAlphaBand<uint8_t>();
-                    }else if (textureDepth == CV_16U){
-                        log_ << "Texture depth: 16bit\n";
-                        initBands<uint16_t>(texture.channels());
-                        if (primary) initAlphaBand<uint16_t>();
-                    }else if (textureDepth == CV_32F){
-                        log_ << "Texture depth: 32bit (float)\n";
-                        initBands<float>(texture.channels());
-                        if (primary) initAlphaBand<float>();
-                    }else{
-                        std::cerr << "Unsupported bit depth value: " << textureDepth;
-                        exit(1);
-                    }
-                }catch(const std::bad_alloc &){
-                    std::cerr << "Couldn't allocate enough memory to render the orthophoto (" << width << "x" << height << " cells = " << ((long long)width * (long long)height * 4) << " bytes). Try to increase the --orthophoto-resolution parameter to a larger integer or add more RAM.\n";
-                    exit(1);
+            // The material of the current submesh.
+            const pcl::TexMaterial &material = model.materials[t];
+            cv::Mat texture;
+            if (decode[i])
+            {
+                ProfilePhase phase("texture_wait");
+                texture = textures.next();
+                if (!texture.empty())
+                {
+                    textureCache_.setSize(material.tex_file, texture.size());
+                    levels[i] = setPixelLevels(model, t, texture.size());
                 }
             }
 
+            // Draw every level of the pyramid used by the faces into the ortho photo.
+            ProfilePhase phase("shade");
+            bool rendered = false;
+            for (int level = 0; level < 32 && (!decode[i] || !texture.empty()); level++){
+                if ((levels[i] & (1u << level)) == 0) continue;
+
+                cv::Mat texels = getTextureLevel(material.tex_file, level, texture);
+                if (texels.empty()) break;
+                shadeSubmesh<T>(texels, model.uvs, t, level);
+                rendered = true;
+            }
+
             // Check for missing files.
-            if(texture.empty())
+            if(!rendered)
             {
                 log_ << "Material texture could not be read:\n";
                 log_ << material.tex_file << '\n';
                 log_ << "Could not be read as image, does the file exist?\n";
                 continue; // Skip to next material.
             }
+            Profile::instance().addCount("pixels_shaded", visibleOffsets_[t + 1] - visibleOffsets_[t]);
+            log_ << "Material " << t << " rendered.\n";
+        }
+        log_ << "... model rendered\n";
+
+        currentBandIndex += model.channels;
+    }
+
+    {
+        ProfilePhase phase("write_tiff");
+        writeWindow<T>(hDstDS, dataType);
+    }
+    releaseBands();
+}
+
+Bounds OdmOrthoPhoto::getPixelAlignedBounds(const Bounds &window) const
+{
+    double resolution = static_cast<double>(resolution_);
+    return Bounds(static_cast<float>(std::floor(window.xMin * resolution) / resolution),
+                  static_cast<float>(std::ceil(window.xMax * resolution) / resolution),
+                  static_cast<float>(std::floor(window.yMin * resolution) / resolution),
+                  static_cast<float>(std::ceil(window.yMax * resolution) / resolution));
+}
+
+void OdmOrthoPhoto::cropModel(OrthoModel &model)
+{
+    ProfilePhase phase("crop_model");
+    const std::vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ> > &points = model.meshCloud->points;
 
-            // The faces of the current submesh.
-            std::vector<pcl::Vertices> faces = mesh.tex_polygons[t];
+    // The new index of each vertex used by a kept face, -1 for the others.
+    std::vector<int64_t> vertexMap(points.size(), -1);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
+    std::vector<Eigen::Vector2f> uvs;
+
+    size_t faceOff = 0;
+    size_t total = 0;
+    for(size_t t = 0; t < model.faces.size(); ++t)
+    {
+        std::vector<pcl::Vertices> &faces = model.faces[t];
+        size_t kept = 0;
+        for(size_t faceIndex = 0; faceIndex < faces.size(); ++faceIndex)
+        {
+            pcl::Vertices &polygon = faces[faceIndex];
+            const pcl::PointXYZ &v1 = points[polygon.vertices[0]];
+            const pcl::PointXYZ &v2 = points[polygon.vertices[1]];
+            const pcl::PointXYZ &v3 = points[polygon.vertices[2]];
+
+            // The vertices are in pixel coordinates, the photo is the window.
+            if (std::max(v1.x, std::max(v2.x, v3.x)) < 0.0f || std::min(v1.x, std::min(v2.x, v3.x)) > static_cast<float>(width) ||
+                std::max(v1.y, std::max(v2.y, v3.y)) < 0.0f || std::min(v1.y, std::min(v2.y, v3.y)) > static_cast<float>(height))
+            {
+                continue;
+            }
 
-            // Iterate over each face...
-            for(size_t faceIndex = 0; faceIndex < faces.size(); ++faceIndex)
+            for (size_t k = 0; k < 3; ++k)
             {
-                // The current polygon.
-                pcl::Vertices polygon = faces[faceIndex];
-
-                // ... and draw it into the ortho photo.
-                if (textureDepth == CV_8U){
-                    drawTexturedTriangle<uint8_t>(texture, polygon, meshCloud, uvs, faceIndex+faceOff);
-                }else if (textureDepth == CV_16U){
-                    drawTexturedTriangle<uint16_t>(texture, polygon, meshCloud, uvs, faceIndex+faceOff);
-                }else if (textureDepth == CV_32F){
-                    drawTexturedTriangle<float>(texture, polygon, meshCloud, uvs, faceIndex+faceOff);
+                uint32_t &vertex = polygon.vertices[k];
+                if (vertexMap[vertex] < 0)
+                {
+                    vertexMap[vertex] = static_cast<int64_t>(meshCloud->points.size());
+                    meshCloud->points.push_back(points[vertex]);
                 }
+                vertex = static_cast<uint32_t>(vertexMap[vertex]);
+                uvs.push_back(model.uvs[3*(faceOff + faceIndex) + k]);
             }
-            faceOff += faces.size();
-            log_ << "Material " << t << " rendered.\n";
+            if (kept != faceIndex)
+            {
+                faces[kept] = std::move(polygon);
+            }
+            ++kept;
         }
-        log_ << "... model rendered\n";
+        faceOff += faces.size();
+        total += faces.size();
+        faces.resize(kept);
+        std::vector<pcl::Vertices>(faces.begin(), faces.end()).swap(faces);
+    }
 
-        currentBandIndex += texture.channels();
-        primary = false;
+    size_t kept = uvs.size() / 3;
+    log_ << "Faces overlapping the window: " << kept << " of " << total << "\n";
+    if (kept == 0)
+    {
+        log_.warning() << "Warning: no face of the model overlaps the window, the photo is left empty.\n";
     }
+    Profile::instance().addCount("faces_cropped", total - kept);
 
-    log_ << '\n';
-    log_ << "Writing ortho photo to " << outputFile_ << "\n";
+    meshCloud->width = static_cast<uint32_t>(meshCloud->points.size());
+    meshCloud->height = 1;
+    model.meshCloud = meshCloud;
+    model.uvs.swap(uvs);
+}
 
-    if (textureDepth == CV_8U){
-        saveTIFF(outputFile_, GDT_Byte);
-    }else if (textureDepth == CV_16U){
-        saveTIFF(outputFile_, GDT_UInt16);
-    }else if (textureDepth == CV_32F){
-        saveTIFF(outputFile_, GDT_Float32);
-    }else{
-        std::cerr << "Unsupported bit depth value: " << textureDepth;
-        exit(1);
+void OdmOrthoPhoto::prepareFaceRows(OrthoModel &model)
+{
+    Tile photo(0, width, 0, height);
+    size_t faceOff = 0;
+    uint64_t totalSlivers = 0;
+
+    model.faceRows.resize(model.faces.size());
+    model.maxFaceRows.resize(model.faces.size(), 0);
+    model.faceOffsets.resize(model.faces.size(), 0);
+
+    for(size_t t = 0; t < model.faces.size(); ++t)
+    {
+        const std::vector<pcl::Vertices> &faces = model.faces[t];
+        std::vector<FaceRows> &faceRows = model.faceRows[t];
+        faceRows.reserve(faces.size());
+        model.faceOffsets[t] = faceOff;
+        uint64_t slivers = 0;
+
+        for(size_t faceIndex = 0; faceIndex < faces.size(); ++faceIndex)
+        {
+            const pcl::Vertices &polygon = faces[faceIndex];
+            const pcl::PointXYZ &v1 = model.meshCloud->points[polygon.vertices[0]];
+            const pcl::PointXYZ &v2 = model.meshCloud->points[polygon.vertices[1]];
+            const pcl::PointXYZ &v3 = model.meshCloud->points[polygon.vertices[2]];
+
+            if(isSliverPolygon(v1, v2, v3))
+            {
+                log_.debug() << "Sliver polygon found at face index " << faceIndex + faceOff << '\n';
+                ++slivers;
+                continue;
+            }
+
+            FaceRows rows(height, 0, faceIndex);
+            forEachTriangleSpan(v1, v2, v3, photo, [&rows](int row, int, int){
+                rows.rowMin = std::min(rows.rowMin, row);
+                rows.rowMax = std::max(rows.rowMax, row + 1);
+            });
+            if (rows.rowMin >= rows.rowMax) continue; // Covers no pixels.
+
+            faceRows.push_back(rows);
+            model.maxFaceRows[t] = std::max(model.maxFaceRows[t], rows.rowMax - rows.rowMin);
+        }
+
+        std::sort(faceRows.begin(), faceRows.end(), [](const FaceRows &a, const FaceRows &b){
+            return a.rowMin < b.rowMin || (a.rowMin == b.rowMin && a.face < b.face);
+        });
+
+        if (slivers > 0)
+        {
+            log_.warning() << "Warning: skipped " << slivers << " sliver polygons of the " << faces.size() << " faces of material " << t << "\n";
+        }
+        totalSlivers += slivers;
+        faceOff += faces.size();
     }
+    Profile::instance().addCount("sliver_faces_skipped", totalSlivers);
+}
 
-    if (!outputCornerFile_.empty())
+void OdmOrthoPhoto::prepareFootprints(OrthoModel &model, const OrthoModel &geometry)
+{
+    model.footprints.assign(model.uvs.size() / 3, 0.0f);
+
+    for(size_t t = 0; t < geometry.faces.size(); ++t)
     {
-        log_ << "Writing corner coordinates to " << outputCornerFile_ << "\n";
-        std::ofstream cornerStream(outputCornerFile_.c_str());
-        if (!cornerStream.is_open())
+        for(size_t faceIndex = 0; faceIndex < geometry.faces[t].size(); ++faceIndex)
         {
-            throw OdmOrthoPhotoException("Failed opening output corner file " + outputCornerFile_ + ".");
+            const pcl::Vertices &polygon = geometry.faces[t][faceIndex];
+            const pcl::PointXYZ &v1 = geometry.meshCloud->points[polygon.vertices[0]];
+            const pcl::PointXYZ &v2 = geometry.meshCloud->points[polygon.vertices[1]];
+            const pcl::PointXYZ &v3 = geometry.meshCloud->points[polygon.vertices[2]];
+
+            size_t f = geometry.faceOffsets[t] + faceIndex;
+            const Eigen::Vector2f &uv1 = model.uvs[3*f];
+            const Eigen::Vector2f &uv2 = model.uvs[3*f + 1];
+            const Eigen::Vector2f &uv3 = model.uvs[3*f + 2];
+
+            // Twice the areas of the face in the photo, in pixels, and in the texture, in uv units.
+            double pixelArea = std::fabs(static_cast<double>(v2.x - v1.x) * static_cast<double>(v3.y - v1.y) -
+                                         static_cast<double>(v3.x - v1.x) * static_cast<double>(v2.y - v1.y));
+            double uvArea = std::fabs(static_cast<double>(uv2[0] - uv1[0]) * static_cast<double>(uv3[1] - uv1[1]) -
+                                      static_cast<double>(uv3[0] - uv1[0]) * static_cast<double>(uv2[1] - uv1[1]));
+            if (pixelArea > 0.0)
+            {
+                model.footprints[f] = static_cast<float>(0.5 * std::log2(uvArea / pixelArea));
+            }
         }
-        cornerStream.setf(std::ios::scientific, std::ios::floatfield);
-        cornerStream.precision(17);
-        cornerStream << bounds.xMin << " " << bounds.yMin << " " << bounds.xMax << " " << bounds.yMax;
-        cornerStream.close();
     }
+}
 
-    log_ << "Orthophoto generation done.\n";
+std::vector<size_t> OdmOrthoPhoto::getWindowFaces(const std::vector<FaceRows> &faceRows, int maxFaceRows) const
+{
+    std::vector<size_t> faceList;
+
+    // Faces starting more than maxFaceRows rows above the window cannot reach into it.
+    int firstRow = window_.rowMin - maxFaceRows + 1;
+    auto it = std::lower_bound(faceRows.begin(), faceRows.end(), firstRow, [](const FaceRows &f, int row){
+        return f.rowMin < row;
+    });
+
+    for (; it != faceRows.end() && it->rowMin < window_.rowMax; ++it){
+        if (it->rowMax > window_.rowMin){
+            faceList.push_back(it->face);
+        }
+    }
+
+    // Back to submesh order, faces drawn later win depth ties.
+    std::sort(faceList.begin(), faceList.end());
+    return faceList;
+}
+
+size_t OdmOrthoPhoto::getPixelBytes(size_t sampleSize) const
+{
+    // The bands, the coverage, the depth and the visibility buffer (face, two barycentric weights,
+    // the position in the list of visible pixels and the pyramid level).
+    size_t depthSize = depthBits_ == 16 ? sizeof(uint16_t) : sizeof(float);
+    return sampleSize * static_cast<size_t>(bandCount_) + sizeof(uint8_t) + depthSize +
+           sizeof(int32_t) + 2 * sizeof(float) + sizeof(size_t) + sizeof(uint8_t);
+}
+
+size_t OdmOrthoPhoto::getPrefetchBytes() const
+{
+    if (prefetchTextures_ == 0 || prefetchMemory_ == 0)
+    {
+        return static_cast<size_t>(prefetchTextures_) * textureBytes_;
+    }
+
+    // The next texture is decoded even when it does not fit.
+    size_t budget = static_cast<size_t>(prefetchMemory_) * 1024 * 1024;
+    return std::max(textureBytes_, std::min(budget, static_cast<size_t>(prefetchTextures_) * textureBytes_));
+}
+
+void OdmOrthoPhoto::setDepthRange(OrthoModel &model)
+{
+    float zMin = std::numeric_limits<float>::infinity();
+    float zMax = -std::numeric_limits<float>::infinity();
+    const std::vector<pcl::PointXYZ, Eigen::aligned_allocator<pcl::PointXYZ> > &points = model.meshCloud->points;
+    for (size_t i = 0; i < points.size(); i++){
+        if (!std::isfinite(points[i].z)) continue;
+        zMin = std::min(zMin, points[i].z);
+        zMax = std::max(zMax, points[i].z);
+    }
+
+    model.depthMin = zMin <= zMax ? zMin : 0.0f;
+    model.depthScale = zMin < zMax ? 65534.0f / (zMax - zMin) : 0.0f;
+    if (model.depthScale > 0.0f){
+        log_ << "Depths are quantized to 16 bits, in steps of " << 1.0f / model.depthScale << "m\n";
+    }
+}
+
+size_t OdmOrthoPhoto::getModelBytes(const OrthoModel &model) const
+{
+    size_t bytes = model.uvs.size() * sizeof(Eigen::Vector2f) + model.footprints.size() * sizeof(float);
+    if (model.meshCloud)
+    {
+        bytes += model.meshCloud->points.size() * sizeof(pcl::PointXYZ);
+    }
+    for(size_t t = 0; t < model.faces.size(); ++t)
+    {
+        // A face is a vector of three indices on the heap.
+        bytes += model.faces[t].size() * (sizeof(pcl::Vertices) + 3 * sizeof(uint32_t) + 16) +
+                 model.faceRows[t].size() * sizeof(FaceRows);
+    }
+    return bytes;
+}
+
+bool OdmOrthoPhoto::hasSameGeometry(const OrthoModel &a, const OrthoModel &b) const
+{
+    if (a.faces.size() != b.faces.size())
+    {
+        return false;
+    }
+
+    for(size_t t = 0; t < a.faces.size(); ++t)
+    {
+        if (a.faces[t].size() != b.faces[t].size())
+        {
+            return false;
+        }
+
+        // Vertex indices may differ (split models), positions may not.
+        for(size_t faceIndex = 0; faceIndex < a.faces[t].size(); ++faceIndex)
+        {
+            for(size_t i = 0; i < 3; ++i)
+            {
+                const pcl::PointXYZ &p = a.meshCloud->points[a.faces[t][faceIndex].vertices[i]];
+                const pcl::PointXYZ &q = b.meshCloud->points[b.faces[t][faceIndex].vertices[i]];
+                if (p.x != q.x || p.y != q.y || p.z != q.z)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
 }
 
-Bounds OdmOrthoPhoto::computeBoundsForModel(const pcl::TextureMesh &mesh)
+Bounds OdmOrthoPhoto::computeBoundsForModel(const pcl::PointCloud<pcl::PointXYZ> &meshCloud)
 {
     log_ << "Set boundary to contain entire model.\n";
 
@@ -599,97 +1655,422 @@ Bounds OdmOrthoPhoto::computeBoundsForModel(const pcl::TextureMesh &mesh)
     r.yMin = std::numeric_limits<float>::infinity();
     r.yMax = -std::numeric_limits<float>::infinity();
 
-    // Contains the vertices of the mesh.
-    pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud (new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::fromPCLPointCloud2 (mesh.cloud, *meshCloud);
+    for (size_t i = 0; i < meshCloud.points.size(); i++){
+        const pcl::PointXYZ &v = meshCloud.points[i];
+        r.xMin = std::min(r.xMin, v.x);
+        r.xMax = std::max(r.xMax, v.x);
+        r.yMin = std::min(r.yMin, v.y);
+        r.yMax = std::max(r.yMax, v.y);
+    }
+
+    log_ << "Boundary points:\n";
+    log_ << "Point 1: " << r.xMin << " " << r.yMin << "\n";
+    log_ << "Point 2: " << r.xMin << " " << r.yMax << "\n";
+    log_ << "Point 3: " << r.xMax << " " << r.yMax << "\n";
+    log_ << "Point 4: " << r.xMax << " " << r.yMin << "\n";
+    log_ << "\n";
+
+    return r;
+}
+
+Eigen::Transform<float, 3, Eigen::Affine> OdmOrthoPhoto::getROITransform(float xMin, float yMin) const
+{
+    // The transform used to move the chosen area into the ortho photo.
+    Eigen::Transform<float, 3, Eigen::Affine> transform;
+
+    transform(0, 0) = resolution_;     // x Scaling.
+    transform(1, 0) = 0.0f;
+    transform(2, 0) = 0.0f;
+    transform(3, 0) = 0.0f;
+
+    transform(0, 1) = 0.0f;
+    transform(1, 1) = -resolution_;     // y Scaling, mirrored for easier rendering.
+    transform(2, 1) = 0.0f;
+    transform(3, 1) = 0.0f;
+
+    transform(0, 2) = 0.0f;
+    transform(1, 2) = 0.0f;
+    transform(2, 2) = 1.0f;
+    transform(3, 2) = 0.0f;
+
+    transform(0, 3) = -xMin * resolution_;    // x Translation
+    transform(1, 3) = -yMin * resolution_;    // y Translation
+    transform(2, 3) = 0.0f;
+    transform(3, 3) = 1.0f;
+
+    return transform;
+}
+
+template <typename D>
+void OdmOrthoPhoto::rasterizeTriangles(const std::vector<pcl::Vertices> &faces, const std::vector<size_t> &faceList, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, size_t faceOff)
+{
+    if (threads_ <= 1)
+    {
+        for(size_t i = 0; i < faceList.size(); ++i)
+        {
+            rasterizeTriangle<D>(faces[faceList[i]], meshCloud, faceList[i] + faceOff, window_);
+        }
+        return;
+    }
+
+    int tilesX = (window_.colMax - window_.colMin + tileSize_ - 1) / tileSize_;
+    int tilesY = (window_.rowMax - window_.rowMin + tileSize_ - 1) / tileSize_;
+
+    // The faces covering each tile, in submesh order.
+    std::vector<std::vector<size_t> > bins(static_cast<size_t>(tilesX) * static_cast<size_t>(tilesY));
+
+    for(size_t i = 0; i < faceList.size(); ++i)
+    {
+        const pcl::Vertices &polygon = faces[faceList[i]];
+        const pcl::PointXYZ &v1 = meshCloud->points[polygon.vertices[0]];
+        const pcl::PointXYZ &v2 = meshCloud->points[polygon.vertices[1]];
+        const pcl::PointXYZ &v3 = meshCloud->points[polygon.vertices[2]];
+
+        // The exact pixel extent of the face inside the window, found by walking
+        // its spans the same way rasterizeTriangle does.
+        Tile extent(window_.colMax, window_.colMin, window_.rowMax, window_.rowMin);
+        forEachTriangleSpan(v1, v2, v3, window_, [&extent](int row, int colStart, int colEnd){
+            extent.colMin = std::min(extent.colMin, colStart);
+            extent.colMax = std::max(extent.colMax, colEnd);
+            extent.rowMin = std::min(extent.rowMin, row);
+            extent.rowMax = std::max(extent.rowMax, row + 1);
+        });
+        if (extent.colMin >= extent.colMax || extent.rowMin >= extent.rowMax) continue;
+
+        for (int ty = (extent.rowMin - window_.rowMin) / tileSize_; ty <= (extent.rowMax - 1 - window_.rowMin) / tileSize_; ty++){
+            for (int tx = (extent.colMin - window_.colMin) / tileSize_; tx <= (extent.colMax - 1 - window_.colMin) / tileSize_; tx++){
+                bins[static_cast<size_t>(ty) * static_cast<size_t>(tilesX) + static_cast<size_t>(tx)].push_back(faceList[i]);
+            }
+        }
+    }
+
+    std::vector<size_t> activeTiles;
+    for (size_t i = 0; i < bins.size(); i++){
+        if (!bins[i].empty()) activeTiles.push_back(i);
+    }
+
+    // Tiles do not share pixels, so workers can pick them up in any order.
+    std::atomic<size_t> nextTile(0);
+    auto worker = [&](){
+        for (size_t i = nextTile++; i < activeTiles.size(); i = nextTile++){
+            size_t tileIndex = activeTiles[i];
+            int colMin = window_.colMin + static_cast<int>(tileIndex % static_cast<size_t>(tilesX)) * tileSize_;
+            int rowMin = window_.rowMin + static_cast<int>(tileIndex / static_cast<size_t>(tilesX)) * tileSize_;
+            Tile tile(colMin, std::min(colMin + tileSize_, window_.colMax),
+                      rowMin, std::min(rowMin + tileSize_, window_.rowMax));
+
+            const std::vector<size_t> &bin = bins[tileIndex];
+            for (size_t j = 0; j < bin.size(); j++){
+                rasterizeTriangle<D>(faces[bin[j]], meshCloud, bin[j] + faceOff, tile);
+            }
+        }
+    };
+
+    boost::thread_group threads;
+    size_t numThreads = std::min(static_cast<size_t>(threads_), activeTiles.size());
+    for (size_t t = 0; t < numThreads; ++t)
+    {
+        threads.create_thread(worker);
+    }
+    threads.join_all();
+}
+
+template <typename D>
+void OdmOrthoPhoto::rasterizeTriangle(const pcl::Vertices &polygon, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, size_t faceIndex, const Tile &tile)
+{
+    // The index to the vertices of the polygon.
+    size_t v1i = polygon.vertices[0];
+    size_t v2i = polygon.vertices[1];
+    size_t v3i = polygon.vertices[2];
+
+    // The polygon's points.
+    pcl::PointXYZ v1 = meshCloud->points[v1i];
+    pcl::PointXYZ v2 = meshCloud->points[v2i];
+    pcl::PointXYZ v3 = meshCloud->points[v3i];
+
+    // Get vertex position.
+    float v1z = v1.z;
+    float v2z = v2.z;
+    float v3z = v3.z;
+
+    int32_t face = static_cast<int32_t>(faceIndex);
+    DepthBuffer<D> depthBuffer(depthMin_, depthScale_);
+
+    // The barycentric coordinates and the depth are linear over the triangle, so they are
+    // evaluated at the start of every span and stepped along it. A pixel adds its offset in
+    // the span times the step to the start, so rounding errors do not pile up on long spans.
+    float y2y3 = v2.y-v3.y;
+    float y1y3 = v1.y-v3.y;
+    float y3y1 = v3.y-v1.y;
+    float x3x2 = v3.x-v2.x;
+    float x1x3 = v1.x-v3.x;
+    float invNorm = 1.0f / (y2y3*x1x3 + x3x2*y1y3);
+
+    // The steps of l1, l2 and z from one pixel to the next.
+    float dl1 = y2y3*invNorm;
+    float dl2 = y3y1*invNorm;
+    float dz = (v1z - v3z)*dl1 + (v2z - v3z)*dl2;
+
+    forEachTriangleSpan(v1, v2, v3, tile, [&](int rq, int cqStart, int cqEnd){
+        // The values at the center of the first pixel of the span.
+        float yy3 = (static_cast<float>(rq)+0.5f) - v3.y;
+        float xx3 = (static_cast<float>(cqStart)+0.5f) - v3.x;
+        float l1 = (y2y3*xx3 + x3x2*yy3)*invNorm;
+        float l2 = (y3y1*xx3 + x1x3*yy3)*invNorm;
+        float z = v1z*l1 + v2z*l2 + v3z*(1.0f - l1 - l2);
+
+        int row = rq - window_.rowMin;
+        D *depth = depth_.ptr<D>(row);
+        int32_t *faceIds = faceIds_.ptr<int32_t>(row);
+        float *weights = &weights_.ptr<cv::Vec2f>(row)[0][0];
+
+        int cq = cqStart;
+        // There is only an SSE2 path, which every x86-64 target has. AVX2 would need per-target
+        // compile flags and runtime dispatch, which this build does not have. Other targets, NEON
+        // included, use the scalar loop below.
+#if defined(__SSE2__)
+        if (cqEnd - cq >= 4)
+        {
+            const __m128 four = _mm_set1_ps(4.0f);
+            const __m128 vl1 = _mm_set1_ps(l1);
+            const __m128 vl2 = _mm_set1_ps(l2);
+            const __m128 vz = _mm_set1_ps(z);
+            const __m128 vdl1 = _mm_set1_ps(dl1);
+            const __m128 vdl2 = _mm_set1_ps(dl2);
+            const __m128 vdz = _mm_set1_ps(dz);
+            const __m128i vface = _mm_set1_epi32(face);
+
+            // Four pixels at a time, the offsets of the pixels in the span step by four.
+            __m128 offsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            for(; cq + 4 <= cqEnd; cq += 4, offsets = _mm_add_ps(offsets, four))
+            {
+                __m128 l1v = _mm_add_ps(vl1, _mm_mul_ps(offsets, vdl1));
+                __m128 l2v = _mm_add_ps(vl2, _mm_mul_ps(offsets, vdl2));
+                __m128 zv = _mm_add_ps(vz, _mm_mul_ps(offsets, vdz));
+
+                // Drawn unless behind another, like the scalar test below.
+                int col = cq - window_.colMin;
+                __m128 zq = depthBuffer.quantize(zv);
+                __m128 d = DepthBuffer<D>::load(depth + col);
+                __m128 drawn = _mm_cmpnlt_ps(zq, d);
+                int mask = _mm_movemask_ps(drawn);
+                if (mask == 0) continue;
+
+                DepthBuffer<D>::store(depth + col, _mm_or_ps(_mm_and_ps(drawn, zq), _mm_andnot_ps(drawn, d)));
+
+                __m128i drawnInt = _mm_castps_si128(drawn);
+                __m128i ids = _mm_loadu_si128(reinterpret_cast<const __m128i *>(faceIds + col));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(faceIds + col), _mm_or_si128(_mm_and_si128(drawnInt, vface), _mm_andnot_si128(drawnInt, ids)));
+
+                // The weights are stored interleaved, two pixels per register.
+                __m128 drawnLow = _mm_unpacklo_ps(drawn, drawn);
+                __m128 drawnHigh = _mm_unpackhi_ps(drawn, drawn);
+                __m128 wLow = _mm_loadu_ps(weights + 2 * col);
+                __m128 wHigh = _mm_loadu_ps(weights + 2 * col + 4);
+                _mm_storeu_ps(weights + 2 * col, _mm_or_ps(_mm_and_ps(drawnLow, _mm_unpacklo_ps(l1v, l2v)), _mm_andnot_ps(drawnLow, wLow)));
+                _mm_storeu_ps(weights + 2 * col + 4, _mm_or_ps(_mm_and_ps(drawnHigh, _mm_unpackhi_ps(l1v, l2v)), _mm_andnot_ps(drawnHigh, wHigh)));
+            }
+        }
+#endif
+
+        for(; cq < cqEnd; ++cq)
+        {
+            // The same arithmetic as the vector path.
+            float offset = static_cast<float>(cq - cqStart);
+            float l1q = l1 + offset*dl1;
+            float l2q = l2 + offset*dl2;
 
-    for (size_t i = 0; i < meshCloud->points.size(); i++){
-        pcl::PointXYZ v = meshCloud->points[i];
-        r.xMin = std::min(r.xMin, v.x);
-        r.xMax = std::max(r.xMax, v.x);
-        r.yMin = std::min(r.yMin, v.y);
-        r.yMax = std::max(r.yMax, v.y);
-    }
+            // The z value for the point, as stored in the depth buffer.
+            float zq = depthBuffer.quantize(z + offset*dz);
 
-    log_ << "Boundary points:\n";
-    log_ << "Point 1: " << r.xMin << " " << r.yMin << "\n";
-    log_ << "Point 2: " << r.xMin << " " << r.yMax << "\n";
-    log_ << "Point 3: " << r.xMax << " " << r.yMax << "\n";
-    log_ << "Point 4: " << r.xMax << " " << r.yMin << "\n";
-    log_ << "\n";
+            // Check depth
+            int col = cq - window_.colMin;
+            if(zq < depth[col])
+            {
+                // Current is behind another, don't draw.
+                continue;
+            }
 
-    return r;
+            // Update the visibility and depth buffers.
+            faceIds[col] = face;
+            weights[2 * col] = l1q;
+            weights[2 * col + 1] = l2q;
+            depth[col] = static_cast<D>(zq);
+        }
+    });
 }
 
-Eigen::Transform<float, 3, Eigen::Affine> OdmOrthoPhoto::getROITransform(float xMin, float yMin) const
+void OdmOrthoPhoto::sortVisiblePixels(const OrthoModel &model)
 {
-    // The transform used to move the chosen area into the ortho photo.
-    Eigen::Transform<float, 3, Eigen::Affine> transform;
+    size_t pixelCount = faceIds_.total();
+    const int32_t *faceIds = faceIds_.ptr<int32_t>();
+
+    // The submesh of a face. Empty submeshes share their offset with the next one, upper_bound skips them.
+    auto submeshOf = [&model](int32_t face){
+        return static_cast<size_t>(std::upper_bound(model.faceOffsets.begin(), model.faceOffsets.end(), static_cast<size_t>(face)) - model.faceOffsets.begin()) - 1;
+    };
+
+    // Counting sort of the covered pixels by submesh, each bucket stays in scanline order.
+    visibleOffsets_.assign(model.faceOffsets.size() + 1, 0);
+    for (size_t i = 0; i < pixelCount; i++){
+        if (faceIds[i] >= 0) visibleOffsets_[submeshOf(faceIds[i]) + 1]++;
+    }
+    for (size_t t = 1; t < visibleOffsets_.size(); t++){
+        visibleOffsets_[t] += visibleOffsets_[t - 1];
+    }
 
-    transform(0, 0) = resolution_;     // x Scaling.
-    transform(1, 0) = 0.0f;
-    transform(2, 0) = 0.0f;
-    transform(3, 0) = 0.0f;
+    visiblePixels_.resize(visibleOffsets_.back());
+    pixelLevels_.assign(visibleOffsets_.back(), 0);
+    std::vector<size_t> next(visibleOffsets_.begin(), visibleOffsets_.end() - 1);
+    for (size_t i = 0; i < pixelCount; i++){
+        if (faceIds[i] >= 0) visiblePixels_[next[submeshOf(faceIds[i])]++] = i;
+    }
+}
 
-    transform(0, 1) = 0.0f;
-    transform(1, 1) = -resolution_;     // y Scaling, mirrored for easier rendering.
-    transform(2, 1) = 0.0f;
-    transform(3, 1) = 0.0f;
+uint32_t OdmOrthoPhoto::setPixelLevels(const OrthoModel &model, size_t submesh, const cv::Size &size)
+{
+    int maxLevel = TextureCache::getMaxLevel(size);
+    float maxFootprint = static_cast<float>(maxLevel);
+
+    // The base 2 logarithm of the side of the texture, in texels.
+    float bias = 0.5f * std::log2(static_cast<float>(size.width) * static_cast<float>(size.height));
+
+    const int32_t *faceIds = faceIds_.ptr<int32_t>();
+    uint32_t mask = 0;
+    for (size_t i = visibleOffsets_[submesh]; i < visibleOffsets_[submesh + 1]; i++){
+        // The level where a pixel covers one to two texels across.
+        float footprint = model.footprints[static_cast<size_t>(faceIds[visiblePixels_[i]])] + bias;
+        int level = 0;
+        if (footprint >= maxFootprint) level = maxLevel;
+        else if (footprint >= 1.0f) level = static_cast<int>(footprint);
+
+        pixelLevels_[i] = static_cast<uint8_t>(level);
+        mask |= 1u << level;
+    }
+    return mask;
+}
 
-    transform(0, 2) = 0.0f;
-    transform(1, 2) = 0.0f;
-    transform(2, 2) = 1.0f;
-    transform(3, 2) = 0.0f;
+cv::Mat OdmOrthoPhoto::getTextureLevel(const std::string &file, int level, cv::Mat &texture)
+{
+    cv::Mat texels = textureCache_.get(file, level);
+    if (!texels.empty())
+    {
+        return texels;
+    }
 
-    transform(0, 3) = -xMin * resolution_;    // x Translation
-    transform(1, 3) = -yMin * resolution_;    // y Translation
-    transform(2, 3) = 0.0f;
-    transform(3, 3) = 1.0f;
+    // Start from the finest level at hand.
+    int from = level - 1;
+    for (; from > 0 && texels.empty(); --from)
+    {
+        texels = textureCache_.get(file, from);
+    }
+    if (texels.empty())
+    {
+        if (texture.empty()) texture = TextureQueue::readTexture(file); // Dropped from the cache since planned.
+        if (texture.empty()) return texels;
+        texels = texture;
+        from = 0;
+    }
+    else
+    {
+        ++from;
+    }
 
-    return transform;
+    for (; from < level; ++from)
+    {
+        texels = TextureCache::downsample(texels);
+    }
+    textureCache_.put(file, level, texels);
+    return texels;
 }
 
 template <typename T>
-void OdmOrthoPhoto::drawTexturedTriangle(const cv::Mat &texture, const pcl::Vertices &polygon, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, const std::vector<Eigen::Vector2f> &uvs, size_t faceIndex)
+void OdmOrthoPhoto::shadeSubmesh(const cv::Mat &texture, const std::vector<Eigen::Vector2f> &uvs, size_t submesh, int level)
 {
-    // The index to the vertices of the polygon.
-    size_t v1i = polygon.vertices[0];
-    size_t v2i = polygon.vertices[1];
-    size_t v3i = polygon.vertices[2];
-
-    // The polygon's points.
-    pcl::PointXYZ v1 = meshCloud->points[v1i];
-    pcl::PointXYZ v2 = meshCloud->points[v2i];
-    pcl::PointXYZ v3 = meshCloud->points[v3i];
+    size_t begin = visibleOffsets_[submesh];
+    size_t end = visibleOffsets_[submesh + 1];
+
+    // The sampling loop is specialized for the common numbers of channels.
+    void (OdmOrthoPhoto::*shade)(const cv::Mat &, const std::vector<Eigen::Vector2f> &, size_t, size_t, int);
+    switch (texture.channels()){
+        case 1: shade = &OdmOrthoPhoto::shadePixels<T, 1>; break;
+        case 3: shade = &OdmOrthoPhoto::shadePixels<T, 3>; break;
+        case 4: shade = &OdmOrthoPhoto::shadePixels<T, 4>; break;
+        default: shade = &OdmOrthoPhoto::shadePixels<T, 0>; break;
+    }
 
-    if(isSliverPolygon(v1, v2, v3))
+    if (threads_ <= 1 || end - begin <= static_cast<size_t>(tileSize_ * tileSize_))
     {
-        log_ << "Warning: Sliver polygon found at face index " << faceIndex << '\n';
+        (this->*shade)(texture, uvs, begin, end, level);
         return;
     }
 
-    // The face data. Position v*{x,y,z}. Texture coordinate v*{u,v}. * is the vertex number in the polygon.
-    float v1x, v1y, v1z, v1u, v1v;
-    float v2x, v2y, v2z, v2u, v2v;
-    float v3x, v3y, v3z, v3u, v3v;
+    // Every pixel is shaded once, so workers can take chunks of the range in any order.
+    size_t chunkSize = static_cast<size_t>(tileSize_ * tileSize_);
+    size_t chunkCount = (end - begin + chunkSize - 1) / chunkSize;
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&](){
+        for (size_t i = nextChunk++; i < chunkCount; i = nextChunk++){
+            size_t chunkBegin = begin + i * chunkSize;
+            (this->*shade)(texture, uvs, chunkBegin, std::min(chunkBegin + chunkSize, end), level);
+        }
+    };
 
-    // Barycentric coordinates of the currently rendered point.
-    float l1, l2, l3;
+    boost::thread_group threads;
+    size_t numThreads = std::min(static_cast<size_t>(threads_), chunkCount);
+    for (size_t t = 0; t < numThreads; ++t)
+    {
+        threads.create_thread(worker);
+    }
+    threads.join_all();
+}
 
+template <typename T, int Channels>
+void OdmOrthoPhoto::shadePixels(const cv::Mat &texture, const std::vector<Eigen::Vector2f> &uvs, size_t begin, size_t end, int level)
+{
     // The size of the photo, as float.
     float fRows, fCols;
     fRows = static_cast<float>(texture.rows);
     fCols = static_cast<float>(texture.cols);
 
-    // Get vertex position.
-    v1x = v1.x; v1y = v1.y; v1z = v1.z;
-    v2x = v2.x; v2y = v2.y; v2z = v2.z;
-    v3x = v3.x; v3y = v3.y; v3z = v3.z;
+    const int32_t *faceIds = faceIds_.ptr<int32_t>();
+    const cv::Vec2f *weights = weights_.ptr<cv::Vec2f>();
 
-    // Get texture coordinates. 
-    v1u = uvs[3*faceIndex][0]; v1v = uvs[3*faceIndex][1];
-    v2u = uvs[3*faceIndex+1][0]; v2v = uvs[3*faceIndex+1][1];
-    v3u = uvs[3*faceIndex+2][0]; v3v = uvs[3*faceIndex+2][1];
+    // The first band written by this texture, in the interleaved samples.
+    T *samples = reinterpret_cast<T *>(&raster_[0]) + currentBandIndex;
+    size_t stride = static_cast<size_t>(bandCount_);
+
+    for (size_t i = begin; i < end; i++){
+        if (pixelLevels_[i] != level) continue; // Sampled from another level of the pyramid.
+
+        size_t idx = visiblePixels_[i];
+        size_t faceIndex = static_cast<size_t>(faceIds[idx]);
+
+        // The same weights, and the same arithmetic, as the rasterization.
+        float l1 = weights[idx][0];
+        float l2 = weights[idx][1];
+        float l3 = 1 - l1 - l2;
+
+        // The uv values of the point.
+        float u, v;
+        u = uvs[3*faceIndex][0]*l1 + uvs[3*faceIndex+1][0]*l2 + uvs[3*faceIndex+2][0]*l3;
+        v = uvs[3*faceIndex][1]*l1 + uvs[3*faceIndex+1][1]*l2 + uvs[3*faceIndex+2][1]*l3;
+
+        renderPixel<T, Channels>(idx, u*fCols, (1.0f-v)*fRows, texture, samples + idx * stride);
+    }
+}
+
+template <typename SpanFunc>
+void OdmOrthoPhoto::forEachTriangleSpan(const pcl::PointXYZ &v1, const pcl::PointXYZ &v2, const pcl::PointXYZ &v3, const Tile &tile, SpanFunc spanFunc) const
+{
+    // The face positions. v*{x,y}. * is the vertex number in the polygon.
+    float v1x, v1y;
+    float v2x, v2y;
+    float v3x, v3y;
+
+    v1x = v1.x; v1y = v1.y;
+    v2x = v2.x; v2y = v2.y;
+    v3x = v3.x; v3y = v3.y;
 
     // Check bounding box overlap.
     int xMin = static_cast<int>(std::min(std::min(v1x, v2x), v3x));
@@ -805,9 +2186,9 @@ void OdmOrthoPhoto::drawTexturedTriangle(const cv::Mat &texture, const pcl::Vert
         ctmdr = (midC-topC)/(midR-topR);
 
         // The first pixel row for the bottom part of the triangle.
-        int rqStart = std::max(static_cast<int>(std::floor(topR+0.5f)), 0);
+        int rqStart = std::max(static_cast<int>(std::floor(topR+0.5f)), tile.rowMin);
         // The last pixel row for the top part of the triangle.
-        int rqEnd = std::min(static_cast<int>(std::floor(midR+0.5f)), height);
+        int rqEnd = std::min(static_cast<int>(std::floor(midR+0.5f)), tile.rowMax);
 
         // Traverse along row from top to middle.
         for(int rq = rqStart; rq < rqEnd; ++rq)
@@ -817,40 +2198,13 @@ void OdmOrthoPhoto::drawTexturedTriangle(const cv::Mat &texture, const pcl::Vert
             ctb = topC + ctbdr*(static_cast<float>(rq)+0.5f-topR);
 
             // The first pixel column for the current row.
-            int cqStart = std::max(static_cast<int>(std::floor(0.5f+std::min(ctm, ctb))), 0);
+            int cqStart = std::max(static_cast<int>(std::floor(0.5f+std::min(ctm, ctb))), tile.colMin);
             // The last pixel column for the current row.
-            int cqEnd = std::min(static_cast<int>(std::floor(0.5f+std::max(ctm, ctb))), width);
+            int cqEnd = std::min(static_cast<int>(std::floor(0.5f+std::max(ctm, ctb))), tile.colMax);
 
-            for(int cq = cqStart; cq < cqEnd; ++cq)
+            if(cqStart < cqEnd)
             {
-                // Get barycentric coordinates for the current point.
-                getBarycentricCoordinates(v1, v2, v3, static_cast<float>(cq)+0.5f, static_cast<float>(rq)+0.5f, l1, l2, l3);
-
-                if(0.f > l1 || 0.f > l2 || 0.f > l3)
-                {
-                    //continue;
-                }
-                
-                // The z value for the point.
-                float z = v1z*l1+v2z*l2+v3z*l3;
-
-                // Check depth
-                float depthValue = depth_.at<float>(rq, cq);
-                if(z < depthValue)
-                {
-                    // Current is behind another, don't draw.
-                    continue;
-                }
-
-                // The uv values of the point.
-                float u, v;
-                u = v1u*l1+v2u*l2+v3u*l3;
-                v = v1v*l1+v2v*l2+v3v*l3;
-                
-                renderPixel<T>(rq, cq, u*fCols, (1.0f-v)*fRows, texture);
-                
-                // Update depth buffer.
-                depth_.at<float>(rq, cq) = z;
+                spanFunc(rq, cqStart, cqEnd);
             }
         }
     }
@@ -863,9 +2217,9 @@ void OdmOrthoPhoto::drawTexturedTriangle(const cv::Mat &texture, const pcl::Vert
         float cmb = midC;
 
         // The first pixel row for the bottom part of the triangle.
-        int rqStart = std::max(static_cast<int>(std::floor(midR+0.5f)), 0);
+        int rqStart = std::max(static_cast<int>(std::floor(midR+0.5f)), tile.rowMin);
         // The last pixel row for the bottom part of the triangle.
-        int rqEnd = std::min(static_cast<int>(std::floor(botR+0.5f)), height);
+        int rqEnd = std::min(static_cast<int>(std::floor(botR+0.5f)), tile.rowMax);
 
         // Traverse along row from middle to bottom.
         for(int rq = rqStart; rq < rqEnd; ++rq)
@@ -875,47 +2229,20 @@ void OdmOrthoPhoto::drawTexturedTriangle(const cv::Mat &texture, const pcl::Vert
             cmb = midC + cmbdr*(static_cast<float>(rq)+0.5f-midR);
 
             // The first pixel column for the current row.
-            int cqStart = std::max(static_cast<int>(std::floor(0.5f+std::min(cmb, ctb))), 0);
+            int cqStart = std::max(static_cast<int>(std::floor(0.5f+std::min(cmb, ctb))), tile.colMin);
             // The last pixel column for the current row.
-            int cqEnd = std::min(static_cast<int>(std::floor(0.5f+std::max(cmb, ctb))), width);
+            int cqEnd = std::min(static_cast<int>(std::floor(0.5f+std::max(cmb, ctb))), tile.colMax);
 
-            for(int cq = cqStart; cq < cqEnd; ++cq)
+            if(cqStart < cqEnd)
             {
-                // Get barycentric coordinates for the current point.
-                getBarycentricCoordinates(v1, v2, v3, static_cast<float>(cq)+0.5f, static_cast<float>(rq)+0.5f, l1, l2, l3);
-
-                if(0.f > l1 || 0.f > l2 || 0.f > l3)
-                {
-                    //continue;
-                }
-
-                // The z value for the point.
-                float z = v1z*l1+v2z*l2+v3z*l3;
-
-                // Check depth
-                float depthValue = depth_.at<float>(rq, cq);
-                if(z < depthValue)
-                {
-                    // Current is behind another, don't draw.
-                    continue;
-                }
-
-                // The uv values of the point.
-                float u, v;
-                u = v1u*l1+v2u*l2+v3u*l3;
-                v = v1v*l1+v2v*l2+v3v*l3;
-
-                renderPixel<T>(rq, cq, u*fCols, (1.0f-v)*fRows, texture);
-
-                // Update depth buffer.
-                depth_.at<float>(rq, cq) = z;
+                spanFunc(rq, cqStart, cqEnd);
             }
         }
     }
 }
 
-template <typename T>
-void OdmOrthoPhoto::renderPixel(int row, int col, float s, float t, const cv::Mat &texture)
+template <typename T, int Channels>
+inline void OdmOrthoPhoto::renderPixel(size_t idx, float s, float t, const cv::Mat &texture, T *out)
 {
     // The offset of the texture coordinate from its pixel positions.
     float leftF, topF;
@@ -935,51 +2262,34 @@ void OdmOrthoPhoto::renderPixel(int row, int col, float s, float t, const cv::Ma
     top = static_cast<int>(topF);
     
     // The interpolated color values.
-    size_t idx = static_cast<size_t>(row) * static_cast<size_t>(width) + static_cast<size_t>(col);
-    T *data = reinterpret_cast<T *>(texture.data); // Faster access
-    int numChannels = texture.channels();
+    const int numChannels = Channels > 0 ? Channels : texture.channels();
+    const T *data = reinterpret_cast<const T *>(texture.data); // Faster access
+    const T *topLeft = data + (top * texture.cols + left) * numChannels;
+    const T *bottomLeft = topLeft + texture.cols * numChannels;
 
     for (int i = 0; i < numChannels; i++){
         float value = 0.0f;
 
-        T tl = data[(top) * texture.cols * numChannels + (left) * numChannels + i];
-        T tr = data[(top) * texture.cols * numChannels + (left + 1) * numChannels + i];
-        T bl = data[(top + 1) * texture.cols * numChannels + (left) * numChannels + i];
-        T br = data[(top + 1) * texture.cols * numChannels + (left + 1) * numChannels + i];
+        // Color textures are decoded as BGR, the bands are RGB.
+        int c = numChannels == 3 ? 2 - i : i;
+
+        T tl = topLeft[c];
+        T tr = topLeft[numChannels + c];
+        T bl = bottomLeft[c];
+        T br = bottomLeft[numChannels + c];
 
         value += static_cast<float>(tl) * dr * db;
         value += static_cast<float>(tr) * dl * db;
         value += static_cast<float>(bl) * dr * dt;
         value += static_cast<float>(br) * dl * dt;
 
-        static_cast<T *>(bands[currentBandIndex + i])[idx] = static_cast<T>(value);
+        out[i] = static_cast<T>(value);
     }
 
-    // Increment the alpha band if the pixel was visible for this band
-    // the final alpha band will be set to 255 if alpha == num bands
+    // Increment the coverage if the pixel was visible for this band
+    // the final alpha band will be set to 255 if coverage == num bands
     // (all bands have information at this pixel)
-    static_cast<T *>(alphaBand)[idx] += static_cast<T>(numChannels);
-}
-
-void OdmOrthoPhoto::getBarycentricCoordinates(pcl::PointXYZ v1, pcl::PointXYZ v2, pcl::PointXYZ v3, float x, float y, float &l1, float &l2, float &l3) const
-{
-    // Diff along y.
-    float y2y3 = v2.y-v3.y;
-    float y1y3 = v1.y-v3.y;
-    float y3y1 = v3.y-v1.y;
-    float yy3  =  y  -v3.y;
-    
-    // Diff along x.
-    float x3x2 = v3.x-v2.x;
-    float x1x3 = v1.x-v3.x;
-    float xx3  =  x  -v3.x;
-    
-    // Normalization factor.
-    float norm = (y2y3*x1x3 + x3x2*y1y3);
-    
-    l1 = (y2y3*(xx3) + x3x2*(yy3)) / norm;
-    l2 = (y3y1*(xx3) + x1x3*(yy3)) / norm;
-    l3 = 1 - l1 - l2;
+    coverage_[idx] = static_cast<uint8_t>(coverage_[idx] + numChannels);
 }
 
 bool OdmOrthoPhoto::isSliverPolygon(pcl::PointXYZ v1, pcl::PointXYZ v2, pcl::PointXYZ v3) const
@@ -1018,363 +2328,23 @@ bool OdmOrthoPhoto::isModelOk(const pcl::TextureMesh &mesh)
 
 bool OdmOrthoPhoto::loadObjFile(std::string inputFile, pcl::TextureMesh &mesh, std::vector<pcl::MTLReader> &companions)
 {
-    int data_type;
-    unsigned int data_idx;
-    int file_version;
-    int offset = 0;
-    Eigen::Vector4f origin;
-    Eigen::Quaternionf orientation;
-
-    if (!readHeader(inputFile, mesh.cloud, origin, orientation, file_version, data_type, data_idx, offset, companions))
-    {
-        throw OdmOrthoPhotoException("Problem reading header in modelfile!\n");
-    }
-
-    std::ifstream fs;
-
-    fs.open (inputFile.c_str (), std::ios::binary);
-    if (!fs.is_open () || fs.fail ())
-    {
-        //PCL_ERROR ("[pcl::OBJReader::readHeader] Could not open file '%s'! Error : %s\n", file_name.c_str (), strerror(errno));
-        fs.close ();
-        log_<<"Could not read mesh from file ";
-        log_ << inputFile.c_str();
-        log_ <<"\n";
-
-        throw OdmOrthoPhotoException("Problem reading mesh from file!\n");
-    }
-
-    // Seek at the given offset
-    fs.seekg (data_idx, std::ios::beg);
-
-    // Get normal_x field indices
-    int normal_x_field = -1;
-    for (std::size_t i = 0; i < mesh.cloud.fields.size (); ++i)
-    {
-        if (mesh.cloud.fields[i].name == "normal_x")
-        {
-            normal_x_field = i;
-            break;
-        }
-    }
-
-    std::size_t v_idx = 0;
-    std::size_t vn_idx = 0;
-    std::size_t vt_idx = 0;
-    std::size_t f_idx = 0;
-    std::string line;
-    std::vector<std::string> st;
-    std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > coordinates;
-    std::vector<Eigen::Vector2f> allTexCoords;
-
-    std::map<int, int> f2vt;
-
-    try
-    {
-        while (!fs.eof ())
-        {
-            getline (fs, line);
-            // Ignore empty lines
-            if (line == "")
-                continue;
-
-            // Tokenize the line
-            std::stringstream sstream (line);
-            sstream.imbue (std::locale::classic ());
-            line = sstream.str ();
-            boost::trim (line);
-            boost::split (st, line, boost::is_any_of ("\t\r "), boost::token_compress_on);
-
-            // Ignore comments
-            if (st[0] == "#")
-                continue;
-            // Vertex
-            if (st[0] == "v")
-            {
-                try
-                {
-                    for (int i = 1, f = 0; i < 4; ++i, ++f)
-                    {
-                        float value = boost::lexical_cast<float> (st[i]);
-                        memcpy (&mesh.cloud.data[v_idx * mesh.cloud.point_step + mesh.cloud.fields[f].offset], &value, sizeof (float));
-                    }
-
-                    ++v_idx;
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex coordinates!\n";
-                    throw OdmOrthoPhotoException("Unable to convert %s to vertex coordinates!");
-                }
-                continue;
-            }
-            // Vertex normal
-            if (st[0] == "vn")
-            {
-                try
-                {
-                    for (int i = 1, f = normal_x_field; i < 4; ++i, ++f)
-                    {
-                        float value = boost::lexical_cast<float> (st[i]);
-                        memcpy (&mesh.cloud.data[vn_idx * mesh.cloud.point_step + mesh.cloud.fields[f].offset],
-                        &value,
-                        sizeof (float));
-                    }
-                    ++vn_idx;
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex normal!\n";
-                    throw OdmOrthoPhotoException("Unable to convert %s to vertex normal!");
-                }
-                continue;
-            }
-            // Texture coordinates
-            if (st[0] == "vt")
-            {
-                try
-                {
-                    Eigen::Vector3f c (0, 0, 0);
-                    for (std::size_t i = 1; i < st.size (); ++i)
-                        c[i-1] = boost::lexical_cast<float> (st[i]);
-
-                    if (c[2] == 0)
-                        coordinates.push_back (Eigen::Vector2f (c[0], c[1]));
-                    else
-                        coordinates.push_back (Eigen::Vector2f (c[0]/c[2], c[1]/c[2]));
-                    ++vt_idx;
-
-                }
-                catch (const boost::bad_lexical_cast &e)
-                {
-                    log_<<"Unable to convert %s to vertex texture coordinates!\n";
-                    throw OdmOrthoPhotoException("Unable to convert %s to vertex texture coordinates!");
-                }
-                continue;
-            }
-            // Material
-            if (st[0] == "usemtl")
-            {
-                mesh.tex_polygons.push_back (std::vector<pcl::Vertices> ());
-                mesh.tex_materials.push_back (pcl::TexMaterial ());
-                for (std::size_t i = 0; i < companions.size (); ++i)
-                {
-                    std::vector<pcl::TexMaterial>::const_iterator mat_it = companions[i].getMaterial (st[1]);
-                    if (mat_it != companions[i].materials_.end ())
-                    {
-                        mesh.tex_materials.back () = *mat_it;
-                        break;
-                    }
-                }
-                // We didn't find the appropriate material so we create it here with name only.
-                if (mesh.tex_materials.back ().tex_name == "")
-                    mesh.tex_materials.back ().tex_name = st[1];
-                mesh.tex_coordinates.push_back (coordinates);
-                coordinates.clear ();
-                continue;
-            }
-            // Face
-            if (st[0] == "f")
-            {
-                //We only care for vertices indices
-                pcl::Vertices face_v; face_v.vertices.resize (st.size () - 1);
-                for (std::size_t i = 1; i < st.size (); ++i)
-                {
-                    int v;
-                    sscanf (st[i].c_str (), "%d", &v);
-                    v = (v < 0) ? v_idx + v : v - 1;
-                    face_v.vertices[i-1] = v;
-
-                    int v2, vt, vn;
-                    sscanf (st[i].c_str (), "%d/%d/%d", &v2, &vt, &vn);
-                    f2vt[3*(f_idx) + i-1] = vt-1;
-                }
-                mesh.tex_polygons.back ().push_back (face_v);
-                ++f_idx;
-                continue;
-            }
-        }
-    }
-    catch (const char *exception)
-    {
-        fs.close ();
-        log_<<"Unable to read file!\n";
-        throw OdmOrthoPhotoException("Unable to read file!");
-    }
-
-    if (vt_idx != v_idx)
-    {
-        std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> > texcoordinates = std::vector<Eigen::Vector2f, Eigen::aligned_allocator<Eigen::Vector2f> >(0);
-        texcoordinates.reserve(3*f_idx);
-
-        for (size_t faceIndex = 0; faceIndex < f_idx; ++faceIndex)
-        {
-            for(size_t i = 0; i < 3; ++i)
-            {
-                Eigen::Vector2f vt = mesh.tex_coordinates[0][f2vt[3*faceIndex+i]];
-                texcoordinates.push_back(vt);
-            }
-        }
-
-        mesh.tex_coordinates.clear();
-        mesh.tex_coordinates.push_back(texcoordinates);
-    }
-
-    fs.close();
-    return (0);
-}
-
-bool OdmOrthoPhoto::readHeader (const std::string &file_name, pcl::PCLPointCloud2 &cloud,
-                                Eigen::Vector4f &origin, Eigen::Quaternionf &orientation,
-                                int &file_version, int &data_type, unsigned int &data_idx,
-                                const int offset,
-                                std::vector<pcl::MTLReader> &companions)
-{
-    origin       = Eigen::Vector4f::Zero ();
-    orientation  = Eigen::Quaternionf::Identity ();
-    file_version = 0;
-    cloud.width  = cloud.height = cloud.point_step = cloud.row_step = 0;
-    cloud.data.clear ();
-    data_type = 0;
-    data_idx = offset;
-
-    std::ifstream fs;
-    std::string line;
-
-    if (file_name == "" || !boost::filesystem::exists (file_name))
-    {
-        return false;
-    }
-
-    // Open file in binary mode to avoid problem of
-    // std::getline() corrupting the result of ifstream::tellg()
-    fs.open (file_name.c_str (), std::ios::binary);
-    if (!fs.is_open () || fs.fail ())
-    {
-        fs.close ();
-        return false;
-    }
-
-    // Seek at the given offset
-    fs.seekg (offset, std::ios::beg);
-
-    // Read the header and fill it in with wonderful values
-    bool vertex_normal_found = false;
-    bool vertex_texture_found = false;
-    // Material library, skip for now!
-    // bool material_found = false;
-    std::vector<std::string> material_files;
-    std::size_t nr_point = 0;
-    std::vector<std::string> st;
+    ObjReader reader;
+    reader.setThreads(threads_);
 
     try
     {
-        while (!fs.eof ())
-        {
-            getline (fs, line);
-            // Ignore empty lines
-            if (line == "")
-            continue;
-
-            // Tokenize the line
-            std::stringstream sstream (line);
-            sstream.imbue (std::locale::classic ());
-            line = sstream.str ();
-            boost::trim (line);
-            boost::split (st, line, boost::is_any_of ("\t\r "), boost::token_compress_on);
-            // Ignore comments
-            if (st.at (0) == "#")
-                continue;
-
-            // Vertex
-            if (st.at (0) == "v")
-            {
-                ++nr_point;
-                continue;
-            }
-
-            // Vertex texture
-            if ((st.at (0) == "vt") && !vertex_texture_found)
-            {
-                vertex_texture_found = true;
-                continue;
-            }
-
-            // Vertex normal
-            if ((st.at (0) == "vn") && !vertex_normal_found)
-            {
-                vertex_normal_found = true;
-                continue;
-            }
-
-            // Material library, skip for now!
-            if (st.at (0) == "mtllib")
-            {
-                material_files.push_back (st.at (1));
-                continue;
-            }
-        }
-    }
-    catch (const char *exception)
-    {
-        fs.close ();
-        return false;
-    }
-
-    if (!nr_point)
-    {
-        fs.close ();
-        return false;
-    }
-
-    int field_offset = 0;
-    for (int i = 0; i < 3; ++i, field_offset += 4)
-    {
-        cloud.fields.push_back (pcl::PCLPointField ());
-        cloud.fields[i].offset   = field_offset;
-        cloud.fields[i].datatype = pcl::PCLPointField::FLOAT32;
-        cloud.fields[i].count    = 1;
+        reader.read(inputFile, mesh, companions);
     }
-
-    cloud.fields[0].name = "x";
-    cloud.fields[1].name = "y";
-    cloud.fields[2].name = "z";
-
-    if (vertex_normal_found)
+    catch (const MeshIOException &e)
     {
-        std::string normals_names[3] = { "normal_x", "normal_y", "normal_z" };
-        for (int i = 0; i < 3; ++i, field_offset += 4)
-        {
-            cloud.fields.push_back (pcl::PCLPointField ());
-            pcl::PCLPointField& last = cloud.fields.back ();
-            last.name     = normals_names[i];
-            last.offset   = field_offset;
-            last.datatype = pcl::PCLPointField::FLOAT32;
-            last.count    = 1;
-        }
+        log_ << e.what() << "\n";
+        throw OdmOrthoPhotoException("Problem reading mesh from file!\n");
     }
 
-    if (material_files.size () > 0)
+    for (size_t i = 0; i < reader.getWarnings().size(); ++i)
     {
-        for (std::size_t i = 0; i < material_files.size (); ++i)
-        {
-            pcl::MTLReader companion;
-
-            if (companion.read (file_name, material_files[i]))
-            {
-                log_<<"Problem reading material file.";
-            }
-
-            companions.push_back (companion);
-        }
+        log_ << reader.getWarnings()[i] << "\n";
     }
 
-    cloud.point_step = field_offset;
-    cloud.width      = nr_point;
-    cloud.height     = 1;
-    cloud.row_step   = cloud.point_step * cloud.width;
-    cloud.is_dense   = true;
-    cloud.data.resize (cloud.point_step * nr_point);
-    fs.close ();
     return true;
 }
@@ -4,6 +4,10 @@
 #include <limits.h>
 #include <istream>
 #include <ostream>
+#include <atomic>
+
+// Boost
+#include <boost/thread.hpp>
 
 // PCL
 #include <pcl/io/obj_io.h>
@@ -23,10 +27,16 @@
 // GDAL
 #include "gdal_priv.h"
 #include "cpl_conv.h" // for CPLMalloc()
+#include "ogr_srs_api.h"
 
 // Logger
 #include "Logger.hpp"
 
+// Textures
+#include "TextureCache.hpp"
+
+class BinaryMesh;
+
 struct Bounds{
     float xMin;
     float xMax;
@@ -44,6 +54,54 @@ struct Bounds{
     }
 };
 
+/*!
+ * \brief   The Tile struct describes the pixel range [colMin, colMax) x [rowMin, rowMax) of the ortho photo.
+ */
+struct Tile{
+    int colMin;
+    int colMax;
+    int rowMin;
+    int rowMax;
+
+    Tile() : colMin(0), colMax(0), rowMin(0), rowMax(0) {}
+    Tile(int colMin, int colMax, int rowMin, int rowMax) :
+        colMin(colMin), colMax(colMax), rowMin(rowMin), rowMax(rowMax){}
+};
+
+/*!
+ * \brief   The FaceRows struct holds the pixel rows [rowMin, rowMax) covered by a face of a submesh.
+ */
+struct FaceRows{
+    int rowMin;
+    int rowMax;
+    size_t face;    /**< Index of the face in its submesh. */
+
+    FaceRows() : rowMin(0), rowMax(0), face(0) {}
+    FaceRows(int rowMin, int rowMax, size_t face) :
+        rowMin(rowMin), rowMax(rowMax), face(face){}
+};
+
+/*!
+ * \brief   The OrthoModel struct holds a textured mesh prepared for rendering.
+ *          A model sharing the geometry of an earlier one keeps only its texture coordinates and materials.
+ */
+struct OrthoModel{
+    pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud;      /**< The vertices, in pixel coordinates. */
+    std::vector<Eigen::Vector2f> uvs;                   /**< The texture coordinates of all faces, three per face, indexed apart from the shared vertices. */
+    std::vector<std::vector<pcl::Vertices> > faces;     /**< The faces of each submesh. */
+    std::vector<pcl::TexMaterial> materials;            /**< The material of each submesh. */
+    std::vector<size_t> faceOffsets;                    /**< The global index of the first face of each submesh. */
+    std::vector<std::vector<FaceRows> > faceRows;       /**< The rows covered by the drawable faces of each submesh, sorted by first row. */
+    std::vector<int> maxFaceRows;                       /**< The largest number of rows covered by a face, per submesh. */
+    std::vector<float> footprints;                      /**< Half the base 2 logarithm of the uv area over the pixel area, per face. */
+    int channels;                                       /**< The number of channels of the textures. */
+    size_t geometry;                                    /**< The index of the model whose geometry, and rasterization, this model shares. */
+    float depthMin;                                     /**< The lowest Z of the geometry, quantized to 1 with "-depthBits 16". */
+    float depthScale;                                   /**< The quantization steps per meter of Z of the geometry. */
+
+    OrthoModel() : channels(0), geometry(0), depthMin(0.0f), depthScale(0.0f) {}
+};
+
 /*!
  * \brief   The OdmOrthoPhoto class is used to create an orthographic photo over a given area.
  *          The class reads an oriented textured mesh from an OBJ-file.
@@ -66,75 +124,309 @@ public:
      */
     int run(int argc, char* argv[]);
 
+    /*!
+     * \brief   run     Runs the ortho photo functionality on meshes held in memory, instead of the "-inputFiles".
+     * \param   argc    Application argument count.
+     * \param   argv    Argument values.
+     * \param   meshes  The models, one per band group in the order of "-bands". They are emptied as they are prepared,
+     *                  the "-inputFiles" are read if there are none.
+     * \param   names   The names of the models in the log, may be empty.
+     * \return  0       if successful.
+     */
+    int run(int argc, char* argv[], std::vector<pcl::TextureMesh> &meshes, const std::vector<std::string> &names);
+
+    /*!
+     * \brief   addModel    Prepares a model for rendering, with the arguments parsed by run.
+     *                      The vertices, faces, texture coordinates and materials are moved out of mesh.
+     * \param   mesh        A georeferenced textured mesh; the textures are read from the paths of its materials.
+     * \param   name        The name of the model in the log.
+     */
+    void addModel(pcl::TextureMesh &mesh, const std::string &name);
+
+    /*!
+     * \brief   addModel    Prepares a model for rendering from the arrays of a mapped binary mesh file.
+     *                      The vertices and texture coordinates are read once from the mapping, which may be closed afterwards.
+     * \param   mesh        A georeferenced binary mesh; the textures are read from the paths of its materials.
+     * \param   name        The name of the model in the log.
+     */
+    void addModel(const BinaryMesh &mesh, const std::string &name);
+
+    /*!
+     * \brief   render      Renders the models added so far into the output file.
+     */
+    void render();
+
 private:
     int width, height;
     void parseArguments(int argc, char* argv[]);
     void printHelp();
 
+    /*!
+     * \brief   createOrthoPhoto    Reads the "-inputFiles" and renders them.
+     */
     void createOrthoPhoto();
 
+    /*!
+     * \brief   writeProfile    Writes the "-profile" report, if one was asked for.
+     */
+    void writeProfile();
+
     /*!
       * \brief Compute the boundary points so that the entire model fits inside the photo.
       *
-      * \param mesh The model which decides the boundary.
+      * \param meshCloud The vertices of the model which decides the boundary.
       */
-    Bounds computeBoundsForModel(const pcl::TextureMesh &mesh);
+    Bounds computeBoundsForModel(const pcl::PointCloud<pcl::PointXYZ> &meshCloud);
+
+    /*!
+      * \brief Fits the photo to the bounds of a model, moves its vertices into pixel coordinates and adds the model with them.
+      *
+      * \param meshCloud The vertices of the model, in model coordinates.
+      * \param primary Whether this is the first model, which decides the bounds of the photo.
+      * \return The new model, to be given its faces, texture coordinates and materials.
+      */
+    OrthoModel &startModel(pcl::PointCloud<pcl::PointXYZ>::Ptr meshCloud, bool primary);
+
+    /*!
+      * \brief Crops a model started by startModel, checks its textures and prepares it for rasterization.
+      */
+    void finishModel(OrthoModel &model, bool primary);
     
     /*!
       * \brief Creates a transformation which aligns the area for the orthophoto.
       */
     Eigen::Transform<float, 3, Eigen::Affine> getROITransform(float xMin, float yMin) const;
 
+    /*!
+      * \brief Renders the current window of the photo from all models and writes it to the output file.
+      *
+      * \param models The models to render, in band order.
+      * \param hDstDS The output dataset.
+      * \param dataType The data type of the output bands.
+      */
     template <typename T>
-    void initBands(int count);
+    void renderWindow(const std::vector<OrthoModel> &models, GDALDatasetH hDstDS, GDALDataType dataType);
 
-    template <typename T>
-    void initAlphaBand();
+    /*!
+      * \brief Widens a window, in model coordinates, to the pixel grid starting at the origin of the model coordinates.
+      */
+    Bounds getPixelAlignedBounds(const Bounds &window) const;
+
+    /*!
+      * \brief Drops the faces of a model outside the photo, with their texture coordinates and the vertices only they use.
+      *
+      * \param model A model with its vertices transformed into pixel coordinates, before its face rows are prepared.
+      */
+    void cropModel(OrthoModel &model);
+
+    /*!
+      * \brief Finds the rows covered by each face of the model, and logs and drops sliver polygons.
+      */
+    void prepareFaceRows(OrthoModel &model);
+
+    /*!
+      * \brief Computes the footprints of the faces of a model in its textures.
+      *
+      * \param model The model, with its texture coordinates.
+      * \param geometry The model holding the geometry of model.
+      */
+    void prepareFootprints(OrthoModel &model, const OrthoModel &geometry);
+
+    /*!
+      * \brief Returns the faces of a submesh which cover rows of the current window, in submesh order.
+      *
+      * \param faceRows The rows covered by the faces, sorted by first row.
+      * \param maxFaceRows The largest number of rows covered by one of the faces.
+      */
+    std::vector<size_t> getWindowFaces(const std::vector<FaceRows> &faceRows, int maxFaceRows) const;
+
+    /*!
+      * \brief Checks if two models have the same faces, in the same order, at the same positions.
+      *
+      * \param a A prepared model.
+      * \param b A model with its vertices transformed into pixel coordinates.
+      */
+    bool hasSameGeometry(const OrthoModel &a, const OrthoModel &b) const;
+
+    /*!
+      * \brief Sets the depth range of a model holding its geometry, which quantizes its Z range to 16 bits.
+      */
+    void setDepthRange(OrthoModel &model);
+
+    /*!
+      * \brief Estimates the memory held by a prepared model, in bytes.
+      */
+    size_t getModelBytes(const OrthoModel &model) const;
+
+    /*!
+      * \brief Returns the memory which may be held by prefetched textures, in bytes.
+      */
+    size_t getPrefetchBytes() const;
+
+    /*!
+      * \brief Returns the memory held per pixel of a window while it is rendered, in bytes.
+      *
+      * \param sampleSize The size of a band sample, in bytes.
+      */
+    size_t getPixelBytes(size_t sampleSize) const;
 
+    /*!
+      * \brief Allocates the pixel-interleaved bands and the coverage of the current window.
+      */
     template <typename T>
+    void initBands();
+
+    /*!
+      * \brief Turns the coverage into the alpha band, only pixels with values on all bands are visible.
+      */
     void finalizeAlphaBand();
 
-    void saveTIFF(const std::string &filename, GDALDataType dataType);
-    
     /*!
-      * \brief Renders a triangle into the ortho photo.
+      * \brief Frees the bands, the coverage, the depth and the visibility buffer of the current window.
+      */
+    void releaseBands();
+
+    /*!
+      * \brief Creates the output GeoTIFF, with bandCount bands followed by an alpha band.
       *
-      *        Pixel center defined as middle of pixel for triangle rasterisation, and in lower left corner for texture look-up.
+      *        The file is georeferenced from the bounds, the UTM offset and the SRS, tiled in blocks of
+      *        blockWidth_ x blockHeight_ pixels unless the creation options say otherwise, and has empty overviews.
+      *
+      * \param bounds The bounds of the models, in model coordinates.
+      */
+    GDALDatasetH createTIFF(const std::string &filename, GDALDataType dataType, int bandCount, const Bounds &bounds);
+
+    /*!
+      * \brief Reads whether the GeoTIFF is tiled, and its block size, from the "-co" creation options.
+      */
+    void parseBlockSize();
+
+    /*!
+      * \brief Returns the number of rows the height of a window is a multiple of, for its blocks and overviews.
+      */
+    int getWindowStep() const;
+
+    /*!
+      * \brief Writes the bands of the current window to the output file in one pixel-interleaved call, then the alpha band.
+      */
+    template <typename T>
+    void writeWindow(GDALDatasetH hDstDS, GDALDataType dataType);
+
+    /*!
+      * \brief Averages the current window into an overview and writes it to the output file.
+      *
+      * \param level The index of the overview in overviews_.
+      */
+    template <typename T>
+    void writeOverview(GDALDatasetH hDstDS, GDALDataType dataType, size_t level);
+
+    /*!
+      * \brief Rasterizes the faces of one submesh into the visibility buffer.
+      *
+      *        With more than one thread the current window is split into tiles of tileSize_ x tileSize_ pixels.
+      *        Faces are binned into the tiles they cover, in submesh order, and the tiles are rasterized
+      *        in parallel. Each tile only touches its own pixels, so the result matches the serial path.
+      *
+      * \param faces The faces of the submesh.
+      * \param faceList The indices of the faces to draw, in submesh order.
+      * \param meshCloud Contains all vertices.
+      * \param faceOff The global index of the first face of the submesh.
+      *
+      *        D is the type of the depth buffer, float or uint16_t for quantized depths.
+      */
+    template <typename D>
+    void rasterizeTriangles(const std::vector<pcl::Vertices> &faces, const std::vector<size_t> &faceList, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, size_t faceOff);
+
+    /*!
+      * \brief Rasterizes a triangle into the visibility buffer.
+      *
+      *        Pixels where the triangle is not behind the current depth get its face index and barycentric weights.
+      *        Pixel center defined as middle of pixel for triangle rasterisation. The weights and the depth are
+      *        evaluated once per span and stepped along it, four pixels at a time with SSE2.
       *
-      * \param texture The texture of the polygon.
       * \param polygon The polygon as athree indices relative meshCloud.
       * \param meshCloud Contains all vertices.
-      * \param uvs Contains the texture coordinates for the active material.
-      * \param faceIndex The index of the face.
+      * \param faceIndex The global index of the face.
+      * \param tile The pixels that may be written, all others are left untouched.
+      */
+    template <typename D>
+    void rasterizeTriangle(const pcl::Vertices &polygon, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, size_t faceIndex, const Tile &tile);
+
+    /*!
+      * \brief Groups the covered pixels of the visibility buffer by submesh, into visiblePixels_ and visibleOffsets_.
+      *
+      * \param model The model which was rasterized.
+      */
+    void sortVisiblePixels(const OrthoModel &model);
+
+    /*!
+      * \brief Chooses the pyramid level sampled by each visible pixel of a submesh, into pixelLevels_.
+      *
+      *        The level is the one where a pixel of the photo covers one to two texels across.
+      *
+      * \param model The model being rendered.
+      * \param submesh The index of the submesh.
+      * \param size The size of the texture of the submesh.
+      * \return The levels used, one bit per level.
+      */
+    uint32_t setPixelLevels(const OrthoModel &model, size_t submesh, const cv::Size &size);
+
+    /*!
+      * \brief Returns a level of the pyramid of a texture, from the cache or built from the finest level at hand.
+      *
+      * \param file The path of the texture.
+      * \param level The level.
+      * \param texture Level 0 of the texture if decoded, else empty, it is then read if needed.
+      * \return The level, empty if the texture could not be read.
+      */
+    cv::Mat getTextureLevel(const std::string &file, int level, cv::Mat &texture);
+
+    /*!
+      * \brief Shades the visible pixels of a submesh sampling a pyramid level, in parallel chunks with more than one thread.
+      *
+      * \param texture The level of the texture of the submesh.
+      * \param uvs Contains the texture coordinates of the model.
+      * \param submesh The index of the submesh.
+      * \param level The level of the texture.
       */
     template <typename T>
-    void drawTexturedTriangle(const cv::Mat &texture, const pcl::Vertices &polygon, const pcl::PointCloud<pcl::PointXYZ>::Ptr &meshCloud, const std::vector<Eigen::Vector2f> &uvs, size_t faceIndex);
+    void shadeSubmesh(const cv::Mat &texture, const std::vector<Eigen::Vector2f> &uvs, size_t submesh, int level);
+
+    /*!
+      * \brief Shades the visible pixels [begin, end) of visiblePixels_ which sample the given pyramid level.
+      *
+      *        Texture look-up with the pixel center in the lower left corner.
+      *        Channels is the number of channels of the texture, or 0 to read it from the texture.
+      */
+    template <typename T, int Channels>
+    void shadePixels(const cv::Mat &texture, const std::vector<Eigen::Vector2f> &uvs, size_t begin, size_t end, int level);
+
+    /*!
+      * \brief Walks the pixel rows covered by a triangle.
+      *
+      *        For every row inside the tile, spanFunc(row, colStart, colEnd) is called with the
+      *        non-empty column range [colStart, colEnd) covered by the triangle on that row.
+      *
+      * \param v1 The first triangle vertex, in pixel coordinates.
+      * \param v2 The second triangle vertex, in pixel coordinates.
+      * \param v3 The third triangle vertex, in pixel coordinates.
+      * \param tile The pixel range to which the spans are clipped.
+      * \param spanFunc The function called for each span.
+      */
+    template <typename SpanFunc>
+    void forEachTriangleSpan(const pcl::PointXYZ &v1, const pcl::PointXYZ &v2, const pcl::PointXYZ &v3, const Tile &tile, SpanFunc spanFunc) const;
     
     /*!
       * \brief Sets the color of a pixel in the photo.
       *
-      * \param row The row index of the pixel.
-      * \param col The column index of the pixel.
+      * \param idx The index of the pixel in the current window.
       * \param s The u texture-coordinate, multiplied with the number of columns in the texture.
       * \param t The v texture-coordinate, multiplied with the number of rows in the texture.
-      * \param texture The texture from which to get the color.
+      * \param texture The texture from which to get the color, three channel textures in BGR order.
+      * \param out The samples of the pixel written, one per channel of the texture.
       **/
-    template <typename T>
-    void renderPixel(int row, int col, float u, float v, const cv::Mat &texture);
-
-    /*!
-      * \brief Calculates the barycentric coordinates of a point in a triangle.
-      *
-      * \param v1 The first triangle vertex.
-      * \param v2 The second triangle vertex.
-      * \param v3 The third triangle vertex.
-      * \param x The x coordinate of the point.
-      * \param y The y coordinate of the point.
-      * \param l1 The first vertex weight.
-      * \param l2 The second vertex weight.
-      * \param l3 The third vertex weight.
-      */
-    void getBarycentricCoordinates(pcl::PointXYZ v1, pcl::PointXYZ v2, pcl::PointXYZ v3, float x, float y, float &l1, float &l2, float &l3) const;
+    template <typename T, int Channels>
+    void renderPixel(size_t idx, float s, float t, const cv::Mat &texture, T *out);
 
     /*!
       * \brief Check if a given polygon is a sliver polygon.
@@ -149,44 +441,72 @@ private:
       * \brief Check if the model is suitable for ortho photo generation.
       *
       * \param mesh The model.
-      * \return True if the model is ok for generating ortho photo.
+      * \return True if the model has texture coordinates per face corner, else a multi-material model
+      *         is taken to have them per vertex.
       */
     bool isModelOk(const pcl::TextureMesh &mesh);
 
     /*!
-      * \brief Loads a model from an .obj file (replacement for the pcl obj loader).
+      * \brief Loads a model from an .obj file, using the parallel reader of the mesh IO library.
       *
       * \param inputFile Path to the .obj file.
       * \param mesh The model.
+      * \param companions The material libraries referenced by the model.
       * \return True if model was loaded successfully.
       */
     bool loadObjFile(std::string inputFile, pcl::TextureMesh &mesh, std::vector<pcl::MTLReader> &companions);
 
-    /*!
-      * \brief Function is compied straight from the function in the pcl::io module.
-      */
-    bool readHeader (const std::string &file_name, pcl::PCLPointCloud2 &cloud,
-                     Eigen::Vector4f &origin, Eigen::Quaternionf &orientation,
-                     int &file_version, int &data_type, unsigned int &data_idx,
-                     const int offset,
-                     std::vector<pcl::MTLReader> &companions);
-
     Logger          log_;               /**< Logging object. */
 
     std::vector<std::string> inputFiles;
+    std::vector<OrthoModel> models_;    /**< The models, ready for rendering. They are all kept in memory, since every window of the photo is rendered from all of them. */
+    std::vector<std::string> modelNames_; /**< The name of each model in the log. */
+    Bounds          bounds_;            /**< The bounds of the photo, the window if one is given, else the bounds of the models. */
+    Bounds          modelBounds_;       /**< The bounds of the first model, which those of the others must match. */
+    Bounds          windowBounds_;      /**< The "-window" to render, in model coordinates, before alignment to the pixel grid. */
+    bool            hasWindowBounds_;   /**< True if a "-window" is given. */
+    int             textureDepth_;      /**< The OpenCV depth of the textures, the same for all models, -1 before the first. */
     std::string     outputFile_;        /**< Path to the destination file. */
     std::string     outputCornerFile_;  /**< Path to the output corner file. */
     std::string     logFile_;           /**< Path to the log file. */
+    std::string     profileFile_;       /**< Path to the profile report, empty if not profiling. */
     std::string     bandsOrder;
 
     float           resolution_;        /**< The number of pixels per meter in the ortho photo. */
+    int             threads_;           /**< The number of threads used for rendering. */
+    int             tileSize_;          /**< The width and height, in pixels, of a render tile, and the default GeoTIFF block size. */
+    int             blockWidth_;        /**< The width, in pixels, of a GeoTIFF block. */
+    int             blockHeight_;       /**< The height, in pixels, of a GeoTIFF block. */
+    bool            tiled_;             /**< Whether the GeoTIFF is tiled, else it is written in strips. */
+    int             maxMemory_;         /**< The memory budget for rendering in megabytes, 0 if unlimited. */
+    std::string     srs_;               /**< The spatial reference system of the photo, empty if unknown. */
+    double          utmEastOffset_;     /**< The east offset of the model coordinates. */
+    double          utmNorthOffset_;    /**< The north offset of the model coordinates. */
+    std::vector<std::string> creationOptions_; /**< The GeoTIFF creation options, as NAME=VALUE. */
+    std::vector<int> overviews_;        /**< The overview factors, ascending. */
+
+    int             prefetchTextures_;  /**< The number of textures decoded ahead of the one being drawn. */
+    int             prefetchMemory_;    /**< The memory budget of the prefetched textures in megabytes, 0 if unlimited. */
+    size_t          textureBytes_;      /**< The size of the largest texture read while loading the models, in bytes. */
+    int             textureCacheMemory_;/**< The memory budget of the texture cache in megabytes. */
+    TextureCache    textureCache_;      /**< The texture pyramid levels kept between materials and windows. */
 
-    std::vector<void *>    bands;
     std::vector<GDALColorInterp> colorInterps;
-    void *alphaBand; // Keep alpha band separate
     int currentBandIndex;
+    int             bandCount_;         /**< The number of bands of the photo, without the alpha band. */
+    int             depthBits_;         /**< 32 for a float depth buffer, 16 for depths quantized over the Z range of the models. */
+    float           depthMin_;          /**< The depthMin of the geometry being rasterized. */
+    float           depthScale_;        /**< The depthScale of the geometry being rasterized. */
 
-    cv::Mat         depth_;             /**< The depth of the ortho photo as an OpenCV matrix, CV_32F. */
+    Tile            window_;            /**< The part of the photo held by raster_, coverage_ and the buffers below. */
+    std::vector<uint8_t> raster_;       /**< The bands of the current window, bandCount_ samples of the output type per pixel. */
+    std::vector<uint8_t> coverage_;     /**< The number of band samples drawn per pixel of the current window, then its alpha. */
+    cv::Mat         depth_;             /**< The depth of the current window as an OpenCV matrix, CV_32F, or CV_16U with 0 where empty. */
+    cv::Mat         faceIds_;           /**< The global index of the visible face of each pixel, -1 if none, CV_32S. */
+    cv::Mat         weights_;           /**< The first two barycentric weights of each pixel in its visible face, CV_32FC2. */
+    std::vector<size_t> visiblePixels_; /**< The pixels with a visible face, grouped by submesh, in scanline order. */
+    std::vector<size_t> visibleOffsets_;/**< The start of each submesh in visiblePixels_, one past the end last. */
+    std::vector<uint8_t> pixelLevels_;  /**< The pyramid level sampled by each pixel of visiblePixels_. */
 };
 
 /*!
@@ -0,0 +1,99 @@
+#include "TextureCache.hpp"
+
+// OpenCV
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace
+{
+
+size_t getBytes(const cv::Mat &texture)
+{
+    return texture.total() * texture.elemSize();
+}
+
+}
+
+TextureCache::TextureCache(size_t maxBytes)
+    : maxBytes_(maxBytes), bytes_(0)
+{
+}
+
+void TextureCache::setMaxBytes(size_t maxBytes)
+{
+    maxBytes_ = maxBytes;
+    while (bytes_ > maxBytes_ && !entries_.empty())
+    {
+        bytes_ -= getBytes(entries_.back().second);
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+}
+
+cv::Mat TextureCache::get(const std::string &file, int level)
+{
+    std::map<Key, Entries::iterator>::iterator it = index_.find(Key(file, level));
+    if (it == index_.end())
+    {
+        return cv::Mat();
+    }
+
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+}
+
+void TextureCache::put(const std::string &file, int level, const cv::Mat &texture)
+{
+    size_t bytes = getBytes(texture);
+    if (bytes > maxBytes_ || index_.find(Key(file, level)) != index_.end())
+    {
+        return;
+    }
+
+    while (bytes_ + bytes > maxBytes_)
+    {
+        bytes_ -= getBytes(entries_.back().second);
+        index_.erase(entries_.back().first);
+        entries_.pop_back();
+    }
+
+    entries_.push_front(std::make_pair(Key(file, level), texture));
+    index_[Key(file, level)] = entries_.begin();
+    bytes_ += bytes;
+}
+
+bool TextureCache::getSize(const std::string &file, cv::Size &size) const
+{
+    std::map<std::string, cv::Size>::const_iterator it = sizes_.find(file);
+    if (it == sizes_.end())
+    {
+        return false;
+    }
+    size = it->second;
+    return true;
+}
+
+void TextureCache::setSize(const std::string &file, const cv::Size &size)
+{
+    sizes_[file] = size;
+}
+
+cv::Mat TextureCache::downsample(const cv::Mat &texture)
+{
+    cv::Mat level;
+    cv::resize(texture, level, cv::Size((texture.cols + 1) / 2, (texture.rows + 1) / 2), 0, 0, cv::INTER_AREA);
+    return level;
+}
+
+int TextureCache::getMaxLevel(const cv::Size &size)
+{
+    int level = 0;
+    int width = size.width;
+    int height = size.height;
+    while ((width + 1) / 2 >= 2 && (height + 1) / 2 >= 2 && level < 31)
+    {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        ++level;
+    }
+    return level;
+}
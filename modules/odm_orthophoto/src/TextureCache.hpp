@@ -0,0 +1,67 @@
+#pragma once
+
+// C++
+#include <list>
+#include <map>
+#include <string>
+
+// OpenCV
+#include <opencv2/core/core.hpp>
+
+/*!
+ * \brief   The TextureCache class keeps the levels of texture pyramids, up to a memory budget.
+ * \details Level 0 is the texture as decoded, every level is half the size of the one below,
+ *          rounded up. When the budget is exceeded the least recently used levels are dropped.
+ *          The size of every texture seen is remembered, so levels can be chosen before decoding.
+ */
+class TextureCache
+{
+public:
+    /*!
+     * \brief TextureCache  Creates an empty cache.
+     * \param maxBytes      The memory budget, in bytes, 0 to keep nothing.
+     */
+    TextureCache(size_t maxBytes = 0);
+
+    void setMaxBytes(size_t maxBytes);
+
+    /*!
+     * \brief get       Looks up a level of a texture, and marks it as recently used.
+     * \return          The level, empty if it is not in the cache.
+     */
+    cv::Mat get(const std::string &file, int level);
+
+    /*!
+     * \brief put       Adds a level of a texture, dropping the least recently used levels to stay within the budget.
+     *                  Levels larger than the budget are not kept.
+     */
+    void put(const std::string &file, int level, const cv::Mat &texture);
+
+    /*!
+     * \brief getSize   Returns the size of level 0 of a texture.
+     * \return          False if the texture was never seen.
+     */
+    bool getSize(const std::string &file, cv::Size &size) const;
+
+    void setSize(const std::string &file, const cv::Size &size);
+
+    /*!
+     * \brief downsample    Computes the next level of a texture pyramid, averaging blocks of 2 x 2 texels.
+     */
+    static cv::Mat downsample(const cv::Mat &texture);
+
+    /*!
+     * \brief getMaxLevel   Returns the coarsest level of a texture of the given size which is still at least 2 x 2 texels.
+     */
+    static int getMaxLevel(const cv::Size &size);
+
+private:
+    typedef std::pair<std::string, int> Key;
+    typedef std::list<std::pair<Key, cv::Mat> > Entries;
+
+    size_t maxBytes_;                           /**< The memory budget, in bytes. */
+    size_t bytes_;                              /**< The memory held by the levels, in bytes. */
+    Entries entries_;                           /**< The levels, most recently used first. */
+    std::map<Key, Entries::iterator> index_;    /**< The position of every level in entries_. */
+    std::map<std::string, cv::Size> sizes_;     /**< The size of level 0 of every texture seen. */
+};
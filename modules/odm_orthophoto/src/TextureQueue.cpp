@@ -0,0 +1,118 @@
+#include "TextureQueue.hpp"
+
+// C++
+#include <algorithm>
+
+// OpenCV
+#include <opencv2/highgui/highgui.hpp>
+
+// Profiling
+#include "Profile.hpp"
+
+TextureQueue::TextureQueue(const std::vector<std::string> &files, size_t ahead, size_t maxBytes, size_t expectedBytes, size_t threads)
+    : files_(files), textures_(files.size()), ready_(files.size(), false),
+      ahead_(ahead), maxBytes_(maxBytes), expectedBytes_(expectedBytes), readyBytes_(0),
+      decoding_(0), nextDecode_(0), nextTake_(0), stop_(false)
+{
+    if (ahead_ == 0 || files_.empty())
+    {
+        return;
+    }
+
+    size_t workerCount = std::min(std::max(threads, static_cast<size_t>(1)), std::min(ahead_, files_.size()));
+    for (size_t t = 0; t < workerCount; ++t)
+    {
+        workers_.create_thread(boost::bind(&TextureQueue::work, this));
+    }
+}
+
+TextureQueue::~TextureQueue()
+{
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    workers_.join_all();
+}
+
+cv::Mat TextureQueue::next()
+{
+    if (ahead_ == 0)
+    {
+        return nextTake_ < files_.size() ? readTexture(files_[nextTake_++]) : cv::Mat();
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (nextTake_ >= files_.size())
+    {
+        return cv::Mat();
+    }
+
+    size_t index = nextTake_;
+    while (!ready_[index])
+    {
+        changed_.wait(lock);
+    }
+
+    cv::Mat texture = textures_[index];
+    textures_[index] = cv::Mat();
+    readyBytes_ -= texture.total() * texture.elemSize();
+    ++nextTake_;
+    lock.unlock();
+
+    // The window of textures which may be decoded moved.
+    changed_.notify_all();
+    return texture;
+}
+
+cv::Mat TextureQueue::readTexture(const std::string &file)
+{
+    try
+    {
+        ProfilePhase phase("texture_decode");
+        cv::Mat texture = cv::imread(file, cv::IMREAD_ANYDEPTH | cv::IMREAD_UNCHANGED);
+        if (!texture.empty()) Profile::instance().addFileSize("bytes_read", file);
+        return texture;
+    }
+    catch (const std::exception &)
+    {
+        // Damaged files, and files too large to decode, are reported like missing ones.
+        return cv::Mat();
+    }
+}
+
+void TextureQueue::work()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    for (;;)
+    {
+        // The texture the renderer waits for is always decoded, the others only within the budget.
+        while (!stop_ && nextDecode_ < files_.size() &&
+               (nextDecode_ >= nextTake_ + ahead_ ||
+                (nextDecode_ > nextTake_ && maxBytes_ > 0 &&
+                 readyBytes_ + (decoding_ + 1) * expectedBytes_ > maxBytes_)))
+        {
+            changed_.wait(lock);
+        }
+        if (stop_ || nextDecode_ >= files_.size())
+        {
+            return;
+        }
+
+        size_t index = nextDecode_++;
+        ++decoding_;
+        lock.unlock();
+
+        cv::Mat texture = readTexture(files_[index]);
+        size_t bytes = texture.total() * texture.elemSize();
+
+        lock.lock();
+        --decoding_;
+        textures_[index] = texture;
+        ready_[index] = true;
+        readyBytes_ += bytes;
+        expectedBytes_ = std::max(expectedBytes_, bytes);
+        changed_.notify_all();
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// C++
+#include <string>
+#include <vector>
+
+// Boost
+#include <boost/thread.hpp>
+
+// OpenCV
+#include <opencv2/core/core.hpp>
+
+/*!
+ * \brief   The TextureQueue class decodes a list of textures on background threads, ahead of their use.
+ * \details Textures are handed out in list order. Workers decode at most ahead textures past the one
+ *          being used, and stop early when the decoded textures would exceed the memory budget.
+ *          The size of a texture is only known once it is decoded, so the budget is kept by
+ *          reserving the size of the largest texture seen for every decode in flight.
+ */
+class TextureQueue
+{
+public:
+    /*!
+     * \brief TextureQueue      Starts decoding the textures.
+     * \param files             The paths of the textures, in the order they are used.
+     * \param ahead             The number of textures decoded ahead of the one in use, 0 to decode on demand.
+     * \param maxBytes          The memory budget of the textures decoded ahead, in bytes, 0 if unlimited.
+     * \param expectedBytes     The expected size of a decoded texture, in bytes.
+     * \param threads           The number of decoding threads.
+     */
+    TextureQueue(const std::vector<std::string> &files, size_t ahead, size_t maxBytes, size_t expectedBytes, size_t threads);
+
+    /*!
+     * \brief Stops the workers, textures which were not handed out are dropped.
+     */
+    ~TextureQueue();
+
+    /*!
+     * \brief next  Waits for the next texture of the list.
+     * \return      The texture, in the channel order of the file (BGR for color images), empty if it could not be read.
+     */
+    cv::Mat next();
+
+    /*!
+     * \brief readTexture   Decodes a texture, keeping its bit depth and channels.
+     * \return              The texture, in the channel order of the file, empty if it could not be read.
+     */
+    static cv::Mat readTexture(const std::string &file);
+
+private:
+    void work();
+
+    std::vector<std::string> files_;    /**< The paths of the textures. */
+    std::vector<cv::Mat> textures_;     /**< The decoded textures which were not handed out yet. */
+    std::vector<bool> ready_;           /**< True for the textures which are decoded. */
+
+    size_t ahead_;                      /**< The number of textures decoded ahead of the one in use. */
+    size_t maxBytes_;                   /**< The memory budget of the textures decoded ahead, 0 if unlimited. */
+    size_t expectedBytes_;              /**< The size of the largest texture seen. */
+    size_t readyBytes_;                 /**< The size of the decoded textures which were not handed out yet. */
+    size_t decoding_;                   /**< The number of decodes in flight. */
+    size_t nextDecode_;                 /**< The index of the next texture to decode. */
+    size_t nextTake_;                   /**< The index of the next texture to hand out. */
+    bool stop_;                         /**< Set when the workers should exit. */
+
+    boost::mutex mutex_;
+    boost::condition_variable changed_; /**< Signaled when a texture is decoded or handed out. */
+    boost::thread_group workers_;
+};
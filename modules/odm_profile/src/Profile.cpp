@@ -0,0 +1,195 @@
+#include "Profile.hpp"
+
+// C++
+#include <cstdio>
+#include <fstream>
+
+// POSIX
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+namespace
+{
+
+// Writes a string as a JSON string.
+void writeString(std::ostream &out, const std::string &s)
+{
+    out << '"';
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c == '"' || c == '\\')
+        {
+            out << '\\' << s[i];
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+        {
+            out << s[i];
+        }
+    }
+    out << '"';
+}
+
+}
+
+Profile& Profile::instance()
+{
+    static Profile profile;
+    return profile;
+}
+
+Profile::Profile()
+    : enabled_(false)
+{
+}
+
+void Profile::enable(const std::string &program, const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    program_ = program;
+    filename_ = filename;
+    if (!enabled_.load())
+    {
+        start_ = std::chrono::steady_clock::now();
+        enabled_.store(true);
+    }
+}
+
+void Profile::addPhase(const std::string &name, double seconds)
+{
+    if (!isEnabled()) return;
+
+    uint64_t peakBytes = peakResidentBytes();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, size_t>::iterator it = phaseIndices_.find(name);
+    if (it == phaseIndices_.end())
+    {
+        it = phaseIndices_.insert(std::make_pair(name, phases_.size())).first;
+        Phase phase = { name, 0.0, 0, 0 };
+        phases_.push_back(phase);
+    }
+    Phase &phase = phases_[it->second];
+    phase.seconds += seconds;
+    phase.calls++;
+    phase.peakBytes = peakBytes;
+}
+
+void Profile::addCount(const std::string &name, uint64_t count)
+{
+    if (!isEnabled()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    counters_[name] += count;
+}
+
+void Profile::addFileSize(const std::string &name, const std::string &filename)
+{
+    if (!isEnabled()) return;
+
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0)
+    {
+        addCount(name, static_cast<uint64_t>(st.st_size));
+    }
+}
+
+void Profile::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    phases_.clear();
+    phaseIndices_.clear();
+    counters_.clear();
+    start_ = std::chrono::steady_clock::now();
+}
+
+double Profile::getPhaseSeconds(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, size_t>::const_iterator it = phaseIndices_.find(name);
+    return it == phaseIndices_.end() ? 0.0 : phases_[it->second].seconds;
+}
+
+uint64_t Profile::getCount(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, uint64_t>::const_iterator it = counters_.find(name);
+    return it == counters_.end() ? 0 : it->second;
+}
+
+uint64_t Profile::peakResidentBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    // Linux gives kilobytes.
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+bool Profile::write() const
+{
+    if (!isEnabled()) return true;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ofstream out(filename_.c_str());
+    if (!out.is_open())
+    {
+        return false;
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    out.precision(6);
+    out << std::fixed;
+
+    out << "{\n  \"program\": ";
+    writeString(out, program_);
+    out << ",\n  \"wall_seconds\": " << wallSeconds;
+    out << ",\n  \"peak_rss_bytes\": " << peakResidentBytes();
+
+    out << ",\n  \"phases\": [";
+    for (size_t p = 0; p < phases_.size(); ++p)
+    {
+        const Phase &phase = phases_[p];
+        out << (p == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        writeString(out, phase.name);
+        out << ", \"seconds\": " << phase.seconds << ", \"calls\": " << phase.calls
+            << ", \"peak_rss_bytes\": " << phase.peakBytes << "}";
+    }
+    out << (phases_.empty() ? "]" : "\n  ]");
+
+    out << ",\n  \"counters\": {";
+    for (std::map<std::string, uint64_t>::const_iterator it = counters_.begin(); it != counters_.end(); ++it)
+    {
+        out << (it == counters_.begin() ? "\n    " : ",\n    ");
+        writeString(out, it->first);
+        out << ": " << it->second;
+    }
+    out << (counters_.empty() ? "}" : "\n  }");
+    out << "\n}\n";
+
+    return out.good();
+}
+
+ProfilePhase::ProfilePhase(const char *name)
+    : name_(name), enabled_(Profile::instance().isEnabled())
+{
+    if (enabled_)
+    {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+ProfilePhase::~ProfilePhase()
+{
+    if (enabled_)
+    {
+        Profile::instance().addPhase(name_, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// C++
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*!
+ * \brief   The Profile class collects the phase times, counters and peak memory of a run,
+ *          and writes them as a JSON report.
+ * \details There is one profile per process. Until it is enabled every call returns at once,
+ *          so the instrumentation can stay in the hot paths. All methods are thread safe, but
+ *          counts in tight loops should be summed locally and added once per batch.
+ *
+ *          The report holds the program, the wall time since the profile was enabled, the peak
+ *          resident set size, the phases in the order they first ended, with their total time,
+ *          number of calls and the peak resident set size when they last ended, and the counters.
+ */
+class Profile
+{
+public:
+    /*!
+     * \brief instance  The profile of the process.
+     */
+    static Profile& instance();
+
+    /*!
+     * \brief enable    Starts collecting.
+     * \param program   The name of the program in the report.
+     * \param filename  Path of the report written by write().
+     */
+    void enable(const std::string &program, const std::string &filename);
+
+    /*!
+     * \brief isEnabled True if the profile collects.
+     */
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /*!
+     * \brief addPhase  Adds a call of a phase. Phases running on several threads at once add up their times.
+     */
+    void addPhase(const std::string &name, double seconds);
+
+    /*!
+     * \brief addCount  Adds to a counter.
+     */
+    void addCount(const std::string &name, uint64_t count);
+
+    /*!
+     * \brief addFileSize   Adds the size of a file to a counter, as for the bytes read or written.
+     */
+    void addFileSize(const std::string &name, const std::string &filename);
+
+    /*!
+     * \brief reset     Drops the phases and counters collected so far and restarts the wall time.
+     */
+    void reset();
+
+    /*!
+     * \brief getPhaseSeconds   The total time of a phase so far, 0 if it never ended.
+     */
+    double getPhaseSeconds(const std::string &name) const;
+
+    /*!
+     * \brief getCount  The value of a counter so far, 0 if it was never added to.
+     */
+    uint64_t getCount(const std::string &name) const;
+
+    /*!
+     * \brief write     Writes the report, if the profile is enabled.
+     * \return          False if the report could not be written.
+     */
+    bool write() const;
+
+    /*!
+     * \brief getFilename   Path of the report.
+     */
+    const std::string& getFilename() const { return filename_; }
+
+    /*!
+     * \brief peakResidentBytes The peak resident set size of the process so far.
+     */
+    static uint64_t peakResidentBytes();
+
+private:
+    Profile();
+    Profile(const Profile &);
+    Profile& operator=(const Profile &);
+
+    struct Phase
+    {
+        std::string name;       /**< The name of the phase. */
+        double seconds;         /**< The total time of the calls. */
+        uint64_t calls;         /**< The number of calls. */
+        uint64_t peakBytes;     /**< The peak resident set size at the end of the last call. */
+    };
+
+    std::atomic<bool> enabled_;                     /**< True if collecting. */
+    std::string program_;                           /**< The name of the program. */
+    std::string filename_;                          /**< Path of the report. */
+    std::chrono::steady_clock::time_point start_;   /**< When the profile was enabled. */
+
+    mutable std::mutex mutex_;                      /**< Guards the phases and the counters. */
+    std::vector<Phase> phases_;                     /**< The phases, in the order they first ended. */
+    std::map<std::string, size_t> phaseIndices_;    /**< The index of every phase in phases_. */
+    std::map<std::string, uint64_t> counters_;      /**< The counters, by name. */
+};
+
+/*!
+ * \brief   The ProfilePhase class times a phase from its construction to its destruction.
+ */
+class ProfilePhase
+{
+public:
+    explicit ProfilePhase(const char *name);
+    ~ProfilePhase();
+
+private:
+    ProfilePhase(const ProfilePhase &);
+    ProfilePhase& operator=(const ProfilePhase &);
+
+    const char *name_;                              /**< The name of the phase. */
+    bool enabled_;                                  /**< True if the profile was enabled at construction. */
+    std::chrono::steady_clock::time_point start_;   /**< The start of the phase. */
+};
@@ -0,0 +1,104 @@
+#include "FrameFilter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+
+const int maxSmallWidth = 640;      // The width the frames are scaled down to.
+const int maxCorners = 200;         // The corners tracked by the parallax test.
+const size_t minTracked = 20;       // Fewer corners tracked than this count as a new view.
+
+}
+
+FrameFilter::FrameFilter(double minSharpness, double minParallax)
+    : minSharpness_(minSharpness), minParallax_(minParallax), scale_(1.0),
+      accepted_(0), skippedBlurred_(0), skippedStill_(0)
+{
+}
+
+bool FrameFilter::enabled() const
+{
+    return minSharpness_ > 0 || minParallax_ > 0;
+}
+
+double FrameFilter::sharpness(const cv::Mat &small) const
+{
+    cv::Mat laplacian;
+    cv::Laplacian(small, laplacian, CV_64F);
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(laplacian, mean, stddev);
+    return stddev[0] * stddev[0];
+}
+
+bool FrameFilter::medianFlow(const cv::Mat &small, double &flow) const
+{
+    std::vector<cv::Point2f> corners;
+    std::vector<unsigned char> status;
+    std::vector<float> error;
+    cv::calcOpticalFlowPyrLK(lastSmall_, small, lastCorners_, corners, status, error);
+
+    std::vector<double> distances;
+    for (size_t i = 0; i < corners.size(); ++i)
+    {
+        if (status[i])
+        {
+            cv::Point2f d = corners[i] - lastCorners_[i];
+            distances.push_back(std::sqrt(d.x * d.x + d.y * d.y));
+        }
+    }
+    if (distances.size() < minTracked)
+    {
+        return false;
+    }
+
+    std::nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+    flow = distances[distances.size() / 2] / scale_;
+    return true;
+}
+
+bool FrameFilter::accept(const VideoFrame &frame)
+{
+    scale_ = std::min(1.0, static_cast<double>(maxSmallWidth) / frame.gray_.cols);
+    cv::resize(frame.gray_, small_, cv::Size(), scale_, scale_, cv::INTER_AREA);
+
+    std::ostringstream log;
+    if (minSharpness_ > 0)
+    {
+        double s = sharpness(small_);
+        if (s < minSharpness_)
+        {
+            log << "skipping frame " << frame.index_ << ": sharpness " << s << " < " << minSharpness_ << "\n";
+            std::cout << log.str();
+            ++skippedBlurred_;
+            return false;
+        }
+    }
+
+    // Without corners to follow, as for the first frame, the frame counts as a new view.
+    double flow;
+    if (minParallax_ > 0 && !lastCorners_.empty() && medianFlow(small_, flow) && flow < minParallax_)
+    {
+        log << "skipping frame " << frame.index_ << ": parallax " << flow << " < " << minParallax_ << "\n";
+        std::cout << log.str();
+        ++skippedStill_;
+        return false;
+    }
+
+    if (minParallax_ > 0)
+    {
+        cv::swap(lastSmall_, small_);
+        cv::goodFeaturesToTrack(lastSmall_, lastCorners_, maxCorners, 0.01, 8);
+    }
+    ++accepted_;
+    return true;
+}
+
+void FrameFilter::printSummary() const
+{
+    std::cout << "Tracked " << accepted_ << " frames, skipped " << skippedBlurred_ << " blurred and "
+              << skippedStill_ << " without parallax" << std::endl;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "VideoReader.hpp"
+
+/*!
+ * \brief   Skips the frames of the video that add nothing to the tracking.
+ *
+ *          A frame is skipped if it is blurred, by the variance of the Laplacian
+ *          of the frame scaled down to at most 640 pixels wide, or if it moved too
+ *          little since the last tracked frame, by the median optical flow of
+ *          corners of the last tracked frame. The thresholds are read from the
+ *          settings file as "Frames.minSharpness" and "Frames.minParallax" (in
+ *          pixels of the video); a test is off when its threshold is not above 0.
+ */
+class FrameFilter
+{
+public:
+    FrameFilter(double minSharpness, double minParallax);
+
+    /*!
+     * \brief   True if any of the tests is on.
+     */
+    bool enabled() const;
+
+    /*!
+     * \brief   Tests a frame, logging it if it is skipped.
+     * \return  True if the frame is to be tracked.
+     */
+    bool accept(const VideoFrame &frame);
+
+    /*!
+     * \brief   Logs the number of frames tracked and skipped.
+     */
+    void printSummary() const;
+
+private:
+    double sharpness(const cv::Mat &small) const;
+    bool medianFlow(const cv::Mat &small, double &flow) const;
+
+    double minSharpness_;                   /**< The least variance of the Laplacian of a tracked frame. */
+    double minParallax_;                    /**< The least median flow since the last tracked frame, in pixels. */
+
+    cv::Mat small_;                         /**< The scaled down frame being tested. */
+    cv::Mat lastSmall_;                     /**< The scaled down last tracked frame. */
+    std::vector<cv::Point2f> lastCorners_;  /**< The corners of the last tracked frame. */
+    double scale_;                          /**< The scale of the scaled down frames. */
+
+    int accepted_;                          /**< The number of frames tracked. */
+    int skippedBlurred_;                    /**< The number of frames skipped as blurred. */
+    int skippedStill_;                      /**< The number of frames skipped for too little parallax. */
+};
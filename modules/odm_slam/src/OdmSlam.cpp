@@ -5,6 +5,9 @@
 #include <System.h>
 #include <Converter.h>
 
+#include "VideoReader.hpp"
+#include "FrameFilter.hpp"
+
 
 void SaveKeyFrameTrajectory(ORB_SLAM2::Map *map, const string &filename, const string &tracksfile) {
     std::cout << std::endl << "Saving keyframe trajectory to " << filename << " ..." << std::endl;
@@ -65,30 +68,43 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    ORB_SLAM2::System SLAM(argv[1], argv[2], ORB_SLAM2::System::MONOCULAR, true);
+    // The frames are converted to grayscale as the tracker would, by the "Camera.RGB" setting.
+    cv::FileStorage settings(argv[2], cv::FileStorage::READ);
+    int rgb = settings["Camera.RGB"];
+
+    // Blurred frames and frames without parallax are skipped, if set in the settings.
+    double minSharpness = settings["Frames.minSharpness"];
+    double minParallax = settings["Frames.minParallax"];
+    FrameFilter filter(minSharpness, minParallax);
+
+    // Decoding starts while the vocabulary loads.
+    VideoReader reader(cap, rgb != 0, 4);
+    if (filter.enabled()) {
+        reader.setFilter(&filter);
+    }
+    reader.start();
 
-    usleep(10 * 1e6);
+    ORB_SLAM2::System SLAM(argv[1], argv[2], ORB_SLAM2::System::MONOCULAR, true);
 
     std::cout << "Start processing video ..." << std::endl;
 
-    double T = 0.1;  // Seconds between frames
-    cv::Mat im;
-    int num_frames = cap.get(CV_CAP_PROP_FRAME_COUNT);
-    for(int ni = 0;; ++ni){
-        std::cout << "processing frame " << ni << "/" << num_frames << std::endl;
-        // Get frame
-        bool res = false;
-        for (int trial = 0; !res && trial < 20; ++trial) {
-            std::cout << "trial " << trial << std::endl;
-            res = cap.read(im);
-        }
-        if(!res) break;
+    // The video index of every tracked frame, since the timestamps of the tracker come from the container.
+    std::ofstream ftimestamps("FrameTimestamps.txt");
+    ftimestamps << fixed;
 
-        double timestamp = ni * T;
+    int num_frames = reader.frameCount();
+    for (VideoFrame *frame = reader.next(); frame; frame = reader.next()) {
+        std::cout << "processing frame " << frame->index_ << "/" << num_frames << std::endl;
 
-        SLAM.TrackMonocular(im, timestamp);
+        SLAM.TrackMonocular(frame->gray_, frame->timestamp_);
+        ftimestamps << frame->index_ << " " << setprecision(6) << frame->timestamp_ << std::endl;
 
-        //usleep(int(T * 1e6));
+        reader.release();
+    }
+    reader.stop();
+    ftimestamps.close();
+    if (filter.enabled()) {
+        filter.printSummary();
     }
 
     SLAM.Shutdown();
@@ -0,0 +1,141 @@
+#include "VideoReader.hpp"
+#include "FrameFilter.hpp"
+
+#include <algorithm>
+
+VideoReader::VideoReader(cv::VideoCapture &cap, bool rgb, size_t capacity)
+    : cap_(cap), rgb_(rgb), filter_(NULL), frames_(std::max(capacity, static_cast<size_t>(1))),
+      head_(0), count_(0), done_(false), stopped_(false)
+{
+    double fps = cap_.get(CV_CAP_PROP_FPS);
+    frameInterval_ = fps > 0 ? 1.0 / fps : 0.1;
+    frameCount_ = static_cast<int>(cap_.get(CV_CAP_PROP_FRAME_COUNT));
+}
+
+int VideoReader::frameCount() const
+{
+    return frameCount_;
+}
+
+VideoReader::~VideoReader()
+{
+    stop();
+}
+
+void VideoReader::setFilter(FrameFilter *filter)
+{
+    filter_ = filter;
+}
+
+void VideoReader::start()
+{
+    thread_ = std::thread(&VideoReader::run, this);
+}
+
+VideoFrame *VideoReader::next()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this]{ return count_ > 0 || done_; });
+    return count_ > 0 ? &frames_[head_] : NULL;
+}
+
+void VideoReader::release()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        head_ = (head_ + 1) % frames_.size();
+        --count_;
+    }
+    changed_.notify_all();
+}
+
+void VideoReader::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopped_ = true;
+    }
+    changed_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+bool VideoReader::readFrame(VideoFrame &frame, int index, double &lastTimestamp)
+{
+    // Some decoders fail on a frame now and then, so a frame is tried a few times.
+    bool res = false;
+    for (int trial = 0; !res && trial < 20; ++trial)
+    {
+        res = cap_.read(frame.image_);
+    }
+    if (!res)
+    {
+        return false;
+    }
+
+    // Containers without timestamps give none or repeat them; the frame rate is used then.
+    double timestamp = cap_.get(CV_CAP_PROP_POS_MSEC) / 1000.0;
+    if (index > 0 && !(timestamp > lastTimestamp))
+    {
+        timestamp = lastTimestamp + frameInterval_;
+    }
+    lastTimestamp = timestamp;
+
+    frame.index_ = index;
+    frame.timestamp_ = timestamp;
+    if (frame.image_.channels() == 3)
+    {
+        cv::cvtColor(frame.image_, frame.gray_, rgb_ ? CV_RGB2GRAY : CV_BGR2GRAY);
+    }
+    else if (frame.image_.channels() == 4)
+    {
+        cv::cvtColor(frame.image_, frame.gray_, rgb_ ? CV_RGBA2GRAY : CV_BGRA2GRAY);
+    }
+    else
+    {
+        frame.image_.copyTo(frame.gray_);
+    }
+    return true;
+}
+
+void VideoReader::run()
+{
+    double lastTimestamp = 0.0;
+    for (int index = 0;; ++index)
+    {
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this]{ return count_ < frames_.size() || stopped_; });
+            if (stopped_)
+            {
+                break;
+            }
+            slot = (head_ + count_) % frames_.size();
+        }
+
+        // The slot is not seen by the tracker until it is counted, so it is filled without the lock.
+        if (!readFrame(frames_[slot], index, lastTimestamp))
+        {
+            break;
+        }
+        if (filter_ && !filter_->accept(frames_[slot]))
+        {
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++count_;
+        }
+        changed_.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    changed_.notify_all();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+class FrameFilter;
+
+/*!
+ * \brief   A frame of the video, decoded and converted for the tracker.
+ */
+struct VideoFrame
+{
+    int index_;         /**< The index of the frame in the video. */
+    double timestamp_;  /**< The time of the frame in the video, in seconds. */
+    cv::Mat image_;     /**< The decoded frame. */
+    cv::Mat gray_;      /**< The frame in grayscale, as passed to the tracker. */
+};
+
+/*!
+ * \brief   Decodes a video on a producer thread, ahead of the tracker.
+ *
+ *          The frames are decoded and converted to grayscale into a ring of
+ *          preallocated frames, so that decoding overlaps tracking. The
+ *          timestamps come from the container, which handles videos of
+ *          variable frame rate.
+ */
+class VideoReader
+{
+public:
+    /*!
+     * \param cap       The opened video, owned by the caller. Only the reader touches it from start() on.
+     * \param rgb       True if the color frames are to be read as RGB instead of BGR, as "Camera.RGB" of ORB_SLAM2.
+     * \param capacity  The number of frames decoded ahead.
+     */
+    VideoReader(cv::VideoCapture &cap, bool rgb, size_t capacity);
+    ~VideoReader();
+
+    /*!
+     * \brief   Sets the filter of the frames to track, tested on the producer thread. Set before start().
+     */
+    void setFilter(FrameFilter *filter);
+
+    /*!
+     * \brief   The number of frames given by the container, read before decoding starts.
+     */
+    int frameCount() const;
+
+    /*!
+     * \brief   Starts decoding.
+     */
+    void start();
+
+    /*!
+     * \brief   Waits for the next frame.
+     * \return  The frame, owned by the reader until release() is called, or NULL at the end of the video.
+     */
+    VideoFrame *next();
+
+    /*!
+     * \brief   Hands the frame returned by next() back to the producer.
+     */
+    void release();
+
+    /*!
+     * \brief   Stops decoding and waits for the producer thread.
+     */
+    void stop();
+
+private:
+    void run();
+    bool readFrame(VideoFrame &frame, int index, double &lastTimestamp);
+
+    cv::VideoCapture &cap_;         /**< The video. */
+    bool rgb_;                      /**< True if the color frames are RGB. */
+    double frameInterval_;          /**< The time between frames given by the container, used when it gives no timestamps. */
+    int frameCount_;                /**< The number of frames given by the container. */
+    FrameFilter *filter_;           /**< The filter of the frames to track, or NULL to track all. */
+
+    std::vector<VideoFrame> frames_;/**< The ring of frames. */
+    size_t head_;                   /**< The ring index of the next frame for the tracker. */
+    size_t count_;                  /**< The number of frames decoded and not released. */
+    bool done_;                     /**< True once the producer is at the end of the video. */
+    bool stopped_;                  /**< True if the producer is asked to stop. */
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
@@ -1,4 +1,5 @@
 import argparse
+import bisect
 import json
 import os
 import yaml
@@ -11,6 +12,10 @@ from opensfm.io import mkdir_p
 
 SCALE = 50
 
+# Timestamps and video indices of the tracked frames, sorted by timestamp
+FRAME_TIMESTAMPS = []
+FRAME_INDICES = []
+
 
 def parse_orb_slam2_config_file(filename):
     '''
@@ -54,9 +59,38 @@ def camera_from_config(video_filename, config_filename):
     }
 
 
+def load_frame_timestamps(filename):
+    '''
+    Load the video index of every tracked frame, as written by odm_slam.
+    '''
+    frames = []
+    with open(filename) as fin:
+        for line in fin:
+            words = line.split()
+            if len(words) == 2:
+                frames.append((float(words[1]), int(words[0])))
+    frames.sort()
+    FRAME_TIMESTAMPS[:] = [timestamp for timestamp, _ in frames]
+    FRAME_INDICES[:] = [index for _, index in frames]
+
+
+def frame_index_from_timestamp(timestamp):
+    if not FRAME_TIMESTAMPS:
+        # Older runs of odm_slam tracked every frame 0.1 s apart
+        T = 0.1
+        return int(round(timestamp / T))
+
+    # The nearest tracked frame, since the timestamps are written rounded
+    i = bisect.bisect_left(FRAME_TIMESTAMPS, timestamp)
+    if i == len(FRAME_TIMESTAMPS) or (
+            i > 0 and timestamp - FRAME_TIMESTAMPS[i - 1] <
+            FRAME_TIMESTAMPS[i] - timestamp):
+        i -= 1
+    return FRAME_INDICES[i]
+
+
 def shot_id_from_timestamp(timestamp):
-    T = 0.1  # TODO(pau) get this from config
-    i = int(round(timestamp / T))
+    i = frame_index_from_timestamp(timestamp)
     return 'frame{0:06d}.png'.format(i)
 
 
@@ -133,7 +167,6 @@ def extract_keyframes_from_video(video, reconstruction):
     '''
     image_path = 'images'
     mkdir_p(image_path)
-    T = 0.1  # TODO(pau) get this from config
     cap = cv2.VideoCapture(video)
     video_idx = 0
 
@@ -141,7 +174,7 @@ def extract_keyframes_from_video(video, reconstruction):
     for shot_id in shot_ids:
         shot = reconstruction['shots'][shot_id]
         timestamp = shot['created_at']
-        keyframe_idx = int(round(timestamp / T))
+        keyframe_idx = frame_index_from_timestamp(timestamp)
 
         while video_idx <= keyframe_idx:
             for i in range(20):
@@ -177,6 +210,11 @@ if __name__ == '__main__':
         help='config file with camera calibration')
     args = parser.parse_args()
 
+    frame_timestamps = os.path.join(os.path.dirname(args.trajectory),
+                                    'FrameTimestamps.txt')
+    if os.path.exists(frame_timestamps):
+        load_frame_timestamps(frame_timestamps)
+
     r = {
         'cameras': {},
         'shots': {},
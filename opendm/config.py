@@ -637,7 +637,9 @@ def config(argv=None):
                         action=StoreTrue,
                         nargs=0,
                         default=False,
-                        help='Generates a benchmark file with runtime info\n'
+                        help='Generates a benchmark file with runtime info, '
+                             'and a JSON profile of each run of the ODM modules '
+                             'in the "profiles" directory\n'
                              'Default: %(default)s')
     
     parser.add_argument('--debug',
@@ -108,13 +108,14 @@ def dem_to_mesh_gridded(inGeotiff, outMesh, maxVertexCount, verbose=False):
         'outfile': outMesh,
         'infile': outMeshDirty,
         'max_vertex': maxVertexCount,
-        'verbose': '-verbose' if verbose else ''
+        'verbose': '-verbose' if verbose else '',
+        'profile': system.profile_option('odm_cleanmesh')
     }
 
     system.run('{bin}/odm_cleanmesh -inputFile {infile} '
          '-outputFile {outfile} '
          '-removeIslands '
-         '-decimateMesh {max_vertex} {verbose} '.format(**cleanupArgs))
+         '-decimateMesh {max_vertex} {verbose} {profile} '.format(**cleanupArgs))
 
     # Delete intermediate results
     os.remove(outMeshDirty)
@@ -161,13 +162,14 @@ def screened_poisson_reconstruction(inPointCloud, outMesh, depth = 8, samples =
         'outfile': outMesh,
         'infile': outMeshDirty,
         'max_vertex': maxVertexCount,
-        'verbose': '-verbose' if verbose else ''
+        'verbose': '-verbose' if verbose else '',
+        'profile': system.profile_option('odm_cleanmesh')
     }
 
     system.run('{bin}/odm_cleanmesh -inputFile {infile} '
          '-outputFile {outfile} '
          '-removeIslands '
-         '-decimateMesh {max_vertex} {verbose} '.format(**cleanupArgs))
+         '-decimateMesh {max_vertex} {verbose} {profile} '.format(**cleanupArgs))
 
     # Delete intermediate results
     os.remove(outMeshDirty)
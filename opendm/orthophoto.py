@@ -42,11 +42,12 @@ def generate_png(orthophoto_file):
                '--config GDAL_CACHEMAX %s%% ' % (orthophoto_file, orthophoto_png, get_max_memory()))
 
 
-def post_orthophoto_steps(args, bounds_file_path, orthophoto_file):
+def post_orthophoto_steps(args, bounds_file_path, orthophoto_file, has_overviews=False):
     if args.crop > 0:
         Cropper.crop(bounds_file_path, orthophoto_file, get_orthophoto_vars(args), keep_original=not args.optimize_disk_space, warp_options=['-dstalpha'])
+        has_overviews = False
 
-    if args.build_overviews:
+    if args.build_overviews and not has_overviews:
         build_overviews(orthophoto_file)
 
     if args.orthophoto_png:
@@ -7,7 +7,7 @@ from opendm import entwine
 from opendm import io
 from pipes import quote
 
-def filter(input_point_cloud, output_point_cloud, standard_deviation=2.5, meank=16, confidence=None, sample_radius=0, verbose=False):
+def filter(input_point_cloud, output_point_cloud, standard_deviation=2.5, meank=16, confidence=None, sample_radius=0, verbose=False, max_concurrency=None):
     """
     Filters a point cloud
     """
@@ -42,7 +42,9 @@ def filter(input_point_cloud, output_point_cloud, standard_deviation=2.5, meank=
       'meank': meank,
       'verbose': '-verbose' if verbose else '',
       'confidence': '-confidence %s' % confidence if confidence else '',
-      'sample': max(0, sample_radius)
+      'sample': max(0, sample_radius),
+      'threads': '-threads %s' % max_concurrency if max_concurrency else '',
+      'profile': system.profile_option('odm_filterpoints')
     }
 
     system.run('{bin} -inputFile {inputFile} '
@@ -50,7 +52,7 @@ def filter(input_point_cloud, output_point_cloud, standard_deviation=2.5, meank=
          '-sd {sd} '
          '-meank {meank} '
          '-sample {sample} '
-         '{confidence} {verbose} '.format(**filterArgs))
+         '{confidence} {threads} {verbose} {profile} '.format(**filterArgs))
 
     # Remove input file, swap temp file
     if not os.path.exists(output_point_cloud):
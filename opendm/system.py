@@ -95,6 +95,31 @@ def benchmark(start, benchmarking_file, process):
     with open(benchmarking_file, 'a') as b:
         b.write('%s runtime: %s seconds\n' % (process, delta))
 
+profile_dir = None
+
+def set_profile_dir(path):
+    """
+    Makes the ODM modules write a JSON profile of each run into path,
+    see profile_option
+    """
+    global profile_dir
+    mkdir_p(path)
+    profile_dir = path
+
+def profile_option(program):
+    """
+    :return: the "-profile" option for a run of an ODM module, with a file
+    in the profile directory not used by an earlier run, or an empty string
+    if profiles are not written
+    """
+    if profile_dir is None:
+        return ''
+
+    n = 1
+    while os.path.exists(os.path.join(profile_dir, '%s_%s.json' % (program, n))):
+        n += 1
+    return '-profile "%s"' % os.path.join(profile_dir, '%s_%s.json' % (program, n))
+
 def mkdir_p(path):
     """Make a directory including parent directories.
     """
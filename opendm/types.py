@@ -227,6 +227,7 @@ class ODM_Tree(object):
 
         # benchmarking
         self.benchmarking = io.join_paths(self.root_path, 'benchmark.txt')
+        self.profiles = io.join_paths(self.root_path, 'profiles')
         self.dataset_list = io.join_paths(self.root_path, 'img_list.txt')
 
         # opensfm
@@ -272,6 +273,7 @@ class ODM_Tree(object):
         self.odm_georeferencing_proj = 'proj.txt'
         self.odm_georeferencing_model_txt_geo = 'odm_georeferencing_model_geo.txt'
         self.odm_georeferencing_model_obj_geo = 'odm_textured_model_geo.obj'
+        self.odm_georeferencing_model_bin_geo = 'odm_textured_model_geo.odmmesh'
         self.odm_georeferencing_xyz_file = io.join_paths(
             self.odm_georeferencing, 'odm_georeferenced_model.csv')
         self.odm_georeferencing_las_json = io.join_paths(
@@ -47,6 +47,10 @@ class ODMLoadDatasetStage(types.ODM_Stage):
             os.remove(tree.benchmarking)
             with open(tree.benchmarking, 'a') as b:
                 b.write('ODM Benchmarking file created %s\nNumber of Cores: %s\n\n' % (system.now(), context.num_cores))
+
+        if args.time:
+            # The modules write their phase times, memory and counters here
+            system.set_profile_dir(tree.profiles)
     
         # check if the extension is supported
         def supported_extension(file_name):
@@ -27,7 +27,8 @@ class ODMFilterPoints(types.ODM_Stage):
                                 standard_deviation=args.pc_filter, 
                                 confidence=None, 
                                 sample_radius=args.pc_sample,
-                                verbose=args.verbose)
+                                verbose=args.verbose,
+                                max_concurrency=args.max_concurrency)
             
         else:
             log.ODM_WARNING('Found a valid point cloud file in: %s' %
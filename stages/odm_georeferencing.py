@@ -58,6 +58,7 @@ class ODMGeoreferencingStage(types.ODM_Stage):
                 system.mkdir_p(r['georeferencing_dir'])
 
             odm_georeferencing_model_obj_geo = os.path.join(r['texturing_dir'], tree.odm_georeferencing_model_obj_geo)
+            odm_georeferencing_model_bin_geo = os.path.join(r['texturing_dir'], tree.odm_georeferencing_model_bin_geo)
             odm_georeferencing_model_obj = os.path.join(r['texturing_dir'], tree.odm_textured_model_obj)
             odm_georeferencing_log = os.path.join(r['georeferencing_dir'], tree.odm_georeferencing_log)
             odm_georeferencing_transform_file = os.path.join(r['georeferencing_dir'], tree.odm_georeferencing_transform_file)
@@ -81,7 +82,9 @@ class ODMGeoreferencingStage(types.ODM_Stage):
                     'output_pc_file': tree.odm_georeferencing_model_laz,
                     'geo_sys': odm_georeferencing_model_txt_geo_file,
                     'model_geo': odm_georeferencing_model_obj_geo,
-                    'verbose': verbose
+                    'model_bin_geo': odm_georeferencing_model_bin_geo,
+                    'verbose': verbose,
+                    'profile': system.profile_option('odm_georef')
                 }
 
                 if transformPointCloud:
@@ -97,14 +100,14 @@ class ODMGeoreferencingStage(types.ODM_Stage):
                 if io.file_exists(tree.opensfm_transformation) and io.file_exists(tree.odm_georeferencing_coords):
                     log.ODM_INFO('Running georeferencing with OpenSfM transformation matrix')
                     system.run('{bin}/odm_georef -bundleFile {bundle} -inputTransformFile {input_trans_file} -inputCoordFile {coords} '
-                               '-inputFile {model} -outputFile {model_geo} '
-                               '{pc_params} {verbose} '
+                               '-inputFile {model} -outputFile {model_geo} -outputBinaryMeshFile {model_bin_geo} '
+                               '{pc_params} {verbose} {profile} '
                                '-logFile {log} -outputTransformFile {transform_file} -georefFileOutputPath {geo_sys}'.format(**kwargs))
                 elif io.file_exists(tree.odm_georeferencing_coords):
                     log.ODM_INFO('Running georeferencing with generated coords file.')
                     system.run('{bin}/odm_georef -bundleFile {bundle} -inputCoordFile {coords} '
-                               '-inputFile {model} -outputFile {model_geo} '
-                               '{pc_params} {verbose} '
+                               '-inputFile {model} -outputFile {model_geo} -outputBinaryMeshFile {model_bin_geo} '
+                               '{pc_params} {verbose} {profile} '
                                '-logFile {log} -outputTransformFile {transform_file} -georefFileOutputPath {geo_sys}'.format(**kwargs))
                 else:
                     log.ODM_WARNING('Georeferencing failed. Make sure your '
@@ -7,7 +7,7 @@ from opendm import context
 from opendm import types
 from opendm import gsd
 from opendm import orthophoto
-from opendm.concurrency import get_max_memory
+from opendm.concurrency import get_max_memory_mb
 from opendm.cutline import compute_cutline
 from pipes import quote
 from opendm import pseudogeo
@@ -43,7 +43,10 @@ class ODMOrthoPhotoStage(types.ODM_Stage):
                 'corners': tree.odm_orthophoto_corners,
                 'res': resolution,
                 'bands': '',
-                'verbose': verbose
+                'threads': args.max_concurrency,
+                'max_memory_mb': int(get_max_memory_mb()),
+                'verbose': verbose,
+                'profile': system.profile_option('odm_orthophoto')
             }
 
             # Check if the georef object is initialized
@@ -70,65 +73,53 @@ class ODMOrthoPhotoStage(types.ODM_Stage):
             else:
                 model_file = tree.odm_textured_model_obj
 
+            def find_model(model_dir, obj_file):
+                # Prefer the binary mesh written by odm_georef, which loads without parsing
+                if obj_file == tree.odm_georeferencing_model_obj_geo:
+                    bin_model = os.path.join(model_dir, tree.odm_georeferencing_model_bin_geo)
+                    if io.file_exists(bin_model):
+                        return bin_model
+                return os.path.join(model_dir, obj_file)
+
             if reconstruction.multi_camera:
                 for band in reconstruction.multi_camera:
                     primary = band == reconstruction.multi_camera[0]
                     subdir = ""
                     if not primary:
                         subdir = band['name'].lower()
-                    models.append(os.path.join(base_dir, subdir, model_file))
+                    models.append(find_model(os.path.join(base_dir, subdir), model_file))
                 kwargs['bands'] = '-bands %s' % (','.join([quote(b['name'].lower()) for b in reconstruction.multi_camera]))
             else:
-                models.append(os.path.join(base_dir, model_file))
+                models.append(find_model(base_dir, model_file))
 
             kwargs['models'] = ','.join(map(quote, models))
 
+            georeferenced = reconstruction.is_georeferenced() and reconstruction.georef.valid_utm_offsets()
+            internal_overviews = georeferenced and args.build_overviews and args.crop == 0
+            kwargs['georef'] = ''
+
+            if georeferenced:
+                # Render the final GeoTIFF directly, instead of rewriting it with gdal_translate
+                orthophoto_vars = orthophoto.get_orthophoto_vars(args)
+                kwargs['georef'] = '-srs {} -utmOffset {} {} {} {}'.format(
+                    quote(reconstruction.georef.proj4()),
+                    reconstruction.georef.utm_east_offset,
+                    reconstruction.georef.utm_north_offset,
+                    ' '.join(['-co %s=%s' % (k, orthophoto_vars[k]) for k in orthophoto_vars]),
+                    '-overviews 2,4,8,16' if internal_overviews else '')
+                log.ODM_INFO('Creating GeoTIFF')
+
             # run odm_orthophoto
             system.run('{bin}/odm_orthophoto -inputFiles {models} '
                        '-logFile {log} -outputFile {ortho} -resolution {res} {verbose} '
-                       '-outputCornerFile {corners} {bands}'.format(**kwargs))
+                       '-outputCornerFile {corners} {bands} -threads {threads} -maxMemory {max_memory_mb} {georef} {profile}'.format(**kwargs))
 
             # Create georeferenced GeoTiff
             geotiffcreated = False
 
-            if reconstruction.is_georeferenced() and reconstruction.georef.valid_utm_offsets():
-                ulx = uly = lrx = lry = 0.0
-                with open(tree.odm_orthophoto_corners) as f:
-                    for lineNumber, line in enumerate(f):
-                        if lineNumber == 0:
-                            tokens = line.split(' ')
-                            if len(tokens) == 4:
-                                ulx = float(tokens[0]) + \
-                                    float(reconstruction.georef.utm_east_offset)
-                                lry = float(tokens[1]) + \
-                                    float(reconstruction.georef.utm_north_offset)
-                                lrx = float(tokens[2]) + \
-                                    float(reconstruction.georef.utm_east_offset)
-                                uly = float(tokens[3]) + \
-                                    float(reconstruction.georef.utm_north_offset)
-                log.ODM_INFO('Creating GeoTIFF')
-
-                orthophoto_vars = orthophoto.get_orthophoto_vars(args)
-
-                kwargs = {
-                    'ulx': ulx,
-                    'uly': uly,
-                    'lrx': lrx,
-                    'lry': lry,
-                    'vars': ' '.join(['-co %s=%s' % (k, orthophoto_vars[k]) for k in orthophoto_vars]),
-                    'proj': reconstruction.georef.proj4(),
-                    'input': tree.odm_orthophoto_render,
-                    'output': tree.odm_orthophoto_tif,
-                    'log': tree.odm_orthophoto_tif_log,
-                    'max_memory': get_max_memory(),
-                }
-
-                system.run('gdal_translate -a_ullr {ulx} {uly} {lrx} {lry} '
-                           '{vars} '
-                           '-a_srs \"{proj}\" '
-                           '--config GDAL_CACHEMAX {max_memory}% '
-                           '--config GDAL_TIFF_INTERNAL_MASK YES '
-                           '{input} {output} > {log}'.format(**kwargs))
+            if georeferenced and io.file_exists(tree.odm_orthophoto_render):
+                # Renamed only once complete, so that a failed render is not picked up on rerun
+                os.rename(tree.odm_orthophoto_render, tree.odm_orthophoto_tif)
 
                 bounds_file_path = os.path.join(tree.odm_georeferencing, 'odm_georeferenced_model.bounds.gpkg')
                     
@@ -148,7 +139,7 @@ class ODMOrthoPhotoStage(types.ODM_Stage):
                                            os.path.join(tree.odm_orthophoto, "odm_orthophoto_cut.tif"),
                                            blend_distance=20, only_max_coords_feature=True)
 
-                orthophoto.post_orthophoto_steps(args, bounds_file_path, tree.odm_orthophoto_tif)
+                orthophoto.post_orthophoto_steps(args, bounds_file_path, tree.odm_orthophoto_tif, has_overviews=internal_overviews)
 
                 # Generate feathered orthophoto also
                 if args.orthophoto_cutline: